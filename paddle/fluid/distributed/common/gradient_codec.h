@@ -0,0 +1,232 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "paddle/fluid/platform/float16.h"
+
+namespace paddle {
+namespace distributed {
+
+// The types the gradients pushed to a table are compressed in, set by
+// TableAccessorParameter.gradient_compress_type.
+//   fp16: every value as a float16
+//   int8: every row as a float scale and a int8 per value
+enum GradientCompressType : uint32_t {
+  GRADIENT_COMPRESS_NONE = 0,
+  GRADIENT_COMPRESS_FP16 = 1,
+  GRADIENT_COMPRESS_INT8 = 2,
+};
+
+// the dense gradients are compressed by rows of this many values
+static const size_t kDenseGradientRowSize = 1024;
+
+inline GradientCompressType ParseGradientCompressType(const std::string& str) {
+  if (str == "fp16") {
+    return GRADIENT_COMPRESS_FP16;
+  } else if (str == "int8") {
+    return GRADIENT_COMPRESS_INT8;
+  }
+  return GRADIENT_COMPRESS_NONE;
+}
+
+inline size_t GradientRowCompressedSize(GradientCompressType type,
+                                        size_t dim) {
+  switch (type) {
+    case GRADIENT_COMPRESS_FP16:
+      return dim * sizeof(platform::float16);
+    case GRADIENT_COMPRESS_INT8:
+      return sizeof(float) + dim * sizeof(int8_t);
+    default:
+      return dim * sizeof(float);
+  }
+}
+
+// The bytes of num values compressed by rows of dim, the last row holds the
+// num % dim values left.
+inline size_t GradientCompressedSize(GradientCompressType type, size_t num,
+                                     size_t dim) {
+  if (dim == 0) {
+    return 0;
+  }
+  size_t size = num / dim * GradientRowCompressedSize(type, dim);
+  if (num % dim != 0) {
+    size += GradientRowCompressedSize(type, num % dim);
+  }
+  return size;
+}
+
+// Compresses values + residual to out, and keeps in residual what the
+// compression loses, to be pushed with the next gradients (error feedback).
+// residual may be nullptr.
+inline void CompressGradientRow(GradientCompressType type, const float* values,
+                                size_t dim, float* residual, char* out) {
+  if (type == GRADIENT_COMPRESS_FP16) {
+    platform::float16* res = reinterpret_cast<platform::float16*>(out);
+    for (size_t i = 0; i < dim; ++i) {
+      float value = residual ? values[i] + residual[i] : values[i];
+      platform::float16 half(value);
+      memcpy(res + i, &half, sizeof(half));
+      if (residual) {
+        residual[i] = value - static_cast<float>(half);
+      }
+    }
+    return;
+  }
+  if (type == GRADIENT_COMPRESS_INT8) {
+    float max_abs = 0;
+    for (size_t i = 0; i < dim; ++i) {
+      float value = residual ? values[i] + residual[i] : values[i];
+      max_abs = std::max(max_abs, std::fabs(value));
+    }
+    float scale = max_abs / 127;
+    memcpy(out, &scale, sizeof(float));
+    int8_t* res = reinterpret_cast<int8_t*>(out + sizeof(float));
+    for (size_t i = 0; i < dim; ++i) {
+      float value = residual ? values[i] + residual[i] : values[i];
+      int8_t q = 0;
+      if (scale > 0) {
+        q = static_cast<int8_t>(
+            std::max(-127.f, std::min(127.f, std::round(value / scale))));
+      }
+      res[i] = q;
+      if (residual) {
+        residual[i] = value - q * scale;
+      }
+    }
+    return;
+  }
+  if (residual) {
+    for (size_t i = 0; i < dim; ++i) {
+      float value = values[i] + residual[i];
+      memcpy(out + i * sizeof(float), &value, sizeof(float));
+      residual[i] = 0;
+    }
+  } else {
+    memcpy(out, values, dim * sizeof(float));
+  }
+}
+
+inline void DecompressGradientRow(GradientCompressType type, const char* data,
+                                  size_t dim, float* res) {
+  if (type == GRADIENT_COMPRESS_FP16) {
+    for (size_t i = 0; i < dim; ++i) {
+      platform::float16 half;
+      memcpy(&half, data + i * sizeof(half), sizeof(half));
+      res[i] = static_cast<float>(half);
+    }
+  } else if (type == GRADIENT_COMPRESS_INT8) {
+    float scale;
+    memcpy(&scale, data, sizeof(float));
+    const int8_t* q = reinterpret_cast<const int8_t*>(data + sizeof(float));
+    for (size_t i = 0; i < dim; ++i) {
+      res[i] = q[i] * scale;
+    }
+  } else {
+    memcpy(res, data, dim * sizeof(float));
+  }
+}
+
+// Compresses num contiguous values by rows of dim, as a dense gradient.
+inline void CompressGradient(GradientCompressType type, const float* values,
+                             size_t num, size_t dim, float* residual,
+                             char* out) {
+  if (dim == 0) {
+    return;
+  }
+  for (size_t begin = 0; begin < num; begin += dim) {
+    size_t row_dim = std::min(dim, num - begin);
+    CompressGradientRow(type, values + begin, row_dim,
+                        residual ? residual + begin : nullptr, out);
+    out += GradientRowCompressedSize(type, row_dim);
+  }
+}
+
+inline void DecompressGradient(GradientCompressType type, const char* data,
+                               size_t num, size_t dim, float* res) {
+  if (dim == 0) {
+    return;
+  }
+  for (size_t begin = 0; begin < num; begin += dim) {
+    size_t row_dim = std::min(dim, num - begin);
+    DecompressGradientRow(type, data, row_dim, res + begin);
+    data += GradientRowCompressedSize(type, row_dim);
+  }
+}
+
+// The residuals of the sparse rows pushed by a trainer, of at most capacity
+// rows. A residual whose values are all within epsilon is not kept, what it
+// would add to the next push is negligible, and the rows pushed least
+// recently are dropped first past the capacity. Not thread safe.
+class SparseGradientResidual {
+ public:
+  SparseGradientResidual(size_t capacity, float epsilon)
+      : _capacity(capacity), _epsilon(epsilon) {}
+
+  // CompressGradientRow with the residual of key.
+  void CompressRow(GradientCompressType type, uint64_t key,
+                   const float* values, size_t dim, char* out) {
+    auto iter = _index.find(key);
+    if (iter == _index.end()) {
+      _rows.emplace_front(key, std::vector<float>(dim, 0));
+      iter = _index.emplace(key, _rows.begin()).first;
+    } else {
+      _rows.splice(_rows.begin(), _rows, iter->second);
+    }
+    auto& residual = iter->second->second;
+    residual.resize(dim);
+    CompressGradientRow(type, values, dim, residual.data(), out);
+    bool negligible = true;
+    for (size_t i = 0; negligible && i < dim; ++i) {
+      negligible = std::fabs(residual[i]) <= _epsilon;
+    }
+    if (negligible) {
+      _rows.erase(iter->second);
+      _index.erase(iter);
+    }
+    while (_index.size() > _capacity) {
+      _index.erase(_rows.back().first);
+      _rows.pop_back();
+    }
+  }
+
+  // The residual kept of key, nullptr if none.
+  const std::vector<float>* Find(uint64_t key) const {
+    auto iter = _index.find(key);
+    return iter == _index.end() ? nullptr : &iter->second->second;
+  }
+
+  size_t size() const { return _index.size(); }
+
+ private:
+  typedef std::list<std::pair<uint64_t, std::vector<float>>> RowList;
+
+  size_t _capacity;
+  float _epsilon;
+  // the most recently pushed first
+  RowList _rows;
+  std::unordered_map<uint64_t, RowList::iterator> _index;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,155 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#include <fstream>
+#include <future>  // NOLINT
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <ThreadPool.h>
+#include "glog/logging.h"
+#include "paddle/fluid/distributed/table/depends/binary_checkpoint.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/platform/port.h"
+
+namespace paddle {
+namespace distributed {
+
+// Merges the binary base checkpoint of one pserver and the delta checkpoints
+// saved after it into a new base checkpoint, so that a restore does not have
+// to replay a long delta chain. Every prefix is the value path of the text
+// format with or without the ".txt", e.g. "model/emb.shard/emb.block0".
+class CheckpointCompactor {
+ public:
+  CheckpointCompactor() {}
+  ~CheckpointCompactor() {}
+
+  int64_t Compact(const std::string &base,
+                  const std::vector<std::string> &deltas,
+                  const std::string &output, const int thread_num) {
+    auto base_prefix = BinaryCheckpointPrefix(base);
+    auto output_prefix = BinaryCheckpointPrefix(output);
+
+    std::vector<std::string> delta_prefixes;
+    std::vector<BinaryIndex> indexes;
+    indexes.emplace_back(base_prefix + PSERVER_SAVE_INDEX_SUFFIX);
+    for (auto &delta : deltas) {
+      delta_prefixes.push_back(BinaryCheckpointPrefix(delta));
+      indexes.emplace_back(delta_prefixes.back() + PSERVER_SAVE_INDEX_SUFFIX);
+    }
+    for (size_t x = 1; x < indexes.size(); ++x) {
+      PADDLE_ENFORCE_EQ(
+          indexes[x].shards.size() == indexes[0].shards.size() &&
+              indexes[x].value_length == indexes[0].value_length,
+          true, platform::errors::InvalidArgument(
+                    "Delta checkpoint %s does not match the base %s.",
+                    delta_prefixes[x - 1], base_prefix));
+    }
+
+    MkDirRecursively(DirName(output_prefix).c_str());
+
+    BinaryIndex output_index;
+    output_index.mode = 1;  // SaveMode::base
+    output_index.value_length = indexes[0].value_length;
+    output_index.shards.resize(indexes[0].shards.size());
+
+    // every shard is merged in memory, thread_num bounds the memory used
+    ::ThreadPool pool(thread_num > 0 ? thread_num : 1);
+    std::vector<std::future<int64_t>> tasks;
+    for (size_t shard_id = 0; shard_id < output_index.shards.size();
+         ++shard_id) {
+      tasks.emplace_back(pool.enqueue([&, shard_id]() -> int64_t {
+        return CompactShard(base_prefix, delta_prefixes, output_prefix,
+                            indexes, shard_id, &output_index.shards[shard_id]);
+      }));
+    }
+    int64_t total = 0;
+    for (auto &task : tasks) {
+      total += task.get();
+    }
+
+    output_index.Save(output_prefix + PSERVER_SAVE_INDEX_SUFFIX);
+    SaveMeta(base_prefix + ".meta", output_prefix + ".meta", total);
+    VLOG(0) << "compact " << base_prefix << " with " << deltas.size()
+            << " deltas into " << output_prefix << ", " << total << " rows";
+    return total;
+  }
+
+ private:
+  int64_t CompactShard(const std::string &base,
+                       const std::vector<std::string> &deltas,
+                       const std::string &output,
+                       const std::vector<BinaryIndex> &indexes,
+                       const int shard_id, BinaryShardIndex *output_index) {
+    const int value_length = indexes[0].value_length;
+    const size_t row_bytes =
+        sizeof(BinaryRowHeader) + sizeof(float) * value_length;
+    std::unordered_map<uint64_t, std::string> rows;
+
+    BinaryRowHeader row;
+    const float *values = nullptr;
+    std::vector<uint64_t> erased;
+    for (size_t x = 0; x < indexes.size(); ++x) {
+      auto &prefix = x == 0 ? base : deltas[x - 1];
+      BinaryShardReader reader(BinaryShardPath(prefix, shard_id),
+                               indexes[x].shards[shard_id], value_length);
+      while (reader.Next(&row, &values)) {
+        auto &bytes = rows[row.id];
+        bytes.resize(row_bytes);
+        std::memcpy(&bytes[0], &row, sizeof(row));
+        std::memcpy(&bytes[sizeof(row)], values, row_bytes - sizeof(row));
+      }
+      reader.ReadErased(&erased);
+      for (auto id : erased) {
+        rows.erase(id);
+      }
+    }
+
+    output_index->shard_id = shard_id;
+    BinaryShardWriter writer(BinaryShardPath(output, shard_id), value_length,
+                             kBlockRows, output_index);
+    for (auto &kv : rows) {
+      std::memcpy(&row, kv.second.data(), sizeof(row));
+      writer.Append(row, reinterpret_cast<const float *>(kv.second.data() +
+                                                        sizeof(row)));
+    }
+    writer.Finish({});
+    return output_index->rows;
+  }
+
+  // The meta of the base is kept, with the count of the merged rows.
+  void SaveMeta(const std::string &base_meta, const std::string &output_meta,
+                const int64_t total) {
+    std::ifstream is(base_meta);
+    PADDLE_ENFORCE_EQ(is.is_open(), true,
+                      platform::errors::NotFound("Cannot open meta %s.",
+                                                 base_meta));
+    std::ofstream os(output_meta);
+    std::string line;
+    while (std::getline(is, line)) {
+      if (StartWith(line, "count=")) {
+        line = "count=" + std::to_string(total);
+      }
+      os << line << "\n";
+    }
+  }
+
+  static constexpr size_t kBlockRows = 4096;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -24,6 +24,7 @@
 #include "boost/lexical_cast.hpp"
 #include "glog/logging.h"
 #include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/table/depends/binary_checkpoint.h"
 #include "paddle/fluid/framework/blocking_queue.h"
 #include "paddle/fluid/framework/dim.h"
 #include "paddle/fluid/framework/framework.pb.h"
@@ -47,6 +48,43 @@ inline double GetCurrentUS() {
 namespace paddle {
 namespace distributed {
 
+// Reads the rows of a binary sparse checkpoint shard by shard, in the order
+// they were saved.
+class BinaryRowStream {
+ public:
+  explicit BinaryRowStream(const std::string &prefix)
+      : prefix_(prefix), index_(prefix + PSERVER_SAVE_INDEX_SUFFIX) {}
+
+  int value_length() const { return index_.value_length; }
+
+  bool Next(BinaryRowHeader *row, const float **values) {
+    while (true) {
+      if (!reader_) {
+        if (shard_ == index_.shards.size()) {
+          return false;
+        }
+        auto &shard = index_.shards[shard_];
+        reader_.reset(new BinaryShardReader(
+            BinaryShardPath(prefix_, shard.shard_id), shard,
+            index_.value_length));
+      }
+      if (reader_->Next(row, values)) {
+        return true;
+      }
+      reader_.reset();
+      ++shard_;
+    }
+  }
+
+ private:
+  std::string prefix_;
+  BinaryIndex index_;
+  std::unique_ptr<BinaryShardReader> reader_;
+  size_t shard_{0};
+};
+
+// Inputs are the value paths of the text format, a binary checkpoint saved
+// next to one is read instead, as CommonSparseTable::load does.
 class ShardingMerge {
  public:
   ShardingMerge() {}
@@ -56,6 +94,12 @@ class ShardingMerge {
              const std::vector<int64_t> &feasigns, const std::string &output,
              const int embedding_dim) {
     pool_.reset(new ::ThreadPool(inputs.size()));
+    binary_.resize(inputs.size());
+    for (size_t x = 0; x < inputs.size(); ++x) {
+      std::ifstream index_file(BinaryCheckpointPrefix(inputs[x]) +
+                               PSERVER_SAVE_INDEX_SUFFIX);
+      binary_[x] = index_file.good();
+    }
 
     std::vector<std::future<int>> tasks(inputs.size());
     std::vector<std::vector<int64_t>> rows;
@@ -64,7 +108,11 @@ class ShardingMerge {
     auto begin = GetCurrentUS();
     for (int x = 0; x < inputs.size(); ++x) {
       tasks[x] = pool_->enqueue([this, x, &rows, &inputs, &feasigns]() -> int {
-        DeserializeRowsFromFile(inputs[x], feasigns[x], &rows[x]);
+        if (binary_[x]) {
+          DeserializeRowsFromBinary(inputs[x], feasigns[x], &rows[x]);
+        } else {
+          DeserializeRowsFromFile(inputs[x], feasigns[x], &rows[x]);
+        }
         return 0;
       });
     }
@@ -223,6 +271,16 @@ class ShardingMerge {
     p_write.join();
   }
 
+  void SerializeBinaryValueToVec(BinaryRowStream *in, const int batch,
+                                 const int embedding_dim,
+                                 std::vector<float> *out) {
+    BinaryRowHeader row;
+    const float *values = nullptr;
+    for (int count = 0; count < batch && in->Next(&row, &values); ++count) {
+      out->insert(out->end(), values, values + embedding_dim);
+    }
+  }
+
   void SerializeVecToStream(std::ostream &out,
                             const std::vector<float> &value) {
     out.write(reinterpret_cast<const char *>(value.data()),
@@ -233,10 +291,22 @@ class ShardingMerge {
       std::ostream &out, const std::vector<std::string> &ins,
       const std::vector<std::vector<int>> &batch_buckets,
       const int embedding_dim) {
-    std::vector<std::shared_ptr<std::ifstream>> in_streams;
+    std::vector<std::shared_ptr<std::ifstream>> in_streams(ins.size());
+    std::vector<std::shared_ptr<BinaryRowStream>> binary_streams(ins.size());
 
     for (int x = 0; x < ins.size(); ++x) {
-      in_streams.emplace_back(std::make_shared<std::ifstream>(ins[x]));
+      if (binary_[x]) {
+        binary_streams[x] =
+            std::make_shared<BinaryRowStream>(BinaryCheckpointPrefix(ins[x]));
+        PADDLE_ENFORCE_LE(
+            embedding_dim, binary_streams[x]->value_length(),
+            platform::errors::InvalidArgument(
+                "The embedding dim %d is larger than the value length %d "
+                "saved in %s.",
+                embedding_dim, binary_streams[x]->value_length(), ins[x]));
+      } else {
+        in_streams[x] = std::make_shared<std::ifstream>(ins[x]);
+      }
     }
 
     std::vector<std::future<int>> tasks(ins.size());
@@ -255,10 +325,15 @@ class ShardingMerge {
 
       for (int x = 0; x < tasks.size(); ++x) {
         tasks[x] =
-            pool_->enqueue([this, b, x, &out, &in_streams, &batch_buckets,
-                            &values, embedding_dim]() -> int {
+            pool_->enqueue([this, b, x, &out, &in_streams, &binary_streams,
+                            &batch_buckets, &values, embedding_dim]() -> int {
               auto batch = batch_buckets[x][b + 1] - batch_buckets[x][b];
               if (batch == 0) return 0;
+              if (binary_[x]) {
+                SerializeBinaryValueToVec(binary_streams[x].get(), batch,
+                                          embedding_dim, &values[x]);
+                return 0;
+              }
               SerializeValueToVec(*(in_streams[x].get()), batch, embedding_dim,
                                   &values[x]);
               return 0;
@@ -304,8 +379,25 @@ class ShardingMerge {
             << input_file;
   }
 
+  void DeserializeRowsFromBinary(const std::string &input_file,
+                                 const int64_t feasigns,
+                                 std::vector<int64_t> *rows) {
+    BinaryRowStream in(BinaryCheckpointPrefix(input_file));
+    BinaryRowHeader row;
+    const float *values = nullptr;
+
+    rows->reserve(feasigns);
+    while (in.Next(&row, &values)) {
+      rows->push_back(static_cast<int64_t>(row.id));
+    }
+
+    VLOG(0) << "parse " << rows->size() << " embedding rows from binary "
+            << BinaryCheckpointPrefix(input_file);
+  }
+
  private:
   std::unique_ptr<::ThreadPool> pool_;
+  std::vector<bool> binary_;
 };
 }  // namespace distributed
 }  // namespace paddle
@@ -14,60 +14,163 @@
 
 #include "paddle/fluid/distributed/index_dataset/index_sampler.h"
 
+#include <algorithm>
+#include <random>
+
+DEFINE_int32(layerwise_sampler_thread_num, 8,
+             "threads of LayerWiseSampler, sampling the targets by chunks");
+
 namespace paddle {
 namespace distributed {
 
+// the targets of a task of the thread pool, sampled with a random engine
+static const size_t kSampleChunkSize = 128;
+
+void LayerWiseSampler::init_layerwise_conf(
+    const std::vector<int>& layer_sample_counts, int start_sample_layer,
+    int seed) {
+  seed_ = seed;
+  start_sample_layer_ = start_sample_layer;
+
+  PADDLE_ENFORCE_GT(
+      start_sample_layer_, 0,
+      paddle::platform::errors::InvalidArgument(
+          "start sampler layer = [%d], it should greater than 0.",
+          start_sample_layer_));
+  PADDLE_ENFORCE_LT(start_sample_layer_, tree_->Height(),
+                    paddle::platform::errors::InvalidArgument(
+                        "start sampler layer = [%d], it should less than "
+                        "max_layer, which is [%d].",
+                        start_sample_layer_, tree_->Height()));
+
+  size_t i = 0;
+  layer_counts_sum_ = 0;
+  layer_counts_.clear();
+  int cur_layer = start_sample_layer_;
+  while (cur_layer < tree_->Height()) {
+    int layer_sample_num = 1;
+    if (i < layer_sample_counts.size()) {
+      layer_sample_num = layer_sample_counts[i];
+    }
+    layer_counts_sum_ += layer_sample_num + 1;
+    layer_counts_.push_back(layer_sample_num);
+    VLOG(3) << "[INFO] level " << cur_layer
+            << " sample_layer_counts.push_back: " << layer_sample_num;
+    cur_layer += 1;
+    i += 1;
+  }
+  reverse(layer_counts_.begin(), layer_counts_.end());
+  VLOG(3) << "sample counts sum: " << layer_counts_sum_;
+
+  auto max_layer = tree_->Height();
+  layer_ids_.clear();
+
+  auto layer_index = max_layer - 1;
+  while (layer_index >= start_sample_layer_) {
+    auto layer_codes = tree_->GetLayerCodes(layer_index);
+    PADDLE_ENFORCE_GT(layer_codes.size(), 1,
+                      paddle::platform::errors::InvalidArgument(
+                          "layer [%d] of the tree has [%d] nodes, it should "
+                          "have more than one to sample negatives from.",
+                          layer_index, layer_codes.size()));
+    std::vector<uint64_t> ids(layer_codes.size());
+    for (size_t x = 0; x < layer_codes.size(); x++) {
+      ids[x] = tree_->GetNodeId(layer_codes[x]);
+    }
+    layer_ids_.push_back(std::move(ids));
+    layer_index--;
+  }
+  thread_pool_.reset(
+      new ::ThreadPool(std::max(FLAGS_layerwise_sampler_thread_num, 1)));
+}
+
 std::vector<std::vector<uint64_t>> LayerWiseSampler::sample(
     const std::vector<std::vector<uint64_t>>& user_inputs,
     const std::vector<uint64_t>& target_ids, bool with_hierarchy) {
   auto input_num = target_ids.size();
+  std::vector<std::vector<uint64_t>> outputs(input_num * layer_counts_sum_);
+  if (input_num == 0) {
+    return outputs;
+  }
+
+  size_t chunk_num = (input_num + kSampleChunkSize - 1) / kSampleChunkSize;
+  uint64_t first_chunk = chunks_.fetch_add(chunk_num);
+  if (chunk_num == 1) {
+    sample_targets(user_inputs, target_ids, with_hierarchy, 0, input_num,
+                   first_chunk, &outputs);
+    return outputs;
+  }
+  std::vector<std::future<void>> tasks(chunk_num);
+  for (size_t chunk = 0; chunk < chunk_num; chunk++) {
+    size_t begin = chunk * kSampleChunkSize;
+    size_t end = std::min(begin + kSampleChunkSize, input_num);
+    tasks[chunk] = thread_pool_->enqueue([&, begin, end, chunk]() {
+      sample_targets(user_inputs, target_ids, with_hierarchy, begin, end,
+                     first_chunk + chunk, &outputs);
+    });
+  }
+  for (auto& task : tasks) {
+    task.get();
+  }
+  return outputs;
+}
+
+void LayerWiseSampler::sample_targets(
+    const std::vector<std::vector<uint64_t>>& user_inputs,
+    const std::vector<uint64_t>& target_ids, bool with_hierarchy, size_t begin,
+    size_t end, uint64_t chunk, std::vector<std::vector<uint64_t>>* outputs) {
   auto user_feature_num = user_inputs[0].size();
-  std::vector<std::vector<uint64_t>> outputs(
-      input_num * layer_counts_sum_,
-      std::vector<uint64_t>(user_feature_num + 2));
+  uint64_t seed = seed_ == 0 ? std::random_device()() : seed_;
+  std::seed_seq seed_seq{seed, chunk};
+  std::mt19937_64 engine(seed_seq);
 
-  auto max_layer = tree_->Height();
-  size_t idx = 0;
-  for (size_t i = 0; i < input_num; i++) {
-    auto travel_codes =
-        tree_->GetTravelCodes(target_ids[i], start_sample_layer_);
-    auto travel_path = tree_->GetNodes(travel_codes);
-    for (size_t j = 0; j < travel_path.size(); j++) {
+  std::vector<uint64_t> user_codes(user_feature_num);
+  std::vector<uint64_t> row_values(user_feature_num + 2);
+  for (size_t i = begin; i < end; i++) {
+    auto target_code = tree_->GetLeafCode(target_ids[i]);
+    PADDLE_ENFORCE_NE(target_code, tree_->max_code_,
+                      paddle::platform::errors::InvalidArgument(
+                          "id = %d doesn't exist in Tree.", target_ids[i]));
+    if (with_hierarchy) {
+      for (size_t k = 0; k < user_feature_num; k++) {
+        user_codes[k] = tree_->GetLeafCode(user_inputs[i][k]);
+      }
+    }
+
+    size_t idx = i * layer_counts_sum_;
+    for (size_t j = 0; j < layer_counts_.size(); j++) {
       // user
-      if (j > 0 && with_hierarchy) {
-        auto ancestor_codes =
-            tree_->GetAncestorCodes(user_inputs[i], max_layer - j - 1);
-        auto hierarchical_user = tree_->GetNodes(ancestor_codes);
-        for (int idx_offset = 0; idx_offset <= layer_counts_[j]; idx_offset++) {
-          for (size_t k = 0; k < user_feature_num; k++) {
-            outputs[idx + idx_offset][k] = hierarchical_user[k].id();
-          }
-        }
-      } else {
-        for (int idx_offset = 0; idx_offset <= layer_counts_[j]; idx_offset++) {
-          for (size_t k = 0; k < user_feature_num; k++) {
-            outputs[idx + idx_offset][k] = user_inputs[i][k];
-          }
+      for (size_t k = 0; k < user_feature_num; k++) {
+        if (j > 0 && with_hierarchy) {
+          row_values[k] =
+              user_codes[k] == tree_->max_code_
+                  ? 0
+                  : tree_->GetNodeId(tree_->GetAncestorCode(user_codes[k], j));
+        } else {
+          row_values[k] = user_inputs[i][k];
         }
       }
 
       // sampler ++
-      outputs[idx][user_feature_num] = travel_path[j].id();
-      outputs[idx][user_feature_num + 1] = 1.0;
-      idx += 1;
+      auto positive = tree_->GetNodeId(tree_->GetAncestorCode(target_code, j));
+      row_values[user_feature_num] = positive;
+      row_values[user_feature_num + 1] = 1;
+      (*outputs)[idx++] = row_values;
+
+      auto& layer_ids = layer_ids_[j];
+      std::uniform_int_distribution<size_t> distribution(0,
+                                                         layer_ids.size() - 1);
+      row_values[user_feature_num + 1] = 0;
       for (int idx_offset = 0; idx_offset < layer_counts_[j]; idx_offset++) {
-        int sample_res = 0;
+        uint64_t negative = 0;
         do {
-          sample_res = sampler_vec_[j]->Sample();
-        } while (layer_ids_[j][sample_res].id() == travel_path[j].id());
-        outputs[idx + idx_offset][user_feature_num] =
-            layer_ids_[j][sample_res].id();
-        outputs[idx + idx_offset][user_feature_num + 1] = 0;
+          negative = layer_ids[distribution(engine)];
+        } while (negative == positive);
+        row_values[user_feature_num] = negative;
+        (*outputs)[idx++] = row_values;
       }
-      idx += layer_counts_[j];
     }
   }
-  return outputs;
 }
 
 }  // end namespace distributed
@@ -13,10 +13,13 @@
 // limitations under the License.
 
 #pragma once
+#include <ThreadPool.h>
+#include <atomic>
+#include <memory>
+#include <string>
 #include <vector>
 #include "paddle/fluid/distributed/index_dataset/index_wrapper.h"
 #include "paddle/fluid/framework/program_desc.h"
-#include "paddle/fluid/operators/math/sampler.h"
 #include "paddle/fluid/platform/enforce.h"
 
 namespace paddle {
@@ -43,6 +46,10 @@ class IndexSampler {
       bool with_hierarchy = false) = 0;
 };
 
+// Samples for every target the nodes on its path from the leaf up to
+// start_sample_layer as positives, each followed by negatives drawn
+// uniformly from its level. The targets are sampled by chunks on a thread
+// pool, every chunk with a random engine of its own.
 class LayerWiseSampler : public IndexSampler {
  public:
   virtual ~LayerWiseSampler() {}
@@ -51,69 +58,29 @@ class LayerWiseSampler : public IndexSampler {
   }
 
   void init_layerwise_conf(const std::vector<int>& layer_sample_counts,
-                           int start_sample_layer, int seed) override {
-    seed_ = seed;
-    start_sample_layer_ = start_sample_layer;
-
-    PADDLE_ENFORCE_GT(
-        start_sample_layer_, 0,
-        paddle::platform::errors::InvalidArgument(
-            "start sampler layer = [%d], it should greater than 0.",
-            start_sample_layer_));
-    PADDLE_ENFORCE_LT(start_sample_layer_, tree_->Height(),
-                      paddle::platform::errors::InvalidArgument(
-                          "start sampler layer = [%d], it should less than "
-                          "max_layer, which is [%d].",
-                          start_sample_layer_, tree_->Height()));
-
-    size_t i = 0;
-    layer_counts_sum_ = 0;
-    layer_counts_.clear();
-    int cur_layer = start_sample_layer_;
-    while (cur_layer < tree_->Height()) {
-      int layer_sample_num = 1;
-      if (i < layer_sample_counts.size()) {
-        layer_sample_num = layer_sample_counts[i];
-      }
-      layer_counts_sum_ += layer_sample_num + 1;
-      layer_counts_.push_back(layer_sample_num);
-      VLOG(3) << "[INFO] level " << cur_layer
-              << " sample_layer_counts.push_back: " << layer_sample_num;
-      cur_layer += 1;
-      i += 1;
-    }
-    reverse(layer_counts_.begin(), layer_counts_.end());
-    VLOG(3) << "sample counts sum: " << layer_counts_sum_;
-
-    auto max_layer = tree_->Height();
-    sampler_vec_.clear();
-    layer_ids_.clear();
-
-    auto layer_index = max_layer - 1;
-    size_t idx = 0;
-    while (layer_index >= start_sample_layer_) {
-      auto layer_codes = tree_->GetLayerCodes(layer_index);
-      layer_ids_.push_back(tree_->GetNodes(layer_codes));
-      auto sampler_temp =
-          std::make_shared<paddle::operators::math::UniformSampler>(
-              layer_ids_[idx].size() - 1, seed_);
-      sampler_vec_.push_back(sampler_temp);
-      layer_index--;
-      idx++;
-    }
-  }
+                           int start_sample_layer, int seed) override;
   std::vector<std::vector<uint64_t>> sample(
       const std::vector<std::vector<uint64_t>>& user_inputs,
       const std::vector<uint64_t>& target_ids, bool with_hierarchy) override;
 
  private:
+  // Fills the rows of the targets [begin, end) in outputs.
+  void sample_targets(const std::vector<std::vector<uint64_t>>& user_inputs,
+                      const std::vector<uint64_t>& target_ids,
+                      bool with_hierarchy, size_t begin, size_t end,
+                      uint64_t chunk,
+                      std::vector<std::vector<uint64_t>>* outputs);
+
   std::vector<int> layer_counts_;
   int64_t layer_counts_sum_{0};
   std::shared_ptr<TreeIndex> tree_{nullptr};
   int seed_{0};
   int start_sample_layer_{1};
-  std::vector<std::shared_ptr<paddle::operators::math::Sampler>> sampler_vec_;
-  std::vector<std::vector<IndexNode>> layer_ids_;
+  // the ids of the nodes of every level sampled, from the leaves up
+  std::vector<std::vector<uint64_t>> layer_ids_;
+  // the chunks sampled so far, numbering the random engines
+  std::atomic<uint64_t> chunks_{0};
+  std::unique_ptr<::ThreadPool> thread_pool_;
 };
 
 }  // end namespace distributed
@@ -9,6 +9,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <thread>
@@ -41,6 +42,10 @@ int TreeIndex::Load(const std::string filename) {
   fake_node_.set_is_leaf(false);
   fake_node_.set_probability(0.0);
   max_code_ = 0;
+  total_nodes_num_ = 0;
+  node_ids_.clear();
+  node_probs_.clear();
+  node_is_leafs_.clear();
   size_t ret = fread(&num, sizeof(num), 1, fp.get());
   while (ret == 1 && num > 0) {
     std::string content(num, '\0');
@@ -74,27 +79,60 @@ int TreeIndex::Load(const std::string filename) {
       if (node.is_leaf()) {
         id_codes_map_[node.id()] = code;
       }
-      data_[code] = node;
       if (node.id() > max_id_) {
         max_id_ = node.id();
       }
       if (code > max_code_) {
         max_code_ = code;
       }
+      if (code >= node_ids_.size()) {
+        size_t size = std::max<size_t>(code + 1, node_ids_.size() * 2);
+        node_ids_.resize(size, 0);
+        node_probs_.resize(size, 0);
+        node_is_leafs_.resize(size, 0);
+      }
+      total_nodes_num_ += node_ids_[code] == 0 ? 1 : 0;
+      node_ids_[code] = node.id();
+      node_probs_[code] = node.probability();
+      node_is_leafs_[code] = node.is_leaf();
     }
     ret = fread(&num, sizeof(num), 1, fp.get());
   }
-  total_nodes_num_ = data_.size();
   max_code_ += 1;
+  node_ids_.resize(max_code_, 0);
+  node_ids_.shrink_to_fit();
+  node_probs_.resize(max_code_, 0);
+  node_probs_.shrink_to_fit();
+  node_is_leafs_.resize(max_code_, 0);
+  node_is_leafs_.shrink_to_fit();
+
+  level_offsets_.resize(meta_.height() + 1);
+  level_sizes_.resize(meta_.height() + 1);
+  level_offsets_[0] = 0;
+  level_sizes_[0] = 1;
+  for (int level = 1; level <= meta_.height(); ++level) {
+    level_offsets_[level] = level_offsets_[level - 1] + level_sizes_[level - 1];
+    level_sizes_[level] = level_sizes_[level - 1] * meta_.branch();
+  }
   return 0;
 }
 
+int TreeIndex::GetCodeLevel(uint64_t code) {
+  return std::upper_bound(level_offsets_.begin(), level_offsets_.end(),
+                          code) -
+         level_offsets_.begin() - 1;
+}
+
 std::vector<IndexNode> TreeIndex::GetNodes(const std::vector<uint64_t>& codes) {
   std::vector<IndexNode> nodes;
   nodes.reserve(codes.size());
   for (size_t i = 0; i < codes.size(); i++) {
     if (CheckIsValid(codes[i])) {
-      nodes.push_back(data_.at(codes[i]));
+      IndexNode node;
+      node.set_id(node_ids_[codes[i]]);
+      node.set_is_leaf(node_is_leafs_[codes[i]]);
+      node.set_probability(node_probs_[codes[i]]);
+      nodes.push_back(std::move(node));
     } else {
       nodes.push_back(fake_node_);
     }
@@ -103,14 +141,16 @@ std::vector<IndexNode> TreeIndex::GetNodes(const std::vector<uint64_t>& codes) {
 }
 
 std::vector<uint64_t> TreeIndex::GetLayerCodes(int level) {
-  uint64_t level_num = static_cast<uint64_t>(std::pow(meta_.branch(), level));
-  uint64_t level_offset = level_num - 1;
-
   std::vector<uint64_t> res;
-  res.reserve(level_num);
-  for (uint64_t i = 0; i < level_num; i++) {
-    auto code = level_offset + i;
-    if (CheckIsValid(code)) {
+  if (level < 0 || level >= meta_.height()) {
+    return res;
+  }
+  auto code_min = level_offsets_[level];
+  auto code_max = std::min<uint64_t>(level_offsets_[level + 1], max_code_);
+
+  res.reserve(code_max > code_min ? code_max - code_min : 0);
+  for (auto code = code_min; code < code_max; code++) {
+    if (node_ids_[code] != 0) {
       res.push_back(code);
     }
   }
@@ -119,51 +159,45 @@ std::vector<uint64_t> TreeIndex::GetLayerCodes(int level) {
 
 std::vector<uint64_t> TreeIndex::GetAncestorCodes(
     const std::vector<uint64_t>& ids, int level) {
-  std::vector<uint64_t> res;
-  res.reserve(ids.size());
-
-  int cur_level;
+  std::vector<uint64_t> res(ids.size());
+  int steps = level >= 0 ? std::max(meta_.height() - 1 - level, 0) : 0;
   for (size_t i = 0; i < ids.size(); i++) {
-    if (id_codes_map_.find(ids[i]) == id_codes_map_.end()) {
-      res.push_back(max_code_);
-    } else {
-      auto code = id_codes_map_.at(ids[i]);
-      cur_level = meta_.height() - 1;
-
-      while (level >= 0 && cur_level > level) {
-        code = (code - 1) / meta_.branch();
-        cur_level--;
-      }
-      res.push_back(code);
-    }
+    auto code = GetLeafCode(ids[i]);
+    res[i] = code == max_code_ ? max_code_ : GetAncestorCode(code, steps);
   }
   return res;
 }
 
 std::vector<uint64_t> TreeIndex::GetChildrenCodes(uint64_t ancestor,
                                                   int level) {
-  auto level_code_num = static_cast<uint64_t>(std::pow(meta_.branch(), level));
-  auto code_min = level_code_num - 1;
-  auto code_max = meta_.branch() * level_code_num - 1;
+  return GetChildrenCodes(std::vector<uint64_t>{ancestor}, level);
+}
 
-  std::vector<uint64_t> parent;
-  parent.push_back(ancestor);
+std::vector<uint64_t> TreeIndex::GetChildrenCodes(
+    const std::vector<uint64_t>& ancestors, int level) {
   std::vector<uint64_t> res;
-  size_t p_idx = 0;
-  while (true) {
-    size_t p_size = parent.size();
-    for (; p_idx < p_size; p_idx++) {
-      for (int i = 0; i < meta_.branch(); i++) {
-        auto code = parent[p_idx] * meta_.branch() + i + 1;
-        if (data_.find(code) != data_.end()) parent.push_back(code);
-      }
+  if (level < 0 || level >= meta_.height()) {
+    return res;
+  }
+  for (auto ancestor : ancestors) {
+    if (!CheckIsValid(ancestor)) {
+      continue;
     }
-    if ((code_min <= parent[p_idx]) && (parent[p_idx] < code_max)) {
-      break;
+    int steps = level - GetCodeLevel(ancestor);
+    if (steps < 0) {
+      continue;
+    }
+    // the descendants steps levels below are contiguous, in level order
+    auto code_min = ancestor * level_sizes_[steps] + level_offsets_[steps];
+    auto code_max =
+        std::min<uint64_t>(code_min + level_sizes_[steps], max_code_);
+    for (auto code = code_min; code < code_max; code++) {
+      if (node_ids_[code] != 0) {
+        res.push_back(code);
+      }
     }
   }
-
-  return std::vector<uint64_t>(parent.begin() + p_idx, parent.end());
+  return res;
 }
 
 std::vector<uint64_t> TreeIndex::GetTravelCodes(uint64_t id, int start_level) {
@@ -183,13 +217,14 @@ std::vector<uint64_t> TreeIndex::GetTravelCodes(uint64_t id, int start_level) {
 }
 
 std::vector<IndexNode> TreeIndex::GetAllLeafs() {
-  std::vector<IndexNode> res;
-  res.reserve(id_codes_map_.size());
-  for (auto& ite : id_codes_map_) {
-    auto code = ite.second;
-    res.push_back(data_.at(code));
+  std::vector<uint64_t> codes;
+  codes.reserve(id_codes_map_.size());
+  for (uint64_t code = 0; code < max_code_; code++) {
+    if (node_ids_[code] != 0 && node_is_leafs_[code]) {
+      codes.push_back(code);
+    }
   }
-  return res;
+  return GetNodes(codes);
 }
 
 }  // end namespace distributed
@@ -10,6 +10,7 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #pragma once
+#include <algorithm>
 #include <cmath>
 #include <memory>
 #include <string>
@@ -29,6 +30,11 @@ class Index {
   ~Index() {}
 };
 
+// A tree of branch children per node, the nodes stored in arrays by their
+// codes, which number the nodes level by level from the root 0, the children
+// of code being code * branch + 1 to code * branch + branch. The levels are
+// thus contiguous ranges of codes and the ancestors and descendants of a code
+// are computed rather than looked up.
 class TreeIndex : public Index {
  public:
   TreeIndex() {}
@@ -40,12 +46,24 @@ class TreeIndex : public Index {
   uint64_t EmbSize() { return max_id_ + 1; }
   int Load(const std::string path);
 
-  inline bool CheckIsValid(int code) {
-    if (data_.find(code) != data_.end()) {
-      return true;
-    } else {
-      return false;
-    }
+  inline bool CheckIsValid(uint64_t code) {
+    return code < node_ids_.size() && node_ids_[code] != 0;
+  }
+
+  // the id of the node of code, 0 if there is none
+  inline uint64_t GetNodeId(uint64_t code) {
+    return CheckIsValid(code) ? node_ids_[code] : 0;
+  }
+
+  // the code of the leaf of id, max_code_ if there is none
+  inline uint64_t GetLeafCode(uint64_t id) {
+    auto iter = id_codes_map_.find(id);
+    return iter == id_codes_map_.end() ? max_code_ : iter->second;
+  }
+
+  // the ancestor of code steps levels above it
+  inline uint64_t GetAncestorCode(uint64_t code, int steps) {
+    return (code - level_offsets_[steps]) / level_sizes_[steps];
   }
 
   std::vector<IndexNode> GetNodes(const std::vector<uint64_t>& codes);
@@ -53,16 +71,30 @@ class TreeIndex : public Index {
   std::vector<uint64_t> GetAncestorCodes(const std::vector<uint64_t>& ids,
                                          int level);
   std::vector<uint64_t> GetChildrenCodes(uint64_t ancestor, int level);
+  // The descendants at level of every ancestor in turn, e.g. the candidates
+  // of a beam one level down.
+  std::vector<uint64_t> GetChildrenCodes(const std::vector<uint64_t>& ancestors,
+                                         int level);
   std::vector<uint64_t> GetTravelCodes(uint64_t id, int start_level);
   std::vector<IndexNode> GetAllLeafs();
 
-  std::unordered_map<uint64_t, IndexNode> data_;
   std::unordered_map<uint64_t, uint64_t> id_codes_map_;
   uint64_t total_nodes_num_;
   TreeMeta meta_;
   uint64_t max_id_;
   uint64_t max_code_;
   IndexNode fake_node_;
+
+ private:
+  int GetCodeLevel(uint64_t code);
+
+  // by code, the ids of the nodes, 0 where there is none
+  std::vector<uint64_t> node_ids_;
+  std::vector<float> node_probs_;
+  std::vector<uint8_t> node_is_leafs_;
+  // by level, its first code and number of codes, branch^level
+  std::vector<uint64_t> level_offsets_;
+  std::vector<uint64_t> level_sizes_;
 };
 
 using TreePtr = std::shared_ptr<TreeIndex>;
@@ -52,6 +52,32 @@ DEFINE_int32(pserver_connect_timeout_ms, 10000,
 
 DEFINE_int32(pserver_sparse_merge_thread, 1, "pserver sparse merge thread num");
 
+DEFINE_int32(pserver_sparse_residual_max_num, 1000000,
+             "max number of sparse rows of a table compressed when pushed "
+             "whose residual is kept, the least recently pushed are dropped");
+DEFINE_double(pserver_sparse_residual_epsilon, 1e-6,
+              "the residual of a sparse row compressed when pushed is not "
+              "kept when all its values are within it");
+DEFINE_int32(pserver_shm_acquire_wait_us, 100,
+             "how long a call waits for a free slot of the shared memory "
+             "channel of a pserver before it goes through brpc");
+DEFINE_int32(pserver_shm_client_thread, 4,
+             "number of threads of a client waiting for the responses of "
+             "its shared memory calls");
+DEFINE_int32(pserver_hot_key_replica_num, 0,
+             "pservers holding a read-only replica of a hot sparse feasign "
+             "besides its owner, 0 to pull every feasign from its owner");
+
+DEFINE_int32(pserver_hot_key_threshold, 1000,
+             "pulls of a sparse feasign in a round for it to be hot");
+
+DEFINE_int32(pserver_hot_key_max_num, 1000,
+             "max hot sparse feasigns of a table");
+
+DEFINE_int32(pserver_hot_key_refresh_ms, 10000,
+             "the round the hot sparse feasigns are found in and their "
+             "replicas written, 0 to refresh them only on demand");
+
 namespace paddle {
 namespace framework {
 class Scope;
@@ -159,6 +185,7 @@ int32_t BrpcPsClient::initialize() {
   // 获取server列表，并连接
   std::vector<PSHost> server_list = _env->get_ps_servers();
   _server_channels.resize(server_list.size());
+  _shm_channels.resize(server_list.size());
   for (size_t i = 0; i < server_list.size(); ++i) {
     server_ip_port.assign(server_list[i].ip.c_str());
     server_ip_port.append(":");
@@ -179,8 +206,55 @@ int32_t BrpcPsClient::initialize() {
         }
       }
     }
+    if (PsShmEnabled(server_list[i].ip, server_list[i].port)) {
+      _shm_channels[i] =
+          PsShmChannel::Open(server_list[i].ip, server_list[i].port);
+      if (_shm_channels[i] == nullptr) {
+        LOG(WARNING) << "BrpcPSclient found no shared memory of Server:"
+                     << server_ip_port << ", use brpc instead";
+      } else {
+        VLOG(0) << "BrpcPSclient connect to Server:" << server_ip_port
+                << " through shared memory";
+      }
+    }
     os << server_ip_port << ",";
   }
+  for (auto &channel : _shm_channels) {
+    if (channel != nullptr) {
+      _shm_wait_pool.reset(
+          new ::ThreadPool(std::max(FLAGS_pserver_shm_client_thread, 1)));
+      break;
+    }
+  }
+  for (auto &iter : _table_accessors) {
+    if (iter.second->gradient_compress_type() != GRADIENT_COMPRESS_NONE) {
+      _gradient_residuals[iter.first].reset(
+          new GradientResidual(FLAGS_pserver_sparse_residual_max_num,
+                               FLAGS_pserver_sparse_residual_epsilon));
+    }
+  }
+  _server_pull_load.reset(new std::atomic<uint64_t>[server_list.size()]);
+  for (size_t i = 0; i < server_list.size(); ++i) {
+    _server_pull_load[i] = 0;
+  }
+  const auto &worker_param = _config.worker_param().downpour_worker_param();
+  if (FLAGS_pserver_hot_key_replica_num > 0 && server_list.size() > 1) {
+    for (int i = 0; i < worker_param.downpour_table_param_size(); ++i) {
+      auto &table_param = worker_param.downpour_table_param(i);
+      if (table_param.type() != PS_SPARSE_TABLE) {
+        continue;
+      }
+      _hot_key_routers[table_param.table_id()].reset(new HotKeyRouter(
+          server_list.size(), FLAGS_pserver_hot_key_replica_num,
+          FLAGS_pserver_hot_key_threshold, FLAGS_pserver_hot_key_max_num));
+    }
+  }
+  if (!_hot_key_routers.empty() && FLAGS_pserver_hot_key_refresh_ms > 0) {
+    _hot_key_stop = false;
+    _hot_key_thread =
+        std::thread(&BrpcPsClient::hot_key_refresh_loop, this,
+                    static_cast<int>(FLAGS_pserver_hot_key_refresh_ms));
+  }
   // 启动client探听接口, 并相互建立连接
   start_client_service();
 
@@ -189,6 +263,80 @@ int32_t BrpcPsClient::initialize() {
   return 0;
 }
 
+GradientCompressType BrpcPsClient::fill_sparse_push_data(
+    size_t table_id, const uint64_t *keys, const float *const *values,
+    size_t num, std::string *push_data) {
+  auto *accessor = table_accessor(table_id);
+  auto residual_iter = _gradient_residuals.find(table_id);
+  GradientCompressType type = residual_iter == _gradient_residuals.end()
+                                  ? GRADIENT_COMPRESS_NONE
+                                  : accessor->gradient_compress_type();
+  size_t dim = accessor->update_dim();
+  size_t value_size = type == GRADIENT_COMPRESS_NONE
+                          ? accessor->update_size()
+                          : GradientRowCompressedSize(type, dim);
+  push_data->resize(num * (sizeof(uint64_t) + value_size));
+  char *push_data_ptr = const_cast<char *>(push_data->data());
+  memcpy(push_data_ptr, keys, num * sizeof(uint64_t));
+  push_data_ptr += num * sizeof(uint64_t);
+  if (type == GRADIENT_COMPRESS_NONE) {
+    for (size_t i = 0; i < num; ++i) {
+      memcpy(push_data_ptr, values[i], value_size);
+      push_data_ptr += value_size;
+    }
+    return type;
+  }
+  auto &residual = *residual_iter->second;
+  std::lock_guard<std::mutex> lock(residual.mutex);
+  for (size_t i = 0; i < num; ++i) {
+    residual.sparse.CompressRow(type, keys[i], values[i], dim, push_data_ptr);
+    push_data_ptr += value_size;
+  }
+  return type;
+}
+
+bool BrpcPsClient::shm_call(size_t server_id, DownpourBrpcClosure *closure,
+                            size_t request_idx, uint32_t num,
+                            const std::function<void(char *)> &fill,
+                            size_t request_size, size_t response_size) {
+  auto channel = _shm_channels[server_id];
+  PsShmClaim claim;
+  if (channel == nullptr ||
+      !channel->Acquire(request_size, response_size,
+                        FLAGS_pserver_shm_acquire_wait_us, &claim)) {
+    return false;
+  }
+  auto *request = closure->request(request_idx);
+  auto *slot = claim.slot;
+  slot->cmd_id = request->cmd_id();
+  slot->table_id = request->table_id();
+  slot->num = num;
+  slot->data_size = request_size;
+  if (fill) {
+    fill(slot->data());
+  }
+  channel->Publish(&claim);
+  _shm_wait_pool->enqueue([channel, claim, closure, request_idx]() mutable {
+    if (!channel->Wait(&claim, FLAGS_pserver_timeout_ms)) {
+      closure->cntl(request_idx)
+          ->SetFailed(brpc::ERPCTIMEDOUT, "shared memory call failed");
+    } else {
+      auto *slot = claim.slot;
+      auto *response = closure->response(request_idx);
+      response->set_err_code(slot->err_code);
+      if (slot->err_code != 0) {
+        response->set_err_msg("server internal error");
+      }
+      closure->cntl(request_idx)
+          ->response_attachment()
+          .append(slot->data(), slot->data_size);
+      channel->Release(&claim);
+    }
+    closure->Run();
+  });
+  return true;
+}
+
 int DownpourBrpcClosure::check_response(size_t request_idx, int cmd_id) {
   if (_cntls[request_idx]->Failed()) {
     LOG(ERROR) << "resquest cmd_id:" << cmd_id << " failed, "
@@ -391,6 +539,7 @@ std::future<int32_t> BrpcPsClient::flush() {
 }
 
 void BrpcPsClient::finalize_worker() {
+  stop_hot_key_refresh();
   flush();
   _running = false;
   _server.Stop(1000);
@@ -566,6 +715,10 @@ std::future<int32_t> BrpcPsClient::pull_dense(Region *regions,
     closure->request(i)->set_client_id(_client_id);
     closure->request(i)->add_params((char *)&num_per_shard,
                                     sizeof(num_per_shard));
+    if (shm_call(i, closure, i, num_per_shard, nullptr, 0,
+                 num_per_shard * accessor->select_size())) {
+      continue;
+    }
     PsService_Stub rpc_stub(get_dense_channel(i));
     rpc_stub.service(closure->cntl(i), closure->request(i),
                      closure->response(i), closure);
@@ -666,8 +819,31 @@ std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient(
   ids.resize(request_call_num);
   value_ptrs.resize(request_call_num);
 
+  // the gradients of a hot feasign are merged to a single push of it
+  auto router_iter = _hot_key_routers.find(table_id);
+  HotKeyRouter *router = router_iter == _hot_key_routers.end()
+                             ? nullptr
+                             : router_iter->second.get();
+  std::unordered_map<uint64_t, size_t> hot_key_rows;
+  std::vector<std::vector<float>> hot_key_values;
+  size_t update_dim = accessor->update_dim();
+
   for (size_t i = 0; i < num; ++i) {
     size_t pserver_idx = keys[i] % request_call_num;
+    if (router != nullptr && router->IsHot(keys[i])) {
+      auto iter = hot_key_rows.find(keys[i]);
+      if (iter != hot_key_rows.end()) {
+        float *row = hot_key_values[iter->second].data();
+        accessor->merge(&row, &update_values[i], update_dim);
+        continue;
+      }
+      hot_key_rows.emplace(keys[i], hot_key_values.size());
+      hot_key_values.emplace_back(update_values[i],
+                                  update_values[i] + update_dim);
+      ids[pserver_idx].push_back(keys[i]);
+      value_ptrs[pserver_idx].push_back(hot_key_values.back().data());
+      continue;
+    }
     ids[pserver_idx].push_back(keys[i]);
     value_ptrs[pserver_idx].push_back(update_values[i]);
   }
@@ -685,15 +861,26 @@ std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient(
     push_request->set_table_id(table_id);
     push_request->set_client_id(_client_id);
     push_request->add_params((char *)&kv_size, sizeof(uint32_t));
-    auto *push_data = push_request->mutable_data();
-    push_data->resize(kv_size * (sizeof(uint64_t) + accessor->update_size()));
-    char *push_data_ptr = const_cast<char *>(push_data->data());
-    memcpy(push_data_ptr, kvs.data(), kv_size * sizeof(uint64_t));
-    push_data_ptr += kv_size * sizeof(uint64_t);
-
-    for (int i = 0; i < kv_size; ++i) {
-      memcpy(push_data_ptr, value_ptr[i], accessor->update_size());
-      push_data_ptr += accessor->update_size();
+    size_t push_data_size =
+        kv_size * (sizeof(uint64_t) + accessor->update_size());
+    auto fill_push_data = [&](char *push_data_ptr) {
+      memcpy(push_data_ptr, kvs.data(), kv_size * sizeof(uint64_t));
+      push_data_ptr += kv_size * sizeof(uint64_t);
+
+      for (int i = 0; i < kv_size; ++i) {
+        memcpy(push_data_ptr, value_ptr[i], accessor->update_size());
+        push_data_ptr += accessor->update_size();
+      }
+    };
+    if (shm_call(shard_idx, closure, shard_idx, kv_size, fill_push_data,
+                 push_data_size, 0)) {
+      continue;
+    }
+    uint32_t compress_type = fill_sparse_push_data(
+        table_id, kvs.data(), value_ptr.data(), kv_size,
+        push_request->mutable_data());
+    if (compress_type != GRADIENT_COMPRESS_NONE) {
+      push_request->add_params((char *)&compress_type, sizeof(uint32_t));
     }
     PsService_Stub rpc_stub(get_sparse_channel(shard_idx));
     closure->cntl(shard_idx)->set_request_compress_type(
@@ -715,17 +902,40 @@ std::future<int32_t> BrpcPsClient::push_dense_raw_gradient(
   auto *accessor = table_accessor(table_id);
   uint32_t num_per_shard =
       dense_dim_per_shard(accessor->fea_dim(), request_call_num);
+  uint32_t compress_type = GRADIENT_COMPRESS_NONE;
+  float *residual = nullptr;
+  std::unique_lock<std::mutex> residual_lock;
+  auto residual_iter = _gradient_residuals.find(table_id);
+  if (residual_iter != _gradient_residuals.end()) {
+    compress_type = accessor->gradient_compress_type();
+    residual_lock = std::unique_lock<std::mutex>(residual_iter->second->mutex);
+    auto &dense_residual = residual_iter->second->dense;
+    dense_residual.resize(num_per_shard * request_call_num);
+    residual = dense_residual.data();
+  }
+  size_t values_size = GradientCompressedSize(
+      (GradientCompressType)compress_type, num_per_shard,
+      kDenseGradientRowSize);
   for (size_t i = 0; i < request_call_num; ++i) {
     closure->request(i)->set_cmd_id(PS_PUSH_DENSE_TABLE);
     closure->request(i)->set_table_id(table_id);
     closure->request(i)->set_client_id(_client_id);
     auto *push_data = closure->request(i)->mutable_data();
     push_data->clear();
-    push_data->resize(sizeof(uint32_t) + num_per_shard * sizeof(float));
+    push_data->resize(sizeof(uint32_t) + values_size);
     char *push_data_ptr = const_cast<char *>(push_data->data());
     memcpy(push_data_ptr, &num_per_shard, sizeof(uint32_t));
-    memcpy(push_data_ptr + sizeof(uint32_t),
-           total_send_data + i * num_per_shard, num_per_shard * sizeof(float));
+    if (compress_type == GRADIENT_COMPRESS_NONE) {
+      memcpy(push_data_ptr + sizeof(uint32_t),
+             total_send_data + i * num_per_shard, values_size);
+    } else {
+      closure->request(i)->add_params((char *)&compress_type,
+                                      sizeof(uint32_t));
+      CompressGradient((GradientCompressType)compress_type,
+                       total_send_data + i * num_per_shard, num_per_shard,
+                       kDenseGradientRowSize, residual + i * num_per_shard,
+                       push_data_ptr + sizeof(uint32_t));
+    }
     VLOG(1) << "push_dense_raw_gradient finish memcpy";
     // closure->cntl(i)->set_request_compress_type(
     //     (brpc::CompressType)FLAGS_pserver_communicate_compress_type);
@@ -770,16 +980,33 @@ std::future<int32_t> BrpcPsClient::pull_sparse(float **select_values,
                                                size_t table_id,
                                                const uint64_t *keys, size_t num,
                                                bool is_training) {
+  return pull_sparse_from(select_values, table_id, keys, num, is_training,
+                          true);
+}
+
+std::future<int32_t> BrpcPsClient::pull_sparse_from(
+    float **select_values, size_t table_id, const uint64_t *keys, size_t num,
+    bool is_training, bool route_hot_keys) {
   size_t request_call_num = _server_channels.size();
 
   auto shard_sorted_kvs = std::make_shared<
       std::vector<std::vector<std::pair<uint64_t, float *>>>>();
   shard_sorted_kvs->resize(request_call_num);
 
+  auto router_iter = _hot_key_routers.find(table_id);
+  std::vector<size_t> servers;
+  if (route_hot_keys && router_iter != _hot_key_routers.end()) {
+    std::vector<size_t> load;
+    router_iter->second->Record(keys, num);
+    router_iter->second->Route(keys, num, &load, &servers);
+  }
   for (size_t i = 0; i < num; ++i) {
-    size_t shard_id = keys[i] % request_call_num;
+    size_t shard_id = servers.empty() ? keys[i] % request_call_num : servers[i];
     shard_sorted_kvs->at(shard_id).push_back({keys[i], select_values[i]});
   }
+  for (size_t i = 0; i < request_call_num; ++i) {
+    _server_pull_load[i] += shard_sorted_kvs->at(i).size();
+  }
 
   auto *accessor = table_accessor(table_id);
   size_t value_size = accessor->select_size();
@@ -866,6 +1093,13 @@ std::future<int32_t> BrpcPsClient::pull_sparse(float **select_values,
       closure->request(i)->set_client_id(_client_id);
       closure->request(i)->add_params((char *)&kv_request_count,
                                       sizeof(uint32_t));
+      if (shm_call(i, closure, i, kv_request_count,
+                   [&request_buffer](char *data) {
+                     request_buffer.copy_to(data, request_buffer.size());
+                   },
+                   request_buffer.size(), kv_request_count * value_size)) {
+        continue;
+      }
       PsService_Stub rpc_stub(get_cmd_channel(i));
       closure->cntl(i)->set_log_id(butil::gettimeofday_ms());
       rpc_stub.service(closure->cntl(i), closure->request(i),
@@ -903,8 +1137,6 @@ std::future<int32_t> BrpcPsClient::send_client2client_msg(
 std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient_partial(
     size_t table_id, const uint64_t *keys, const float **update_values,
     uint32_t num, void *done, int pserver_idx) {
-  auto *accessor = table_accessor(table_id);
-  size_t value_size = accessor->update_size();
   DownpourBrpcClosure *closure = reinterpret_cast<DownpourBrpcClosure *>(done);
   auto promise = std::make_shared<std::promise<int32_t>>();
   closure->add_promise(promise);
@@ -916,14 +1148,10 @@ std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient_partial(
   push_request->set_table_id(table_id);
   push_request->set_client_id(_client_id);
   push_request->add_params((char *)&num, sizeof(uint32_t));
-  auto *push_data = push_request->mutable_data();
-  push_data->resize(num * (sizeof(uint64_t) + value_size));
-  char *push_data_ptr = const_cast<char *>(push_data->data());
-  memcpy(push_data_ptr, keys, num * sizeof(uint64_t));
-  push_data_ptr += num * sizeof(uint64_t);
-  for (int i = 0; i < num; ++i) {
-    memcpy(push_data_ptr, update_values[i], value_size);
-    push_data_ptr += value_size;
+  uint32_t compress_type = fill_sparse_push_data(
+      table_id, keys, update_values, num, push_request->mutable_data());
+  if (compress_type != GRADIENT_COMPRESS_NONE) {
+    push_request->add_params((char *)&compress_type, sizeof(uint32_t));
   }
   PsService_Stub rpc_stub(get_sparse_channel(pserver_idx));
   closure->cntl(0)->set_request_compress_type(
@@ -933,6 +1161,134 @@ std::future<int32_t> BrpcPsClient::push_sparse_raw_gradient_partial(
   return fut;
 }
 
+int32_t BrpcPsClient::refresh_hot_keys(size_t table_id) {
+  auto router_iter = _hot_key_routers.find(table_id);
+  if (router_iter == _hot_key_routers.end()) {
+    return 0;
+  }
+  auto &router = *router_iter->second;
+  std::vector<uint64_t> keys = router.TakeCandidates();
+  if (keys.empty()) {
+    router.SetHotKeys(keys);
+    return 0;
+  }
+
+  // the values of the owners, read as they are, not counted as a pull
+  size_t value_size = table_accessor(table_id)->select_size();
+  size_t dim = value_size / sizeof(float);
+  std::vector<float> values(keys.size() * dim);
+  std::vector<float *> value_ptrs(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    value_ptrs[i] = values.data() + i * dim;
+  }
+  auto pull_status = pull_sparse_from(value_ptrs.data(), table_id, keys.data(),
+                                      keys.size(), false, false);
+  pull_status.wait();
+  if (pull_status.get() != 0) {
+    LOG(WARNING) << "failed to pull the hot feasigns of table " << table_id
+                 << ", pull them from their owner";
+    router.SetHotKeys({});
+    return -1;
+  }
+
+  size_t request_call_num = _server_channels.size();
+  std::vector<std::vector<size_t>> server_offsets(request_call_num);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    for (auto server : router.Replicas(keys[i])) {
+      server_offsets[server].push_back(i);
+    }
+  }
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(
+      request_call_num, [request_call_num](void *done) {
+        int ret = 0;
+        auto *closure = (DownpourBrpcClosure *)done;
+        for (size_t i = 0; i < request_call_num; ++i) {
+          if (closure->check_response(i, PS_PUSH_SPARSE_REPLICA) != 0) {
+            ret = -1;
+            break;
+          }
+        }
+        closure->set_promise_value(ret);
+      });
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+  for (size_t i = 0; i < request_call_num; ++i) {
+    auto &offsets = server_offsets[i];
+    if (offsets.empty()) {
+      closure->Run();
+      continue;
+    }
+    uint32_t kv_size = offsets.size();
+    auto *request = closure->request(i);
+    request->set_cmd_id(PS_PUSH_SPARSE_REPLICA);
+    request->set_table_id(table_id);
+    request->set_client_id(_client_id);
+    request->add_params((char *)&kv_size, sizeof(uint32_t));
+    auto *push_data = request->mutable_data();
+    push_data->resize(kv_size * (sizeof(uint64_t) + value_size));
+    char *push_data_ptr = const_cast<char *>(push_data->data());
+    for (auto offset : offsets) {
+      memcpy(push_data_ptr, &keys[offset], sizeof(uint64_t));
+      push_data_ptr += sizeof(uint64_t);
+    }
+    for (auto offset : offsets) {
+      memcpy(push_data_ptr, value_ptrs[offset], value_size);
+      push_data_ptr += value_size;
+    }
+    PsService_Stub rpc_stub(get_cmd_channel(i));
+    rpc_stub.service(closure->cntl(i), closure->request(i),
+                     closure->response(i), closure);
+  }
+  fut.wait();
+  if (fut.get() != 0) {
+    LOG(WARNING) << "failed to replicate the hot feasigns of table "
+                 << table_id << ", pull them from their owner";
+    router.SetHotKeys({});
+    return -1;
+  }
+  router.SetHotKeys(keys);
+  return 0;
+}
+
+std::vector<uint64_t> BrpcPsClient::get_server_pull_load() {
+  std::vector<uint64_t> load(_server_channels.size());
+  for (size_t i = 0; i < load.size(); ++i) {
+    load[i] = _server_pull_load[i];
+  }
+  return load;
+}
+
+void BrpcPsClient::hot_key_refresh_loop(int refresh_ms) {
+  std::unique_lock<std::mutex> lock(_hot_key_mutex);
+  while (!_hot_key_cv.wait_for(lock, std::chrono::milliseconds(refresh_ms),
+                               [this] { return _hot_key_stop; })) {
+    lock.unlock();
+    for (auto &iter : _hot_key_routers) {
+      refresh_hot_keys(iter.first);
+      VLOG(1) << "table " << iter.first
+              << " hot feasigns: " << iter.second->hot_key_num();
+    }
+    std::ostringstream os;
+    for (auto load : get_server_pull_load()) {
+      os << load << " ";
+    }
+    VLOG(1) << "feasigns pulled from every server: " << os.str();
+    lock.lock();
+  }
+}
+
+void BrpcPsClient::stop_hot_key_refresh() {
+  {
+    std::lock_guard<std::mutex> lock(_hot_key_mutex);
+    _hot_key_stop = true;
+  }
+  _hot_key_cv.notify_all();
+  if (_hot_key_thread.joinable()) {
+    _hot_key_thread.join();
+  }
+}
+
 int32_t BrpcPsClient::recv_and_save_table(const uint64_t table_id,
                                           const std::string &path) {
   // get var information
@@ -14,15 +14,25 @@
 
 #pragma once
 
+#include <ThreadPool.h>
+#include <atomic>
+#include <condition_variable>  // NOLINT
+#include <functional>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
+#include <unordered_map>
 #include <vector>
 
 #include "brpc/channel.h"
 #include "brpc/controller.h"
 #include "brpc/server.h"
+#include "paddle/fluid/distributed/common/gradient_codec.h"
 #include "paddle/fluid/distributed/service/brpc_utils.h"
+#include "paddle/fluid/distributed/service/hot_key_router.h"
 #include "paddle/fluid/distributed/service/ps_client.h"
+#include "paddle/fluid/distributed/service/ps_shm_channel.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/scope.h"
 #include "paddle/fluid/framework/tensor_util.h"
@@ -106,6 +116,7 @@ class BrpcPsClient : public PSClient {
  public:
   BrpcPsClient() {}
   virtual ~BrpcPsClient() {
+    stop_hot_key_refresh();
     // _running = false;
     // try {
     // _async_push_dense_thread.join();
@@ -171,6 +182,14 @@ class BrpcPsClient : public PSClient {
   virtual int32_t recv_and_save_table(const uint64_t table_id,
                                       const std::string &path);
 
+  // Ends the round of the hot feasigns of the table: writes the replicas of
+  // the feasigns pulled the most in it, then routes their pulls over them.
+  // Runs every FLAGS_pserver_hot_key_refresh_ms in background.
+  int32_t refresh_hot_keys(size_t table_id);
+
+  // The feasigns pulled from every server so far.
+  std::vector<uint64_t> get_server_pull_load();
+
  protected:
   virtual size_t get_server_nums() { return _server_channels.size(); }
   inline brpc::Channel *get_sparse_channel(size_t server_id) {
@@ -198,6 +217,34 @@ class BrpcPsClient : public PSClient {
   std::future<int32_t> send_save_cmd(uint32_t table_id, int cmd_id,
                                      const std::vector<std::string> &param);
 
+  // Sends the request request_idx of the closure through the shared memory
+  // of the server, fill writes its request_size bytes of data before it
+  // returns. The response lands in the controller and the response as with
+  // brpc, and the closure is run on _shm_wait_pool. Returns false when the
+  // server has no shared memory on this host, the call does not fit in a
+  // slot or no slot is free soon, the request then goes through brpc.
+  bool shm_call(size_t server_id, DownpourBrpcClosure *closure,
+                size_t request_idx, uint32_t num,
+                const std::function<void(char *)> &fill, size_t request_size,
+                size_t response_size);
+
+  // pull_sparse, with the hot feasigns pulled from their owner unless
+  // route_hot_keys.
+  std::future<int32_t> pull_sparse_from(float **select_values, size_t table_id,
+                                        const uint64_t *keys, size_t num,
+                                        bool is_training, bool route_hot_keys);
+
+  void hot_key_refresh_loop(int refresh_ms);
+  void stop_hot_key_refresh();
+
+  // Writes |keys|values| of num keys to push_data, the values compressed as
+  // the table is configured, returns the type they are compressed in.
+  GradientCompressType fill_sparse_push_data(size_t table_id,
+                                             const uint64_t *keys,
+                                             const float *const *values,
+                                             size_t num,
+                                             std::string *push_data);
+
   bool _running = false;
   bool _flushing = false;
   std::atomic<uint32_t> _async_call_num;  //异步请求计数
@@ -206,6 +253,30 @@ class BrpcPsClient : public PSClient {
       _client_channels;  // client2client
   std::vector<std::array<std::shared_ptr<brpc::Channel>, 3>>
       _server_channels;  // client2server
+  std::vector<std::shared_ptr<PsShmChannel>>
+      _shm_channels;  // client2server on the same host
+  // waits for the responses of the shared memory calls
+  std::unique_ptr<::ThreadPool> _shm_wait_pool;
+
+  // What the compression of the gradients pushed has lost so far, added to
+  // the next gradients pushed (error feedback), of the tables compressed.
+  struct GradientResidual {
+    GradientResidual(size_t sparse_capacity, float sparse_epsilon)
+        : sparse(sparse_capacity, sparse_epsilon) {}
+    std::mutex mutex;
+    std::vector<float> dense;
+    SparseGradientResidual sparse;
+  };
+  std::unordered_map<size_t, std::shared_ptr<GradientResidual>>
+      _gradient_residuals;
+
+  // of the sparse tables the hot feasigns of are replicated
+  std::unordered_map<size_t, std::shared_ptr<HotKeyRouter>> _hot_key_routers;
+  std::unique_ptr<std::atomic<uint64_t>[]> _server_pull_load;
+  std::thread _hot_key_thread;
+  std::mutex _hot_key_mutex;
+  std::condition_variable _hot_key_cv;
+  bool _hot_key_stop = false;
   virtual std::future<int32_t> push_dense_raw_gradient(
       int table_id, float *total_send_data, size_t total_send_data_size,
       void *done) override;
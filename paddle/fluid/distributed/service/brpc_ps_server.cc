@@ -20,6 +20,17 @@
 #include "paddle/fluid/framework/archive.h"
 #include "paddle/fluid/platform/profiler.h"
 
+DECLARE_int32(pserver_shm_slot_num);
+DECLARE_int32(pserver_shm_slot_size);
+DECLARE_int32(pserver_shm_server_thread);
+
+DEFINE_int32(pserver_pull_sparse_coalesce_window_us, 0,
+             "the pull_sparse of a table arriving within this window are "
+             "merged into one lookup, 0 to look each up alone");
+
+DEFINE_int32(pserver_pull_sparse_coalesce_max_requests, 64,
+             "max pull_sparse merged into one lookup");
+
 namespace google {
 namespace protobuf {
 class Closure;
@@ -82,6 +93,18 @@ uint64_t BrpcPsServer::start(const std::string &ip, uint32_t port) {
     }
   }
 
+  auto *ps_service = dynamic_cast<BrpcPsService *>(_service.get());
+  if (ps_service != nullptr && PsShmEnabled(ip, port)) {
+    if (_shm_server.Start(
+            ip, port, FLAGS_pserver_shm_slot_num, FLAGS_pserver_shm_slot_size,
+            FLAGS_pserver_shm_server_thread,
+            [ps_service](PsShmSlot *slot) { ps_service->shm_service(slot); }) !=
+        0) {
+      LOG(WARNING) << "BrpcPsServer failed to serve shared memory, ip_port= "
+                   << ip_port << ", co-located trainers will use brpc";
+    }
+  }
+
   _environment->registe_ps_server(ip, port, _rank);
   cv_.wait(lock, [&] { return stoped_; });
 
@@ -113,6 +136,8 @@ int32_t BrpcPsService::initialize() {
   _service_handler_map[PS_PULL_GEO_PARAM] = &BrpcPsService::pull_geo_param;
   _service_handler_map[PS_PUSH_SPARSE_PARAM] =
       &BrpcPsService::push_sparse_param;
+  _service_handler_map[PS_PUSH_SPARSE_REPLICA] =
+      &BrpcPsService::push_sparse_replica;
   _service_handler_map[PS_BARRIER] = &BrpcPsService::barrier;
   _service_handler_map[PS_START_PROFILER] = &BrpcPsService::start_profiler;
   _service_handler_map[PS_STOP_PROFILER] = &BrpcPsService::stop_profiler;
@@ -121,9 +146,27 @@ int32_t BrpcPsService::initialize() {
   // shard初始化,server启动后才可从env获取到server_list的shard信息
   initialize_shard_info();
 
+  if (FLAGS_pserver_pull_sparse_coalesce_window_us > 0) {
+    for (auto &itr : *(_server->table())) {
+      _pull_coalescers[itr.first].reset(new SparsePullCoalescer(
+          itr.second.get(), FLAGS_pserver_pull_sparse_coalesce_window_us,
+          FLAGS_pserver_pull_sparse_coalesce_max_requests));
+    }
+  }
+
   return 0;
 }
 
+// The values of a response, of the object pool, returned to it once the
+// response is sent.
+static std::shared_ptr<std::vector<float>> GetResponseValues(size_t num) {
+  std::shared_ptr<std::vector<float>> values(
+      butil::get_object<std::vector<float>>(),
+      [](std::vector<float> *values) { butil::return_object(values); });
+  values->resize(num);
+  return values;
+}
+
 #define CHECK_TABLE_EXIST(table, request, response)        \
   if (table == NULL) {                                     \
     std::string err_msg("table not found with table_id:"); \
@@ -148,6 +191,16 @@ int32_t BrpcPsService::initialize_shard_info() {
   return 0;
 }
 
+int32_t BrpcPsService::pull_sparse_values(uint32_t table_id, Table *table,
+                                          const PullSparseValue &value,
+                                          float *values) {
+  auto itr = _pull_coalescers.find(table_id);
+  if (itr == _pull_coalescers.end()) {
+    return table->pull_sparse(values, value);
+  }
+  return itr->second->Pull(value, values);
+}
+
 void BrpcPsService::service(google::protobuf::RpcController *cntl_base,
                             const PsRequestMessage *request,
                             PsResponseMessage *response,
@@ -179,6 +232,74 @@ void BrpcPsService::service(google::protobuf::RpcController *cntl_base,
   }
 }
 
+void BrpcPsService::shm_service(PsShmSlot *slot) {
+  auto *table = _server->table(slot->table_id);
+  size_t slot_size = FLAGS_pserver_shm_slot_size;
+  size_t request_size = slot->data_size;
+  slot->data_size = 0;
+  if (table == NULL) {
+    LOG(ERROR) << "table not found with table_id:" << slot->table_id;
+    slot->err_code = -1;
+    return;
+  }
+  uint32_t num = slot->num;
+  switch (slot->cmd_id) {
+    case PS_PULL_DENSE_TABLE: {
+      platform::RecordEvent record_event("PsService->shm_pull_dense");
+      size_t res_size = num * table->value_accesor()->select_size();
+      if (res_size > slot_size) {
+        slot->err_code = -1;
+        break;
+      }
+      table->pull_dense(reinterpret_cast<float *>(slot->data()), num);
+      slot->data_size = res_size;
+      break;
+    }
+    case PS_PULL_SPARSE_TABLE: {
+      platform::RecordEvent record_event("PsService->shm_pull_sparse");
+      auto dim = table->value_accesor()->select_dim();
+      size_t res_size = num * dim * sizeof(float);
+      if (res_size > slot_size ||
+          request_size <
+              sizeof(bool) + num * (sizeof(uint64_t) + sizeof(uint32_t))) {
+        slot->err_code = -1;
+        break;
+      }
+      // the values are written over the keys, which are read first
+      thread_local std::string req_buffer;
+      req_buffer.assign(slot->data(), request_size);
+      auto value = PullSparseValue(num, dim);
+      value.DeserializeFromBytes(const_cast<char *>(req_buffer.data()));
+      if (pull_sparse_values(slot->table_id, table, value,
+                             reinterpret_cast<float *>(slot->data())) != 0) {
+        slot->err_code = -1;
+        break;
+      }
+      slot->data_size = res_size;
+      break;
+    }
+    case PS_PUSH_SPARSE_TABLE: {
+      platform::RecordEvent record_event("PsService->shm_push_sparse");
+      if (num == 0) {
+        break;
+      }
+      // |---keysData---|---valuesData---|, as the brpc push_sparse
+      const uint64_t *keys = reinterpret_cast<const uint64_t *>(slot->data());
+      const float *values = reinterpret_cast<const float *>(
+          slot->data() + sizeof(uint64_t) * num);
+      if (request_size < sizeof(uint64_t) * num ||
+          table->push_sparse(keys, values, num) != 0) {
+        slot->err_code = -1;
+      }
+      break;
+    }
+    default:
+      LOG(ERROR) << "cmd_id:" << slot->cmd_id
+                 << " is not served through shared memory";
+      slot->err_code = -1;
+  }
+}
+
 int32_t BrpcPsService::pull_dense(Table *table, const PsRequestMessage &request,
                                   PsResponseMessage &response,
                                   brpc::Controller *cntl) {
@@ -197,13 +318,12 @@ int32_t BrpcPsService::pull_dense(Table *table, const PsRequestMessage &request,
     return 0;
   }
 
-  auto res_data = butil::get_object<std::vector<float>>();
-  res_data->resize(num * table->value_accesor()->select_size() / sizeof(float));
+  auto res_data = GetResponseValues(
+      num * table->value_accesor()->select_size() / sizeof(float));
   table->pull_dense(res_data->data(), num);
 
-  cntl->response_attachment().append((char *)(res_data->data()),
-                                     res_data->size() * sizeof(float));
-  butil::return_object(res_data);
+  AppendToIOBuf(res_data, res_data->data(), res_data->size() * sizeof(float),
+                &cntl->response_attachment());
 
   return 0;
 }
@@ -254,6 +374,21 @@ int32_t BrpcPsService::push_dense(Table *table, const PsRequestMessage &request,
   uint32_t num = *(const uint32_t *)(request.data().data());
   const float *values =
       (const float *)(request.data().data() + sizeof(uint32_t));
+  if (request.params_size() > 0) {
+    // the values compressed by the client, params[0] is the compress type
+    auto type = (GradientCompressType)(
+        *(const uint32_t *)request.params(0).c_str());
+    thread_local std::vector<float> decompressed;
+    decompressed.resize(num);
+    if (table->value_accesor()->decompress_dense_update(
+            type, request.data().data() + sizeof(uint32_t),
+            req_buffer_size - sizeof(uint32_t), num,
+            decompressed.data()) != 0) {
+      set_response_code(response, -1, "push_dense data size mismatch");
+      return 0;
+    }
+    values = decompressed.data();
+  }
   if (table->push_dense(values, num) != 0) {
     set_response_code(response, -1, "push_dense failed");
   }
@@ -311,6 +446,39 @@ int32_t BrpcPsService::push_sparse_param(Table *table,
   return 0;
 }
 
+int32_t BrpcPsService::push_sparse_replica(Table *table,
+                                           const PsRequestMessage &request,
+                                           PsResponseMessage &response,
+                                           brpc::Controller *cntl) {
+  platform::RecordEvent record_event("PsService->push_sparse_replica");
+  CHECK_TABLE_EXIST(table, request, response)
+  if (request.params_size() < 1) {
+    set_response_code(response, -1,
+                      "PsRequestMessage.params is requeired at "
+                      "least 1 for num of sparse_key");
+    return 0;
+  }
+  uint32_t num = *(uint32_t *)(request.params(0).c_str());
+  /*
+  Push Content:
+  |---keysData---|---valuesData---|
+  |---8*{num}B---|---select_size*{num}B---|
+  */
+  auto &push_data = request.data();
+  if (push_data.size() !=
+      num * (sizeof(uint64_t) + table->value_accesor()->select_size())) {
+    set_response_code(response, -1, "push_sparse_replica data size mismatch");
+    return 0;
+  }
+  const uint64_t *keys = (const uint64_t *)push_data.data();
+  const float *values =
+      (const float *)(push_data.data() + sizeof(uint64_t) * num);
+  if (table->push_sparse_replica(keys, values, num) != 0) {
+    set_response_code(response, -1, "push_sparse_replica error");
+  }
+  return 0;
+}
+
 int32_t BrpcPsService::pull_geo_param(Table *table,
                                       const PsRequestMessage &request,
                                       PsResponseMessage &response,
@@ -369,13 +537,15 @@ int32_t BrpcPsService::pull_sparse(Table *table,
 
   value.DeserializeFromBytes(const_cast<void *>(data));
 
-  auto res_data = butil::get_object<std::vector<float>>();
-  res_data->resize(num * dim);
-  table->pull_sparse(res_data->data(), value);
+  auto res_data = GetResponseValues(num * dim);
+  if (pull_sparse_values(request.table_id(), table, value,
+                         res_data->data()) != 0) {
+    set_response_code(response, -1, "pull_sparse error");
+    return 0;
+  }
 
-  cntl->response_attachment().append((char *)(res_data->data()),
-                                     res_data->size() * sizeof(float));
-  butil::return_object(res_data);
+  AppendToIOBuf(res_data, res_data->data(), res_data->size() * sizeof(float),
+                &cntl->response_attachment());
   return 0;
 }
 
@@ -405,6 +575,23 @@ int32_t BrpcPsService::push_sparse(Table *table,
   const uint64_t *keys = (const uint64_t *)push_data.data();
   const float *values =
       (const float *)(push_data.data() + sizeof(uint64_t) * num);
+  if (request.params_size() > 1) {
+    // the values compressed by the client, params[1] is the compress type
+    auto type = (GradientCompressType)(
+        *(const uint32_t *)request.params(1).c_str());
+    auto *accessor = table->value_accesor();
+    thread_local std::vector<float> decompressed;
+    decompressed.resize(num * accessor->update_dim());
+    if (push_data.size() < sizeof(uint64_t) * num ||
+        accessor->decompress_update(
+            type, push_data.data() + sizeof(uint64_t) * num,
+            push_data.size() - sizeof(uint64_t) * num, num,
+            decompressed.data()) != 0) {
+      set_response_code(response, -1, "push_sparse data size mismatch");
+      return 0;
+    }
+    values = decompressed.data();
+  }
   if (table->push_sparse(keys, values, num) != 0) {
     set_response_code(response, -1, "push_sparse error");
   }
@@ -18,7 +18,9 @@
 #include "brpc/controller.h"
 #include "brpc/server.h"
 #include "paddle/fluid/distributed/service/brpc_utils.h"
+#include "paddle/fluid/distributed/service/ps_shm_channel.h"
 #include "paddle/fluid/distributed/service/server.h"
+#include "paddle/fluid/distributed/service/sparse_pull_coalescer.h"
 
 namespace brpc {
 class Controller;
@@ -49,6 +51,7 @@ class BrpcPsServer : public PSServer {
 
     _server.Stop(1000);
     _server.Join();
+    _shm_server.Stop();
     return 0;
   }
   virtual int32_t port();
@@ -59,6 +62,9 @@ class BrpcPsServer : public PSServer {
   std::condition_variable cv_;
   bool stoped_ = false;
   brpc::Server _server;
+  // serves the trainers on the same host when the endpoint is listed in
+  // FLAGS_pserver_shm_endpoints
+  PsShmServer _shm_server;
   std::shared_ptr<PsBaseService> _service;
   std::vector<std::shared_ptr<brpc::Channel>> _pserver_channels;
 };
@@ -78,8 +84,16 @@ class BrpcPsService : public PsBaseService {
                        PsResponseMessage *response,
                        ::google::protobuf::Closure *done) override;
 
+  // Runs a pull_sparse, push_sparse or pull_dense call of a trainer on the
+  // same host, read from and answered in a shared memory slot.
+  void shm_service(PsShmSlot *slot);
+
  private:
   int32_t initialize_shard_info();
+  // pull_sparse of the table, merged with the others arriving together when
+  // FLAGS_pserver_pull_sparse_coalesce_window_us > 0
+  int32_t pull_sparse_values(uint32_t table_id, Table *table,
+                             const PullSparseValue &value, float *values);
   int32_t pull_dense(Table *table, const PsRequestMessage &request,
                      PsResponseMessage &response, brpc::Controller *cntl);
   int32_t push_dense(Table *table, const PsRequestMessage &request,
@@ -91,6 +105,9 @@ class BrpcPsService : public PsBaseService {
                             brpc::Controller *cntl);
   int32_t pull_sparse(Table *table, const PsRequestMessage &request,
                       PsResponseMessage &response, brpc::Controller *cntl);
+  int32_t push_sparse_replica(Table *table, const PsRequestMessage &request,
+                              PsResponseMessage &response,
+                              brpc::Controller *cntl);
   int32_t pull_geo_param(Table *table, const PsRequestMessage &request,
                          PsResponseMessage &response, brpc::Controller *cntl);
   int32_t barrier(Table *table, const PsRequestMessage &request,
@@ -129,6 +146,8 @@ class BrpcPsService : public PsBaseService {
   std::unordered_map<int32_t, serviceHandlerFunc> _service_handler_map;
   std::unordered_map<int32_t, serviceHandlerFunc> _msg_handler_map;
   std::vector<float> _ori_values;
+  std::unordered_map<uint32_t, std::shared_ptr<SparsePullCoalescer>>
+      _pull_coalescers;
 };
 
 class DownpourPServerBrpcClosure : public PServerClosure {
@@ -15,8 +15,16 @@ limitations under the License. */
 #include "paddle/fluid/distributed/service/brpc_utils.h"
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <utility>
 #include "paddle/fluid/platform/enforce.h"
 
+DEFINE_int64(pserver_zero_copy_min_bytes, 4096,
+             "tensors and pulled values of at least this many bytes are "
+             "attached to brpc messages and received without a copy, "
+             "-1 to copy them all");
+
 namespace paddle {
 namespace framework {
 class Variable;
@@ -27,6 +35,105 @@ class LoDTensor;
 namespace paddle {
 namespace distributed {
 
+// The owners of the bytes appended to IOBufs without a copy, by the address
+// of the bytes, with the number of IOBuf blocks referencing them.
+struct ZeroCopyOwners {
+  std::mutex mutex;
+  std::unordered_map<const void*, std::pair<std::shared_ptr<void>, int>>
+      owners;
+};
+
+static ZeroCopyOwners& GetZeroCopyOwners() {
+  static ZeroCopyOwners* owners = new ZeroCopyOwners();
+  return *owners;
+}
+
+static void ReleaseZeroCopy(void* data) {
+  auto& owners = GetZeroCopyOwners();
+  // the owner is released out of the lock
+  std::shared_ptr<void> owner;
+  std::lock_guard<std::mutex> lock(owners.mutex);
+  auto iter = owners.owners.find(data);
+  if (--iter->second.second == 0) {
+    owner = std::move(iter->second.first);
+    owners.owners.erase(iter);
+  }
+}
+
+static bool IsZeroCopied(const void* data) {
+  auto& owners = GetZeroCopyOwners();
+  std::lock_guard<std::mutex> lock(owners.mutex);
+  return owners.owners.count(data) > 0;
+}
+
+void AppendToIOBuf(std::shared_ptr<void> owner, const void* data, size_t len,
+                   butil::IOBuf* iobuf) {
+  if (FLAGS_pserver_zero_copy_min_bytes < 0 || len == 0 ||
+      len < static_cast<size_t>(FLAGS_pserver_zero_copy_min_bytes)) {
+    iobuf->append(data, len);
+    return;
+  }
+  auto& owners = GetZeroCopyOwners();
+  {
+    std::lock_guard<std::mutex> lock(owners.mutex);
+    auto& entry = owners.owners[data];
+    if (entry.second++ == 0) {
+      entry.first = std::move(owner);
+    }
+  }
+  if (iobuf->append_user_data(const_cast<void*>(data), len,
+                              ReleaseZeroCopy) != 0) {
+    iobuf->append(data, len);
+    ReleaseZeroCopy(const_cast<void*>(data));
+  }
+}
+
+// The bytes of a received IOBuf taken as the allocation of a tensor.
+class IOBufAllocation : public memory::Allocation {
+ public:
+  explicit IOBufAllocation(butil::IOBuf* buf)
+      : Allocation(const_cast<char*>(buf->backing_block(0).data()),
+                   buf->size(), platform::CPUPlace()) {
+    buf_.swap(*buf);
+  }
+
+ private:
+  butil::IOBuf buf_;
+};
+
+// Reads the payload of a CPU tensor. A payload received in one block is
+// adopted as the allocation of the tensor when aligned to its type and the
+// tensor shares no memory with others, otherwise it is copied.
+static void DeserializeCPUPayload(framework::Tensor* tensor,
+                                  framework::proto::VarType::Type type,
+                                  butil::IOBufBytesIterator& io_buffer_itr) {
+  unsigned long data_len;
+  io_buffer_itr.copy_and_forward((void*)(&data_len), 8);
+  butil::IOBuf payload;
+  io_buffer_itr.append_and_forward(&payload, data_len);
+
+  size_t type_size = framework::SizeOfType(type);
+  bool adopt =
+      FLAGS_pserver_zero_copy_min_bytes >= 0 && data_len > 0 &&
+      data_len >= static_cast<size_t>(FLAGS_pserver_zero_copy_min_bytes) &&
+      data_len == tensor->numel() * type_size &&
+      payload.backing_block_num() == 1 && tensor->offset() == 0 &&
+      (tensor->Holder() == nullptr || tensor->Holder().use_count() == 1);
+  if (adopt) {
+    const void* data = payload.backing_block(0).data();
+    // the bytes of a tensor sent in this process are still the sender's
+    adopt = reinterpret_cast<uintptr_t>(data) % type_size == 0 &&
+            !IsZeroCopied(data);
+  }
+  if (adopt) {
+    tensor->ResetHolderWithType(std::make_shared<IOBufAllocation>(&payload),
+                                type);
+    return;
+  }
+  void* tensor_data = tensor->mutable_data(platform::CPUPlace(), type);
+  payload.copy_to(tensor_data, data_len);
+}
+
 framework::proto::VarType::Type VarMessageToVarType(
     VariableMessage::Type type) {
   switch (type) {
@@ -51,7 +158,7 @@ void SerializeToMultiVarMsgAndIOBuf(
     const std::vector<std::string>& send_var_name_val,
     const std::vector<std::string>& recv_var_name_val,
     const platform::DeviceContext& ctx, const framework::Scope* scope,
-    MultiVarMsg* request, butil::IOBuf* iobuf) {
+    MultiVarMsg* request, butil::IOBuf* iobuf, bool exclusive_scope) {
   // 1. message_name
   request->set_message_name(message_name);
 
@@ -70,19 +177,35 @@ void SerializeToMultiVarMsgAndIOBuf(
     send_var_msg->set_varname(send_var_name);
 
     framework::Variable* var = scope->FindVar(send_var_name);
+    // the variables of the parent scopes are shared with other requests
+    bool zero_copy =
+        exclusive_scope && scope->FindLocalVar(send_var_name) == var;
 
     if (var->IsType<framework::LoDTensor>()) {
-      SerializeLodTensor(var, ctx, send_var_msg, &temp_iobuf);
+      SerializeLodTensor(var, ctx, send_var_msg, &temp_iobuf, zero_copy);
     } else if (var->IsType<framework::SelectedRows>()) {
-      SerializeSelectedRows(var, ctx, send_var_msg, &temp_iobuf);
+      SerializeSelectedRows(var, ctx, send_var_msg, &temp_iobuf, zero_copy);
     }
     iobuf->append(temp_iobuf);
   }
 }
 
+// Appends the bytes of a CPU tensor, referenced if zero_copy and its memory
+// is shared with no other tensor, copied otherwise.
+static void AppendTensorToIOBuf(const framework::Tensor& tensor,
+                                bool zero_copy, butil::IOBuf* iobuf) {
+  auto data_len = tensor.numel() * framework::SizeOfType(tensor.type());
+  iobuf->append(reinterpret_cast<const char*>(&data_len), 8);
+  if (zero_copy && tensor.Holder().use_count() == 1) {
+    AppendToIOBuf(tensor.Holder(), tensor.data<void>(), data_len, iobuf);
+  } else {
+    iobuf->append(tensor.data<void>(), data_len);
+  }
+}
+
 void SerializeLodTensor(framework::Variable* var,
                         const platform::DeviceContext& ctx, VarMsg* var_msg,
-                        butil::IOBuf* iobuf) {
+                        butil::IOBuf* iobuf, bool zero_copy) {
   auto* tensor = var->GetMutable<framework::LoDTensor>();
   var_msg->set_type(::paddle::distributed::LOD_TENSOR);
   const framework::LoD lod = tensor->lod();
@@ -101,10 +224,7 @@ void SerializeLodTensor(framework::Variable* var,
   }
   // IO Buffer
   if (platform::is_cpu_place(tensor->place())) {
-    auto data_len = tensor->numel() * framework::SizeOfType(tensor->type());
-    iobuf->append(reinterpret_cast<const char*>(&data_len), 8);
-    iobuf->append(reinterpret_cast<const char*>(tensor->data<void>()),
-                  data_len);
+    AppendTensorToIOBuf(*tensor, zero_copy, iobuf);
   } else {
 #ifdef PADDLE_WITH_CUDA
     char* temp_ptr =
@@ -126,7 +246,7 @@ void SerializeLodTensor(framework::Variable* var,
 
 void SerializeSelectedRows(framework::Variable* var,
                            const platform::DeviceContext& ctx, VarMsg* var_msg,
-                           butil::IOBuf* iobuf) {
+                           butil::IOBuf* iobuf, bool zero_copy) {
   framework::SelectedRows* slr = var->GetMutable<framework::SelectedRows>();
   auto* tensor = slr->mutable_value();
   auto* rows = slr->mutable_rows();
@@ -157,10 +277,7 @@ void SerializeSelectedRows(framework::Variable* var,
 
   // IO Buffer
   if (platform::is_cpu_place(tensor->place())) {
-    auto data_len = tensor->numel() * framework::SizeOfType(tensor->type());
-    iobuf->append(reinterpret_cast<const char*>(&data_len), 8);
-    iobuf->append(reinterpret_cast<const char*>(tensor->data<void>()),
-                  data_len);
+    AppendTensorToIOBuf(*tensor, zero_copy, iobuf);
   } else {
 #ifdef PADDLE_WITH_CUDA
     char* temp_ptr =
@@ -240,16 +357,14 @@ void DeserializeLodTensor(framework::Variable* var, const VarMsg& msg,
   }
   tensor->set_lod(lod);
 
-  void* tensor_data =
-      tensor->mutable_data(place, VarMessageToVarType(msg.data_type()));
-
   // IO Buffer
   if (platform::is_cpu_place(place)) {
-    unsigned long data_len;
-    io_buffer_itr.copy_and_forward((void*)(&data_len), 8);
-    io_buffer_itr.copy_and_forward(tensor_data, data_len);
+    DeserializeCPUPayload(tensor, VarMessageToVarType(msg.data_type()),
+                          io_buffer_itr);
   } else if (platform::is_gpu_place(place)) {
 #ifdef PADDLE_WITH_CUDA
+    void* tensor_data =
+        tensor->mutable_data(place, VarMessageToVarType(msg.data_type()));
     unsigned long data_len;
     char* temp_ptr =
         new char[tensor->numel() * framework::SizeOfType(tensor->type())];
@@ -281,15 +396,14 @@ void DeserializeSelectedRows(framework::Variable* var, const VarMsg& msg,
     vec_dim.push_back(x);
   }
   tensor->Resize(framework::make_ddim(vec_dim));
-  void* tensor_data =
-      tensor->mutable_data(place, VarMessageToVarType(msg.data_type()));
   // IO Buffer
   if (platform::is_cpu_place(place)) {
-    unsigned long data_len;
-    io_buffer_itr.copy_and_forward((void*)(&data_len), 8);
-    io_buffer_itr.copy_and_forward(tensor_data, data_len);
+    DeserializeCPUPayload(tensor, VarMessageToVarType(msg.data_type()),
+                          io_buffer_itr);
   } else if (platform::is_gpu_place(place)) {
 #ifdef PADDLE_WITH_CUDA
+    void* tensor_data =
+        tensor->mutable_data(place, VarMessageToVarType(msg.data_type()));
     char* temp_ptr =
         new char[tensor->numel() * framework::SizeOfType(tensor->type())];
     unsigned long data_len;
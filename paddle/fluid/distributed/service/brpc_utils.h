@@ -16,6 +16,7 @@ limitations under the License. */
 
 #include <netdb.h>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -53,20 +54,26 @@ namespace distributed {
 using MultiVarMsg = ::paddle::distributed::MultiVariableMessage;
 using VarMsg = ::paddle::distributed::VariableMessage;
 
+// exclusive_scope tells that no one else touches the variables local to
+// scope until iobuf is sent, e.g. the scope of a request. The tensors of
+// them that share their memory with no other are then sent without a copy.
+// All others are copied, as they may be written while brpc still sends.
 void SerializeToMultiVarMsgAndIOBuf(
     const std::string& message_name,
     const std::vector<std::string>& send_var_name_val,
     const std::vector<std::string>& recv_var_name_val,
     const platform::DeviceContext& ctx, const framework::Scope* scope,
-    MultiVarMsg* var_msg, butil::IOBuf* iobuf);
+    MultiVarMsg* var_msg, butil::IOBuf* iobuf, bool exclusive_scope = false);
 
+// zero_copy: var is not written until iobuf is sent, see
+// SerializeToMultiVarMsgAndIOBuf.
 void SerializeLodTensor(framework::Variable* var,
                         const platform::DeviceContext& ctx, VarMsg* var_msg,
-                        butil::IOBuf* iobuf);
+                        butil::IOBuf* iobuf, bool zero_copy = false);
 
 void SerializeSelectedRows(framework::Variable* var,
                            const platform::DeviceContext& ctx, VarMsg* request,
-                           butil::IOBuf* iobuf);
+                           butil::IOBuf* iobuf, bool zero_copy = false);
 
 // Deserialize for Server
 void DeserializeFromMultiVarMsgAndIOBuf(const MultiVarMsg& multi_msg,
@@ -88,6 +95,12 @@ void DeserializeSelectedRows(framework::Variable* var, const VarMsg& msg,
                              butil::IOBufBytesIterator& iobuf,
                              const platform::DeviceContext& ctx);
 
+// Appends len bytes at data to iobuf. Payloads of at least
+// FLAGS_pserver_zero_copy_min_bytes are referenced instead of copied, owner
+// keeping them until iobuf and all its copies release them.
+void AppendToIOBuf(std::shared_ptr<void> owner, const void* data, size_t len,
+                   butil::IOBuf* iobuf);
+
 std::string GetIntTypeEndpoint(const std::string& ip, const uint32_t& port);
 
 }  // namespace distributed
@@ -145,6 +145,110 @@ std::future<int32_t> GraphBrpcClient::get_node_feat(
   return fut;
 }
 
+template <typename T>
+std::future<int32_t> GraphBrpcClient::get_node_feat_dense_impl(
+    const uint32_t &table_id, const std::vector<uint64_t> &node_ids,
+    const std::string &feature_name, const std::string &dtype, int32_t shape,
+    T *res) {
+  if (node_ids.empty()) {
+    std::promise<int32_t> promise;
+    promise.set_value(0);
+    return promise.get_future();
+  }
+  std::vector<int> request2server;
+  std::vector<int> server2request(server_size, -1);
+  std::vector<std::vector<uint64_t>> node_id_buckets;
+  std::vector<std::vector<int>> query_idx_buckets;
+  for (int query_idx = 0; query_idx < node_ids.size(); ++query_idx) {
+    int server_index = get_server_index_by_id(node_ids[query_idx]);
+    if (server2request[server_index] == -1) {
+      server2request[server_index] = request2server.size();
+      request2server.push_back(server_index);
+      node_id_buckets.emplace_back();
+      query_idx_buckets.emplace_back();
+    }
+    int request_idx = server2request[server_index];
+    node_id_buckets[request_idx].push_back(node_ids[query_idx]);
+    query_idx_buckets[request_idx].push_back(query_idx);
+  }
+  size_t request_call_num = request2server.size();
+
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(
+      request_call_num,
+      [&, query_idx_buckets, request_call_num, shape, res](void *done) {
+        int ret = 0;
+        auto *closure = (DownpourBrpcClosure *)done;
+        for (size_t request_idx = 0; request_idx < request_call_num;
+             ++request_idx) {
+          if (closure->check_response(request_idx,
+                                      PS_GRAPH_GET_NODE_FEAT_DENSE) != 0) {
+            ret = -1;
+            continue;
+          }
+          // |shape|rows of shape values|, copied row by row into res
+          auto &res_io_buffer =
+              closure->cntl(request_idx)->response_attachment();
+          butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+          auto &query_idxs = query_idx_buckets[request_idx];
+          int32_t server_shape = -1;
+          io_buffer_itr.copy_and_forward((void *)&server_shape,
+                                         sizeof(int32_t));
+          if (server_shape != shape ||
+              io_buffer_itr.bytes_left() !=
+                  sizeof(T) * shape * query_idxs.size()) {
+            LOG(ERROR) << "get_node_feat_dense expects " << shape
+                       << " values per node of " << feature_name
+                       << ", but the server has " << server_shape;
+            ret = -1;
+            continue;
+          }
+          for (int query_idx : query_idxs) {
+            io_buffer_itr.copy_and_forward((void *)(res + query_idx * shape),
+                                           sizeof(T) * shape);
+          }
+        }
+        closure->set_promise_value(ret);
+      });
+
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+
+  for (int request_idx = 0; request_idx < request_call_num; ++request_idx) {
+    int server_index = request2server[request_idx];
+    closure->request(request_idx)->set_cmd_id(PS_GRAPH_GET_NODE_FEAT_DENSE);
+    closure->request(request_idx)->set_table_id(table_id);
+    closure->request(request_idx)->set_client_id(_client_id);
+    closure->request(request_idx)
+        ->add_params((char *)node_id_buckets[request_idx].data(),
+                     sizeof(uint64_t) * node_id_buckets[request_idx].size());
+    closure->request(request_idx)->add_params(feature_name);
+    closure->request(request_idx)->add_params(dtype);
+
+    GraphPsService_Stub rpc_stub =
+        getServiceStub(get_cmd_channel(server_index));
+    closure->cntl(request_idx)->set_log_id(butil::gettimeofday_ms());
+    rpc_stub.service(closure->cntl(request_idx), closure->request(request_idx),
+                     closure->response(request_idx), closure);
+  }
+
+  return fut;
+}
+
+std::future<int32_t> GraphBrpcClient::get_node_feat_dense(
+    const uint32_t &table_id, const std::vector<uint64_t> &node_ids,
+    const std::string &feature_name, int32_t shape, float *res) {
+  return get_node_feat_dense_impl(table_id, node_ids, feature_name, "float32",
+                                  shape, res);
+}
+
+std::future<int32_t> GraphBrpcClient::get_node_feat_dense(
+    const uint32_t &table_id, const std::vector<uint64_t> &node_ids,
+    const std::string &feature_name, int32_t shape, int64_t *res) {
+  return get_node_feat_dense_impl(table_id, node_ids, feature_name, "int64",
+                                  shape, res);
+}
+
 std::future<int32_t> GraphBrpcClient::clear_nodes(uint32_t table_id) {
   DownpourBrpcClosure *closure = new DownpourBrpcClosure(
       server_size, [&, server_size = this->server_size ](void *done) {
@@ -399,6 +503,57 @@ std::future<int32_t> GraphBrpcClient::batch_sample_neighboors(
 
   return fut;
 }
+std::future<int32_t> GraphBrpcClient::sample_subgraph(
+    uint32_t table_id, const std::vector<uint64_t> &seeds,
+    const std::vector<int> &fanouts,
+    const std::vector<std::string> &feature_names, uint32_t feat_table_id,
+    GraphSubgraph &res) {
+  // the server holding most of the seeds samples their neighbors in place
+  std::vector<size_t> seed_nums(server_size, 0);
+  for (auto id : seeds) {
+    ++seed_nums[get_server_index_by_id(id)];
+  }
+  int server_index =
+      std::max_element(seed_nums.begin(), seed_nums.end()) - seed_nums.begin();
+
+  DownpourBrpcClosure *closure = new DownpourBrpcClosure(1, [&](void *done) {
+    int ret = 0;
+    auto *closure = (DownpourBrpcClosure *)done;
+    if (closure->check_response(0, PS_GRAPH_SAMPLE_SUBGRAPH) != 0) {
+      ret = -1;
+    } else {
+      auto &res_io_buffer = closure->cntl(0)->response_attachment();
+      butil::IOBufBytesIterator io_buffer_itr(res_io_buffer);
+      size_t bytes_size = io_buffer_itr.bytes_left();
+      std::unique_ptr<char[]> buffer(new char[bytes_size]);
+      io_buffer_itr.copy_and_forward((void *)(buffer.get()), bytes_size);
+      ret = res.from_buffer(buffer.get(), bytes_size);
+    }
+    closure->set_promise_value(ret);
+  });
+  auto promise = std::make_shared<std::promise<int32_t>>();
+  closure->add_promise(promise);
+  std::future<int> fut = promise->get_future();
+
+  closure->request(0)->set_cmd_id(PS_GRAPH_SAMPLE_SUBGRAPH);
+  closure->request(0)->set_table_id(table_id);
+  closure->request(0)->set_client_id(_client_id);
+  closure->request(0)->add_params((char *)seeds.data(),
+                                  sizeof(uint64_t) * seeds.size());
+  closure->request(0)->add_params((char *)fanouts.data(),
+                                  sizeof(int) * fanouts.size());
+  std::string joint_feature_name =
+      paddle::string::join_strings(feature_names, '\t');
+  closure->request(0)->add_params(joint_feature_name.c_str(),
+                                  joint_feature_name.size());
+  closure->request(0)->add_params((char *)&feat_table_id, sizeof(uint32_t));
+
+  GraphPsService_Stub rpc_stub = getServiceStub(get_cmd_channel(server_index));
+  closure->cntl(0)->set_log_id(butil::gettimeofday_ms());
+  rpc_stub.service(closure->cntl(0), closure->request(0), closure->response(0),
+                   closure);
+  return fut;
+}
 std::future<int32_t> GraphBrpcClient::random_sample_nodes(
     uint32_t table_id, int server_index, int sample_size,
     std::vector<uint64_t> &ids) {
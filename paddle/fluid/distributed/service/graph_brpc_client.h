@@ -27,6 +27,7 @@
 #include "paddle/fluid/distributed/service/brpc_ps_client.h"
 #include "paddle/fluid/distributed/service/graph_brpc_server.h"
 #include "paddle/fluid/distributed/service/ps_client.h"
+#include "paddle/fluid/distributed/table/graph/graph_subgraph.h"
 #include "paddle/fluid/distributed/table/table.h"
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/scope.h"
@@ -79,6 +80,24 @@ class GraphBrpcClient : public BrpcPsClient {
       const std::vector<std::string>& feature_names,
       std::vector<std::vector<std::string>>& res);
 
+  // Pulls the numeric feature of the nodes into res, node_ids.size() rows of
+  // the shape values of the feature as the table is configured.
+  virtual std::future<int32_t> get_node_feat_dense(
+      const uint32_t& table_id, const std::vector<uint64_t>& node_ids,
+      const std::string& feature_name, int32_t shape, float* res);
+  virtual std::future<int32_t> get_node_feat_dense(
+      const uint32_t& table_id, const std::vector<uint64_t>& node_ids,
+      const std::string& feature_name, int32_t shape, int64_t* res);
+
+  // Samples the subgraph fanouts.size() hops away from seeds on the server
+  // holding most of them, which asks the others for their part, with the
+  // features feature_names of the nodes in feat_table_id if not empty.
+  virtual std::future<int32_t> sample_subgraph(
+      uint32_t table_id, const std::vector<uint64_t>& seeds,
+      const std::vector<int>& fanouts,
+      const std::vector<std::string>& feature_names, uint32_t feat_table_id,
+      GraphSubgraph& res);
+
   virtual std::future<int32_t> clear_nodes(uint32_t table_id);
   virtual std::future<int32_t> add_graph_node(
       uint32_t table_id, std::vector<uint64_t>& node_id_list,
@@ -102,6 +121,12 @@ class GraphBrpcClient : public BrpcPsClient {
   }
 
  private:
+  template <typename T>
+  std::future<int32_t> get_node_feat_dense_impl(
+      const uint32_t& table_id, const std::vector<uint64_t>& node_ids,
+      const std::string& feature_name, const std::string& dtype,
+      int32_t shape, T* res);
+
   int shard_num;
   size_t server_size;
   ::google::protobuf::RpcChannel* local_channel;
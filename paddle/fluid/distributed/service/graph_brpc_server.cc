@@ -20,7 +20,13 @@
 #include "iomanip"
 #include "paddle/fluid/distributed/service/brpc_ps_client.h"
 #include "paddle/fluid/framework/archive.h"
+#include "paddle/fluid/distributed/table/graph/graph_subgraph.h"
 #include "paddle/fluid/platform/profiler.h"
+
+DEFINE_int32(pserver_graph_peer_timeout_ms, 10000,
+             "timeout of the requests a graph server sends to the other "
+             "servers, e.g. to sample a subgraph spanning them");
+
 namespace paddle {
 namespace distributed {
 
@@ -157,6 +163,10 @@ int32_t GraphBrpcService::initialize() {
       &GraphBrpcService::add_graph_node;
   _service_handler_map[PS_GRAPH_REMOVE_GRAPH_NODE] =
       &GraphBrpcService::remove_graph_node;
+  _service_handler_map[PS_GRAPH_SAMPLE_SUBGRAPH] =
+      &GraphBrpcService::graph_sample_subgraph;
+  _service_handler_map[PS_GRAPH_GET_NODE_FEAT_DENSE] =
+      &GraphBrpcService::graph_get_node_feat_dense;
   // shard初始化,server启动后才可从env获取到server_list的shard信息
   initialize_shard_info();
 
@@ -337,7 +347,7 @@ int32_t GraphBrpcService::graph_random_sample_neighboors(
   }
   size_t node_num = request.params(0).size() / sizeof(uint64_t);
   uint64_t *node_data = (uint64_t *)(request.params(0).c_str());
-  int sample_size = *(uint64_t *)(request.params(1).c_str());
+  int sample_size = *(int *)(request.params(1).c_str());
   std::vector<std::unique_ptr<char[]>> buffers(node_num);
   std::vector<int> actual_sizes(node_num, 0);
   ((GraphTable *)table)
@@ -400,5 +410,247 @@ int32_t GraphBrpcService::graph_get_node_feat(Table *table,
 
   return 0;
 }
+
+int32_t GraphBrpcService::graph_get_node_feat_dense(
+    Table *table, const PsRequestMessage &request, PsResponseMessage &response,
+    brpc::Controller *cntl) {
+  CHECK_TABLE_EXIST(table, request, response)
+  if (request.params_size() < 3) {
+    set_response_code(
+        response, -1,
+        "graph_get_node_feat_dense request requires at least 3 arguments");
+    return 0;
+  }
+  size_t node_num = request.params(0).size() / sizeof(uint64_t);
+  uint64_t *node_data = (uint64_t *)(request.params(0).c_str());
+  std::vector<uint64_t> node_ids(node_data, node_data + node_num);
+  const std::string &feature_name = request.params(1);
+  auto *graph_table = (GraphTable *)table;
+  int32_t shape = graph_table->get_numeric_feat_shape(feature_name);
+  if (shape < 0) {
+    std::string err_msg("graph_get_node_feat_dense requires a numeric feature:");
+    err_msg.append(feature_name);
+    set_response_code(response, -1, err_msg.c_str());
+    return 0;
+  }
+
+  // |shape|node_num rows of shape values|
+  cntl->response_attachment().append(&shape, sizeof(int32_t));
+  if (request.params(2) == "int64") {
+    std::vector<int64_t> feature(node_num * shape);
+    graph_table->get_node_feat_dense(node_ids, feature_name, feature.data());
+    cntl->response_attachment().append(feature.data(),
+                                       sizeof(int64_t) * feature.size());
+  } else {
+    std::vector<float> feature(node_num * shape);
+    graph_table->get_node_feat_dense(node_ids, feature_name, feature.data());
+    cntl->response_attachment().append(feature.data(),
+                                       sizeof(float) * feature.size());
+  }
+  return 0;
+}
+
+brpc::Channel *GraphBrpcService::get_peer_channel(size_t rank) {
+  std::lock_guard<std::mutex> guard(_peer_channel_mutex);
+  if (_peer_channels.empty()) {
+    brpc::ChannelOptions options;
+    options.protocol = "baidu_std";
+    options.timeout_ms = FLAGS_pserver_graph_peer_timeout_ms;
+    options.connection_type = "pooled";
+    options.connect_timeout_ms = FLAGS_pserver_graph_peer_timeout_ms;
+    options.max_retry = 3;
+    auto servers = _server->environment()->get_ps_servers();
+    _peer_channels.resize(servers.size());
+    for (size_t i = 0; i < servers.size(); ++i) {
+      if (i == _rank) {
+        continue;
+      }
+      std::string ip_port =
+          servers[i].ip + ":" + std::to_string(servers[i].port);
+      _peer_channels[i].reset(new brpc::Channel());
+      if (_peer_channels[i]->Init(ip_port.c_str(), "", &options) != 0) {
+        LOG(ERROR) << "failed to connect to graph server " << ip_port;
+        _peer_channels[i].reset();
+      }
+    }
+  }
+  return rank < _peer_channels.size() ? _peer_channels[rank].get() : nullptr;
+}
+
+int32_t GraphBrpcService::call_servers_by_ids(
+    uint32_t table_id, int32_t cmd_id, const std::vector<uint64_t> &ids,
+    const std::vector<std::string> &params,
+    const std::function<void(const std::vector<size_t> &positions,
+                             const std::string &response)> &parse) {
+  auto *table = (GraphTable *)_server->table(table_id);
+  if (table == NULL) {
+    LOG(ERROR) << "table not found with table_id:" << table_id;
+    return -1;
+  }
+  size_t server_num = _server->environment()->get_ps_servers().size();
+  std::vector<std::vector<size_t>> positions(server_num);
+  for (size_t pos = 0; pos < ids.size(); ++pos) {
+    positions[table->get_server_index_by_id(ids[pos])].push_back(pos);
+  }
+
+  std::vector<PsRequestMessage> requests(server_num);
+  std::vector<PsResponseMessage> responses(server_num);
+  std::vector<std::unique_ptr<brpc::Controller>> cntls(server_num);
+  for (size_t rank = 0; rank < server_num; ++rank) {
+    if (positions[rank].empty()) {
+      continue;
+    }
+    std::vector<uint64_t> server_ids;
+    server_ids.reserve(positions[rank].size());
+    for (auto pos : positions[rank]) {
+      server_ids.push_back(ids[pos]);
+    }
+    auto &request = requests[rank];
+    request.set_cmd_id(cmd_id);
+    request.set_table_id(table_id);
+    request.set_client_id(_rank);
+    request.add_params((char *)server_ids.data(),
+                       sizeof(uint64_t) * server_ids.size());
+    for (auto &param : params) {
+      request.add_params(param);
+    }
+    cntls[rank].reset(new brpc::Controller());
+    if (rank == _rank) {
+      continue;
+    }
+    auto *channel = get_peer_channel(rank);
+    if (channel == nullptr) {
+      return -1;
+    }
+    PsService_Stub stub(channel);
+    stub.service(cntls[rank].get(), &request, &responses[rank],
+                 brpc::DoNothing());
+  }
+
+  // the part of this server, while the others are on the way
+  int32_t ret = 0;
+  if (_rank < server_num && cntls[_rank] != nullptr) {
+    auto handler = _service_handler_map.find(cmd_id)->second;
+    if ((this->*handler)(table, requests[_rank], responses[_rank],
+                         cntls[_rank].get()) != 0 ||
+        responses[_rank].err_code() != 0) {
+      LOG(ERROR) << "cmd " << cmd_id << " failed on table " << table_id
+                 << ": " << responses[_rank].err_msg();
+      ret = -1;
+    }
+  }
+  for (size_t rank = 0; rank < server_num; ++rank) {
+    if (cntls[rank] == nullptr || rank == _rank) {
+      continue;
+    }
+    brpc::Join(cntls[rank]->call_id());
+    if (cntls[rank]->Failed() || responses[rank].err_code() != 0) {
+      LOG(ERROR) << "cmd " << cmd_id << " failed on graph server " << rank
+                 << ": "
+                 << (cntls[rank]->Failed() ? cntls[rank]->ErrorText()
+                                           : responses[rank].err_msg());
+      ret = -1;
+    }
+  }
+  if (ret != 0) {
+    return ret;
+  }
+  for (size_t rank = 0; rank < server_num; ++rank) {
+    if (cntls[rank] != nullptr) {
+      parse(positions[rank], cntls[rank]->response_attachment().to_string());
+    }
+  }
+  return 0;
+}
+
+int32_t GraphBrpcService::graph_sample_subgraph(Table *table,
+                                                const PsRequestMessage &request,
+                                                PsResponseMessage &response,
+                                                brpc::Controller *cntl) {
+  CHECK_TABLE_EXIST(table, request, response)
+  if (request.params_size() < 2) {
+    set_response_code(
+        response, -1,
+        "graph_sample_subgraph request requires at least 2 arguments");
+    return 0;
+  }
+  size_t node_num = request.params(0).size() / sizeof(uint64_t);
+  const uint64_t *node_data = (const uint64_t *)(request.params(0).c_str());
+  std::vector<uint64_t> seeds(node_data, node_data + node_num);
+  size_t hop_num = request.params(1).size() / sizeof(int);
+  const int *fanout_data = (const int *)(request.params(1).c_str());
+  std::vector<int> fanouts(fanout_data, fanout_data + hop_num);
+  uint32_t table_id = request.table_id();
+
+  auto sample_func = [&](
+      const std::vector<uint64_t> &ids, int sample_size,
+      std::vector<std::vector<std::pair<uint64_t, float>>> *res) -> int32_t {
+    res->assign(ids.size(), std::vector<std::pair<uint64_t, float>>());
+    std::string size_param((char *)&sample_size, sizeof(int));
+    return call_servers_by_ids(
+        table_id, PS_GRAPH_SAMPLE_NEIGHBOORS, ids, {size_param},
+        [&](const std::vector<size_t> &positions, const std::string &data) {
+          const char *buffer = data.data();
+          const int *actual_sizes = (const int *)(buffer + sizeof(size_t));
+          const char *node_buffer =
+              buffer + sizeof(size_t) + sizeof(int) * positions.size();
+          for (size_t idx = 0; idx < positions.size(); ++idx) {
+            auto &node_res = (*res)[positions[idx]];
+            for (int start = 0; start < actual_sizes[idx];
+                 start += GraphNode::id_size + GraphNode::weight_size) {
+              node_res.push_back(
+                  {*(const uint64_t *)(node_buffer + start),
+                   *(const float *)(node_buffer + start + GraphNode::id_size)});
+            }
+            node_buffer += actual_sizes[idx];
+          }
+        });
+  };
+  GraphSubgraph subgraph;
+  if (subgraph.sample(seeds, fanouts, sample_func) != 0) {
+    set_response_code(response, -1,
+                      "graph_sample_subgraph failed to sample neighbors");
+    return -1;
+  }
+
+  // the features, of the nodes in the table params(3) if given
+  if (request.params_size() > 2 && !request.params(2).empty()) {
+    size_t feat_num =
+        paddle::string::split_string<std::string>(request.params(2), "\t")
+            .size();
+    uint32_t feat_table_id = table_id;
+    if (request.params_size() > 3 &&
+        request.params(3).size() == sizeof(uint32_t)) {
+      feat_table_id = *(const uint32_t *)(request.params(3).c_str());
+    }
+    subgraph.features.assign(feat_num,
+                             std::vector<std::string>(subgraph.node_size()));
+    int32_t ret = call_servers_by_ids(
+        feat_table_id, PS_GRAPH_GET_NODE_FEAT, subgraph.ids,
+        {request.params(2)},
+        [&](const std::vector<size_t> &positions, const std::string &data) {
+          const char *buffer = data.data();
+          for (size_t feat_idx = 0; feat_idx < feat_num; ++feat_idx) {
+            for (auto pos : positions) {
+              size_t feat_len = *(const size_t *)buffer;
+              buffer += sizeof(size_t);
+              subgraph.features[feat_idx][pos].assign(buffer, feat_len);
+              buffer += feat_len;
+            }
+          }
+        });
+    if (ret != 0) {
+      set_response_code(response, -1,
+                        "graph_sample_subgraph failed to get features");
+      return -1;
+    }
+  }
+
+  size_t size = subgraph.get_size();
+  std::unique_ptr<char[]> buffer(new char[size]);
+  subgraph.to_buffer(buffer.get());
+  cntl->response_attachment().append(buffer.get(), size);
+  return 0;
+}
 }  // namespace distributed
 }  // namespace paddle
@@ -18,7 +18,9 @@
 #include "brpc/controller.h"
 #include "brpc/server.h"
 
+#include <functional>
 #include <memory>
+#include <string>
 #include <vector>
 #include "paddle/fluid/distributed/service/brpc_ps_server.h"
 #include "paddle/fluid/distributed/service/server.h"
@@ -109,9 +111,32 @@ class GraphBrpcService : public PsBaseService {
   int32_t print_table_stat(Table *table, const PsRequestMessage &request,
                            PsResponseMessage &response, brpc::Controller *cntl);
 
+  int32_t graph_get_node_feat_dense(Table *table,
+                                    const PsRequestMessage &request,
+                                    PsResponseMessage &response,
+                                    brpc::Controller *cntl);
+
+  int32_t graph_sample_subgraph(Table *table, const PsRequestMessage &request,
+                                PsResponseMessage &response,
+                                brpc::Controller *cntl);
+
+  // Sends ids, split by the servers holding them, and params to cmd_id of the
+  // table, and parses the response of every server with the positions of its
+  // ids in ids. The part of this server runs in place, the others in
+  // parallel.
+  int32_t call_servers_by_ids(
+      uint32_t table_id, int32_t cmd_id, const std::vector<uint64_t> &ids,
+      const std::vector<std::string> &params,
+      const std::function<void(const std::vector<size_t> &positions,
+                               const std::string &response)> &parse);
+  brpc::Channel *get_peer_channel(size_t rank);
+
  private:
   bool _is_initialize_shard_info;
   std::mutex _initialize_shard_mutex;
+  // to the other servers, for the requests spanning them
+  std::mutex _peer_channel_mutex;
+  std::vector<std::shared_ptr<brpc::Channel>> _peer_channels;
   std::unordered_map<int32_t, serviceHandlerFunc> _msg_handler_map;
   std::vector<float> _ori_values;
   const int sample_nodes_ranges = 23;
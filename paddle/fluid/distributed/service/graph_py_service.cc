@@ -330,6 +330,49 @@ std::vector<std::vector<std::string>> GraphPyClient::get_node_feat(
   return v;
 }
 
+int32_t GraphPyClient::get_node_feat_dense(
+    std::string node_type, const std::vector<uint64_t> &node_ids,
+    std::string feature_name, int32_t shape, float *res) {
+  if (!this->table_id_map.count(node_type)) {
+    return -1;
+  }
+  uint32_t table_id = this->table_id_map[node_type];
+  auto status = worker_ptr->get_node_feat_dense(table_id, node_ids,
+                                                feature_name, shape, res);
+  status.wait();
+  return status.get();
+}
+
+int32_t GraphPyClient::get_node_feat_dense(
+    std::string node_type, const std::vector<uint64_t> &node_ids,
+    std::string feature_name, int32_t shape, int64_t *res) {
+  if (!this->table_id_map.count(node_type)) {
+    return -1;
+  }
+  uint32_t table_id = this->table_id_map[node_type];
+  auto status = worker_ptr->get_node_feat_dense(table_id, node_ids,
+                                                feature_name, shape, res);
+  status.wait();
+  return status.get();
+}
+
+GraphSubgraph GraphPyClient::sample_subgraph(
+    std::string name, std::vector<uint64_t> seeds, std::vector<int> fanouts,
+    std::string node_type, std::vector<std::string> feature_names) {
+  GraphSubgraph res;
+  if (this->table_id_map.count(name)) {
+    uint32_t table_id = this->table_id_map[name];
+    uint32_t feat_table_id = table_id;
+    if (!feature_names.empty() && this->table_id_map.count(node_type)) {
+      feat_table_id = this->table_id_map[node_type];
+    }
+    auto status = worker_ptr->sample_subgraph(
+        table_id, seeds, fanouts, feature_names, feat_table_id, res);
+    status.wait();
+  }
+  return res;
+}
+
 std::vector<FeatureNode> GraphPyClient::pull_graph_list(std::string name,
                                                         int server_index,
                                                         int start, int size,
@@ -155,6 +155,22 @@ class GraphPyClient : public GraphPyService {
   std::vector<std::vector<std::string>> get_node_feat(
       std::string node_type, std::vector<uint64_t> node_ids,
       std::vector<std::string> feature_names);
+  // Writes the numeric feature of the nodes into res, node_ids.size() rows
+  // of shape values.
+  int32_t get_node_feat_dense(std::string node_type,
+                              const std::vector<uint64_t>& node_ids,
+                              std::string feature_name, int32_t shape,
+                              float* res);
+  int32_t get_node_feat_dense(std::string node_type,
+                              const std::vector<uint64_t>& node_ids,
+                              std::string feature_name, int32_t shape,
+                              int64_t* res);
+  // the features feature_names are of the nodes of node_type
+  GraphSubgraph sample_subgraph(std::string name,
+                                std::vector<uint64_t> seeds,
+                                std::vector<int> fanouts,
+                                std::string node_type,
+                                std::vector<std::string> feature_names);
   std::vector<FeatureNode> pull_graph_list(std::string name, int server_index,
                                            int start, int size, int step = 1);
   ::paddle::distributed::PSParameter GetWorkerProto();
@@ -259,9 +259,10 @@ class RequestSendAndRecvHandler final : public HeterRequestHandler {
       response_var_names[var_idx] = request->recv_var_names(var_idx);
     }
     auto& response_io_buffer = cntl->response_attachment();
+    // local_scope is the request's, deleted once the response is built
     distributed::SerializeToMultiVarMsgAndIOBuf(
         message_name, response_var_names, empty_var_names, *dev_ctx_,
-        &local_scope, response, &response_io_buffer);
+        &local_scope, response, &response_io_buffer, true);
     scope_->DeleteScope(&local_scope);
     return 0;
   }
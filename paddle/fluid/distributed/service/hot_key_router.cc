@@ -0,0 +1,125 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/service/hot_key_router.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace paddle {
+namespace distributed {
+
+// the counters of the sketch of a table, 1MB
+static const size_t kHotKeySketchWidth = 1 << 16;
+static const size_t kHotKeySketchDepth = 4;
+
+HotKeyRouter::HotKeyRouter(size_t server_num, size_t replica_num,
+                           uint32_t threshold, size_t max_num)
+    : server_num_(std::max<size_t>(server_num, 1)),
+      replica_num_(std::min(replica_num, server_num_ - 1)),
+      threshold_(std::max<uint32_t>(threshold, 1)),
+      max_num_(max_num),
+      sketch_(kHotKeySketchWidth, kHotKeySketchDepth) {}
+
+void HotKeyRouter::Record(const uint64_t *keys, size_t num) {
+  std::lock_guard<std::mutex> lock(sketch_mutex_);
+  for (size_t i = 0; i < num; ++i) {
+    uint32_t estimate = sketch_.Add(keys[i], 1);
+    if (estimate < threshold_) {
+      continue;
+    }
+    // a few times max_num are tracked, the most pulled kept at the end
+    auto iter = candidates_.find(keys[i]);
+    if (iter != candidates_.end()) {
+      iter->second = estimate;
+    } else if (candidates_.size() < max_num_ * 4) {
+      candidates_.emplace(keys[i], estimate);
+    }
+  }
+}
+
+std::vector<uint64_t> HotKeyRouter::TakeCandidates() {
+  std::vector<std::pair<uint32_t, uint64_t>> candidates;
+  {
+    std::lock_guard<std::mutex> lock(sketch_mutex_);
+    candidates.reserve(candidates_.size());
+    for (auto &candidate : candidates_) {
+      candidates.emplace_back(candidate.second, candidate.first);
+    }
+    candidates_.clear();
+    sketch_.Decay();
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const std::pair<uint32_t, uint64_t> &a,
+               const std::pair<uint32_t, uint64_t> &b) {
+              return a.first > b.first ||
+                     (a.first == b.first && a.second < b.second);
+            });
+  std::vector<uint64_t> keys;
+  keys.reserve(std::min(candidates.size(), max_num_));
+  for (size_t i = 0; i < candidates.size() && i < max_num_; ++i) {
+    keys.push_back(candidates[i].second);
+  }
+  return keys;
+}
+
+void HotKeyRouter::SetHotKeys(const std::vector<uint64_t> &keys) {
+  std::unordered_set<uint64_t> hot_keys(keys.begin(), keys.end());
+  std::lock_guard<std::mutex> lock(hot_mutex_);
+  hot_keys_.swap(hot_keys);
+}
+
+bool HotKeyRouter::IsHot(uint64_t key) const {
+  std::lock_guard<std::mutex> lock(hot_mutex_);
+  return hot_keys_.count(key) > 0;
+}
+
+size_t HotKeyRouter::hot_key_num() const {
+  std::lock_guard<std::mutex> lock(hot_mutex_);
+  return hot_keys_.size();
+}
+
+void HotKeyRouter::Route(const uint64_t *keys, size_t num,
+                         std::vector<size_t> *load,
+                         std::vector<size_t> *servers) const {
+  load->resize(server_num_, 0);
+  servers->resize(num);
+  std::lock_guard<std::mutex> lock(hot_mutex_);
+  for (size_t i = 0; i < num; ++i) {
+    size_t server = Owner(keys[i]);
+    if (replica_num_ > 0 && hot_keys_.count(keys[i]) > 0) {
+      size_t owner = server;
+      for (size_t j = 1; j <= replica_num_; ++j) {
+        size_t replica = (owner + j) % server_num_;
+        if (load->at(replica) < load->at(server)) {
+          server = replica;
+        }
+      }
+    }
+    ++load->at(server);
+    servers->at(i) = server;
+  }
+}
+
+std::vector<size_t> HotKeyRouter::Replicas(uint64_t key) const {
+  std::vector<size_t> replicas;
+  replicas.reserve(replica_num_);
+  for (size_t j = 1; j <= replica_num_; ++j) {
+    replicas.push_back((Owner(key) + j) % server_num_);
+  }
+  return replicas;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,78 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <mutex>  // NOLINT
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "paddle/fluid/distributed/table/depends/count_min_sketch.h"
+
+namespace paddle {
+namespace distributed {
+
+// Finds the feasigns of a sparse table a client pulls the most, and spreads
+// the pulls of them over the pservers holding a read-only replica.
+//
+// A feasign is owned by the pserver key % server_num. The replicas of a hot
+// feasign are on the replica_num pservers after its owner. The pulls of a
+// round are counted in a count-min sketch, the feasigns reaching threshold
+// in the round are the candidates of the next hot set, at most max_num of
+// the most pulled. The hot set is only routed to once its replicas are
+// written, see BrpcPsClient::refresh_hot_keys.
+class HotKeyRouter {
+ public:
+  HotKeyRouter(size_t server_num, size_t replica_num, uint32_t threshold,
+               size_t max_num);
+
+  // Counts the keys pulled in the round.
+  void Record(const uint64_t *keys, size_t num);
+
+  // Ends the round, returns the candidates sorted, the most pulled first.
+  std::vector<uint64_t> TakeCandidates();
+
+  void SetHotKeys(const std::vector<uint64_t> &keys);
+
+  bool IsHot(uint64_t key) const;
+
+  // The servers to pull the keys from: the owner, or for a hot key the one
+  // of its owner and replicas the least keys are pulled from so far, with
+  // load the keys pulled from every server before.
+  void Route(const uint64_t *keys, size_t num, std::vector<size_t> *load,
+             std::vector<size_t> *servers) const;
+
+  // The servers holding a replica of the key, its owner excluded.
+  std::vector<size_t> Replicas(uint64_t key) const;
+
+  size_t Owner(uint64_t key) const { return key % server_num_; }
+  size_t hot_key_num() const;
+
+ private:
+  size_t server_num_;
+  size_t replica_num_;
+  uint32_t threshold_;
+  size_t max_num_;
+
+  std::mutex sketch_mutex_;
+  CountMinSketch sketch_;
+  std::unordered_map<uint64_t, uint32_t> candidates_;
+
+  mutable std::mutex hot_mutex_;
+  std::unordered_set<uint64_t> hot_keys_;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,498 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/service/ps_shm_channel.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <new>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/string/string_helper.h"
+
+DEFINE_string(pserver_shm_endpoints, "",
+              "comma separated ip:port of the pservers that share the host "
+              "with their trainers, pull_sparse, push_sparse and pull_dense "
+              "to them go through shared memory instead of brpc");
+DEFINE_int32(pserver_shm_slot_num, 32,
+             "number of concurrent calls of the shared memory channel of a "
+             "pserver");
+DEFINE_int32(pserver_shm_slot_size, 4 << 20,
+             "max bytes of the request and of the response of a shared "
+             "memory call, larger calls go through brpc");
+DEFINE_int32(pserver_shm_server_thread, 4,
+             "number of threads serving the shared memory channel of a "
+             "pserver");
+DEFINE_int32(pserver_shm_heartbeat_timeout_ms, 3000,
+             "trainers stop using the shared memory channel of a pserver "
+             "whose threads have not run for that long, and go through brpc");
+
+namespace paddle {
+namespace distributed {
+
+static const uint32_t kPsShmMagic = 0x50535348;  // "PSSH"
+
+struct alignas(64) PsShmHeader {
+  // written last by the server, the segment is usable once it is set, and
+  // cleared when the server stops
+  std::atomic<uint32_t> magic;
+  uint32_t slot_num;
+  uint64_t slot_size;
+  // tells a segment recreated by a restarted server from the mapped one
+  uint64_t generation;
+  // CLOCK_MONOTONIC of the last round of the server, shared by processes
+  std::atomic<int64_t> heartbeat_ms;
+};
+
+static int64_t PsShmNowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+static uint64_t PsShmTag(uint32_t pid, uint32_t state) {
+  return static_cast<uint64_t>(pid) << 32 | state;
+}
+static uint32_t PsShmOwner(uint64_t tag) { return tag >> 32; }
+static uint32_t PsShmState(uint64_t tag) { return tag & 0xffffffff; }
+
+static bool PsShmProcessAlive(uint32_t pid) {
+  return kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+// Spins first since the peer usually answers within microseconds, then
+// yields, and finally sleeps so that an idle server does not burn a core.
+class PsShmBackoff {
+ public:
+  void Wait() {
+    ++_count;
+    if (_count < 1024) {
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+    } else if (_count < 2048) {
+      std::this_thread::yield();
+    } else {
+      std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+  }
+  bool Sleeping() const { return _count >= 2048; }
+  void Reset() { _count = 0; }
+
+ private:
+  uint32_t _count = 0;
+};
+
+class PsShmSegment {
+ public:
+  ~PsShmSegment() {
+    if (_base != nullptr) {
+      munmap(_base, _bytes);
+    }
+    if (_owner) {
+      shm_unlink(_name.c_str());
+    }
+  }
+
+  static std::unique_ptr<PsShmSegment> Create(const std::string &name,
+                                              uint32_t slot_num,
+                                              size_t slot_size) {
+    std::unique_ptr<PsShmSegment> segment(new PsShmSegment());
+    segment->_name = name;
+    segment->_stride = sizeof(PsShmSlot) + (slot_size + 63) / 64 * 64;
+    segment->_bytes = sizeof(PsShmHeader) + segment->_stride * slot_num;
+    // a segment left by a pserver that crashed is replaced, its trainers
+    // map the new one by the generation
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      PLOG(WARNING) << "shm_open " << name << " failed";
+      return nullptr;
+    }
+    segment->_owner = true;
+    if (ftruncate(fd, segment->_bytes) != 0 || !segment->Map(fd)) {
+      PLOG(WARNING) << "failed to map " << name;
+      close(fd);
+      return nullptr;
+    }
+    close(fd);
+
+    auto *header = segment->header();
+    header->slot_num = slot_num;
+    header->slot_size = slot_size;
+    header->generation =
+        static_cast<uint64_t>(
+            std::chrono::system_clock::now().time_since_epoch().count()) ^
+        static_cast<uint64_t>(getpid()) << 48;
+    header->heartbeat_ms.store(PsShmNowMs(), std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slot_num; ++i) {
+      new (segment->slot(i)) PsShmSlot();
+      segment->slot(i)->tag.store(PS_SHM_SLOT_FREE, std::memory_order_relaxed);
+    }
+    header->magic.store(kPsShmMagic, std::memory_order_release);
+    return segment;
+  }
+
+  static std::unique_ptr<PsShmSegment> Open(const std::string &name) {
+    int fd = shm_open(name.c_str(), O_RDWR, 0600);
+    if (fd < 0) {
+      return nullptr;
+    }
+    struct stat st;
+    std::unique_ptr<PsShmSegment> segment(new PsShmSegment());
+    segment->_name = name;
+    if (fstat(fd, &st) != 0 ||
+        static_cast<size_t>(st.st_size) < sizeof(PsShmHeader)) {
+      close(fd);
+      return nullptr;
+    }
+    segment->_bytes = st.st_size;
+    if (!segment->Map(fd)) {
+      PLOG(WARNING) << "failed to map " << name;
+      close(fd);
+      return nullptr;
+    }
+    close(fd);
+
+    auto *header = segment->header();
+    if (header->magic.load(std::memory_order_acquire) != kPsShmMagic) {
+      return nullptr;
+    }
+    segment->_stride =
+        sizeof(PsShmSlot) + (header->slot_size + 63) / 64 * 64;
+    if (sizeof(PsShmHeader) + segment->_stride * header->slot_num >
+        segment->_bytes) {
+      LOG(WARNING) << "shared memory segment " << name << " is truncated";
+      return nullptr;
+    }
+    return segment;
+  }
+
+  PsShmHeader *header() { return reinterpret_cast<PsShmHeader *>(_base); }
+  PsShmSlot *slot(uint32_t i) {
+    return reinterpret_cast<PsShmSlot *>(_base + sizeof(PsShmHeader) +
+                                         _stride * i);
+  }
+  uint32_t slot_num() { return header()->slot_num; }
+  size_t slot_size() { return header()->slot_size; }
+  uint64_t generation() { return header()->generation; }
+
+  // Whether the server is still serving the segment.
+  bool Alive() {
+    return header()->magic.load(std::memory_order_acquire) == kPsShmMagic &&
+           PsShmNowMs() -
+                   header()->heartbeat_ms.load(std::memory_order_relaxed) <
+               FLAGS_pserver_shm_heartbeat_timeout_ms;
+  }
+
+ private:
+  PsShmSegment() {}
+
+  bool Map(int fd) {
+    void *base =
+        mmap(nullptr, _bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED) {
+      return false;
+    }
+    _base = reinterpret_cast<char *>(base);
+    return true;
+  }
+
+  std::string _name;
+  char *_base = nullptr;
+  size_t _bytes = 0;
+  size_t _stride = 0;
+  bool _owner = false;
+};
+
+std::string PsShmName(const std::string &ip, uint32_t port) {
+  return "/paddle_ps_" + ip + "_" + std::to_string(port);
+}
+
+bool PsShmEnabled(const std::string &ip, uint32_t port) {
+  if (FLAGS_pserver_shm_endpoints.empty()) {
+    return false;
+  }
+  std::string endpoint = ip + ":" + std::to_string(port);
+  auto endpoints = paddle::string::split_string<std::string>(
+      FLAGS_pserver_shm_endpoints, ",");
+  for (auto &item : endpoints) {
+    if (paddle::string::trim_spaces(item) == endpoint) {
+      return true;
+    }
+  }
+  return false;
+}
+
+PsShmChannel::PsShmChannel() {}
+
+PsShmChannel::~PsShmChannel() {}
+
+std::shared_ptr<PsShmChannel> PsShmChannel::Open(const std::string &ip,
+                                                 uint32_t port) {
+  auto segment = PsShmSegment::Open(PsShmName(ip, port));
+  if (segment == nullptr) {
+    return nullptr;
+  }
+  std::shared_ptr<PsShmChannel> channel(new PsShmChannel());
+  channel->_name = PsShmName(ip, port);
+  channel->_segment = std::move(segment);
+  return channel;
+}
+
+std::shared_ptr<PsShmSegment> PsShmChannel::segment() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _segment;
+}
+
+std::shared_ptr<PsShmSegment> PsShmChannel::Refresh(
+    const std::shared_ptr<PsShmSegment> &stale) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  if (_segment != stale) {
+    return _segment->Alive() ? _segment : nullptr;
+  }
+  // the segment is looked up at most once per second while the server is
+  // away, not once per call
+  auto now = std::chrono::steady_clock::now();
+  if (now - _last_refresh < std::chrono::seconds(1)) {
+    return nullptr;
+  }
+  _last_refresh = now;
+  auto fresh = PsShmSegment::Open(_name);
+  if (fresh == nullptr || fresh->generation() == stale->generation() ||
+      !fresh->Alive()) {
+    return nullptr;
+  }
+  LOG(INFO) << "map " << _name << " again, recreated by the pserver";
+  _segment = std::move(fresh);
+  return _segment;
+}
+
+size_t PsShmChannel::slot_size() { return segment()->slot_size(); }
+
+bool PsShmChannel::Acquire(size_t request_size, size_t response_size,
+                           int wait_us, PsShmClaim *claim) {
+  auto segment = this->segment();
+  if (!segment->Alive()) {
+    segment = Refresh(segment);
+    if (segment == nullptr) {
+      return false;
+    }
+  }
+  if (request_size > segment->slot_size() ||
+      response_size > segment->slot_size()) {
+    return false;
+  }
+  uint32_t pid = getpid();
+  uint32_t slot_num = segment->slot_num();
+  auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::microseconds(wait_us);
+  PsShmBackoff backoff;
+  while (true) {
+    uint32_t start = _next_slot.fetch_add(1, std::memory_order_relaxed);
+    for (uint32_t x = 0; x < slot_num; ++x) {
+      auto *slot = segment->slot((start + x) % slot_num);
+      uint64_t expected = PsShmTag(0, PS_SHM_SLOT_FREE);
+      if (slot->tag.load(std::memory_order_relaxed) == expected &&
+          slot->tag.compare_exchange_strong(expected,
+                                            PsShmTag(pid, PS_SHM_SLOT_CLAIMED),
+                                            std::memory_order_acquire)) {
+        claim->segment = segment;
+        claim->slot = slot;
+        return true;
+      }
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      return false;
+    }
+    backoff.Wait();
+  }
+}
+
+void PsShmChannel::Publish(PsShmClaim *claim) {
+  auto *slot = claim->slot;
+  slot->err_code = 0;
+  slot->tag.store(PsShmTag(PsShmOwner(slot->tag.load()), PS_SHM_SLOT_REQUEST),
+                  std::memory_order_release);
+}
+
+bool PsShmChannel::Wait(PsShmClaim *claim, int timeout_ms) {
+  auto *slot = claim->slot;
+  PsShmBackoff backoff;
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::milliseconds(timeout_ms);
+  while (PsShmState(slot->tag.load(std::memory_order_acquire)) !=
+         PS_SHM_SLOT_RESPONSE) {
+    backoff.Wait();
+    if (!backoff.Sleeping()) {
+      continue;
+    }
+    if (std::chrono::steady_clock::now() > deadline) {
+      LOG(ERROR) << "shared memory call cmd_id:" << slot->cmd_id
+                 << " timeout after " << timeout_ms << "ms";
+      GiveUp(claim);
+      return false;
+    }
+    if (!claim->segment->Alive()) {
+      LOG(ERROR) << "shared memory call cmd_id:" << slot->cmd_id
+                 << " failed, the pserver is gone";
+      GiveUp(claim);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool PsShmChannel::Call(PsShmClaim *claim, int timeout_ms) {
+  Publish(claim);
+  return Wait(claim, timeout_ms);
+}
+
+void PsShmChannel::GiveUp(PsShmClaim *claim) {
+  auto *slot = claim->slot;
+  uint32_t pid = PsShmOwner(slot->tag.load());
+  // freed at once if the server has not started on it, left to the server
+  // if it is serving it, and the late response is dropped otherwise
+  uint64_t expected = PsShmTag(pid, PS_SHM_SLOT_REQUEST);
+  if (!slot->tag.compare_exchange_strong(expected, PS_SHM_SLOT_FREE)) {
+    expected = PsShmTag(pid, PS_SHM_SLOT_SERVING);
+    if (!slot->tag.compare_exchange_strong(
+            expected, PsShmTag(pid, PS_SHM_SLOT_ABANDONED))) {
+      slot->tag.store(PS_SHM_SLOT_FREE, std::memory_order_release);
+    }
+  }
+  claim->slot = nullptr;
+  claim->segment.reset();
+}
+
+void PsShmChannel::Release(PsShmClaim *claim) {
+  if (claim->slot == nullptr) {
+    return;
+  }
+  claim->slot->tag.store(PS_SHM_SLOT_FREE, std::memory_order_release);
+  claim->slot = nullptr;
+  claim->segment.reset();
+}
+
+PsShmServer::PsShmServer() {}
+
+PsShmServer::~PsShmServer() { Stop(); }
+
+int32_t PsShmServer::Start(const std::string &ip, uint32_t port, int slot_num,
+                           size_t slot_size, int thread_num,
+                           PsShmHandler handler) {
+  _segment = PsShmSegment::Create(PsShmName(ip, port), slot_num, slot_size);
+  if (_segment == nullptr) {
+    return -1;
+  }
+  _handler = handler;
+  _running = true;
+  _thread_num = std::max(1, std::min(thread_num, slot_num));
+  for (int i = 0; i < _thread_num; ++i) {
+    _threads.emplace_back(&PsShmServer::Serve, this, i);
+  }
+  VLOG(0) << "pserver " << ip << ":" << port << " serves "
+          << PsShmName(ip, port) << " with " << slot_num << " slots of "
+          << slot_size << " bytes";
+  return 0;
+}
+
+void PsShmServer::Serve(int thread_id) {
+  PsShmBackoff backoff;
+  uint32_t slot_num = _segment->slot_num();
+  auto *header = _segment->header();
+  int64_t last_beat = 0;
+  int64_t last_reap = PsShmNowMs();
+  while (_running.load(std::memory_order_relaxed)) {
+    bool busy = false;
+    for (uint32_t x = thread_id; x < slot_num; x += _thread_num) {
+      auto *slot = _segment->slot(x);
+      uint64_t tag = slot->tag.load(std::memory_order_acquire);
+      if (PsShmState(tag) != PS_SHM_SLOT_REQUEST) {
+        continue;
+      }
+      // the trainer may give the request up or die meanwhile
+      uint64_t serving = PsShmTag(PsShmOwner(tag), PS_SHM_SLOT_SERVING);
+      if (!slot->tag.compare_exchange_strong(tag, serving,
+                                             std::memory_order_acquire)) {
+        continue;
+      }
+      _handler(slot);
+      if (!slot->tag.compare_exchange_strong(
+              serving, PsShmTag(PsShmOwner(serving), PS_SHM_SLOT_RESPONSE),
+              std::memory_order_release)) {
+        slot->tag.store(PS_SHM_SLOT_FREE, std::memory_order_release);
+      }
+      busy = true;
+    }
+    if (busy) {
+      backoff.Reset();
+    } else {
+      backoff.Wait();
+    }
+    // every thread beats, a long call on one of them does not stall it
+    int64_t now = PsShmNowMs();
+    if (now - last_beat >= 100) {
+      header->heartbeat_ms.store(now, std::memory_order_relaxed);
+      last_beat = now;
+    }
+    if (thread_id == 0 && now - last_reap >= 1000) {
+      Reap();
+      last_reap = now;
+    }
+  }
+}
+
+void PsShmServer::Reap() {
+  uint32_t slot_num = _segment->slot_num();
+  for (uint32_t x = 0; x < slot_num; ++x) {
+    auto *slot = _segment->slot(x);
+    uint64_t tag = slot->tag.load(std::memory_order_acquire);
+    uint32_t state = PsShmState(tag);
+    // a SERVING or ABANDONED slot is freed by its serving thread
+    if (state == PS_SHM_SLOT_FREE || state == PS_SHM_SLOT_SERVING ||
+        state == PS_SHM_SLOT_ABANDONED ||
+        PsShmProcessAlive(PsShmOwner(tag))) {
+      continue;
+    }
+    if (slot->tag.compare_exchange_strong(tag, PS_SHM_SLOT_FREE,
+                                          std::memory_order_release)) {
+      LOG(WARNING) << "free shared memory slot " << x << " of dead trainer "
+                   << PsShmOwner(tag);
+    }
+  }
+}
+
+void PsShmServer::Stop() {
+  _running = false;
+  for (auto &t : _threads) {
+    t.join();
+  }
+  _threads.clear();
+  if (_segment != nullptr) {
+    // trainers fail fast and fall back to brpc instead of timing out
+    _segment->header()->magic.store(0, std::memory_order_release);
+    _segment.reset();
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
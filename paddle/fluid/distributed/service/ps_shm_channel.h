@@ -0,0 +1,165 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <chrono>  // NOLINT
+#include <functional>
+#include <memory>
+#include <mutex>  // NOLINT
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// The shared memory transport between a pserver and the trainers on the same
+// host. The pserver creates one segment per endpoint, named after it, which
+// holds slot_num slots of a fixed size. A trainer claims a free slot with a
+// CAS, writes the request in place and publishes it; the server thread owning
+// the slot runs it against the table and writes the response into the same
+// slot. No lock and no syscall is on the path, both sides spin and then back
+// off while waiting.
+//
+// Only pull_sparse, push_sparse and pull_dense go through it, with the same
+// layout of keys and values as the brpc attachments, and only when they fit
+// in one slot and a slot is free in time. Everything else keeps using brpc.
+//
+// The tag of a slot holds its state and the pid of the trainer holding it.
+// The server frees the slots of trainers that died, and the ones given up by
+// a trainer while being served. It refreshes a heartbeat in the header, so
+// that trainers stop using a segment whose server is gone, and map the new
+// one when the server comes back. Trainers and pserver must share the pid
+// namespace.
+enum PsShmSlotState : uint32_t {
+  PS_SHM_SLOT_FREE = 0,
+  PS_SHM_SLOT_CLAIMED = 1,
+  PS_SHM_SLOT_REQUEST = 2,
+  PS_SHM_SLOT_SERVING = 3,
+  PS_SHM_SLOT_RESPONSE = 4,
+  // given up by the trainer while served, freed by the server
+  PS_SHM_SLOT_ABANDONED = 5,
+};
+
+struct alignas(64) PsShmSlot {
+  // the PsShmSlotState in the low 32 bits, the pid of the owner in the high
+  std::atomic<uint64_t> tag;
+  int32_t cmd_id;
+  uint32_t table_id;
+  uint32_t num;
+  int32_t err_code;
+  // bytes of the request, then of the response, in data()
+  uint64_t data_size;
+
+  char *data() { return reinterpret_cast<char *>(this + 1); }
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2,
+              "PsShmSlot needs lock free atomics to be shared by processes");
+
+// "/paddle_ps_127.0.0.1_4209", the name of the segment of an endpoint.
+std::string PsShmName(const std::string &ip, uint32_t port);
+
+// Whether the endpoint is listed in FLAGS_pserver_shm_endpoints.
+bool PsShmEnabled(const std::string &ip, uint32_t port);
+
+class PsShmSegment;
+
+// A slot claimed by a trainer, it keeps the segment of the slot mapped.
+struct PsShmClaim {
+  std::shared_ptr<PsShmSegment> segment;
+  PsShmSlot *slot = nullptr;
+};
+
+// The trainer end, shared by all the threads of a client.
+class PsShmChannel {
+ public:
+  ~PsShmChannel();
+
+  // Returns nullptr when the segment of the endpoint is not there, e.g. the
+  // pserver runs on another host.
+  static std::shared_ptr<PsShmChannel> Open(const std::string &ip,
+                                            uint32_t port);
+
+  // The bytes a request or a response may take.
+  size_t slot_size();
+
+  // Claims a free slot for a request and a response of the given sizes,
+  // waiting at most wait_us. Returns false when they do not fit, no slot was
+  // free in time or the server is gone; the call then goes through brpc.
+  bool Acquire(size_t request_size, size_t response_size, int wait_us,
+               PsShmClaim *claim);
+
+  // Publishes the request written in the slot, the server starts on it.
+  void Publish(PsShmClaim *claim);
+
+  // Waits for the response of the published request, whose err_code and data
+  // are then in the slot. Returns false if none came within timeout_ms or the
+  // server is gone, the slot is then given up and must not be touched.
+  bool Wait(PsShmClaim *claim, int timeout_ms);
+
+  // Publish and Wait.
+  bool Call(PsShmClaim *claim, int timeout_ms);
+
+  void Release(PsShmClaim *claim);
+
+ private:
+  PsShmChannel();
+
+  std::shared_ptr<PsShmSegment> segment();
+
+  // The segment to use instead of stale, mapped again if the server
+  // recreated it, or nullptr if the server is not back.
+  std::shared_ptr<PsShmSegment> Refresh(
+      const std::shared_ptr<PsShmSegment> &stale);
+
+  void GiveUp(PsShmClaim *claim);
+
+  std::string _name;
+  std::mutex _mutex;
+  std::shared_ptr<PsShmSegment> _segment;
+  std::chrono::steady_clock::time_point _last_refresh;
+  std::atomic<uint32_t> _next_slot{0};
+};
+
+typedef std::function<void(PsShmSlot *)> PsShmHandler;
+
+// The pserver end. Slot i is served by thread i % thread_num, so a slot has a
+// single producer and a single consumer at any time.
+class PsShmServer {
+ public:
+  PsShmServer();
+  ~PsShmServer();
+
+  int32_t Start(const std::string &ip, uint32_t port, int slot_num,
+                size_t slot_size, int thread_num, PsShmHandler handler);
+  void Stop();
+
+ private:
+  void Serve(int thread_id);
+
+  // Frees the slots held by trainers that died.
+  void Reap();
+
+  std::unique_ptr<PsShmSegment> _segment;
+  PsShmHandler _handler;
+  int _thread_num = 1;
+  std::vector<std::thread> _threads;
+  std::atomic<bool> _running{false};
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,138 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/service/sparse_pull_coalescer.h"
+
+#include <errno.h>
+#include <algorithm>
+#include <unordered_map>
+
+#include "butil/time.h"
+#include "paddle/fluid/distributed/table/table.h"
+
+namespace paddle {
+namespace distributed {
+
+SparsePullCoalescer::SparsePullCoalescer(Table *table, int64_t window_us,
+                                         size_t max_requests)
+    : _table(table),
+      _window_us(window_us),
+      _max_requests(std::max<size_t>(max_requests, 1)) {}
+
+int32_t SparsePullCoalescer::Pull(const PullSparseValue &value,
+                                  float *values) {
+  ++_requests;
+  auto &open = _batches[value.is_training_ ? 1 : 0];
+  std::unique_lock<bthread::Mutex> lock(_mutex);
+  bool leader = open == nullptr;
+  if (leader) {
+    open = std::make_shared<Batch>();
+  }
+  auto batch = open;
+  size_t index = batch->requests.size();
+  batch->requests.push_back({&value, values});
+  if (batch->requests.size() >= _max_requests) {
+    // the next requests start another batch
+    open.reset();
+    batch->full = true;
+    batch->cv.notify_all();
+  }
+
+  if (!leader) {
+    while (!batch->done) {
+      batch->cv.wait(lock);
+    }
+    return batch->rets[index];
+  }
+  int64_t deadline_us = butil::gettimeofday_us() + _window_us;
+  while (!batch->full) {
+    int64_t left_us = deadline_us - butil::gettimeofday_us();
+    if (left_us <= 0 || batch->cv.wait_for(lock, left_us) == ETIMEDOUT) {
+      break;
+    }
+  }
+  if (open == batch) {
+    open.reset();
+  }
+  lock.unlock();
+
+  // the batch is closed, its requests are read without the lock
+  std::vector<int32_t> rets;
+  run(batch->requests, value.is_training_, &rets);
+
+  lock.lock();
+  batch->rets.swap(rets);
+  batch->done = true;
+  batch->cv.notify_all();
+  return batch->rets[0];
+}
+
+void SparsePullCoalescer::run(const std::vector<Request> &requests,
+                              bool is_training, std::vector<int32_t> *rets) {
+  ++_lookups;
+  rets->assign(requests.size(), 0);
+  if (requests.size() == 1) {
+    (*rets)[0] = _table->pull_sparse(requests[0].values, *requests[0].value);
+    return;
+  }
+
+  // the distinct feasigns, and where every request finds its values
+  std::unordered_map<uint64_t, uint32_t> index;
+  std::vector<uint64_t> feasigns;
+  std::vector<uint32_t> frequencies;
+  std::vector<uint32_t> positions;
+  for (auto &request : requests) {
+    auto &value = *request.value;
+    for (int x = 0; x < value.numel_; ++x) {
+      uint32_t frequency =
+          value.frequencies_ == nullptr ? 1 : value.frequencies_[x];
+      auto iter = index.emplace(value.feasigns_[x], feasigns.size());
+      if (iter.second) {
+        feasigns.push_back(value.feasigns_[x]);
+        frequencies.push_back(frequency);
+      } else {
+        frequencies[iter.first->second] += frequency;
+      }
+      positions.push_back(iter.first->second);
+    }
+  }
+
+  int dim = requests[0].value->dim_;
+  PullSparseValue merged(feasigns.size(), dim);
+  merged.is_training_ = is_training;
+  merged.feasigns_ = feasigns.data();
+  merged.frequencies_ = frequencies.data();
+  std::vector<float> merged_values(feasigns.size() * dim);
+  if (_table->pull_sparse(merged_values.data(), merged) != 0) {
+    // a request must not fail for the feasigns of another
+    VLOG(1) << "the merged pull of " << requests.size()
+            << " requests failed, pulls them one by one";
+    for (size_t i = 0; i < requests.size(); ++i) {
+      ++_lookups;
+      (*rets)[i] = _table->pull_sparse(requests[i].values, *requests[i].value);
+    }
+    return;
+  }
+
+  size_t position = 0;
+  for (auto &request : requests) {
+    for (int x = 0; x < request.value->numel_; ++x) {
+      std::copy_n(merged_values.data() + positions[position++] * dim, dim,
+                  request.values + x * dim);
+    }
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,78 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "bthread/condition_variable.h"
+#include "bthread/mutex.h"
+#include "paddle/fluid/distributed/table/depends/sparse_utils.h"
+
+namespace paddle {
+namespace distributed {
+
+class Table;
+
+// Merges the pull_sparse of a table arriving together into one lookup of
+// their distinct feasigns, the values of which are copied back to every
+// request. The first request of a batch waits window_us for the others, or
+// less once max_requests are in. The frequencies of a feasign pulled by
+// several requests are summed, so the table counts it as the requests would.
+// If the merged lookup fails, every request of the batch is pulled alone so
+// that only the failing ones fail. The requests wait on butexes, which park
+// the bthread of a brpc handler instead of blocking its worker.
+class SparsePullCoalescer {
+ public:
+  SparsePullCoalescer(Table *table, int64_t window_us, size_t max_requests);
+
+  // As table->pull_sparse(values, value), with the other requests of the
+  // batch.
+  int32_t Pull(const PullSparseValue &value, float *values);
+
+  // the requests pulled and the lookups of the table they took so far
+  int64_t requests() const { return _requests; }
+  int64_t lookups() const { return _lookups; }
+
+ private:
+  struct Request {
+    const PullSparseValue *value;
+    float *values;
+  };
+  struct Batch {
+    std::vector<Request> requests;
+    bool full = false;
+    bool done = false;
+    // of every request
+    std::vector<int32_t> rets;
+    bthread::ConditionVariable cv;
+  };
+
+  void run(const std::vector<Request> &requests, bool is_training,
+           std::vector<int32_t> *rets);
+
+  Table *_table;
+  int64_t _window_us;
+  size_t _max_requests;
+  bthread::Mutex _mutex;
+  // the batches open, of the training pulls and the others
+  std::shared_ptr<Batch> _batches[2];
+  std::atomic<int64_t> _requests{0};
+  std::atomic<int64_t> _lookups{0};
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -17,6 +17,7 @@
 #include <stdio.h>
 #include <unordered_map>
 #include <vector>
+#include "paddle/fluid/distributed/common/gradient_codec.h"
 #include "paddle/fluid/distributed/common/registerer.h"
 #include "paddle/fluid/distributed/ps.pb.h"
 
@@ -96,6 +97,32 @@ class ValueAccessor {
   virtual size_t update_size() = 0;
   // fea total for dense
   virtual size_t fea_dim() { return _config.fea_dim(); }
+  // client push梯度的压缩类型
+  virtual GradientCompressType gradient_compress_type() {
+    return ParseGradientCompressType(_config.gradient_compress_type());
+  }
+  // 将num个key压缩的push value解压到update_values中, data_size为校验
+  virtual int32_t decompress_update(GradientCompressType type,
+                                    const char* data, size_t data_size,
+                                    size_t num, float* update_values) {
+    size_t dim = update_dim();
+    if (GradientCompressedSize(type, num * dim, dim) != data_size) {
+      return -1;
+    }
+    DecompressGradient(type, data, num * dim, dim, update_values);
+    return 0;
+  }
+  // 将num个dense push value解压到update_values中
+  virtual int32_t decompress_dense_update(GradientCompressType type,
+                                          const char* data, size_t data_size,
+                                          size_t num, float* update_values) {
+    if (GradientCompressedSize(type, num, kDenseGradientRowSize) !=
+        data_size) {
+      return -1;
+    }
+    DecompressGradient(type, data, num, kDenseGradientRowSize, update_values);
+    return 0;
+  }
   // converter for save
   virtual std::string get_converter(int param) {
     auto itr = _data_coverter_map.find(param);
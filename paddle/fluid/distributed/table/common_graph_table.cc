@@ -16,27 +16,44 @@
 #include <time.h>
 #include <algorithm>
 #include <chrono>
+#include <fstream>
 #include <set>
 #include <sstream>
+#include "gflags/gflags.h"
 #include "paddle/fluid/distributed/common/utils.h"
 #include "paddle/fluid/distributed/table/graph/graph_node.h"
 #include "paddle/fluid/framework/generator.h"
 #include "paddle/fluid/string/printf.h"
 #include "paddle/fluid/string/string_helper.h"
 
+DEFINE_bool(pserver_graph_table_csr, false,
+            "load the edges of GraphTable into immutable compressed sparse "
+            "rows per shard instead of a GraphNode per node");
+
 namespace paddle {
 namespace distributed {
 
-std::vector<Node *> GraphShard::get_batch(int start, int end, int step) {
+std::vector<std::pair<uint64_t, Node *>> GraphShard::get_batch(int start,
+                                                               int end,
+                                                               int step) {
   if (start < 0) start = 0;
-  std::vector<Node *> res;
-  for (int pos = start; pos < std::min(end, (int)bucket.size()); pos += step) {
-    res.push_back(bucket[pos]);
+  std::vector<std::pair<uint64_t, Node *>> res;
+  int csr_size = (int)csr.node_size();
+  for (int pos = start; pos < std::min(end, (int)get_size()); pos += step) {
+    if (pos < csr_size) {
+      uint64_t id = csr.get_id(pos);
+      auto iter = csr_features.find(id);
+      res.push_back(
+          {id, iter == csr_features.end() ? nullptr : iter->second});
+    } else {
+      Node *node = bucket[pos - csr_size];
+      res.push_back({node->get_id(), node});
+    }
   }
   return res;
 }
 
-size_t GraphShard::get_size() { return bucket.size(); }
+size_t GraphShard::get_size() { return csr.node_size() + bucket.size(); }
 
 int32_t GraphTable::add_graph_node(std::vector<uint64_t> &id_list,
                                    std::vector<bool> &is_weight_list) {
@@ -56,6 +73,7 @@ int32_t GraphTable::add_graph_node(std::vector<uint64_t> &id_list,
     tasks.push_back(_shards_task_pool[i]->enqueue([&batch, i, this]() -> int {
       for (auto &p : batch[i]) {
         size_t index = p.first % this->shard_num - this->shard_start;
+        if (this->shards[index].get_csr().find(p.first) >= 0) continue;
         this->shards[index].add_graph_node(p.first)->build_edges(p.second);
       }
       return 0;
@@ -94,12 +112,24 @@ void GraphShard::clear() {
   }
   bucket.clear();
   node_location.clear();
+  for (auto &p : csr_features) {
+    delete p.second;
+  }
+  csr_features.clear();
+  csr.clear();
+  feature_store.clear();
 }
 
 GraphShard::~GraphShard() { clear(); }
 void GraphShard::delete_node(uint64_t id) {
   auto iter = node_location.find(id);
-  if (iter == node_location.end()) return;
+  if (iter == node_location.end()) {
+    if (csr.find(id) >= 0) {
+      VLOG(0) << "node " << id << " has loaded edges and cannot be removed "
+              << "in CSR mode";
+    }
+    return;
+  }
   int pos = iter->second;
   delete bucket[pos];
   if (pos != (int)bucket.size() - 1) {
@@ -108,6 +138,7 @@ void GraphShard::delete_node(uint64_t id) {
   }
   node_location.erase(id);
   bucket.pop_back();
+  feature_store.remove_node(id);
 }
 GraphNode *GraphShard::add_graph_node(uint64_t id) {
   if (node_location.find(id) == node_location.end()) {
@@ -118,6 +149,13 @@ GraphNode *GraphShard::add_graph_node(uint64_t id) {
 }
 
 FeatureNode *GraphShard::add_feature_node(uint64_t id) {
+  if (csr.find(id) >= 0) {
+    auto &node = csr_features[id];
+    if (node == nullptr) {
+      node = new FeatureNode(id);
+    }
+    return node;
+  }
   if (node_location.find(id) == node_location.end()) {
     node_location[id] = bucket.size();
     bucket.push_back(new FeatureNode(id));
@@ -131,7 +169,45 @@ void GraphShard::add_neighboor(uint64_t id, uint64_t dst_id, float weight) {
 
 Node *GraphShard::find_node(uint64_t id) {
   auto iter = node_location.find(id);
-  return iter == node_location.end() ? nullptr : bucket[iter->second];
+  if (iter != node_location.end()) {
+    return bucket[iter->second];
+  }
+  auto feature_iter = csr_features.find(id);
+  return feature_iter == csr_features.end() ? nullptr : feature_iter->second;
+}
+
+void GraphShard::build_csr(std::vector<GraphCsrEdge> *edges,
+                           bool is_weighted) {
+  if (csr.edge_size() > 0) {
+    // the edges loaded before come first, as GraphNode::add_edge appends
+    std::vector<GraphCsrEdge> all_edges;
+    csr.export_edges(&all_edges);
+    all_edges.insert(all_edges.end(), edges->begin(), edges->end());
+    std::vector<GraphCsrEdge>().swap(*edges);
+    edges->swap(all_edges);
+    is_weighted = is_weighted || csr.is_weighted();
+  }
+  csr.build(edges, is_weighted);
+
+  // a node is either in csr or in bucket
+  std::vector<Node *> remain;
+  for (auto *node : bucket) {
+    if (csr.find(node->get_id()) < 0) {
+      remain.push_back(node);
+      continue;
+    }
+    auto *feature_node = dynamic_cast<FeatureNode *>(node);
+    if (feature_node != nullptr) {
+      csr_features[node->get_id()] = feature_node;
+    } else {
+      delete node;
+    }
+  }
+  bucket.swap(remain);
+  node_location.clear();
+  for (size_t i = 0; i < bucket.size(); i++) {
+    node_location[bucket[i]->get_id()] = i;
+  }
 }
 
 int32_t GraphTable::load(const std::string &path, const std::string &param) {
@@ -216,14 +292,14 @@ int32_t GraphTable::load_nodes(const std::string &path, std::string node_type) {
 
       size_t index = shard_id - shard_start;
 
-      auto node = shards[index].add_feature_node(id);
-
-      node->set_feature_size(feat_name.size());
+      shards[index].add_feature_node(id);
+      auto &feature_store = shards[index].get_feature_store();
+      feature_store.add_node(id);
 
       for (size_t slice = 2; slice < values.size(); slice++) {
         auto feat = this->parse_feature(values[slice]);
         if (feat.first >= 0) {
-          node->set_feature(feat.first, feat.second);
+          feature_store.set_feature(id, feat.first, feat.second);
         } else {
           VLOG(4) << "Node feature:  " << values[slice]
                   << " not in feature_map.";
@@ -240,6 +316,9 @@ int32_t GraphTable::load_nodes(const std::string &path, std::string node_type) {
 
 int32_t GraphTable::load_edges(const std::string &path, bool reverse_edge) {
   auto paths = paddle::string::split_string<std::string>(path, ";");
+  if (FLAGS_pserver_graph_table_csr) {
+    return this->load_edges_to_csr(paths, reverse_edge);
+  }
   int64_t count = 0;
   std::string sample_type = "random";
   bool is_weighted = false;
@@ -295,6 +374,114 @@ int32_t GraphTable::load_edges(const std::string &path, bool reverse_edge) {
   return 0;
 }
 
+int32_t GraphTable::load_edges_to_csr(const std::vector<std::string> &paths,
+                                      bool reverse_edge) {
+  // every file is parsed by chunks of lines in parallel, each one sorts its
+  // edges by local shard
+  const int64_t chunk_bytes = 16 << 20;
+  struct Chunk {
+    std::string path;
+    int64_t begin, end;
+    std::vector<std::vector<GraphCsrEdge>> edges;
+    int64_t count = 0;
+    bool is_weighted = false;
+  };
+  std::vector<Chunk> chunks;
+  for (auto &path : paths) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    int64_t file_size = file.is_open() ? (int64_t)file.tellg() : 0;
+    int64_t chunk_num =
+        std::min<int64_t>(file_size / chunk_bytes + 1, task_pool_size_);
+    for (int64_t i = 0; i < chunk_num; i++) {
+      Chunk chunk;
+      chunk.path = path;
+      chunk.begin = file_size * i / chunk_num;
+      chunk.end = file_size * (i + 1) / chunk_num;
+      chunks.push_back(std::move(chunk));
+    }
+  }
+
+  std::vector<std::future<int>> tasks;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
+        [this, &chunks, i, reverse_edge]() -> int {
+          auto &chunk = chunks[i];
+          chunk.edges.resize(shard_num_per_table);
+          std::ifstream file(chunk.path);
+          std::string line;
+          int64_t pos = chunk.begin;
+          // a chunk parses the lines which begin in [begin, end)
+          if (pos > 0) {
+            file.seekg(pos - 1);
+            std::getline(file, line);
+            pos += (int64_t)line.size();
+          }
+          while (pos < chunk.end && std::getline(file, line)) {
+            pos += (int64_t)line.size() + 1;
+            auto values = paddle::string::split_string<std::string>(line, "\t");
+            chunk.count++;
+            if (values.size() < 2) continue;
+            auto src_id = std::stoull(values[0]);
+            auto dst_id = std::stoull(values[1]);
+            if (reverse_edge) {
+              std::swap(src_id, dst_id);
+            }
+            float weight = 1;
+            if (values.size() == 3) {
+              weight = std::stof(values[2]);
+              chunk.is_weighted = true;
+            }
+            size_t src_shard_id = src_id % shard_num;
+            if (src_shard_id >= shard_end || src_shard_id < shard_start) {
+              VLOG(4) << "will not load " << src_id << " from " << chunk.path
+                      << ", please check id distribution";
+              continue;
+            }
+            chunk.edges[src_shard_id - shard_start].push_back(
+                {src_id, dst_id, weight});
+          }
+          return 0;
+        }));
+  }
+  for (size_t i = 0; i < tasks.size(); i++) tasks[i].get();
+  tasks.clear();
+
+  int64_t count = 0, valid_count = 0;
+  bool is_weighted = false;
+  for (auto &chunk : chunks) {
+    count += chunk.count;
+    is_weighted = is_weighted || chunk.is_weighted;
+  }
+  for (size_t i = 0; i < shards.size(); i++) {
+    tasks.push_back(
+        _shards_task_pool[get_thread_pool_index_by_shard_index(i)]->enqueue(
+            [this, &chunks, i, is_weighted]() -> int {
+              // the chunks are in the order of the files, so are the edges
+              std::vector<GraphCsrEdge> edges;
+              size_t size = 0;
+              for (auto &chunk : chunks) size += chunk.edges[i].size();
+              edges.reserve(size);
+              for (auto &chunk : chunks) {
+                edges.insert(edges.end(), chunk.edges[i].begin(),
+                             chunk.edges[i].end());
+                std::vector<GraphCsrEdge>().swap(chunk.edges[i]);
+              }
+              this->shards[i].build_csr(&edges, is_weighted);
+              return (int)size;
+            }));
+  }
+  size_t memory_size = 0, edge_size = 0;
+  for (size_t i = 0; i < tasks.size(); i++) {
+    valid_count += tasks[i].get();
+    memory_size += shards[i].get_csr().memory_size();
+    edge_size += shards[i].get_csr().edge_size();
+  }
+  VLOG(0) << valid_count << "/" << count
+          << " edges are loaded successfully into csr, " << edge_size
+          << " edges of " << memory_size << " bytes in the shards";
+  return 0;
+}
+
 Node *GraphTable::find_node(uint64_t id) {
   size_t shard_id = id % shard_num;
   if (shard_id >= shard_end || shard_id < shard_start) {
@@ -397,42 +584,59 @@ int32_t GraphTable::random_sample_neighboors(
     std::vector<std::unique_ptr<char[]>> &buffers,
     std::vector<int> &actual_sizes) {
   size_t node_num = buffers.size();
-  std::vector<std::future<int>> tasks;
+  // one task per thread samples all of its nodes, reusing the indexes
+  std::vector<std::vector<size_t>> seq_id(task_pool_size_);
   for (size_t idx = 0; idx < node_num; ++idx) {
-    uint64_t &node_id = node_ids[idx];
-    std::unique_ptr<char[]> &buffer = buffers[idx];
-    int &actual_size = actual_sizes[idx];
-
-    int thread_pool_index = get_thread_pool_index(node_id);
-    auto rng = _shards_task_rng_pool[thread_pool_index];
-
-    tasks.push_back(_shards_task_pool[thread_pool_index]->enqueue([&]() -> int {
-      Node *node = find_node(node_id);
+    seq_id[get_thread_pool_index(node_ids[idx])].push_back(idx);
+  }
+  std::vector<std::future<int>> tasks;
+  for (int i = 0; i < task_pool_size_; ++i) {
+    if (seq_id[i].empty()) {
+      continue;
+    }
+    tasks.push_back(_shards_task_pool[i]->enqueue([&, i]() -> int {
+      std::mt19937_64 *rng = _shards_task_rng_pool[i].get();
+      std::vector<int> res;
+      for (size_t idx : seq_id[i]) {
+        uint64_t node_id = node_ids[idx];
+        const GraphCsr *csr = nullptr;
+        int64_t pos = -1;
+        Node *node = nullptr;
+        size_t shard_id = node_id % shard_num;
+        if (shard_id >= shard_start && shard_id < shard_end) {
+          csr = &shards[shard_id - shard_start].get_csr();
+          pos = csr->find(node_id);
+        }
+        if (pos >= 0) {
+          csr->sample_k(pos, sample_size, false, rng, &res);
+        } else if ((node = find_node(node_id)) != nullptr) {
+          node->sample_k(sample_size, false, rng, &res);
+        } else {
+          res.clear();
+        }
 
-      if (node == nullptr) {
-        actual_size = 0;
-        return 0;
-      }
-      std::vector<int> res = node->sample_k(sample_size, rng);
-      actual_size = res.size() * (Node::id_size + Node::weight_size);
-      int offset = 0;
-      uint64_t id;
-      float weight;
-      char *buffer_addr = new char[actual_size];
-      buffer.reset(buffer_addr);
-      for (int &x : res) {
-        id = node->get_neighbor_id(x);
-        weight = node->get_neighbor_weight(x);
-        memcpy(buffer_addr + offset, &id, Node::id_size);
-        offset += Node::id_size;
-        memcpy(buffer_addr + offset, &weight, Node::weight_size);
-        offset += Node::weight_size;
+        actual_sizes[idx] = res.size() * (Node::id_size + Node::weight_size);
+        if (res.empty()) {
+          continue;
+        }
+        char *buffer_addr = new char[actual_sizes[idx]];
+        buffers[idx].reset(buffer_addr);
+        for (int &x : res) {
+          uint64_t id = pos >= 0 ? csr->get_neighbor_id(pos, x)
+                                 : node->get_neighbor_id(x);
+          float weight = pos >= 0 ? csr->get_neighbor_weight(pos, x)
+                                  : node->get_neighbor_weight(x);
+          memcpy(buffer_addr, &id, Node::id_size);
+          buffer_addr += Node::id_size;
+          memcpy(buffer_addr, &weight, Node::weight_size);
+          buffer_addr += Node::weight_size;
+        }
       }
       return 0;
     }));
   }
-  for (size_t idx = 0; idx < node_num; ++idx) {
-    tasks[idx].get();
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i].get();
   }
   return 0;
 }
@@ -440,35 +644,106 @@ int32_t GraphTable::random_sample_neighboors(
 int32_t GraphTable::get_node_feat(const std::vector<uint64_t> &node_ids,
                                   const std::vector<std::string> &feature_names,
                                   std::vector<std::vector<std::string>> &res) {
-  size_t node_num = node_ids.size();
+  std::vector<int> feat_ids;
+  for (auto &feature_name : feature_names) {
+    auto iter = feat_id_map.find(feature_name);
+    feat_ids.push_back(iter == feat_id_map.end() ? -1 : iter->second);
+  }
+  // one task per thread reads the columns of all of its nodes
+  std::vector<std::vector<size_t>> seq_id(task_pool_size_);
+  for (size_t idx = 0; idx < node_ids.size(); ++idx) {
+    size_t shard_id = node_ids[idx] % shard_num;
+    if (shard_id >= shard_start && shard_id < shard_end) {
+      seq_id[get_thread_pool_index(node_ids[idx])].push_back(idx);
+    }
+  }
   std::vector<std::future<int>> tasks;
-  for (size_t idx = 0; idx < node_num; ++idx) {
-    uint64_t node_id = node_ids[idx];
-    tasks.push_back(_shards_task_pool[get_thread_pool_index(node_id)]->enqueue(
-        [&, idx, node_id]() -> int {
-          Node *node = find_node(node_id);
-
-          if (node == nullptr) {
-            return 0;
-          }
-          for (int feat_idx = 0; feat_idx < feature_names.size(); ++feat_idx) {
-            const std::string &feature_name = feature_names[feat_idx];
-            if (feat_id_map.find(feature_name) != feat_id_map.end()) {
-              // res[feat_idx][idx] =
-              // node->get_feature(feat_id_map[feature_name]);
-              auto feat = node->get_feature(feat_id_map[feature_name]);
-              res[feat_idx][idx] = feat;
-            }
+  for (int i = 0; i < task_pool_size_; ++i) {
+    if (seq_id[i].empty()) {
+      continue;
+    }
+    tasks.push_back(_shards_task_pool[i]->enqueue([&, i]() -> int {
+      for (size_t idx : seq_id[i]) {
+        uint64_t node_id = node_ids[idx];
+        auto &feature_store =
+            shards[node_id % shard_num - shard_start].get_feature_store();
+        for (size_t feat_idx = 0; feat_idx < feat_ids.size(); ++feat_idx) {
+          if (feat_ids[feat_idx] >= 0) {
+            feature_store.get_feature(node_id, feat_ids[feat_idx],
+                                      &res[feat_idx][idx]);
           }
-          return 0;
-        }));
+        }
+      }
+      return 0;
+    }));
   }
-  for (size_t idx = 0; idx < node_num; ++idx) {
-    tasks[idx].get();
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i].get();
   }
   return 0;
 }
 
+int32_t GraphTable::get_numeric_feat_shape(const std::string &feature_name) {
+  auto iter = feat_id_map.find(feature_name);
+  if (iter == feat_id_map.end()) {
+    return -1;
+  }
+  const std::string &dtype = feat_dtype[iter->second];
+  if (dtype != "float32" && dtype != "float64" && dtype != "int32" &&
+      dtype != "int64") {
+    return -1;
+  }
+  return feat_shape[iter->second];
+}
+
+template <typename T>
+int32_t GraphTable::get_node_feat_dense(const std::vector<uint64_t> &node_ids,
+                                        const std::string &feature_name,
+                                        T *res) {
+  int32_t shape = get_numeric_feat_shape(feature_name);
+  if (shape < 0) {
+    VLOG(0) << "feature " << feature_name << " of table " << table_name
+            << " is not numeric";
+    return -1;
+  }
+  int feat_id = feat_id_map[feature_name];
+  std::vector<std::vector<size_t>> seq_id(task_pool_size_);
+  for (size_t idx = 0; idx < node_ids.size(); ++idx) {
+    size_t shard_id = node_ids[idx] % shard_num;
+    if (shard_id >= shard_start && shard_id < shard_end) {
+      seq_id[get_thread_pool_index(node_ids[idx])].push_back(idx);
+    } else {
+      std::fill(res + idx * shape, res + (idx + 1) * shape, T(0));
+    }
+  }
+  std::vector<std::future<int>> tasks;
+  for (int i = 0; i < task_pool_size_; ++i) {
+    if (seq_id[i].empty()) {
+      continue;
+    }
+    tasks.push_back(_shards_task_pool[i]->enqueue([&, i]() -> int {
+      for (size_t idx : seq_id[i]) {
+        uint64_t node_id = node_ids[idx];
+        shards[node_id % shard_num - shard_start]
+            .get_feature_store()
+            .copy_feature(node_id, feat_id, res + idx * shape);
+      }
+      return 0;
+    }));
+  }
+  for (size_t i = 0; i < tasks.size(); ++i) {
+    tasks[i].get();
+  }
+  return 0;
+}
+
+template int32_t GraphTable::get_node_feat_dense<float>(
+    const std::vector<uint64_t> &node_ids, const std::string &feature_name,
+    float *res);
+template int32_t GraphTable::get_node_feat_dense<int64_t>(
+    const std::vector<uint64_t> &node_ids, const std::string &feature_name,
+    int64_t *res);
+
 std::pair<int32_t, std::string> GraphTable::parse_feature(
     std::string feat_str) {
   // Return (feat_id, btyes) if name are in this->feat_name, else return (-1,
@@ -507,7 +782,7 @@ int32_t GraphTable::pull_graph_list(int start, int total_size,
                                     int step) {
   if (start < 0) start = 0;
   int size = 0, cur_size;
-  std::vector<std::future<std::vector<Node *>>> tasks;
+  std::vector<std::future<std::vector<std::pair<uint64_t, Node *>>>> tasks;
   for (size_t i = 0; i < shards.size() && total_size > 0; i++) {
     cur_size = shards[i].get_size();
     if (size + cur_size <= start) {
@@ -517,7 +792,8 @@ int32_t GraphTable::pull_graph_list(int start, int total_size,
     int count = std::min(1 + (size + cur_size - start - 1) / step, total_size);
     int end = start + (count - 1) * step + 1;
     tasks.push_back(_shards_task_pool[i % task_pool_size_]->enqueue(
-        [this, i, start, end, step, size]() -> std::vector<Node *> {
+        [this, i, start, end, step,
+         size]() -> std::vector<std::pair<uint64_t, Node *>> {
           return this->shards[i].get_batch(start - size, end - size, step);
         }));
     start += count * step;
@@ -528,20 +804,38 @@ int32_t GraphTable::pull_graph_list(int start, int total_size,
     tasks[i].wait();
   }
   size = 0;
-  std::vector<std::vector<Node *>> res;
+  std::vector<std::vector<std::pair<uint64_t, Node *>>> res;
+  // the features are in the feature stores, the nodes are serialized with
+  // them as FeatureNodes
+  std::vector<std::unique_ptr<FeatureNode>> feature_nodes;
   for (size_t i = 0; i < tasks.size(); i++) {
     res.push_back(tasks[i].get());
-    for (size_t j = 0; j < res.back().size(); j++) {
-      size += res.back()[j]->get_size(need_feature);
+    for (auto &p : res.back()) {
+      auto *feature_store =
+          &shards[p.first % shard_num - shard_start].get_feature_store();
+      if (need_feature && feature_store->has_node(p.first)) {
+        feature_nodes.emplace_back(new FeatureNode(p.first));
+        for (size_t feat_id = 0; feat_id < feat_name.size(); ++feat_id) {
+          std::string feature;
+          feature_store->get_feature(p.first, feat_id, &feature);
+          feature_nodes.back()->set_feature(feat_id, feature);
+        }
+        p.second = feature_nodes.back().get();
+      }
+      size += p.second != nullptr ? p.second->get_size(need_feature)
+                                  : Node(p.first).get_size(need_feature);
     }
   }
   char *buffer_addr = new char[size];
   buffer.reset(buffer_addr);
   int index = 0;
   for (size_t i = 0; i < res.size(); i++) {
-    for (size_t j = 0; j < res[i].size(); j++) {
-      res[i][j]->to_buffer(buffer_addr + index, need_feature);
-      index += res[i][j]->get_size(need_feature);
+    for (auto &p : res[i]) {
+      // a node of csr without feature is serialized as a bare Node
+      Node bare_node(p.first);
+      Node *node = p.second != nullptr ? p.second : &bare_node;
+      node->to_buffer(buffer_addr + index, need_feature);
+      index += node->get_size(need_feature);
     }
   }
   actual_size = size;
@@ -590,6 +884,9 @@ int32_t GraphTable::initialize() {
           << shard_start << " shard_end " << shard_end;
   // shards.resize(shard_num_per_table);
   shards = std::vector<GraphShard>(shard_num_per_table, GraphShard(shard_num));
+  for (auto &shard : shards) {
+    shard.get_feature_store().init(feat_dtype, feat_shape);
+  }
   return 0;
 }
 }  // namespace distributed
@@ -26,11 +26,18 @@
 #include <vector>
 #include "paddle/fluid/distributed/table/accessor.h"
 #include "paddle/fluid/distributed/table/common_table.h"
+#include "paddle/fluid/distributed/table/graph/graph_csr.h"
+#include "paddle/fluid/distributed/table/graph/graph_feature_store.h"
 #include "paddle/fluid/distributed/table/graph/graph_node.h"
 #include "paddle/fluid/framework/rw_lock.h"
 #include "paddle/fluid/string/string_helper.h"
 namespace paddle {
 namespace distributed {
+// The nodes of a shard are those with edges in csr, then those of bucket.
+// In CSR mode (FLAGS_pserver_graph_table_csr) the edges loaded by
+// load_edges go to csr, and the features of its nodes to csr_features;
+// otherwise csr is empty and every node is a Node of bucket. The features
+// loaded by load_nodes are in feature_store, not in the FeatureNodes.
 class GraphShard {
  public:
   size_t get_size();
@@ -38,14 +45,24 @@ class GraphShard {
   GraphShard(int shard_num) { this->shard_num = shard_num; }
   ~GraphShard();
   std::vector<Node *> &get_bucket() { return bucket; }
-  std::vector<Node *> get_batch(int start, int end, int step);
+  // The id and the Node of every step-th node in [start, end), the Node is
+  // nullptr for a node of csr without feature.
+  std::vector<std::pair<uint64_t, Node *>> get_batch(int start, int end,
+                                                     int step);
   std::vector<uint64_t> get_ids_by_range(int start, int end) {
     std::vector<uint64_t> res;
-    for (int i = start; i < end && i < (int)bucket.size(); i++) {
-      res.push_back(bucket[i]->get_id());
+    int csr_size = (int)csr.node_size();
+    for (int i = start; i < end && i < csr_size + (int)bucket.size(); i++) {
+      res.push_back(i < csr_size ? csr.get_id(i)
+                                 : bucket[i - csr_size]->get_id());
     }
     return res;
   }
+  GraphCsr &get_csr() { return csr; }
+  GraphFeatureStore &get_feature_store() { return feature_store; }
+  // Rebuilds csr with its edges and the new ones, the nodes of bucket which
+  // get edges move to it.
+  void build_csr(std::vector<GraphCsrEdge> *edges, bool is_weighted);
   GraphNode *add_graph_node(uint64_t id);
   FeatureNode *add_feature_node(uint64_t id);
   Node *find_node(uint64_t id);
@@ -60,6 +77,9 @@ class GraphShard {
   std::unordered_map<uint64_t, int> node_location;
   int shard_num;
   std::vector<Node *> bucket;
+  GraphCsr csr;
+  std::unordered_map<uint64_t, FeatureNode *> csr_features;
+  GraphFeatureStore feature_store;
 };
 class GraphTable : public SparseTable {
  public:
@@ -86,6 +106,9 @@ class GraphTable : public SparseTable {
 
   int32_t load_edges(const std::string &path, bool reverse);
 
+  int32_t load_edges_to_csr(const std::vector<std::string> &paths,
+                            bool reverse);
+
   int32_t load_nodes(const std::string &path, std::string node_type);
 
   int32_t add_graph_node(std::vector<uint64_t> &id_list,
@@ -94,6 +117,10 @@ class GraphTable : public SparseTable {
   int32_t remove_graph_node(std::vector<uint64_t> &id_list);
 
   Node *find_node(uint64_t id);
+  // The rank of the server holding the node, as GraphBrpcClient computes.
+  size_t get_server_index_by_id(uint64_t id) {
+    return get_sparse_shard(shard_num, server_num, id);
+  }
 
   virtual int32_t pull_sparse(float *values,
                               const PullSparseValue &pull_value) {
@@ -121,6 +148,15 @@ class GraphTable : public SparseTable {
   virtual int32_t get_node_feat(const std::vector<uint64_t> &node_ids,
                                 const std::vector<std::string> &feature_names,
                                 std::vector<std::vector<std::string>> &res);
+  // The number of values of the feature if it is float32, float64, int32 or
+  // int64, else -1.
+  int32_t get_numeric_feat_shape(const std::string &feature_name);
+  // Writes the numeric feature of the nodes into res as node_ids.size() rows
+  // of get_numeric_feat_shape values converted to T, float or int64_t, 0 for
+  // the values a node lacks.
+  template <typename T>
+  int32_t get_node_feat_dense(const std::vector<uint64_t> &node_ids,
+                              const std::string &feature_name, T *res);
 
  protected:
   std::vector<GraphShard> shards;
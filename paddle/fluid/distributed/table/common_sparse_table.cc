@@ -13,12 +13,40 @@
 // limitations under the License.
 
 #include "paddle/fluid/distributed/table/common_sparse_table.h"
+#include <algorithm>
+#include <chrono>  // NOLINT
+#include <cstdio>
+#include <cstring>
 #include <sstream>
 
 #include "boost/lexical_cast.hpp"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "paddle/fluid/platform/enforce.h"
 
+DEFINE_string(pserver_sparse_table_save_format, "binary",
+              "the format of the values saved by CommonSparseTable, binary "
+              "or text. binary is written and read by all shard threads in "
+              "parallel, text is only kept for exporting.");
+DEFINE_int32(pserver_sparse_table_save_block_rows, 4096,
+             "the rows of a compressed block in binary sparse checkpoint");
+DEFINE_bool(pserver_sparse_table_delta_checkpoint, false,
+            "record the rows updated or erased by CommonSparseTable since "
+            "the last checkpoint, so that a delta checkpoint only visits the "
+            "dirty rows and keeps the erased ones. Without it a delta "
+            "checkpoint scans all rows and drops no erased row.");
+DEFINE_int32(pserver_sparse_evict_ttl, 0,
+             "the rows of CommonSparseTable unseen for this many eviction "
+             "rounds are evicted in the background, 0 to never evict");
+DEFINE_int32(pserver_sparse_evict_round_s, 3600,
+             "the seconds of an eviction round of CommonSparseTable, in "
+             "which every row is visited once and the admission sketches of "
+             "count_min_sketch_entry decay");
+DEFINE_int32(pserver_sparse_replica_ttl_ms, 60000,
+             "the replicas of hot feasigns not written again for that long "
+             "are dropped, it must be well above pserver_hot_key_refresh_ms "
+             "of the trainers, 0 to never drop them");
+
 namespace paddle {
 namespace distributed {
 class ValueBlock;
@@ -28,6 +56,12 @@ class ValueBlock;
 namespace paddle {
 namespace distributed {
 
+static int64_t ReplicaNowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
 void CommonSparseTable::ProcessALine(const std::vector<std::string>& columns,
                                      const Meta& meta, const int64_t id,
                                      std::vector<std::vector<float>>* values) {
@@ -63,6 +97,10 @@ void CommonSparseTable::ProcessALine(const std::vector<std::string>& columns,
   }
 }
 
+std::string CommonSparseTable::save_format() const {
+  return FLAGS_pserver_sparse_table_save_format;
+}
+
 void CommonSparseTable::SaveMetaToText(std::ostream* os,
                                        const CommonAccessorParameter& common,
                                        const size_t shard_idx,
@@ -119,6 +157,114 @@ int64_t CommonSparseTable::SaveValueToText(std::ostream* os,
   return save_num;
 }
 
+int64_t CommonSparseTable::SaveValueToBinary(
+    const std::string& path, std::shared_ptr<ValueBlock> block,
+    std::shared_ptr<DeltaRecorder> recorder, const int mode,
+    BinaryShardIndex* index) {
+  BinaryShardWriter writer(
+      path, block->value_length_,
+      static_cast<size_t>(FLAGS_pserver_sparse_table_save_block_rows), index);
+
+  auto append = [&](const uint64_t id, VALUE* value) {
+    BinaryRowHeader row = {id, value->count_, value->unseen_days_,
+                           static_cast<int32_t>(value->is_entry_), 0};
+    writer.Append(row, value->data_.data());
+    if (mode == SaveMode::base || mode == SaveMode::delta) {
+      value->need_save_ = false;
+    }
+  };
+
+  std::vector<uint64_t> updated;
+  std::vector<uint64_t> erased;
+  if (mode == SaveMode::delta && recorder->enabled()) {
+    // only the rows touched since the last base or delta checkpoint
+    recorder->GetAndClear(&updated, &erased);
+    for (auto id : updated) {
+      if (block->Has(id)) {
+        append(id, block->GetValue(id));
+      }
+    }
+  } else {
+    if (mode == SaveMode::base) {
+      recorder->Clear();
+    }
+    for (auto& table : block->values_) {
+      for (auto& value : table) {
+        if (mode == SaveMode::delta && !value.second->need_save_) {
+          continue;
+        }
+        append(value.first, value.second);
+      }
+    }
+  }
+  writer.Finish(erased);
+  return index->rows;
+}
+
+int64_t CommonSparseTable::LoadFromBinary(
+    const std::string& prefix, const int pserver_id, const int pserver_num,
+    std::vector<std::shared_ptr<ValueBlock>>* blocks) {
+  BinaryIndex index(prefix + PSERVER_SAVE_INDEX_SUFFIX);
+  const int local_shard_num = static_cast<int>(blocks->size());
+  PADDLE_ENFORCE_EQ(
+      index.shards.size(), static_cast<size_t>(local_shard_num),
+      paddle::platform::errors::InvalidArgument(
+          "The shard number in %s is %d, but the table has %d shards.",
+          prefix + PSERVER_SAVE_INDEX_SUFFIX, index.shards.size(),
+          local_shard_num));
+
+  // A delta checkpoint is replayed on top of the values already loaded.
+  std::vector<std::future<int64_t>> tasks(local_shard_num);
+  for (int shard_id = 0; shard_id < local_shard_num; ++shard_id) {
+    tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
+        [this, shard_id, pserver_id, pserver_num, local_shard_num, &prefix,
+         &index, blocks]() -> int64_t {
+          auto& block = blocks->at(shard_id);
+          PADDLE_ENFORCE_EQ(index.value_length, block->value_length_,
+                            paddle::platform::errors::InvalidArgument(
+                                "The value length in checkpoint is %d, but "
+                                "the table's is %d.",
+                                index.value_length, block->value_length_));
+          const size_t value_bytes = sizeof(float) * block->value_length_;
+          auto path = BinaryShardPath(prefix, shard_id);
+          BinaryShardReader reader(path, index.shards[shard_id],
+                                   block->value_length_);
+
+          int64_t load_num = 0;
+          BinaryRowHeader row;
+          const float* values = nullptr;
+          while (reader.Next(&row, &values)) {
+            if (row.id % pserver_num != pserver_id ||
+                row.id % local_shard_num != shard_id) {
+              VLOG(3) << "will not load " << row.id << " from " << path
+                      << ", please check id distribution";
+              continue;
+            }
+            block->Init(row.id, false);
+            VALUE* value_instant = block->GetValue(row.id);
+            value_instant->count_ = row.count;
+            value_instant->unseen_days_ = row.unseen_days;
+            value_instant->is_entry_ = static_cast<bool>(row.is_entry);
+            std::memcpy(value_instant->data_.data(), values, value_bytes);
+            ++load_num;
+          }
+
+          std::vector<uint64_t> erased;
+          reader.ReadErased(&erased);
+          for (auto id : erased) {
+            block->erase(id);
+          }
+          return load_num;
+        });
+  }
+
+  int64_t total = 0;
+  for (auto& task : tasks) {
+    total += task.get();
+  }
+  return total;
+}
+
 int64_t CommonSparseTable::LoadFromText(
     const std::string& valuepath, const std::string& metapath,
     const int pserver_id, const int pserver_num, const int local_shard_num,
@@ -202,6 +348,13 @@ int32_t CommonSparseTable::initialize() {
   initialize_value();
   initialize_optimizer();
   initialize_recorder();
+
+  if (FLAGS_pserver_sparse_evict_ttl > 0 || shard_values_[0]->HasSketch()) {
+    evict_thread_ =
+        std::thread(&CommonSparseTable::evict_loop, this,
+                    FLAGS_pserver_sparse_evict_ttl,
+                    FLAGS_pserver_sparse_evict_round_s);
+  }
   return 0;
 }
 
@@ -217,6 +370,8 @@ int32_t CommonSparseTable::initialize_value() {
         initializer_attrs_, common.entry());
 
     shard_values_.emplace_back(shard);
+    delta_recorders_.emplace_back(std::make_shared<DeltaRecorder>(
+        FLAGS_pserver_sparse_table_delta_checkpoint));
   }
 
   auto accessor = _config.accessor();
@@ -282,8 +437,16 @@ int32_t CommonSparseTable::load(const std::string& path,
                                 const std::string& param) {
   auto begin = GetCurrentUS();
   rwlock_->WRLock();
-  LoadFromText(path, param, _shard_idx, _shard_num, task_pool_size_,
-               &shard_values_);
+  // The binary checkpoint is preferred if its index is next to the text one
+  std::string prefix = BinaryCheckpointPrefix(path);
+  std::ifstream index_file(prefix + PSERVER_SAVE_INDEX_SUFFIX);
+  if (index_file.good()) {
+    index_file.close();
+    LoadFromBinary(prefix, _shard_idx, _shard_num, &shard_values_);
+  } else {
+    LoadFromText(path, param, _shard_idx, _shard_num, task_pool_size_,
+                 &shard_values_);
+  }
   rwlock_->UNLock();
   auto end = GetCurrentUS();
 
@@ -314,19 +477,72 @@ int32_t CommonSparseTable::save(const std::string& dirname,
   std::string shard_var_pre =
       string::Sprintf("%s.block%d", varname, _shard_idx);
 
-  std::string value_ = string::Sprintf("%s/%s.txt", var_store, shard_var_pre);
-
-  std::unique_ptr<std::ofstream> vs(new std::ofstream(value_));
+  std::string prefix = string::Sprintf("%s/%s", var_store, shard_var_pre);
+  std::string index_ = prefix + PSERVER_SAVE_INDEX_SUFFIX;
 
   int64_t total_ins = 0;
-  for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
-    // save values
-    auto shard_save_num =
-        SaveValueToText(vs.get(), shard_values_[shard_id],
-                        _shards_task_pool[shard_id], mode, shard_id);
-    total_ins += shard_save_num;
+  std::string value_;
+  const std::string format = save_format();
+  if (format == "binary") {
+    value_ = prefix + ".part*.bin";
+    BinaryIndex index;
+    index.mode = mode;
+    index.value_length = shard_values_[0]->value_length_;
+    index.shards.resize(task_pool_size_);
+
+    // every shard thread writes its own file
+    std::vector<std::future<int64_t>> tasks(task_pool_size_);
+    for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
+      tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
+          [this, shard_id, mode, &prefix, &index]() -> int64_t {
+            index.shards[shard_id].shard_id = shard_id;
+            return SaveValueToBinary(BinaryShardPath(prefix, shard_id),
+                                     shard_values_[shard_id],
+                                     delta_recorders_[shard_id], mode,
+                                     &index.shards[shard_id]);
+          });
+    }
+    for (auto& task : tasks) {
+      total_ins += task.get();
+    }
+
+    index.Save(index_);
+  } else {
+    PADDLE_ENFORCE_EQ(format, "text",
+                      paddle::platform::errors::InvalidArgument(
+                          "Unsupported sparse table save format %s, only "
+                          "binary and text are supported.",
+                          format));
+    // remove the stale index so that load reads the text values
+    std::remove(index_.c_str());
+
+    value_ = prefix + ".txt";
+    std::unique_ptr<std::ofstream> vs(new std::ofstream(value_));
+
+    for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
+      // save values
+      auto shard_save_num =
+          SaveValueToText(vs.get(), shard_values_[shard_id],
+                          _shards_task_pool[shard_id], mode, shard_id);
+      total_ins += shard_save_num;
+    }
+    vs->close();
+
+    // text has no room for the erased rows, the delta chain restarts here
+    if (mode == SaveMode::base || mode == SaveMode::delta) {
+      std::vector<std::future<int>> tasks(task_pool_size_);
+      for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
+        tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
+            [this, shard_id]() -> int {
+              delta_recorders_[shard_id]->Clear();
+              return 0;
+            });
+      }
+      for (auto& task : tasks) {
+        task.wait();
+      }
+    }
   }
-  vs->close();
 
   std::string meta_ = string::Sprintf("%s/%s.meta", var_store, shard_var_pre);
   std::unique_ptr<std::ofstream> ms(new std::ofstream(meta_));
@@ -344,12 +560,30 @@ int32_t CommonSparseTable::save(const std::string& dirname,
 std::pair<int64_t, int64_t> CommonSparseTable::print_table_stat() {
   int64_t feasign_size = 0;
   int64_t mf_size = 0;
+  int64_t admission_pending = 0;
+  int64_t evicted = 0;
+  int64_t sketch_size = 0;
 
   for (auto& shard : shard_values_) {
     for (auto& table : shard->values_) {
       feasign_size += table.size();
     }
+    admission_pending += shard->AdmissionPending();
+    evicted += shard->Evicted();
+    sketch_size += shard->SketchMemorySize();
   }
+  int64_t row_size = shard_values_.empty() ? 0
+                                           : shard_values_[0]->RowMemorySize();
+  VLOG(0) << "sparse table " << _config.common().table_name()
+          << " feasign size: " << feasign_size
+          << ", not admitted: " << admission_pending
+          << ", evicted: " << evicted << ", memory saved: "
+          << (admission_pending + evicted) * row_size - sketch_size
+          << " bytes";
+  VLOG(0) << "sparse table " << _config.common().table_name()
+          << " feasigns pulled: " << pulled_
+          << ", from replicas: " << replica_pulled_
+          << ", replicas: " << replica_num_;
 
   return {feasign_size, mf_size};
 }
@@ -374,24 +608,70 @@ int32_t CommonSparseTable::pour() {
   return 0;
 }
 
+int32_t CommonSparseTable::pull_sparse_replica(
+    float* pull_values, const PullSparseValue& pull_value,
+    std::vector<int>* offsets) {
+  evict_replicas();
+  offsets->reserve(pull_value.numel_);
+  int64_t replica_pulled = 0;
+  framework::AutoRDLock lock(&replica_lock_);
+  for (int x = 0; x < pull_value.numel_; ++x) {
+    auto feasign = pull_value.feasigns_[x];
+    if (feasign % _shard_num == _shard_idx) {
+      offsets->push_back(x);
+      continue;
+    }
+    auto iter = replicas_.find(feasign);
+    if (iter == replicas_.end()) {
+      LOG(ERROR) << "sparse table " << _config.common().table_name()
+                 << " has no replica of feasign " << feasign;
+      return -1;
+    }
+    std::copy_n(iter->second.values.data(), param_dim_,
+                pull_values + param_dim_ * x);
+    ++replica_pulled;
+  }
+  replica_pulled_ += replica_pulled;
+  return 0;
+}
+
 int32_t CommonSparseTable::pull_sparse(float* pull_values,
                                        const PullSparseValue& pull_value) {
   auto shard_num = task_pool_size_;
   std::vector<std::future<int>> tasks(shard_num);
+  pulled_ += pull_value.numel_;
+
+  // the feasigns of other pservers are only served from their replicas
+  bool all_owned = _shard_num <= 1;
+  std::vector<int> owned_offsets;
+  if (!all_owned &&
+      pull_sparse_replica(pull_values, pull_value, &owned_offsets) != 0) {
+    return -1;
+  }
 
   for (int shard_id = 0; shard_id < shard_num; ++shard_id) {
     tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
-        [this, shard_id, shard_num, &pull_value, &pull_values]() -> int {
+        [this, shard_id, shard_num, all_owned, &owned_offsets, &pull_value,
+         &pull_values]() -> int {
           auto& block = shard_values_[shard_id];
 
           std::vector<int> offsets;
-          pull_value.Fission(shard_id, shard_num, &offsets);
+          if (all_owned) {
+            pull_value.Fission(shard_id, shard_num, &offsets);
+          } else {
+            for (auto offset : owned_offsets) {
+              if (pull_value.feasigns_[offset] % shard_num == shard_id) {
+                offsets.push_back(offset);
+              }
+            }
+          }
 
           if (pull_value.is_training_) {
             for (auto& offset : offsets) {
               auto feasign = pull_value.feasigns_[offset];
               auto frequencie = pull_value.frequencies_[offset];
               auto* value = block->Init(feasign, true, frequencie);
+              delta_recorders_[shard_id]->Update(feasign);
               std::copy_n(value + param_offset_, param_dim_,
                           pull_values + param_dim_ * offset);
             }
@@ -469,6 +749,10 @@ int32_t CommonSparseTable::_push_sparse(const uint64_t* keys,
           auto& offsets = offset_bucket[shard_id];
           optimizer_->update(keys, values, num, offsets,
                              shard_values_[shard_id].get());
+          auto& recorder = delta_recorders_[shard_id];
+          for (auto offset : offsets) {
+            recorder->Update(keys[offset]);
+          }
           return 0;
         });
   }
@@ -531,6 +815,7 @@ int32_t CommonSparseTable::_push_sparse(const uint64_t* keys,
             std::vector<uint64_t> tmp_off = {0};
             optimizer_->update(keys + offsets[i], values[offsets[i]], num,
                                tmp_off, shard_values_[shard_id].get());
+            delta_recorders_[shard_id]->Update(keys[offsets[i]]);
           }
           return 0;
         });
@@ -542,6 +827,54 @@ int32_t CommonSparseTable::_push_sparse(const uint64_t* keys,
   return 0;
 }
 
+int32_t CommonSparseTable::push_sparse_replica(const uint64_t* keys,
+                                               const float* values,
+                                               size_t num) {
+  int64_t now_ms = ReplicaNowMs();
+  {
+    framework::AutoWRLock lock(&replica_lock_);
+    for (size_t x = 0; x < num; ++x) {
+      if (keys[x] % _shard_num == _shard_idx) {
+        continue;
+      }
+      auto& replica = replicas_[keys[x]];
+      replica.values.assign(values + param_dim_ * x,
+                            values + param_dim_ * (x + 1));
+      replica.write_ms = now_ms;
+    }
+    replica_num_ = replicas_.size();
+  }
+  evict_replicas();
+  return 0;
+}
+
+void CommonSparseTable::evict_replicas() {
+  int ttl_ms = FLAGS_pserver_sparse_replica_ttl_ms;
+  if (ttl_ms <= 0 || replica_num_ == 0) {
+    return;
+  }
+  // at most twice per ttl, called by every pull
+  int64_t now_ms = ReplicaNowMs();
+  int64_t last_ms = replica_evict_ms_;
+  if (now_ms - last_ms < ttl_ms / 2 ||
+      !replica_evict_ms_.compare_exchange_strong(last_ms, now_ms)) {
+    return;
+  }
+  framework::AutoWRLock lock(&replica_lock_);
+  size_t evicted = 0;
+  for (auto iter = replicas_.begin(); iter != replicas_.end();) {
+    if (now_ms - iter->second.write_ms >= ttl_ms) {
+      iter = replicas_.erase(iter);
+      ++evicted;
+    } else {
+      ++iter;
+    }
+  }
+  replica_num_ = replicas_.size();
+  VLOG(1) << "sparse table " << _config.common().table_name() << " drops "
+          << evicted << " replicas, " << replica_num_ << " left";
+}
+
 int32_t CommonSparseTable::push_sparse_param(const uint64_t* keys,
                                              const float* values, size_t num) {
   std::vector<std::vector<uint64_t>> offset_bucket;
@@ -567,6 +900,7 @@ int32_t CommonSparseTable::push_sparse_param(const uint64_t* keys,
             std::copy_n(values + param_dim_ * offset, param_dim_,
                         value + param_offset_);
             block->SetEntry(id, true);
+            delta_recorders_[shard_id]->Update(id);
           }
           return 0;
         });
@@ -580,18 +914,70 @@ int32_t CommonSparseTable::push_sparse_param(const uint64_t* keys,
 
 int32_t CommonSparseTable::flush() { return 0; }
 
+// the buckets shrunk by a task, between which the pulls and the pushes run
+static const size_t kShrinkBucketsPerTask = 4;
+
 int32_t CommonSparseTable::shrink(const std::string& param) {
   int threshold = std::stoi(param);
   VLOG(3) << "sparse table shrink: " << threshold;
 
-  for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
-    // shrink
-    VLOG(4) << shard_id << " " << task_pool_size_ << " begin shrink";
-    shard_values_[shard_id]->Shrink(threshold);
+  for (size_t begin = 0; begin < SPARSE_SHARD_BUCKET_NUM;
+       begin += kShrinkBucketsPerTask) {
+    shrink_buckets(begin, begin + kShrinkBucketsPerTask, threshold, false);
   }
   return 0;
 }
 
+void CommonSparseTable::shrink_buckets(size_t begin, size_t end,
+                                       int threshold, bool decay) {
+  end = std::min(end, SPARSE_SHARD_BUCKET_NUM);
+  std::vector<std::future<int>> tasks(task_pool_size_);
+  for (int shard_id = 0; shard_id < task_pool_size_; ++shard_id) {
+    tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
+        [this, shard_id, begin, end, threshold, decay]() -> int {
+          auto& block = shard_values_[shard_id];
+          if (threshold > 0) {
+            std::vector<uint64_t> erased;
+            block->ShrinkBuckets(begin, end, threshold, &erased);
+            for (auto id : erased) {
+              delta_recorders_[shard_id]->Erase(id);
+            }
+          }
+          if (decay) {
+            block->DecaySketch();
+          }
+          return 0;
+        });
+  }
+  for (auto& task : tasks) {
+    task.wait();
+  }
+}
+
+void CommonSparseTable::evict_loop(int ttl, int round_s) {
+  auto interval = std::chrono::milliseconds(
+      round_s * 1000LL * kShrinkBucketsPerTask / SPARSE_SHARD_BUCKET_NUM);
+  size_t begin = 0;
+  std::unique_lock<std::mutex> lock(evict_mutex_);
+  while (!evict_cv_.wait_for(lock, interval, [this] { return evict_stop_; })) {
+    size_t end = begin + kShrinkBucketsPerTask;
+    bool round_end = end >= SPARSE_SHARD_BUCKET_NUM;
+    shrink_buckets(begin, end, ttl, round_end);
+    begin = round_end ? 0 : end;
+  }
+}
+
+void CommonSparseTable::stop_evict() {
+  {
+    std::lock_guard<std::mutex> lock(evict_mutex_);
+    evict_stop_ = true;
+  }
+  evict_cv_.notify_all();
+  if (evict_thread_.joinable()) {
+    evict_thread_.join();
+  }
+}
+
 void CommonSparseTable::clear() { VLOG(0) << "clear coming soon"; }
 
 }  // namespace distributed
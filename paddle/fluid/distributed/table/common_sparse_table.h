@@ -17,15 +17,22 @@
 #include <ThreadPool.h>
 #include <assert.h>
 #include <pthread.h>
+#include <atomic>
+#include <chrono>              // NOLINT
+#include <condition_variable>  // NOLINT
+#include <fstream>
 #include <memory>
 #include <mutex>  // NOLINT
 #include <string>
+#include <thread>  // NOLINT
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include "Eigen/Dense"
 #include "paddle/fluid/distributed/table/accessor.h"
 #include "paddle/fluid/distributed/table/common_table.h"
+#include "paddle/fluid/distributed/table/depends/binary_checkpoint.h"
+#include "paddle/fluid/distributed/table/depends/delta_recorder.h"
 #include "paddle/fluid/distributed/table/depends/initializers.h"
 #include "paddle/fluid/distributed/table/depends/large_scale_kv.h"
 #include "paddle/fluid/distributed/table/depends/sparse.h"
@@ -112,7 +119,7 @@ struct Meta {
 class CommonSparseTable : public SparseTable {
  public:
   CommonSparseTable() { rwlock_.reset(new framework::RWLock); }
-  virtual ~CommonSparseTable() {}
+  virtual ~CommonSparseTable() { stop_evict(); }
 
   // unused method begin
   virtual int32_t pull_dense(float* pull_values, size_t num) { return 0; }
@@ -132,12 +139,26 @@ class CommonSparseTable : public SparseTable {
 
   virtual int32_t save(const std::string& path, const std::string& param);
 
-  void SaveMetaToText(std::ostream* os, const CommonAccessorParameter& common,
-                      const size_t shard_idx, const int64_t total);
+  // "binary" or "text", FLAGS_pserver_sparse_table_save_format by default
+  virtual std::string save_format() const;
 
-  int64_t SaveValueToText(std::ostream* os, std::shared_ptr<ValueBlock> block,
-                          std::shared_ptr<::ThreadPool> pool, const int mode,
-                          int shard_id);
+  virtual void SaveMetaToText(std::ostream* os,
+                              const CommonAccessorParameter& common,
+                              const size_t shard_idx, const int64_t total);
+
+  virtual int64_t SaveValueToText(std::ostream* os,
+                                  std::shared_ptr<ValueBlock> block,
+                                  std::shared_ptr<::ThreadPool> pool,
+                                  const int mode, int shard_id);
+
+  int64_t SaveValueToBinary(const std::string& path,
+                            std::shared_ptr<ValueBlock> block,
+                            std::shared_ptr<DeltaRecorder> recorder,
+                            const int mode, BinaryShardIndex* index);
+
+  virtual int64_t LoadFromBinary(
+      const std::string& prefix, const int pserver_id, const int pserver_num,
+      std::vector<std::shared_ptr<ValueBlock>>* blocks);
 
   virtual void ProcessALine(const std::vector<std::string>& columns,
                             const Meta& meta, const int64_t id,
@@ -164,6 +185,11 @@ class CommonSparseTable : public SparseTable {
   virtual int32_t push_sparse_param(const uint64_t* keys, const float* values,
                                     size_t num);
 
+  // Replicas of the hot feasigns of other pservers, pulled in place of their
+  // owner until written again, see BrpcPsClient::refresh_hot_keys.
+  virtual int32_t push_sparse_replica(const uint64_t* keys,
+                                      const float* values, size_t num);
+
   virtual int32_t set_global_lr(float* lr) override;
 
   virtual int32_t pour();
@@ -177,6 +203,22 @@ class CommonSparseTable : public SparseTable {
   virtual int32_t _push_sparse(const uint64_t* keys, const float** values,
                                size_t num);
 
+  // Shrinks the buckets [begin, end) of every shard on the shard threads
+  // when threshold > 0, and decays the admission sketches when decay.
+  void shrink_buckets(size_t begin, size_t end, int threshold, bool decay);
+  // Ages the rows and evicts those unseen for ttl rounds a few buckets at a
+  // time, a round over all of them every round_s seconds.
+  void evict_loop(int ttl, int round_s);
+  void stop_evict();
+  // Pulls the feasigns of pull_value owned by other pservers from their
+  // replicas, the offsets of the others to offsets.
+  int32_t pull_sparse_replica(float* pull_values,
+                              const PullSparseValue& pull_value,
+                              std::vector<int>* offsets);
+  // Drops the replicas not written again for
+  // FLAGS_pserver_sparse_replica_ttl_ms, no trainer routes to them anymore.
+  void evict_replicas();
+
  protected:
   const int task_pool_size_ = 11;
   std::vector<std::shared_ptr<::ThreadPool>> _shards_task_pool;
@@ -193,8 +235,25 @@ class CommonSparseTable : public SparseTable {
 
   std::shared_ptr<SparseOptimizer> optimizer_;
   std::vector<std::shared_ptr<ValueBlock>> shard_values_;
+  std::vector<std::shared_ptr<DeltaRecorder>> delta_recorders_;
   std::unordered_map<uint64_t, ReservoirValue<float>> pull_reservoir_;
   std::unique_ptr<framework::RWLock> rwlock_{nullptr};
+
+  std::thread evict_thread_;
+  std::mutex evict_mutex_;
+  std::condition_variable evict_cv_;
+  bool evict_stop_ = false;
+
+  struct SparseReplica {
+    std::vector<float> values;
+    int64_t write_ms;
+  };
+  framework::RWLock replica_lock_;
+  std::unordered_map<uint64_t, SparseReplica> replicas_;
+  std::atomic<size_t> replica_num_{0};
+  std::atomic<int64_t> replica_evict_ms_{0};
+  std::atomic<int64_t> pulled_{0};
+  std::atomic<int64_t> replica_pulled_{0};
 };
 
 }  // namespace distributed
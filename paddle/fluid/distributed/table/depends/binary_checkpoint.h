@@ -0,0 +1,290 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <snappy.h>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/platform/enforce.h"
+#include "paddle/fluid/string/string_helper.h"
+
+#define PSERVER_SAVE_INDEX_SUFFIX ".index"
+#define PSERVER_SAVE_BINARY_VERSION 1
+
+namespace paddle {
+namespace distributed {
+
+// The binary checkpoint of a pserver is one file per local shard, written
+// and read by the thread of the shard. A file is a sequence of snappy
+// compressed blocks, each one begins with a BinaryBlockHeader and holds
+// `rows` records of a BinaryRowHeader followed by value_length floats.
+// A delta checkpoint appends the ids erased since the last checkpoint
+// after the blocks, as raw uint64_t.
+struct BinaryBlockHeader {
+  uint32_t rows;
+  uint32_t raw_size;
+  uint32_t compressed_size;
+  uint32_t reserved;
+};
+
+struct BinaryRowHeader {
+  uint64_t id;
+  int32_t count;
+  int32_t unseen_days;
+  int32_t is_entry;
+  int32_t reserved;
+};
+
+struct BinaryShardIndex {
+  int shard_id;
+  int64_t rows;
+  int64_t blocks;
+  int64_t bytes;
+  int64_t erased;
+};
+
+// The index of a binary checkpoint, saved as text next to the meta.
+struct BinaryIndex {
+  int version{PSERVER_SAVE_BINARY_VERSION};
+  int mode{0};
+  int value_length{0};
+  std::vector<BinaryShardIndex> shards;
+
+  BinaryIndex() = default;
+
+  explicit BinaryIndex(const std::string& indexpath) {
+    std::ifstream file(indexpath);
+    PADDLE_ENFORCE_EQ(file.is_open(), true,
+                      paddle::platform::errors::NotFound(
+                          "Cannot open checkpoint index %s.", indexpath));
+    std::string line;
+    while (std::getline(file, line)) {
+      if (StartWith(line, "#")) {
+        continue;
+      }
+      auto pairs = paddle::string::split_string<std::string>(line, "=");
+      PADDLE_ENFORCE_EQ(
+          pairs.size(), 2,
+          paddle::platform::errors::InvalidArgument(
+              "info in %s except k=v, but got %s", indexpath, line));
+      if (pairs[0] == "version") {
+        version = std::stoi(pairs[1]);
+      } else if (pairs[0] == "mode") {
+        mode = std::stoi(pairs[1]);
+      } else if (pairs[0] == "value_length") {
+        value_length = std::stoi(pairs[1]);
+      } else if (pairs[0] == "shard") {
+        auto fields = paddle::string::split_string<std::string>(pairs[1], ",");
+        PADDLE_ENFORCE_EQ(fields.size() == 4 || fields.size() == 5, true,
+                          paddle::platform::errors::InvalidArgument(
+                              "shard in %s except id,rows,blocks,bytes[,"
+                              "erased], but got %s",
+                              indexpath, pairs[1]));
+        shards.push_back(
+            {std::stoi(fields[0]), std::stoll(fields[1]),
+             std::stoll(fields[2]), std::stoll(fields[3]),
+             fields.size() == 5 ? std::stoll(fields[4]) : 0});
+      }
+    }
+    PADDLE_ENFORCE_EQ(version, PSERVER_SAVE_BINARY_VERSION,
+                      paddle::platform::errors::InvalidArgument(
+                          "Unsupported binary checkpoint version %d in %s.",
+                          version, indexpath));
+  }
+
+  std::string ToString() {
+    std::stringstream ss;
+    ss << "version=" << version << "\n";
+    ss << "mode=" << mode << "\n";
+    ss << "value_length=" << value_length << "\n";
+    ss << "shard_num=" << shards.size() << "\n";
+    for (auto& shard : shards) {
+      ss << "shard=" << shard.shard_id << "," << shard.rows << ","
+         << shard.blocks << "," << shard.bytes << "," << shard.erased << "\n";
+    }
+    return ss.str();
+  }
+
+  void Save(const std::string& indexpath) {
+    std::ofstream os(indexpath);
+    auto str = ToString();
+    os.write(str.c_str(), sizeof(char) * str.size());
+    os.close();
+    PADDLE_ENFORCE_EQ(os.good(), true,
+                      paddle::platform::errors::Unavailable(
+                          "Failed to write checkpoint index %s.", indexpath));
+  }
+};
+
+// The value path handed to load is the one of the text format, the binary
+// checkpoint lives next to it with the ".txt" stripped.
+inline std::string BinaryCheckpointPrefix(const std::string& path) {
+  if (path.size() > 4 && path.substr(path.size() - 4) == ".txt") {
+    return path.substr(0, path.size() - 4);
+  }
+  return path;
+}
+
+inline std::string BinaryShardPath(const std::string& prefix, int shard_id) {
+  return prefix + ".part" + std::to_string(shard_id) + ".bin";
+}
+
+class BinaryShardWriter {
+ public:
+  BinaryShardWriter(const std::string& path, int value_length,
+                    size_t block_rows, BinaryShardIndex* index)
+      : path_(path),
+        value_bytes_(sizeof(float) * value_length),
+        block_rows_(block_rows > 0 ? block_rows : 1),
+        index_(index),
+        os_(path, std::ios::binary) {
+    PADDLE_ENFORCE_EQ(os_.is_open(), true,
+                      paddle::platform::errors::Unavailable(
+                          "Cannot open %s to save sparse table.", path));
+    raw_.reserve(block_rows_ * (sizeof(BinaryRowHeader) + value_bytes_));
+    index_->rows = 0;
+    index_->blocks = 0;
+    index_->bytes = 0;
+    index_->erased = 0;
+  }
+
+  void Append(const BinaryRowHeader& row, const float* values) {
+    raw_.append(reinterpret_cast<const char*>(&row), sizeof(row));
+    raw_.append(reinterpret_cast<const char*>(values), value_bytes_);
+    if (++rows_ == block_rows_) {
+      Flush();
+    }
+  }
+
+  void Finish(const std::vector<uint64_t>& erased) {
+    Flush();
+    if (!erased.empty()) {
+      os_.write(reinterpret_cast<const char*>(erased.data()),
+                sizeof(uint64_t) * erased.size());
+      index_->erased = erased.size();
+      index_->bytes += sizeof(uint64_t) * erased.size();
+    }
+    os_.close();
+    PADDLE_ENFORCE_EQ(os_.good(), true,
+                      paddle::platform::errors::Unavailable(
+                          "Failed to write sparse table to %s.", path_));
+  }
+
+ private:
+  void Flush() {
+    if (rows_ == 0) return;
+    snappy::Compress(raw_.data(), raw_.size(), &compressed_);
+    BinaryBlockHeader header = {static_cast<uint32_t>(rows_),
+                                static_cast<uint32_t>(raw_.size()),
+                                static_cast<uint32_t>(compressed_.size()), 0};
+    os_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os_.write(compressed_.data(), compressed_.size());
+    index_->rows += rows_;
+    index_->blocks += 1;
+    index_->bytes += sizeof(header) + compressed_.size();
+    raw_.clear();
+    rows_ = 0;
+  }
+
+  std::string path_;
+  size_t value_bytes_;
+  size_t block_rows_;
+  BinaryShardIndex* index_;
+  std::ofstream os_;
+  std::string raw_;
+  std::string compressed_;
+  size_t rows_{0};
+};
+
+class BinaryShardReader {
+ public:
+  BinaryShardReader(const std::string& path, const BinaryShardIndex& index,
+                    int value_length)
+      : path_(path),
+        index_(index),
+        value_bytes_(sizeof(float) * value_length),
+        row_bytes_(sizeof(BinaryRowHeader) + value_bytes_),
+        is_(path, std::ios::binary) {
+    PADDLE_ENFORCE_EQ(is_.is_open(), true,
+                      paddle::platform::errors::NotFound(
+                          "Cannot open %s to load sparse table.", path));
+  }
+
+  // Returns false when all the rows of the shard have been read.
+  bool Next(BinaryRowHeader* row, const float** values) {
+    while (cursor_ == rows_) {
+      if (block_ == index_.blocks) {
+        return false;
+      }
+      ReadBlock();
+    }
+    const char* ptr = raw_.data() + cursor_ * row_bytes_;
+    std::memcpy(row, ptr, sizeof(BinaryRowHeader));
+    *values = reinterpret_cast<const float*>(ptr + sizeof(BinaryRowHeader));
+    ++cursor_;
+    return true;
+  }
+
+  // Must be called after Next returned false.
+  void ReadErased(std::vector<uint64_t>* erased) {
+    erased->resize(index_.erased);
+    if (index_.erased == 0) return;
+    is_.read(reinterpret_cast<char*>(erased->data()),
+             sizeof(uint64_t) * index_.erased);
+    PADDLE_ENFORCE_EQ(is_.good(), true,
+                      paddle::platform::errors::InvalidArgument(
+                          "%s is truncated at the erased ids.", path_));
+  }
+
+ private:
+  void ReadBlock() {
+    BinaryBlockHeader header;
+    is_.read(reinterpret_cast<char*>(&header), sizeof(header));
+    compressed_.resize(header.compressed_size);
+    is_.read(&compressed_[0], header.compressed_size);
+    PADDLE_ENFORCE_EQ(is_.good(), true,
+                      paddle::platform::errors::InvalidArgument(
+                          "%s is truncated at block %d.", path_, block_));
+    PADDLE_ENFORCE_EQ(
+        snappy::Uncompress(compressed_.data(), compressed_.size(), &raw_),
+        true, paddle::platform::errors::InvalidArgument(
+                  "Block %d of %s is corrupted.", block_, path_));
+    PADDLE_ENFORCE_EQ(raw_.size(), header.rows * row_bytes_,
+                      paddle::platform::errors::InvalidArgument(
+                          "Block %d of %s is corrupted.", block_, path_));
+    rows_ = header.rows;
+    cursor_ = 0;
+    ++block_;
+  }
+
+  std::string path_;
+  BinaryShardIndex index_;
+  size_t value_bytes_;
+  size_t row_bytes_;
+  std::ifstream is_;
+  std::string raw_;
+  std::string compressed_;
+  int64_t block_{0};
+  size_t rows_{0};
+  size_t cursor_{0};
+};
+
+}  // namespace distributed
+}  // namespace paddle
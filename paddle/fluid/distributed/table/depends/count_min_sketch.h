@@ -0,0 +1,82 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// Counts the feasigns in depth rows of width counters, without storing them.
+// Estimate never under counts a feasign, it over counts when all its
+// counters are shared with others, which is rare for width much larger than
+// the feasigns counted between two Decay.
+class CountMinSketch {
+ public:
+  CountMinSketch(size_t width, size_t depth)
+      : width_(std::max<size_t>(width, 1)),
+        depth_(std::max<size_t>(depth, 1)),
+        counters_(width_ * depth_, 0) {}
+
+  uint32_t Estimate(uint64_t key) const {
+    uint32_t res = std::numeric_limits<uint32_t>::max();
+    for (size_t row = 0; row < depth_; ++row) {
+      res = std::min(res, counters_[Index(key, row)]);
+    }
+    return res;
+  }
+
+  // Adds count to the key, returns its estimate after. As a conservative
+  // update, only the counters under the new estimate are raised.
+  uint32_t Add(uint64_t key, uint32_t count) {
+    uint64_t estimate = static_cast<uint64_t>(Estimate(key)) + count;
+    uint32_t res = static_cast<uint32_t>(std::min<uint64_t>(
+        estimate, std::numeric_limits<uint32_t>::max()));
+    for (size_t row = 0; row < depth_; ++row) {
+      auto &counter = counters_[Index(key, row)];
+      counter = std::max(counter, res);
+    }
+    return res;
+  }
+
+  // Halves all the counts, so that the feasigns not seen lately fade out.
+  void Decay() {
+    for (auto &counter : counters_) {
+      counter >>= 1;
+    }
+  }
+
+  size_t memory_size() const { return counters_.size() * sizeof(uint32_t); }
+
+ private:
+  size_t Index(uint64_t key, size_t row) const {
+    // splitmix64 of the key seeded by the row
+    uint64_t x = key + (row + 1) * 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x = x ^ (x >> 31);
+    return row * width_ + x % width_;
+  }
+
+  size_t width_;
+  size_t depth_;
+  std::vector<uint32_t> counters_;
+};
+
+}  // namespace distributed
+}  // namespace paddle
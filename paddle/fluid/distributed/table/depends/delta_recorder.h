@@ -0,0 +1,68 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <unordered_set>
+#include <vector>
+
+namespace paddle {
+namespace distributed {
+
+// Records the rows of one shard updated or erased since the last base or
+// delta checkpoint, so that a delta checkpoint only visits the dirty rows.
+// Like the ValueBlock of the shard, it is only touched by the shard's thread.
+// A disabled recorder records nothing, for tables never saved as delta.
+class DeltaRecorder {
+ public:
+  explicit DeltaRecorder(bool enabled = true) : enabled_(enabled) {}
+  ~DeltaRecorder() {}
+
+  bool enabled() const { return enabled_; }
+
+  void Update(uint64_t id) {
+    if (!enabled_) return;
+    erased_.erase(id);
+    updated_.insert(id);
+  }
+
+  void Erase(uint64_t id) {
+    if (!enabled_) return;
+    updated_.erase(id);
+    erased_.insert(id);
+  }
+
+  void GetAndClear(std::vector<uint64_t>* updated,
+                   std::vector<uint64_t>* erased) {
+    updated->assign(updated_.begin(), updated_.end());
+    erased->assign(erased_.begin(), erased_.end());
+    Clear();
+  }
+
+  void Clear() {
+    updated_.clear();
+    erased_.clear();
+  }
+
+  size_t UpdatedSize() const { return updated_.size(); }
+  size_t ErasedSize() const { return erased_.size(); }
+
+ private:
+  bool enabled_;
+  std::unordered_set<uint64_t> updated_;
+  std::unordered_set<uint64_t> erased_;
+};
+
+}  // namespace distributed
+}  // namespace paddle
@@ -28,6 +28,7 @@
 
 #include "butil/object_pool.h"
 #include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/table/depends/count_min_sketch.h"
 #include "paddle/fluid/distributed/table/depends/initializers.h"
 #include "paddle/fluid/distributed/thirdparty/round_robin.h"
 #include "paddle/fluid/framework/generator.h"
@@ -101,7 +102,7 @@ class ValueBlock {
     // for Entry
     {
       auto slices = string::split_string<std::string>(entry_attr, ":");
-      if (slices[0] == "none") {
+      if (slices.empty() || slices[0] == "none") {
         entry_func_ = std::bind(&count_entry, std::placeholders::_1, 0);
         threshold_ = 0;
       } else if (slices[0] == "count_filter_entry") {
@@ -112,13 +113,22 @@ class ValueBlock {
         threshold_ = std::stof(slices[1]);
         entry_func_ =
             std::bind(&probility_entry, std::placeholders::_1, threshold_);
+      } else if (slices[0] == "count_min_sketch_entry") {
+        // count_min_sketch_entry:threshold[:width:depth], the feasigns are
+        // counted by the sketch, a row is created once it is admitted
+        threshold_ = std::stoi(slices[1]);
+        size_t width = slices.size() > 2 ? std::stoul(slices[2]) : 1 << 20;
+        size_t depth = slices.size() > 3 ? std::stoul(slices[3]) : 4;
+        sketch_.reset(new CountMinSketch(width, depth));
+        entry_func_ = std::bind(&count_entry, std::placeholders::_1, 0);
       } else {
         PADDLE_THROW(platform::errors::InvalidArgument(
             "Not supported Entry Type : %s, Only support [CountFilterEntry, "
-            "ProbabilityEntry]",
+            "ProbabilityEntry, CountMinSketchEntry]",
             slices[0]));
       }
     }
+    zero_value_.resize(value_length_, 0);
 
     // for Initializer
     {
@@ -163,7 +173,8 @@ class ValueBlock {
     return pts;
   }
 
-  // pull
+  // pull, with the admission sketch a feasign not admitted yet gets zeros
+  // and no row
   float *Init(const uint64_t &id, const bool with_update = true,
               const int counter = 1) {
     size_t hash = _hasher(id);
@@ -173,7 +184,22 @@ class ValueBlock {
     auto res = table.find(id);
 
     VALUE *value = nullptr;
+    int count = counter;
     if (res == table.end()) {
+      if (sketch_ != nullptr && with_update) {
+        uint32_t before = sketch_->Estimate(id);
+        // the row starts with all the counts so far
+        count = sketch_->Add(id, counter);
+        if (count < threshold_) {
+          if (before == 0) {
+            ++admission_pending_;
+          }
+          return zero_value_.data();
+        }
+        if (before > 0) {
+          --admission_pending_;
+        }
+      }
       value = butil::get_object<VALUE>(value_length_);
 
       table[id] = value;
@@ -183,7 +209,7 @@ class ValueBlock {
     }
 
     if (with_update) {
-      AttrUpdate(value, counter);
+      AttrUpdate(value, count);
     }
     return value->data_.data();
   }
@@ -252,9 +278,14 @@ class ValueBlock {
     return res->second;
   }
 
+  // false for the feasigns without a row, as those not admitted
   bool GetEntry(const uint64_t &id) {
-    auto value = GetValue(id);
-    return value->is_entry_;
+    size_t hash = _hasher(id);
+    size_t bucket = compute_bucket(hash);
+
+    auto &table = values_[bucket];
+    auto res = table.find(id);
+    return res != table.end() && res->second->is_entry_;
   }
 
   void SetEntry(const uint64_t &id, const bool state) {
@@ -274,17 +305,29 @@ class ValueBlock {
     }
   }
 
-  void Shrink(const int threshold) {
-    for (auto &table : values_) {
+  void Shrink(const int threshold, std::vector<uint64_t> *erased = nullptr) {
+    ShrinkBuckets(0, SPARSE_SHARD_BUCKET_NUM, threshold, erased);
+  }
+
+  // Shrink of the buckets [begin, end) only, so that the rows are shrunk a
+  // few buckets at a time between the pulls and the pushes.
+  void ShrinkBuckets(size_t begin, size_t end, const int threshold,
+                     std::vector<uint64_t> *erased = nullptr) {
+    for (size_t bucket = begin; bucket < end; ++bucket) {
+      auto &table = values_[bucket];
       for (auto iter = table.begin(); iter != table.end();) {
         // VALUE* value = (VALUE*)(void*)(iter->second);
         VALUE *value = iter->second;
         value->unseen_days_++;
         if (value->unseen_days_ >= threshold) {
+          if (erased != nullptr) {
+            erased->push_back(iter->first);
+          }
           butil::return_object(iter->second);
           //_alloc.release(iter->second);
           //_alloc.release(value);
           iter = table.erase(iter);
+          ++evicted_;
         } else {
           ++iter;
         }
@@ -293,6 +336,26 @@ class ValueBlock {
     return;
   }
 
+  // Halves the counts of the admission sketch, if any.
+  void DecaySketch() {
+    if (sketch_ != nullptr) {
+      sketch_->Decay();
+    }
+  }
+  bool HasSketch() { return sketch_ != nullptr; }
+  size_t SketchMemorySize() {
+    return sketch_ == nullptr ? 0 : sketch_->memory_size();
+  }
+  // the feasigns seen but not admitted yet, which have no row, estimated
+  int64_t AdmissionPending() { return admission_pending_; }
+  // the rows erased by Shrink
+  int64_t Evicted() { return evicted_; }
+  // the bytes of a row and of its entry in the map
+  size_t RowMemorySize() {
+    return sizeof(VALUE) + value_length_ * sizeof(float) +
+           sizeof(map_type::value_type);
+  }
+
   float GetThreshold() { return threshold_; }
   size_t compute_bucket(size_t hash) {
     if (SPARSE_SHARD_BUCKET_NUM == 1) {
@@ -319,7 +382,6 @@ class ValueBlock {
     }
   }
 
- private:
   bool Has(const uint64_t id) {
     size_t hash = _hasher(id);
     size_t bucket = compute_bucket(hash);
@@ -333,7 +395,6 @@ class ValueBlock {
     }
   }
 
- public:
   map_type values_[SPARSE_SHARD_BUCKET_NUM];
   size_t value_length_ = 0;
   std::hash<uint64_t> _hasher;
@@ -347,6 +408,12 @@ class ValueBlock {
   std::function<bool(VALUE *)> entry_func_;
   std::vector<std::shared_ptr<Initializer>> initializers_;
   float threshold_;
+
+  std::unique_ptr<CountMinSketch> sketch_;
+  // what Init gives the feasigns not admitted
+  std::vector<float> zero_value_;
+  int64_t admission_pending_ = 0;
+  int64_t evicted_ = 0;
 };
 
 }  // namespace distributed
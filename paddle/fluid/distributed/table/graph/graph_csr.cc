@@ -0,0 +1,147 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/table/graph/graph_csr.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include "paddle/fluid/distributed/table/graph/graph_weighted_sampler.h"
+namespace paddle {
+namespace distributed {
+
+void GraphCsr::build(std::vector<GraphCsrEdge> *edges, bool is_weighted) {
+  std::stable_sort(edges->begin(), edges->end(),
+                   [](const GraphCsrEdge &a, const GraphCsrEdge &b) {
+                     return a.src < b.src;
+                   });
+  clear();
+  neighbors.resize(edges->size());
+  if (is_weighted) {
+    weights.resize(edges->size());
+  }
+  for (size_t i = 0; i < edges->size(); ++i) {
+    auto &edge = (*edges)[i];
+    if (ids.empty() || ids.back() != edge.src) {
+      ids.push_back(edge.src);
+      offsets.push_back(i);
+    }
+    neighbors[i] = edge.dst;
+    if (is_weighted) {
+      weights[i] = edge.weight;
+    }
+  }
+  offsets.push_back(edges->size());
+  ids.shrink_to_fit();
+  offsets.shrink_to_fit();
+  std::vector<GraphCsrEdge>().swap(*edges);
+}
+
+void GraphCsr::export_edges(std::vector<GraphCsrEdge> *edges) const {
+  edges->reserve(edges->size() + neighbors.size());
+  for (size_t pos = 0; pos < ids.size(); ++pos) {
+    for (uint64_t i = offsets[pos]; i < offsets[pos + 1]; ++i) {
+      edges->push_back(
+          {ids[pos], neighbors[i], weights.empty() ? 1 : weights[i]});
+    }
+  }
+}
+
+void GraphCsr::clear() {
+  std::vector<uint64_t>().swap(ids);
+  std::vector<uint64_t>().swap(offsets);
+  std::vector<uint64_t>().swap(neighbors);
+  std::vector<float>().swap(weights);
+}
+
+size_t GraphCsr::memory_size() const {
+  return sizeof(uint64_t) * (ids.capacity() + offsets.capacity() +
+                             neighbors.capacity()) +
+         sizeof(float) * weights.capacity();
+}
+
+int64_t GraphCsr::find(uint64_t id) const {
+  auto iter = std::lower_bound(ids.begin(), ids.end(), id);
+  if (iter == ids.end() || *iter != id) {
+    return -1;
+  }
+  return iter - ids.begin();
+}
+
+void GraphCsr::sample_k(size_t pos, int k, bool replace, std::mt19937_64 *rng,
+                        std::vector<int> *res) const {
+  int n = get_degree(pos);
+  if (weights.empty()) {
+    if (!replace) {
+      sample_uniform_k(n, k, rng, res);
+      return;
+    }
+    res->clear();
+    for (int i = 0; n > 0 && i < k; i++) {
+      res->push_back(std::uniform_int_distribution<int>(0, n - 1)(*rng));
+    }
+    return;
+  }
+  res->clear();
+  if (n == 0 || (!replace && k >= n)) {
+    for (int i = 0; i < n && i < k; i++) {
+      res->push_back(i);
+    }
+    return;
+  }
+  // there is no per node sampler to keep memory small, the scratch of every
+  // thread is reused instead
+  const float *weight = weights.data() + offsets[pos];
+  if (replace) {
+    // binary search in the prefix sums
+    static thread_local std::vector<double> prefix;
+    prefix.resize(n);
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+      sum += std::max(weight[i], 0.0f);
+      prefix[i] = sum;
+    }
+    if (sum <= 0) {
+      for (int i = 0; i < k; i++) {
+        res->push_back(std::uniform_int_distribution<int>(0, n - 1)(*rng));
+      }
+      return;
+    }
+    std::uniform_real_distribution<double> distrib(0, sum);
+    for (int i = 0; i < k; i++) {
+      auto iter = std::upper_bound(prefix.begin(), prefix.end(), distrib(*rng));
+      res->push_back(std::min<int>(iter - prefix.begin(), n - 1));
+    }
+    return;
+  }
+  // weighted sampling without replacement by the k largest u^(1/w), taken
+  // in log, the neighbors of zero weight come last
+  static thread_local std::vector<std::pair<double, int>> keys;
+  keys.resize(n);
+  std::uniform_real_distribution<double> distrib(0, 1.0);
+  for (int i = 0; i < n; i++) {
+    double u = std::max(distrib(*rng), 1e-300);
+    keys[i].first = weight[i] > 0 ? std::log(u) / weight[i] : -HUGE_VAL;
+    keys[i].second = i;
+  }
+  std::nth_element(keys.begin(), keys.begin() + k, keys.end(),
+                   [](const std::pair<double, int> &a,
+                      const std::pair<double, int> &b) {
+                     return a.first > b.first;
+                   });
+  for (int i = 0; i < k; i++) {
+    res->push_back(keys[i].second);
+  }
+}
+}  // namespace distributed
+}  // namespace paddle
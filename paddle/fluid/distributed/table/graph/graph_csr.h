@@ -0,0 +1,85 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+struct GraphCsrEdge {
+  uint64_t src;
+  uint64_t dst;
+  float weight;
+};
+
+// The edges loaded into a GraphShard, in compressed sparse row form: the
+// sorted ids of the source nodes, and for the node at position pos, its
+// neighbors in [offsets[pos], offsets[pos + 1]) of neighbors and weights.
+// It costs 8 bytes per edge, 12 if weighted, and 16 bytes per node, instead
+// of a GraphNode, an edge blob and a sampler per node. It is immutable once
+// built, a later load rebuilds it with the new edges appended.
+class GraphCsr {
+ public:
+  GraphCsr() {}
+
+  // Builds from edges, which are sorted by source and released. The edges
+  // of a node keep their order. A graph is weighted if any edge is loaded
+  // with a weight.
+  void build(std::vector<GraphCsrEdge> *edges, bool is_weighted);
+  // Appends the edges of the graph to edges, to rebuild it with more.
+  void export_edges(std::vector<GraphCsrEdge> *edges) const;
+  void clear();
+
+  size_t node_size() const { return ids.size(); }
+  size_t edge_size() const { return neighbors.size(); }
+  bool is_weighted() const { return !weights.empty(); }
+  size_t memory_size() const;
+
+  // The position of the node, or -1 if it has no edge loaded.
+  int64_t find(uint64_t id) const;
+  uint64_t get_id(size_t pos) const { return ids[pos]; }
+  int get_degree(size_t pos) const {
+    return static_cast<int>(offsets[pos + 1] - offsets[pos]);
+  }
+  uint64_t get_neighbor_id(size_t pos, int idx) const {
+    return neighbors[offsets[pos] + idx];
+  }
+  float get_neighbor_weight(size_t pos, int idx) const {
+    return weights.empty() ? 1 : weights[offsets[pos] + idx];
+  }
+
+  // Samples k neighbors of the node at pos with replacement, or min(k,
+  // degree) without, with probabilities proportional to the weights if the
+  // graph is weighted, into res as their indexes as Node::sample_k does.
+  void sample_k(size_t pos, int k, bool replace, std::mt19937_64 *rng,
+                std::vector<int> *res) const;
+  std::vector<int> sample_k(size_t pos, int k,
+                            const std::shared_ptr<std::mt19937_64> rng) const {
+    std::vector<int> res;
+    sample_k(pos, k, false, rng.get(), &res);
+    return res;
+  }
+
+ private:
+  std::vector<uint64_t> ids;
+  std::vector<uint64_t> offsets;
+  std::vector<uint64_t> neighbors;
+  std::vector<float> weights;
+};
+}  // namespace distributed
+}  // namespace paddle
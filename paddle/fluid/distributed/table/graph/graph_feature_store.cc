@@ -0,0 +1,170 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/table/graph/graph_feature_store.h"
+#include <algorithm>
+#include <cstring>
+namespace paddle {
+namespace distributed {
+
+void GraphFeatureStore::init(const std::vector<std::string> &dtypes,
+                             const std::vector<int32_t> &shapes) {
+  clear();
+  columns.resize(dtypes.size());
+  for (size_t feat_id = 0; feat_id < dtypes.size(); ++feat_id) {
+    auto &column = columns[feat_id];
+    const std::string &dtype = dtypes[feat_id];
+    if (dtype == "float32") {
+      column.type = FLOAT32;
+      column.value_size = sizeof(float);
+    } else if (dtype == "float64") {
+      column.type = FLOAT64;
+      column.value_size = sizeof(double);
+    } else if (dtype == "int32") {
+      column.type = INT32;
+      column.value_size = sizeof(int32_t);
+    } else if (dtype == "int64") {
+      column.type = INT64;
+      column.value_size = sizeof(int64_t);
+    } else {
+      // string and feasign
+      column.type = BYTES;
+      column.value_size = 0;
+    }
+    column.shape = feat_id < shapes.size() ? shapes[feat_id] : 1;
+  }
+}
+
+void GraphFeatureStore::add_node(uint64_t id) {
+  if (rows.count(id)) {
+    return;
+  }
+  if (!free_rows.empty()) {
+    rows[id] = free_rows.back();
+    free_rows.pop_back();
+    return;
+  }
+  uint32_t row = rows.size() + free_rows.size();
+  rows[id] = row;
+  for (auto &column : columns) {
+    column.offsets.push_back(column.data.size());
+    column.lengths.push_back(0);
+  }
+}
+
+void GraphFeatureStore::set_feature(uint64_t id, int feat_id,
+                                    const std::string &bytes) {
+  add_node(id);
+  uint32_t row = rows[id];
+  auto &column = columns[feat_id];
+  if (bytes.size() > column.lengths[row]) {
+    column.offsets[row] = column.data.size();
+    column.data.insert(column.data.end(), bytes.begin(), bytes.end());
+  } else if (!bytes.empty()) {
+    // in place, as most features keep their size
+    memcpy(column.data.data() + column.offsets[row], bytes.data(),
+           bytes.size());
+  }
+  column.lengths[row] = bytes.size();
+}
+
+void GraphFeatureStore::get_feature(uint64_t id, int feat_id,
+                                    std::string *res) const {
+  auto iter = rows.find(id);
+  if (iter == rows.end()) {
+    res->clear();
+    return;
+  }
+  auto &column = columns[feat_id];
+  res->assign(column.data.data() + column.offsets[iter->second],
+              column.lengths[iter->second]);
+}
+
+void GraphFeatureStore::remove_node(uint64_t id) {
+  auto iter = rows.find(id);
+  if (iter == rows.end()) {
+    return;
+  }
+  for (auto &column : columns) {
+    column.lengths[iter->second] = 0;
+  }
+  free_rows.push_back(iter->second);
+  rows.erase(iter);
+}
+
+void GraphFeatureStore::clear() {
+  for (auto &column : columns) {
+    std::vector<char>().swap(column.data);
+    std::vector<uint64_t>().swap(column.offsets);
+    std::vector<uint32_t>().swap(column.lengths);
+  }
+  rows.clear();
+  free_rows.clear();
+}
+
+template <typename T, typename V>
+static void convert_values(const char *data, size_t num, T *res) {
+  for (size_t i = 0; i < num; ++i) {
+    V value;
+    memcpy(&value, data + sizeof(V) * i, sizeof(V));
+    res[i] = static_cast<T>(value);
+  }
+}
+
+template <typename T>
+void GraphFeatureStore::copy_feature(uint64_t id, int feat_id, T *res) const {
+  auto &column = columns[feat_id];
+  size_t num = 0;
+  auto iter = rows.find(id);
+  if (iter != rows.end() && column.value_size > 0) {
+    num = std::min<size_t>(column.lengths[iter->second] / column.value_size,
+                           column.shape);
+    const char *data = column.data.data() + column.offsets[iter->second];
+    switch (column.type) {
+      case FLOAT32:
+        convert_values<T, float>(data, num, res);
+        break;
+      case FLOAT64:
+        convert_values<T, double>(data, num, res);
+        break;
+      case INT32:
+        convert_values<T, int32_t>(data, num, res);
+        break;
+      case INT64:
+        convert_values<T, int64_t>(data, num, res);
+        break;
+      default:
+        num = 0;
+    }
+  }
+  std::fill(res + num, res + column.shape, T(0));
+}
+
+template void GraphFeatureStore::copy_feature<float>(uint64_t id, int feat_id,
+                                                     float *res) const;
+template void GraphFeatureStore::copy_feature<int64_t>(uint64_t id,
+                                                       int feat_id,
+                                                       int64_t *res) const;
+
+size_t GraphFeatureStore::memory_size() const {
+  size_t size = rows.size() * (sizeof(uint64_t) + sizeof(uint32_t));
+  for (auto &column : columns) {
+    size += column.data.capacity() +
+            column.offsets.capacity() * sizeof(uint64_t) +
+            column.lengths.capacity() * sizeof(uint32_t);
+  }
+  return size;
+}
+}  // namespace distributed
+}  // namespace paddle
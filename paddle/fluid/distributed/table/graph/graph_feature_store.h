@@ -0,0 +1,76 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+// The features of the nodes of a GraphShard by columns. The values of a
+// feature of all the nodes are contiguous in one array, so that getting a
+// feature of a batch allocates nothing per node. A feature is kept as the
+// bytes GraphTable::parse_feature gives, the values of float32, float64,
+// int32 and int64 features are typed and can be copied as numbers.
+class GraphFeatureStore {
+ public:
+  GraphFeatureStore() {}
+  // dtypes[feat_id] and shapes[feat_id] of every feature, as GraphTable is
+  // configured, drops the features stored.
+  void init(const std::vector<std::string> &dtypes,
+            const std::vector<int32_t> &shapes);
+
+  void add_node(uint64_t id);
+  bool has_node(uint64_t id) const { return rows.count(id) > 0; }
+  // Setting a feature again leaves its former bytes unused until clear.
+  void set_feature(uint64_t id, int feat_id, const std::string &bytes);
+  // Assigns the bytes of the feature to res, empty if the node has none.
+  void get_feature(uint64_t id, int feat_id, std::string *res) const;
+  void remove_node(uint64_t id);
+  void clear();
+
+  bool is_numeric(int feat_id) const {
+    return columns[feat_id].value_size > 0;
+  }
+  int32_t get_shape(int feat_id) const { return columns[feat_id].shape; }
+  // Writes the shape values of the numeric feature as T to res, 0 for the
+  // values the node lacks. The values beyond shape are dropped.
+  template <typename T>
+  void copy_feature(uint64_t id, int feat_id, T *res) const;
+
+  size_t node_size() const { return rows.size(); }
+  size_t memory_size() const;
+
+ private:
+  enum ValueType { BYTES, FLOAT32, FLOAT64, INT32, INT64 };
+  struct Column {
+    ValueType type;
+    size_t value_size;  // 0 for bytes
+    int32_t shape;
+    std::vector<char> data;
+    // the bytes of the row r are [offsets[r], offsets[r] + lengths[r])
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> lengths;
+  };
+
+  std::vector<Column> columns;
+  std::unordered_map<uint64_t, uint32_t> rows;
+  // the rows of the nodes removed, reused by add_node
+  std::vector<uint32_t> free_rows;
+};
+}  // namespace distributed
+}  // namespace paddle
@@ -65,6 +65,11 @@ void GraphNode::build_edges(bool is_weighted) {
   }
 }
 void GraphNode::build_sampler(std::string sample_type) {
+  // rebuilt when more edges are loaded
+  if (sampler != nullptr) {
+    delete sampler;
+    sampler = nullptr;
+  }
   if (sample_type == "random") {
     sampler = new RandomSampler();
   } else if (sample_type == "weighted") {
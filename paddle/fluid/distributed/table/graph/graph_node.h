@@ -38,6 +38,11 @@ class Node {
       int k, const std::shared_ptr<std::mt19937_64> rng) {
     return std::vector<int>();
   }
+  // As Sampler::sample_k, into res which the caller reuses.
+  virtual void sample_k(int k, bool replace, std::mt19937_64 *rng,
+                        std::vector<int> *res) {
+    res->clear();
+  }
   virtual uint64_t get_neighbor_id(int idx) { return 0; }
   virtual float get_neighbor_weight(int idx) { return 1.; }
 
@@ -67,6 +72,10 @@ class GraphNode : public Node {
       int k, const std::shared_ptr<std::mt19937_64> rng) {
     return sampler->sample_k(k, rng);
   }
+  virtual void sample_k(int k, bool replace, std::mt19937_64 *rng,
+                        std::vector<int> *res) {
+    sampler->sample_k(k, replace, rng, res);
+  }
   virtual uint64_t get_neighbor_id(int idx) { return edges->get_id(idx); }
   virtual float get_neighbor_weight(int idx) { return edges->get_weight(idx); }
 
@@ -0,0 +1,166 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/distributed/table/graph/graph_subgraph.h"
+#include <cstring>
+namespace paddle {
+namespace distributed {
+
+void GraphSubgraph::clear() {
+  ids.clear();
+  offsets.assign(1, 0);
+  neighbors.clear();
+  weights.clear();
+  features.clear();
+  node_location.clear();
+}
+
+int64_t GraphSubgraph::add_node(uint64_t id) {
+  auto iter = node_location.find(id);
+  if (iter != node_location.end()) {
+    return iter->second;
+  }
+  node_location[id] = ids.size();
+  ids.push_back(id);
+  return ids.size() - 1;
+}
+
+int64_t GraphSubgraph::find(uint64_t id) const {
+  auto iter = node_location.find(id);
+  return iter == node_location.end() ? -1
+                                      : static_cast<int64_t>(iter->second);
+}
+
+int32_t GraphSubgraph::sample(const std::vector<uint64_t> &seeds,
+                              const std::vector<int> &fanouts,
+                              const GraphSampleFunc &sample_func) {
+  clear();
+  for (auto id : seeds) {
+    add_node(id);
+  }
+  // the nodes reached at the last hop are [begin, ids.size())
+  size_t begin = 0;
+  std::vector<std::vector<std::pair<uint64_t, float>>> res;
+  for (size_t hop = 0; hop < fanouts.size() && begin < ids.size(); ++hop) {
+    std::vector<uint64_t> frontier(ids.begin() + begin, ids.end());
+    begin = ids.size();
+    res.clear();
+    int32_t ret = sample_func(frontier, fanouts[hop], &res);
+    if (ret != 0 || res.size() != frontier.size()) {
+      clear();
+      return ret != 0 ? ret : -1;
+    }
+    for (auto &node_neighbors : res) {
+      for (auto &neighbor : node_neighbors) {
+        neighbors.push_back(add_node(neighbor.first));
+        weights.push_back(neighbor.second);
+      }
+      offsets.push_back(neighbors.size());
+    }
+  }
+  // the nodes of the last hop have no edge sampled
+  offsets.resize(ids.size() + 1, neighbors.size());
+  return 0;
+}
+
+size_t GraphSubgraph::get_size() const {
+  size_t size = sizeof(uint32_t) * 3 + sizeof(uint64_t) * ids.size() +
+                sizeof(uint32_t) * offsets.size() +
+                (sizeof(uint32_t) + sizeof(float)) * neighbors.size();
+  for (auto &feature : features) {
+    for (auto &value : feature) {
+      size += sizeof(uint32_t) + value.size();
+    }
+  }
+  return size;
+}
+
+template <typename T>
+static void write_array(char **buffer, const T *data, size_t num) {
+  if (num > 0) {
+    memcpy(*buffer, data, sizeof(T) * num);
+  }
+  *buffer += sizeof(T) * num;
+}
+
+void GraphSubgraph::to_buffer(char *buffer) const {
+  uint32_t header[3] = {static_cast<uint32_t>(ids.size()),
+                        static_cast<uint32_t>(neighbors.size()),
+                        static_cast<uint32_t>(features.size())};
+  write_array(&buffer, header, 3);
+  write_array(&buffer, ids.data(), ids.size());
+  write_array(&buffer, offsets.data(), offsets.size());
+  write_array(&buffer, neighbors.data(), neighbors.size());
+  write_array(&buffer, weights.data(), weights.size());
+  for (auto &feature : features) {
+    for (auto &value : feature) {
+      uint32_t len = value.size();
+      write_array(&buffer, &len, 1);
+      write_array(&buffer, value.data(), len);
+    }
+  }
+}
+
+template <typename T>
+static bool read_array(const char **buffer, const char *end, T *data,
+                       size_t num) {
+  if (static_cast<size_t>(end - *buffer) < sizeof(T) * num) {
+    return false;
+  }
+  if (num > 0) {
+    memcpy(data, *buffer, sizeof(T) * num);
+  }
+  *buffer += sizeof(T) * num;
+  return true;
+}
+
+int32_t GraphSubgraph::from_buffer(const char *buffer, size_t size) {
+  clear();
+  const char *end = buffer + size;
+  uint32_t header[3];
+  if (!read_array(&buffer, end, header, 3)) {
+    return -1;
+  }
+  ids.resize(header[0]);
+  offsets.resize(header[0] + 1);
+  neighbors.resize(header[1]);
+  weights.resize(header[1]);
+  features.resize(header[2], std::vector<std::string>(header[0]));
+  bool ok = read_array(&buffer, end, ids.data(), ids.size()) &&
+            read_array(&buffer, end, offsets.data(), offsets.size()) &&
+            read_array(&buffer, end, neighbors.data(), neighbors.size()) &&
+            read_array(&buffer, end, weights.data(), weights.size());
+  for (size_t feat_idx = 0; ok && feat_idx < features.size(); ++feat_idx) {
+    for (auto &value : features[feat_idx]) {
+      uint32_t len = 0;
+      ok = read_array(&buffer, end, &len, 1) &&
+           static_cast<size_t>(end - buffer) >= len;
+      if (!ok) {
+        break;
+      }
+      value.assign(buffer, len);
+      buffer += len;
+    }
+  }
+  if (!ok) {
+    clear();
+    return -1;
+  }
+  for (size_t pos = 0; pos < ids.size(); ++pos) {
+    node_location[ids[pos]] = pos;
+  }
+  return 0;
+}
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,72 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+namespace paddle {
+namespace distributed {
+
+// Samples sample_size neighbors of every node of ids into res, as
+// GraphBrpcClient::batch_sample_neighboors returns them.
+typedef std::function<int32_t(
+    const std::vector<uint64_t> &ids, int sample_size,
+    std::vector<std::vector<std::pair<uint64_t, float>>> *res)>
+    GraphSampleFunc;
+
+// The subgraph sampled k hops away from a batch of seeds, with fanouts[h]
+// neighbors per node at hop h. Every node appears once, the seeds first in
+// their order, and its neighbors are sampled the first time it is reached
+// only. The edges are in compressed sparse row form, the neighbors of the
+// node at pos are positions in ids, in [offsets[pos], offsets[pos + 1]).
+class GraphSubgraph {
+ public:
+  GraphSubgraph() : offsets(1, 0) {}
+
+  int32_t sample(const std::vector<uint64_t> &seeds,
+                 const std::vector<int> &fanouts,
+                 const GraphSampleFunc &sample_func);
+  void clear();
+
+  size_t node_size() const { return ids.size(); }
+  size_t edge_size() const { return neighbors.size(); }
+  // The position of the node, or -1.
+  int64_t find(uint64_t id) const;
+
+  // |node_num|edge_num|feat_num|ids|offsets|neighbors|weights|features|,
+  // uint32 but the ids, and a feature as its uint32 length and bytes.
+  size_t get_size() const;
+  void to_buffer(char *buffer) const;
+  // Returns -1 if the buffer is truncated.
+  int32_t from_buffer(const char *buffer, size_t size);
+
+  std::vector<uint64_t> ids;
+  std::vector<uint32_t> offsets;
+  std::vector<uint32_t> neighbors;
+  std::vector<float> weights;
+  // features[feat_idx][pos], empty if not asked for
+  std::vector<std::vector<std::string>> features;
+
+ private:
+  int64_t add_node(uint64_t id);
+
+  std::unordered_map<uint64_t, uint32_t> node_location;
+};
+}  // namespace distributed
+}  // namespace paddle
@@ -13,148 +13,201 @@
 // limitations under the License.
 
 #include "paddle/fluid/distributed/table/graph/graph_weighted_sampler.h"
-#include <iostream>
+#include <algorithm>
 #include <memory>
-#include <unordered_map>
-#include "paddle/fluid/framework/generator.h"
 namespace paddle {
 namespace distributed {
 
-void RandomSampler::build(GraphEdgeBlob *edges) { this->edges = edges; }
+// The marks of the indexes sampled by a call, kept by every thread and
+// cleared before the call returns.
+static std::vector<uint8_t> &sample_marks(int n) {
+  static thread_local std::vector<uint8_t> marks;
+  if (static_cast<int>(marks.size()) < n) {
+    marks.resize(n, 0);
+  }
+  return marks;
+}
 
-std::vector<int> RandomSampler::sample_k(
-    int k, const std::shared_ptr<std::mt19937_64> rng) {
-  int n = edges->size();
+void sample_uniform_k(int n, int k, std::mt19937_64 *rng,
+                      std::vector<int> *res) {
+  res->clear();
   if (k >= n) {
-    k = n;
-    std::vector<int> sample_result;
-    for (int i = 0; i < k; i++) {
-      sample_result.push_back(i);
+    for (int i = 0; i < n; i++) {
+      res->push_back(i);
     }
-    return sample_result;
+    return;
   }
-  std::vector<int> sample_result;
-  std::unordered_map<int, int> replace_map;
-  while (k--) {
-    std::uniform_int_distribution<int> distrib(0, n - 1);
+  auto &marks = sample_marks(n);
+  for (int j = n - k; j < n; j++) {
+    std::uniform_int_distribution<int> distrib(0, j);
     int rand_int = distrib(*rng);
-    auto iter = replace_map.find(rand_int);
-    if (iter == replace_map.end()) {
-      sample_result.push_back(rand_int);
-    } else {
-      sample_result.push_back(iter->second);
+    if (marks[rand_int]) {
+      rand_int = j;
     }
-
-    iter = replace_map.find(n - 1);
-    if (iter == replace_map.end()) {
-      replace_map[rand_int] = n - 1;
-    } else {
-      replace_map[rand_int] = iter->second;
-    }
-    --n;
+    marks[rand_int] = 1;
+    res->push_back(rand_int);
+  }
+  for (int idx : *res) {
+    marks[idx] = 0;
   }
-  return sample_result;
 }
 
-WeightedSampler::WeightedSampler() {
-  left = nullptr;
-  right = nullptr;
-  edges = nullptr;
-}
+void RandomSampler::build(GraphEdgeBlob *edges) { this->edges = edges; }
 
-WeightedSampler::~WeightedSampler() {
-  if (left != nullptr) {
-    delete left;
-    left = nullptr;
+void RandomSampler::sample_k(int k, bool replace, std::mt19937_64 *rng,
+                             std::vector<int> *res) {
+  int n = edges->size();
+  if (!replace) {
+    sample_uniform_k(n, k, rng, res);
+    return;
+  }
+  res->clear();
+  if (n == 0) {
+    return;
   }
-  if (right != nullptr) {
-    delete right;
-    right = nullptr;
+  std::uniform_int_distribution<int> distrib(0, n - 1);
+  for (int i = 0; i < k; i++) {
+    res->push_back(distrib(*rng));
   }
 }
 
+WeightedSampler::WeightedSampler()
+    : edges(nullptr), total_weight(0), positive_count(0) {}
+
+WeightedSampler::~WeightedSampler() {}
+
 void WeightedSampler::build(GraphEdgeBlob *edges) {
-  if (left != nullptr) {
-    delete left;
-    left = nullptr;
+  this->edges = edges;
+  int n = edges->size();
+  prob.assign(n, 0);
+  alias.assign(n, 0);
+  total_weight = 0;
+  positive_count = 0;
+  int any_positive = 0;
+  for (int i = 0; i < n; i++) {
+    float weight = edges->get_weight(i);
+    if (weight > 0) {
+      total_weight += weight;
+      any_positive = i;
+      ++positive_count;
+    }
   }
-  if (right != nullptr) {
-    delete right;
-    right = nullptr;
+  if (positive_count == 0) {
+    return;
+  }
+
+  // every edge holds n / total_weight of the weight, shared with its alias
+  std::vector<double> scaled(n);
+  std::vector<int> small, large;
+  for (int i = 0; i < n; i++) {
+    scaled[i] = std::max(edges->get_weight(i), 0.0f) * n / total_weight;
+    if (scaled[i] < 1) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+  while (!small.empty() && !large.empty()) {
+    int less = small.back();
+    int more = large.back();
+    small.pop_back();
+    prob[less] = scaled[less];
+    alias[less] = more;
+    scaled[more] -= 1 - scaled[less];
+    if (scaled[more] < 1) {
+      large.pop_back();
+      small.push_back(more);
+    }
+  }
+  for (int idx : large) {
+    prob[idx] = 1;
+    alias[idx] = idx;
+  }
+  // left only by rounding errors
+  for (int idx : small) {
+    prob[idx] = edges->get_weight(idx) > 0 ? 1 : 0;
+    alias[idx] = any_positive;
   }
-  return build_one((WeightedGraphEdgeBlob *)edges, 0, edges->size());
 }
 
-void WeightedSampler::build_one(WeightedGraphEdgeBlob *edges, int start,
-                                int end) {
-  count = 0;
-  this->edges = edges;
-  if (start + 1 == end) {
-    left = right = nullptr;
-    idx = start;
-    count = 1;
-    weight = edges->get_weight(idx);
+int WeightedSampler::sample_one(std::mt19937_64 *rng) const {
+  std::uniform_int_distribution<int> pick(0, prob.size() - 1);
+  std::uniform_real_distribution<float> coin(0, 1.0);
+  int idx = pick(*rng);
+  return coin(*rng) < prob[idx] ? idx : alias[idx];
+}
 
-  } else {
-    left = new WeightedSampler();
-    right = new WeightedSampler();
-    left->build_one(edges, start, start + (end - start) / 2);
-    right->build_one(edges, start + (end - start) / 2, end);
-    weight = left->weight + right->weight;
-    count = left->count + right->count;
+void WeightedSampler::sample_k(int k, bool replace, std::mt19937_64 *rng,
+                               std::vector<int> *res) {
+  int n = edges->size();
+  if (positive_count == 0) {
+    // no weight to follow, uniformly as RandomSampler
+    if (!replace) {
+      sample_uniform_k(n, k, rng, res);
+      return;
+    }
+    res->clear();
+    for (int i = 0; n > 0 && i < k; i++) {
+      res->push_back(std::uniform_int_distribution<int>(0, n - 1)(*rng));
+    }
+    return;
   }
-}
-std::vector<int> WeightedSampler::sample_k(
-    int k, const std::shared_ptr<std::mt19937_64> rng) {
-  if (k >= count) {
-    k = count;
-    std::vector<int> sample_result;
+  res->clear();
+  if (replace) {
     for (int i = 0; i < k; i++) {
-      sample_result.push_back(i);
+      res->push_back(sample_one(rng));
     }
-    return sample_result;
-  }
-  std::vector<int> sample_result;
-  float subtract;
-  std::unordered_map<WeightedSampler *, float> subtract_weight_map;
-  std::unordered_map<WeightedSampler *, int> subtract_count_map;
-  std::uniform_real_distribution<float> distrib(0, 1.0);
-  while (k--) {
-    float query_weight = distrib(*rng);
-    query_weight *= weight - subtract_weight_map[this];
-    sample_result.push_back(sample(query_weight, subtract_weight_map,
-                                   subtract_count_map, subtract));
-  }
-  return sample_result;
-}
+    return;
+  }
+  if (k >= positive_count) {
+    // all the edges of positive weight, then the first others
+    for (int i = 0; i < n; i++) {
+      if (edges->get_weight(i) > 0) {
+        res->push_back(i);
+      }
+    }
+    for (int i = 0; i < n && static_cast<int>(res->size()) < k; i++) {
+      if (edges->get_weight(i) <= 0) {
+        res->push_back(i);
+      }
+    }
+    return;
+  }
 
-int WeightedSampler::sample(
-    float query_weight,
-    std::unordered_map<WeightedSampler *, float> &subtract_weight_map,
-    std::unordered_map<WeightedSampler *, int> &subtract_count_map,
-    float &subtract) {
-  if (left == nullptr) {
-    subtract_weight_map[this] = weight;
-    subtract = weight;
-    subtract_count_map[this] = 1;
-    return idx;
-  }
-  int left_count = left->count - subtract_count_map[left];
-  int right_count = right->count - subtract_count_map[right];
-  float left_subtract = subtract_weight_map[left];
-  int return_idx;
-  if (right_count == 0 ||
-      left_count > 0 && left->weight - left_subtract >= query_weight) {
-    return_idx = left->sample(query_weight, subtract_weight_map,
-                              subtract_count_map, subtract);
-  } else {
-    return_idx =
-        right->sample(query_weight - (left->weight - left_subtract),
-                      subtract_weight_map, subtract_count_map, subtract);
-  }
-  subtract_weight_map[this] += subtract;
-  subtract_count_map[this]++;
-  return return_idx;
+  auto &marks = sample_marks(n);
+  double taken_weight = 0;
+  while (static_cast<int>(res->size()) < k &&
+         taken_weight * 2 < total_weight) {
+    int idx = sample_one(rng);
+    if (!marks[idx]) {
+      marks[idx] = 1;
+      res->push_back(idx);
+      taken_weight += edges->get_weight(idx);
+    }
+  }
+  // most of the draws would be rejected from now on
+  std::uniform_real_distribution<double> distrib(0, 1.0);
+  while (static_cast<int>(res->size()) < k) {
+    double query_weight = distrib(*rng) * (total_weight - taken_weight);
+    int idx = -1;
+    for (int i = 0; i < n; i++) {
+      float weight = edges->get_weight(i);
+      if (marks[i] || weight <= 0) {
+        continue;
+      }
+      idx = i;
+      query_weight -= weight;
+      if (query_weight < 0) {
+        break;
+      }
+    }
+    marks[idx] = 1;
+    res->push_back(idx);
+    taken_weight += edges->get_weight(idx);
+  }
+  for (int idx : *res) {
+    marks[idx] = 0;
+  }
 }
 }  // namespace distributed
 }  // namespace paddle
@@ -16,48 +16,66 @@
 #include <ctime>
 #include <memory>
 #include <random>
-#include <unordered_map>
 #include <vector>
 #include "paddle/fluid/distributed/table/graph/graph_edge.h"
 namespace paddle {
 namespace distributed {
 
+// Samplers of the neighbors of a node, built once its edges are loaded. They
+// write the indexes of the sampled edges into res, which the caller keeps
+// across nodes, so that sampling allocates nothing per sample.
 class Sampler {
  public:
   virtual ~Sampler() {}
   virtual void build(GraphEdgeBlob *edges) = 0;
-  virtual std::vector<int> sample_k(
-      int k, const std::shared_ptr<std::mt19937_64> rng) = 0;
+  // Samples k edges with replacement, or min(k, size) edges without.
+  virtual void sample_k(int k, bool replace, std::mt19937_64 *rng,
+                        std::vector<int> *res) = 0;
+  std::vector<int> sample_k(int k, const std::shared_ptr<std::mt19937_64> rng) {
+    std::vector<int> res;
+    sample_k(k, false, rng.get(), &res);
+    return res;
+  }
 };
 
+// Samples k of [0, n) uniformly without replacement, by Floyd's algorithm
+// in O(k), into res. GraphCsr shares it.
+void sample_uniform_k(int n, int k, std::mt19937_64 *rng,
+                      std::vector<int> *res);
+
 class RandomSampler : public Sampler {
  public:
   virtual ~RandomSampler() {}
   virtual void build(GraphEdgeBlob *edges);
-  virtual std::vector<int> sample_k(int k,
-                                    const std::shared_ptr<std::mt19937_64> rng);
+  using Sampler::sample_k;
+  virtual void sample_k(int k, bool replace, std::mt19937_64 *rng,
+                        std::vector<int> *res);
   GraphEdgeBlob *edges;
 };
 
+// Walker's alias table of the weights, built by Vose's method: an edge is
+// drawn in O(1) with two random numbers. Sampling without replacement draws
+// with replacement and rejects the edges drawn before, until they hold half
+// of the weight, and then picks among the rest by a linear scan.
 class WeightedSampler : public Sampler {
  public:
   WeightedSampler();
   virtual ~WeightedSampler();
-  WeightedSampler *left, *right;
-  float weight;
-  int count;
-  int idx;
   GraphEdgeBlob *edges;
   virtual void build(GraphEdgeBlob *edges);
-  virtual void build_one(WeightedGraphEdgeBlob *edges, int start, int end);
-  virtual std::vector<int> sample_k(int k,
-                                    const std::shared_ptr<std::mt19937_64> rng);
+  using Sampler::sample_k;
+  virtual void sample_k(int k, bool replace, std::mt19937_64 *rng,
+                        std::vector<int> *res);
 
  private:
-  int sample(float query_weight,
-             std::unordered_map<WeightedSampler *, float> &subtract_weight_map,
-             std::unordered_map<WeightedSampler *, int> &subtract_count_map,
-             float &subtract);
+  int sample_one(std::mt19937_64 *rng) const;
+
+  // the probability to keep the drawn edge i, else alias[i] is taken
+  std::vector<float> prob;
+  std::vector<int> alias;
+  double total_weight;
+  // the number of edges of positive weight
+  int positive_count;
 };
 }  // namespace distributed
 }  // namespace paddle
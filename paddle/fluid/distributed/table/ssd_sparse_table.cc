@@ -65,14 +65,32 @@ int32_t SSDSparseTable::pull_sparse(float* pull_values,
                                     const PullSparseValue& pull_value) {
   auto shard_num = task_pool_size_;
   std::vector<std::future<int>> tasks(shard_num);
+  pulled_ += pull_value.numel_;
+
+  // as CommonSparseTable, the feasigns of other pservers from the replicas
+  bool all_owned = _shard_num <= 1;
+  std::vector<int> owned_offsets;
+  if (!all_owned &&
+      pull_sparse_replica(pull_values, pull_value, &owned_offsets) != 0) {
+    return -1;
+  }
 
   for (int shard_id = 0; shard_id < shard_num; ++shard_id) {
     tasks[shard_id] = _shards_task_pool[shard_id]->enqueue(
-        [this, shard_id, shard_num, &pull_value, &pull_values]() -> int {
+        [this, shard_id, shard_num, all_owned, &owned_offsets, &pull_value,
+         &pull_values]() -> int {
           auto& block = shard_values_[shard_id];
 
           std::vector<int> offsets;
-          pull_value.Fission(shard_id, shard_num, &offsets);
+          if (all_owned) {
+            pull_value.Fission(shard_id, shard_num, &offsets);
+          } else {
+            for (auto offset : owned_offsets) {
+              if (pull_value.feasigns_[offset] % shard_num == shard_id) {
+                offsets.push_back(offset);
+              }
+            }
+          }
 
           for (auto& offset : offsets) {
             auto feasign = pull_value.feasigns_[offset];
@@ -80,7 +98,7 @@ int32_t SSDSparseTable::pull_sparse(float* pull_values,
             float* embedding = nullptr;
             auto iter = block->Find(feasign);
             // in mem
-            if (iter == block->end()) {
+            if (iter != block->end()) {
               embedding = iter->second->data_.data();
               if (pull_value.is_training_) {
                 block->AttrUpdate(iter->second, frequencie);
@@ -101,7 +119,7 @@ int32_t SSDSparseTable::pull_sparse(float* pull_values,
                 // copy to mem
                 memcpy(value->data_.data(), db_value,
                        value_size * sizeof(float));
-                embedding = db_value;
+                embedding = value->data_.data();
 
                 // param, count, unseen_day
                 value->count_ = db_value[value_size];
@@ -278,7 +296,9 @@ int64_t SSDSparseTable::SaveValueToText(std::ostream* os,
       ss << "\n";
 
       os->write(ss.str().c_str(), sizeof(char) * ss.str().size());
+      ++save_num;
     }
+    delete it;
   }
 
   return save_num;
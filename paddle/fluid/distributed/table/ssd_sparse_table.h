@@ -25,12 +25,13 @@ class SSDSparseTable : public CommonSparseTable {
 
   virtual int32_t initialize() override;
 
-  void SaveMetaToText(std::ostream* os, const CommonAccessorParameter& common,
-                      const size_t shard_idx, const int64_t total);
+  // the rows spilled to rocksdb are only written by the text format
+  virtual std::string save_format() const override { return "text"; }
 
-  int64_t SaveValueToText(std::ostream* os, std::shared_ptr<ValueBlock> block,
-                          std::shared_ptr<::ThreadPool> pool, const int mode,
-                          int shard_id);
+  virtual int64_t SaveValueToText(std::ostream* os,
+                                  std::shared_ptr<ValueBlock> block,
+                                  std::shared_ptr<::ThreadPool> pool,
+                                  const int mode, int shard_id) override;
 
   virtual int64_t LoadFromText(
       const std::string& valuepath, const std::string& metapath,
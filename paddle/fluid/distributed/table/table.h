@@ -66,6 +66,14 @@ class Table {
     return 0;
   }
 
+  // Writes read-only replicas of num feasigns owned by other shards, of
+  // select_dim values each, which pull_sparse then serves.
+  virtual int32_t push_sparse_replica(const uint64_t *keys,
+                                      const float *values, size_t num) {
+    LOG(WARNING) << "sparse replicas are not supported by the table";
+    return -1;
+  }
+
   // only for sparse geo table
   virtual int32_t pull_geo_param(const uint32_t trainer_id,
                                  std::vector<float> *values,
@@ -132,8 +140,8 @@ class Table {
                                          _config.table_id());
   }
 
-  size_t _shard_idx;  // table 分片编号
-  size_t _shard_num;  // table 分片总数
+  size_t _shard_idx = 0;  // table 分片编号
+  size_t _shard_num = 1;  // table 分片总数
   TableParameter _config;
   float *_global_lr = nullptr;
   std::shared_ptr<ValueAccessor> _value_accesor;
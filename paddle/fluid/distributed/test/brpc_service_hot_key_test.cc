@@ -0,0 +1,239 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <unistd.h>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/service/brpc_ps_server.h"
+#include "paddle/fluid/distributed/service/env.h"
+#include "paddle/fluid/distributed/service/hot_key_router.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+DECLARE_int32(pserver_hot_key_replica_num);
+DECLARE_int32(pserver_hot_key_threshold);
+DECLARE_int32(pserver_hot_key_refresh_ms);
+
+namespace framework = paddle::framework;
+namespace distributed = paddle::distributed;
+
+static const int kEmbDim = 4;
+static const size_t kServerNum = 3;
+
+TEST(HotKeyRouter, Route) {
+  distributed::HotKeyRouter router(kServerNum, 2, 3, 2);
+  std::vector<uint64_t> keys = {7, 7, 7, 8, 8, 8, 8, 9, 10};
+  router.Record(keys.data(), keys.size());
+  // 8 is pulled the most, 9 and 10 too few times
+  EXPECT_EQ(router.TakeCandidates(), std::vector<uint64_t>({8, 7}));
+  EXPECT_TRUE(router.TakeCandidates().empty());
+  router.SetHotKeys({7});
+  EXPECT_TRUE(router.IsHot(7));
+  EXPECT_FALSE(router.IsHot(8));
+  EXPECT_EQ(router.Replicas(7), std::vector<size_t>({2, 0}));
+
+  std::vector<uint64_t> pulls = {7, 7, 7, 7, 7, 7, 8, 8};
+  std::vector<size_t> load, servers;
+  router.Route(pulls.data(), pulls.size(), &load, &servers);
+  // 7 spread evenly, 8 from its owner
+  EXPECT_EQ(load, std::vector<size_t>({2, 2, 4}));
+  EXPECT_EQ(servers[6], 2);
+  EXPECT_EQ(servers[7], 2);
+}
+
+void GetSparseTableProto(distributed::TableParameter* sparse_table_proto) {
+  sparse_table_proto->set_table_id(0);
+  sparse_table_proto->set_table_class("CommonSparseTable");
+  sparse_table_proto->set_shard_num(256);
+  sparse_table_proto->set_type(distributed::PS_SPARSE_TABLE);
+  auto* accessor_proto = sparse_table_proto->mutable_accessor();
+  auto* common_proto = sparse_table_proto->mutable_common();
+
+  accessor_proto->set_accessor_class("CommMergeAccessor");
+  accessor_proto->set_fea_dim(0);
+  accessor_proto->set_embedx_dim(kEmbDim);
+
+  common_proto->set_name("sgd");
+  common_proto->set_table_name("HotKeyTable");
+  common_proto->set_trainer_num(1);
+  common_proto->set_sync(false);
+  common_proto->set_entry("none");
+  common_proto->add_params("Param");
+  common_proto->add_dims(kEmbDim);
+  common_proto->add_initializers("fill_constant&0.5");
+  common_proto->add_params("LearningRate");
+  common_proto->add_dims(1);
+  common_proto->add_initializers("fill_constant&1.0");
+}
+
+distributed::PSParameter GetPsProto() {
+  distributed::PSParameter fleet_desc;
+  auto* downpour_server_proto =
+      fleet_desc.mutable_server_param()->mutable_downpour_server_param();
+  auto* server_service_proto = downpour_server_proto->mutable_service_param();
+  server_service_proto->set_service_class("BrpcPsService");
+  server_service_proto->set_server_class("BrpcPsServer");
+  server_service_proto->set_client_class("BrpcPsClient");
+  server_service_proto->set_start_server_port(0);
+  server_service_proto->set_server_thread_num(12);
+  GetSparseTableProto(downpour_server_proto->add_downpour_table_param());
+  GetSparseTableProto(fleet_desc.mutable_worker_param()
+                          ->mutable_downpour_worker_param()
+                          ->add_downpour_table_param());
+  return fleet_desc;
+}
+
+/*-------------------------------------------------------------------------*/
+
+std::string ip_ = "127.0.0.1";
+uint32_t port_ = 4309;
+
+std::vector<std::string> host_sign_list_;
+
+std::vector<std::shared_ptr<distributed::PSServer>> pservers_(kServerNum);
+
+std::shared_ptr<distributed::BrpcPsClient> worker_ptr_;
+
+void RunServer(size_t rank) {
+  distributed::PSParameter server_proto = GetPsProto();
+  auto _ps_env = distributed::PaddlePSEnvironment();
+  _ps_env.set_ps_servers(&host_sign_list_, kServerNum);
+  pservers_[rank] = std::shared_ptr<distributed::PSServer>(
+      distributed::PSServerFactory::create(server_proto));
+  std::vector<framework::ProgramDesc> empty_vec;
+  framework::ProgramDesc empty_prog;
+  empty_vec.push_back(empty_prog);
+  pservers_[rank]->configure(server_proto, _ps_env, rank, empty_vec);
+  pservers_[rank]->start(ip_, port_ + rank);
+}
+
+std::vector<float> Pull(const std::vector<uint64_t>& keys) {
+  std::vector<float> values(keys.size() * kEmbDim, -1);
+  std::vector<float*> value_ptrs(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    value_ptrs[i] = values.data() + i * kEmbDim;
+  }
+  auto status = worker_ptr_->pull_sparse(value_ptrs.data(), 0, keys.data(),
+                                         keys.size(), true);
+  status.wait();
+  EXPECT_EQ(status.get(), 0);
+  return values;
+}
+
+void Push(const std::vector<uint64_t>& keys, float grad) {
+  std::vector<float> grads(keys.size() * kEmbDim, grad);
+  std::vector<const float*> grad_ptrs(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    grad_ptrs[i] = grads.data() + i * kEmbDim;
+  }
+  auto* closure = new distributed::DownpourBrpcClosure(
+      kServerNum, [](void* done) {
+        int ret = 0;
+        auto* closure = (distributed::DownpourBrpcClosure*)done;
+        for (size_t i = 0; i < kServerNum; ++i) {
+          if (closure->check_response(
+                  i, distributed::PS_PUSH_SPARSE_TABLE) != 0) {
+            ret = -1;
+          }
+        }
+        closure->set_promise_value(ret);
+      });
+  auto status = worker_ptr_->push_sparse_raw_gradient(
+      0, keys.data(), grad_ptrs.data(), keys.size(), closure);
+  status.wait();
+  EXPECT_EQ(status.get(), 0);
+}
+
+std::vector<uint64_t> LoadSince(const std::vector<uint64_t>& before) {
+  auto load = worker_ptr_->get_server_pull_load();
+  for (size_t i = 0; i < load.size(); ++i) {
+    load[i] -= before[i];
+  }
+  return load;
+}
+
+TEST(HotKeyReplication, Run) {
+  setenv("http_proxy", "", 1);
+  setenv("https_proxy", "", 1);
+  FLAGS_pserver_hot_key_replica_num = 2;
+  FLAGS_pserver_hot_key_threshold = 3;
+  FLAGS_pserver_hot_key_refresh_ms = 0;
+  for (size_t rank = 0; rank < kServerNum; ++rank) {
+    auto ph_host = distributed::PSHost(ip_, port_ + rank, rank);
+    host_sign_list_.push_back(ph_host.serialize_to_string());
+  }
+  std::vector<std::thread> server_threads;
+  for (size_t rank = 0; rank < kServerNum; ++rank) {
+    server_threads.emplace_back(RunServer, rank);
+  }
+  sleep(2);
+
+  distributed::PSParameter worker_proto = GetPsProto();
+  auto _ps_env = distributed::PaddlePSEnvironment();
+  _ps_env.set_ps_servers(&host_sign_list_, kServerNum);
+  std::map<uint64_t, std::vector<distributed::Region>> dense_regions;
+  dense_regions[0] = {};
+  worker_ptr_ = std::shared_ptr<distributed::BrpcPsClient>(
+      (distributed::BrpcPsClient*)distributed::PSClientFactory::create(
+          worker_proto));
+  worker_ptr_->configure(worker_proto, dense_regions, _ps_env, 0);
+
+  // 7 is hot, owned by the server 1
+  std::vector<uint64_t> keys(6, 7);
+  for (uint64_t key = 20; key < 30; ++key) {
+    keys.push_back(key);
+  }
+  EXPECT_EQ(Pull(keys), std::vector<float>(keys.size() * kEmbDim, 0.5));
+  EXPECT_EQ(worker_ptr_->refresh_hot_keys(0), 0);
+
+  auto before = worker_ptr_->get_server_pull_load();
+  std::vector<uint64_t> hot_keys(9, 7);
+  EXPECT_EQ(Pull(hot_keys), std::vector<float>(9 * kEmbDim, 0.5));
+  EXPECT_EQ(LoadSince(before), std::vector<uint64_t>({3, 3, 3}));
+  before = worker_ptr_->get_server_pull_load();
+  Pull({8});
+  EXPECT_EQ(LoadSince(before), std::vector<uint64_t>({0, 0, 1}));
+
+  // the pushes of 7 merged, applied to its owner, the replicas stale until
+  // refreshed
+  Push({7, 7, 8}, 0.25);
+  auto values = Pull(hot_keys);
+  EXPECT_EQ(std::count(values.begin(), values.end(), 0), 3 * kEmbDim);
+  EXPECT_EQ(std::count(values.begin(), values.end(), 0.5), 6 * kEmbDim);
+  EXPECT_EQ(worker_ptr_->refresh_hot_keys(0), 0);
+  EXPECT_EQ(Pull(hot_keys), std::vector<float>(9 * kEmbDim, 0));
+  EXPECT_EQ(Pull({8}), std::vector<float>(kEmbDim, 0.25));
+
+  // 7 is not pulled in a round, no longer hot
+  EXPECT_EQ(worker_ptr_->refresh_hot_keys(0), 0);
+  EXPECT_EQ(worker_ptr_->refresh_hot_keys(0), 0);
+  before = worker_ptr_->get_server_pull_load();
+  Pull({7, 7, 7});
+  EXPECT_EQ(LoadSince(before), std::vector<uint64_t>({0, 3, 0}));
+
+  worker_ptr_->stop_server();
+  worker_ptr_->finalize_worker();
+  for (auto& server_thread : server_threads) {
+    server_thread.join();
+  }
+  FLAGS_pserver_hot_key_replica_num = 0;
+}
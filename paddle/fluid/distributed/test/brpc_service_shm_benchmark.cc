@@ -0,0 +1,218 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// Measures pull_sparse and push_sparse of a trainer against a pserver on the
+// same host, through loopback brpc and through shared memory, e.g.
+//   ./brpc_service_shm_benchmark --keys=10000 --emb_dim=64 --iterations=200
+
+#include <unistd.h>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/service/brpc_ps_server.h"
+#include "paddle/fluid/distributed/service/env.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+DEFINE_int32(keys, 10000, "number of keys of every pull and push");
+DEFINE_int32(emb_dim, 64, "embedding dim of every key");
+DEFINE_int32(iterations, 200, "number of pulls and pushes");
+DEFINE_int32(brpc_port, 4219, "port of the pserver reached through brpc");
+DEFINE_int32(shm_port, 4229,
+             "port of the pserver reached through shared memory");
+DECLARE_string(pserver_shm_endpoints);
+
+namespace paddle {
+namespace distributed {
+
+static void GetSparseTableProto(TableParameter* sparse_table_proto) {
+  sparse_table_proto->set_table_id(0);
+  sparse_table_proto->set_table_class("CommonSparseTable");
+  sparse_table_proto->set_shard_num(256);
+  sparse_table_proto->set_type(PS_SPARSE_TABLE);
+  TableAccessorParameter* accessor_proto =
+      sparse_table_proto->mutable_accessor();
+  CommonAccessorParameter* common_proto = sparse_table_proto->mutable_common();
+
+  accessor_proto->set_accessor_class("CommMergeAccessor");
+  accessor_proto->set_fea_dim(0);
+  accessor_proto->set_embedx_dim(FLAGS_emb_dim);
+
+  common_proto->set_name("sgd");
+  common_proto->set_table_name("MergedDense");
+  common_proto->set_trainer_num(1);
+  common_proto->set_sync(false);
+  common_proto->set_entry("none");
+  common_proto->add_params("Param");
+  common_proto->add_dims(FLAGS_emb_dim);
+  // the same initial values on both pservers, so that the pulls compare
+  common_proto->add_initializers("fill_constant&1.0");
+  common_proto->add_params("LearningRate");
+  common_proto->add_dims(1);
+  common_proto->add_initializers("fill_constant&0.01");
+}
+
+static PSParameter GetProto(bool is_worker) {
+  PSParameter fleet_desc;
+  if (is_worker) {
+    GetSparseTableProto(fleet_desc.mutable_worker_param()
+                            ->mutable_downpour_worker_param()
+                            ->add_downpour_table_param());
+  }
+  DownpourServerParameter* downpour_server_proto =
+      fleet_desc.mutable_server_param()->mutable_downpour_server_param();
+  ServerServiceParameter* server_service_proto =
+      downpour_server_proto->mutable_service_param();
+  server_service_proto->set_service_class("BrpcPsService");
+  server_service_proto->set_server_class("BrpcPsServer");
+  server_service_proto->set_client_class("BrpcPsClient");
+  server_service_proto->set_start_server_port(0);
+  server_service_proto->set_server_thread_num(12);
+  GetSparseTableProto(downpour_server_proto->add_downpour_table_param());
+  return fleet_desc;
+}
+
+class Endpoint {
+ public:
+  Endpoint(const std::string& ip, uint32_t port) : ip_(ip), port_(port) {
+    host_sign_list_.push_back(PSHost(ip_, port_, 0).serialize_to_string());
+  }
+
+  void Start() {
+    server_thread_ = std::thread([this]() {
+      auto server_proto = GetProto(false);
+      PaddlePSEnvironment env;
+      env.set_ps_servers(&host_sign_list_, 1);
+      server_.reset(PSServerFactory::create(server_proto));
+      std::vector<framework::ProgramDesc> empty_vec;
+      empty_vec.push_back(framework::ProgramDesc());
+      server_->configure(server_proto, env, 0, empty_vec);
+      server_->start(ip_, port_);
+    });
+    sleep(1);
+
+    auto worker_proto = GetProto(true);
+    PaddlePSEnvironment env;
+    env.set_ps_servers(&host_sign_list_, 1);
+    std::map<uint64_t, std::vector<Region>> dense_regions;
+    dense_regions[0] = {};
+    client_.reset(PSClientFactory::create(worker_proto));
+    client_->configure(worker_proto, dense_regions, env, 0);
+  }
+
+  void Stop() {
+    client_->stop_server();
+    client_->finalize_worker();
+    server_thread_.join();
+  }
+
+  // Returns the seconds of the pulls and of the pushes.
+  std::pair<double, double> Run(std::vector<float>* pulled) {
+    size_t num = FLAGS_keys;
+    std::vector<uint64_t> keys(num);
+    std::vector<float> values(num * FLAGS_emb_dim);
+    std::vector<float> grads(num * FLAGS_emb_dim, 0.1);
+    std::vector<float*> value_ptrs(num);
+    std::vector<const float*> grad_ptrs(num);
+    for (size_t i = 0; i < num; ++i) {
+      keys[i] = i * 7919;
+      value_ptrs[i] = values.data() + i * FLAGS_emb_dim;
+      grad_ptrs[i] = grads.data() + i * FLAGS_emb_dim;
+    }
+
+    double pull_s = 0, push_s = 0;
+    for (int x = 0; x < FLAGS_iterations; ++x) {
+      auto begin = GetCurrentUS();
+      client_->pull_sparse(value_ptrs.data(), 0, keys.data(), num, true).wait();
+      pull_s += (GetCurrentUS() - begin) / 1e+6;
+
+      auto* closure = new DownpourBrpcClosure(1, [](void* done) {
+        auto* closure = reinterpret_cast<DownpourBrpcClosure*>(done);
+        closure->set_promise_value(
+            closure->check_response(0, PS_PUSH_SPARSE_TABLE));
+      });
+      begin = GetCurrentUS();
+      client_
+          ->push_sparse_raw_gradient(0, keys.data(), grad_ptrs.data(), num,
+                                     closure)
+          .wait();
+      push_s += (GetCurrentUS() - begin) / 1e+6;
+    }
+    client_->pull_sparse(value_ptrs.data(), 0, keys.data(), num, true).wait();
+    pulled->swap(values);
+    return {pull_s, push_s};
+  }
+
+ private:
+  std::string ip_;
+  uint32_t port_;
+  std::vector<std::string> host_sign_list_;
+  std::shared_ptr<PSServer> server_;
+  std::shared_ptr<PSClient> client_;
+  std::thread server_thread_;
+};
+
+static void Run() {
+  setenv("http_proxy", "", 1);
+  setenv("https_proxy", "", 1);
+  std::string ip = "127.0.0.1";
+  FLAGS_pserver_shm_endpoints = ip + ":" + std::to_string(FLAGS_shm_port);
+
+  Endpoint brpc_endpoint(ip, FLAGS_brpc_port);
+  Endpoint shm_endpoint(ip, FLAGS_shm_port);
+  brpc_endpoint.Start();
+  shm_endpoint.Start();
+
+  std::vector<float> brpc_values, shm_values;
+  auto brpc_s = brpc_endpoint.Run(&brpc_values);
+  auto shm_s = shm_endpoint.Run(&shm_values);
+  brpc_endpoint.Stop();
+  shm_endpoint.Stop();
+
+  size_t mismatch = 0;
+  for (size_t i = 0; i < brpc_values.size(); ++i) {
+    if (std::abs(brpc_values[i] - shm_values[i]) > 1e-5) {
+      ++mismatch;
+    }
+  }
+
+  double mb = FLAGS_iterations * FLAGS_keys * FLAGS_emb_dim * sizeof(float) /
+              1048576.0;
+  std::cout << "keys " << FLAGS_keys << ", emb_dim " << FLAGS_emb_dim
+            << ", iterations " << FLAGS_iterations << std::endl;
+  std::cout << "brpc: pull " << brpc_s.first << "s (" << mb / brpc_s.first
+            << " MB/s), push " << brpc_s.second << "s ("
+            << mb / brpc_s.second << " MB/s)" << std::endl;
+  std::cout << "shm: pull " << shm_s.first << "s (" << mb / shm_s.first
+            << " MB/s), push " << shm_s.second << "s (" << mb / shm_s.second
+            << " MB/s)" << std::endl;
+  std::cout << "values mismatched: " << mismatch << std::endl;
+}
+
+}  // namespace distributed
+}  // namespace paddle
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  paddle::distributed::Run();
+  return 0;
+}
@@ -0,0 +1,158 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <unistd.h>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/service/brpc_ps_server.h"
+#include "paddle/fluid/distributed/service/env.h"
+#include "paddle/fluid/distributed/service/ps_shm_channel.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+DECLARE_string(pserver_shm_endpoints);
+
+namespace paddle {
+namespace distributed {
+
+static const int kEmbDim = 8;
+
+static void GetSparseTableProto(TableParameter* sparse_table_proto) {
+  sparse_table_proto->set_table_id(0);
+  sparse_table_proto->set_table_class("CommonSparseTable");
+  sparse_table_proto->set_shard_num(256);
+  sparse_table_proto->set_type(PS_SPARSE_TABLE);
+  TableAccessorParameter* accessor_proto =
+      sparse_table_proto->mutable_accessor();
+  CommonAccessorParameter* common_proto = sparse_table_proto->mutable_common();
+
+  accessor_proto->set_accessor_class("CommMergeAccessor");
+  accessor_proto->set_fea_dim(0);
+  accessor_proto->set_embedx_dim(kEmbDim);
+
+  common_proto->set_name("sgd");
+  common_proto->set_table_name("MergedDense");
+  common_proto->set_trainer_num(1);
+  common_proto->set_sync(false);
+  common_proto->set_entry("none");
+  common_proto->add_params("Param");
+  common_proto->add_dims(kEmbDim);
+  common_proto->add_initializers("fill_constant&1.0");
+  common_proto->add_params("LearningRate");
+  common_proto->add_dims(1);
+  common_proto->add_initializers("fill_constant&1.0");
+}
+
+static PSParameter GetProto(bool is_worker) {
+  PSParameter fleet_desc;
+  if (is_worker) {
+    GetSparseTableProto(fleet_desc.mutable_worker_param()
+                            ->mutable_downpour_worker_param()
+                            ->add_downpour_table_param());
+  }
+  DownpourServerParameter* downpour_server_proto =
+      fleet_desc.mutable_server_param()->mutable_downpour_server_param();
+  ServerServiceParameter* server_service_proto =
+      downpour_server_proto->mutable_service_param();
+  server_service_proto->set_service_class("BrpcPsService");
+  server_service_proto->set_server_class("BrpcPsServer");
+  server_service_proto->set_client_class("BrpcPsClient");
+  server_service_proto->set_start_server_port(0);
+  server_service_proto->set_server_thread_num(12);
+  GetSparseTableProto(downpour_server_proto->add_downpour_table_param());
+  return fleet_desc;
+}
+
+// The client is set up by configure alone, as the fleet runtime does, with
+// no client2client connection.
+TEST(BrpcPsShm, ConfigureOnly) {
+  setenv("http_proxy", "", 1);
+  setenv("https_proxy", "", 1);
+  std::string ip = "127.0.0.1";
+  uint32_t port = 4239;
+  FLAGS_pserver_shm_endpoints = ip + ":" + std::to_string(port);
+  std::vector<std::string> host_sign_list = {
+      PSHost(ip, port, 0).serialize_to_string()};
+
+  std::shared_ptr<PSServer> server;
+  std::thread server_thread([&]() {
+    auto server_proto = GetProto(false);
+    PaddlePSEnvironment env;
+    env.set_ps_servers(&host_sign_list, 1);
+    server.reset(PSServerFactory::create(server_proto));
+    std::vector<framework::ProgramDesc> empty_vec;
+    empty_vec.push_back(framework::ProgramDesc());
+    server->configure(server_proto, env, 0, empty_vec);
+    server->start(ip, port);
+  });
+  sleep(1);
+  ASSERT_NE(PsShmChannel::Open(ip, port), nullptr);
+
+  auto worker_proto = GetProto(true);
+  PaddlePSEnvironment env;
+  env.set_ps_servers(&host_sign_list, 1);
+  std::map<uint64_t, std::vector<Region>> dense_regions;
+  dense_regions[0] = {};
+  std::shared_ptr<PSClient> client(PSClientFactory::create(worker_proto));
+  ASSERT_EQ(client->configure(worker_proto, dense_regions, env, 0), 0);
+
+  size_t num = 100;
+  std::vector<uint64_t> keys(num);
+  std::vector<float> values(num * kEmbDim);
+  std::vector<float> grads(num * kEmbDim, 0.25);
+  std::vector<float*> value_ptrs(num);
+  std::vector<const float*> grad_ptrs(num);
+  for (size_t i = 0; i < num; ++i) {
+    keys[i] = i * 7919;
+    value_ptrs[i] = values.data() + i * kEmbDim;
+    grad_ptrs[i] = grads.data() + i * kEmbDim;
+  }
+
+  auto pull_status =
+      client->pull_sparse(value_ptrs.data(), 0, keys.data(), num, true);
+  pull_status.wait();
+  EXPECT_EQ(pull_status.get(), 0);
+  EXPECT_EQ(values, std::vector<float>(num * kEmbDim, 1.0));
+
+  auto* closure = new DownpourBrpcClosure(1, [](void* done) {
+    auto* closure = reinterpret_cast<DownpourBrpcClosure*>(done);
+    closure->set_promise_value(
+        closure->check_response(0, PS_PUSH_SPARSE_TABLE));
+  });
+  auto push_status = client->push_sparse_raw_gradient(
+      0, keys.data(), grad_ptrs.data(), num, closure);
+  push_status.wait();
+  EXPECT_EQ(push_status.get(), 0);
+
+  pull_status =
+      client->pull_sparse(value_ptrs.data(), 0, keys.data(), num, true);
+  pull_status.wait();
+  EXPECT_EQ(pull_status.get(), 0);
+  EXPECT_EQ(values, std::vector<float>(num * kEmbDim, 0.75));
+
+  client->stop_server();
+  client->finalize_worker();
+  server_thread.join();
+  FLAGS_pserver_shm_endpoints = "";
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -13,12 +13,15 @@ See the License for the specific language governing permissions and
 limitations under the License. */
 
 #include <string>
+#include <vector>
 
 #include "gtest/gtest.h"
 
 #include "paddle/fluid/distributed/service/brpc_utils.h"
 #include "paddle/fluid/operators/math/math_function.h"
 
+DECLARE_int64(pserver_zero_copy_min_bytes);
+
 namespace paddle {
 namespace framework {
 class Variable;
@@ -130,6 +133,75 @@ TEST(MultiVarMsgCPU, Run) {
   RunMultiVarMsg(place);
 }
 
+TEST(MultiVarMsgCPU, ZeroCopy) {
+  platform::CPUPlace place;
+  platform::DeviceContextPool& pool = platform::DeviceContextPool::Instance();
+  auto& ctx = *pool.Get(place);
+  framework::Scope scope;
+  auto* tensor = scope.Var("x")->GetMutable<framework::LoDTensor>();
+  tensor->Resize(framework::make_ddim({1024}));
+  tensor->mutable_data<float>(place);
+  math::set_constant(ctx, tensor, 1.5);
+  std::vector<std::string> send_var_name = {"x"};
+  std::vector<std::string> recv_var_name = {};
+
+  // the payload sent from a scope of the call references the tensor,
+  // received in this process it is copied as the tensor is still the sender's
+  ::paddle::distributed::MultiVariableMessage multi_msg;
+  butil::IOBuf io_buf;
+  distributed::SerializeToMultiVarMsgAndIOBuf("zero_copy_test", send_var_name,
+                                              recv_var_name, ctx, &scope,
+                                              &multi_msg, &io_buf, true);
+  ASSERT_EQ(io_buf.backing_block_num(), 2);
+  EXPECT_EQ(io_buf.backing_block(1).data(),
+            reinterpret_cast<const char*>(tensor->data<float>()));
+  framework::Scope scope_recv;
+  distributed::DeserializeFromMultiVarMsgAndIOBuf(multi_msg, &io_buf, ctx,
+                                                  &scope_recv);
+  auto* recv = scope_recv.FindVar("x")->GetMutable<framework::LoDTensor>();
+  EXPECT_NE(recv->data<float>(), tensor->data<float>());
+  EXPECT_EQ(std::vector<float>(recv->data<float>(), recv->data<float>() + 1024),
+            std::vector<float>(1024, 1.5));
+
+  // copied from a scope others may write, from a parent scope, or when the
+  // memory is shared by tensors, now both x and y
+  auto* shared = scope.Var("y")->GetMutable<framework::LoDTensor>();
+  shared->ShareDataWith(*tensor);
+  auto& child = scope.NewScope();
+  for (auto& name : {"x", "y"}) {
+    for (auto* from : {&scope, &child}) {
+      for (bool exclusive : {false, true}) {
+        ::paddle::distributed::MultiVariableMessage msg;
+        butil::IOBuf buf;
+        distributed::SerializeToMultiVarMsgAndIOBuf(
+            "zero_copy_test", {name}, recv_var_name, ctx, from, &msg, &buf,
+            exclusive);
+        EXPECT_EQ(buf.backing_block_num(), 1) << name << " " << exclusive;
+      }
+    }
+  }
+  scope.DeleteScope(&child);
+
+  // a payload copied into one block is taken by the tensor received
+  FLAGS_pserver_zero_copy_min_bytes = -1;
+  ::paddle::distributed::MultiVariableMessage copied_msg;
+  butil::IOBuf copied_buf;
+  distributed::SerializeToMultiVarMsgAndIOBuf("zero_copy_test", send_var_name,
+                                              recv_var_name, ctx, &scope,
+                                              &copied_msg, &copied_buf);
+  ASSERT_EQ(copied_buf.backing_block_num(), 1);
+  FLAGS_pserver_zero_copy_min_bytes = 4096;
+  framework::Scope scope_adopt;
+  distributed::DeserializeFromMultiVarMsgAndIOBuf(copied_msg, &copied_buf, ctx,
+                                                  &scope_adopt);
+  auto* adopted = scope_adopt.FindVar("x")->GetMutable<framework::LoDTensor>();
+  EXPECT_EQ(reinterpret_cast<const char*>(adopted->data<float>()),
+            copied_buf.backing_block(0).data() + 8);
+  EXPECT_EQ(std::vector<float>(adopted->data<float>(),
+                               adopted->data<float>() + 1024),
+            std::vector<float>(1024, 1.5));
+}
+
 // #ifdef PADDLE_WITH_CUDA
 // TEST(MultiVarMsgGPU, Run) {
 //   platform::CUDAPlace place;
@@ -0,0 +1,205 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "glog/logging.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/common/gradient_codec.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/tensor_accessor.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(GradientCodec, RoundTrip) {
+  std::vector<float> values = {0.5, -1.25, 3.0, 0.001, -0.75};
+  size_t dim = values.size();
+  EXPECT_EQ(GradientCompressedSize(GRADIENT_COMPRESS_NONE, dim, dim),
+            dim * sizeof(float));
+  EXPECT_EQ(GradientCompressedSize(GRADIENT_COMPRESS_FP16, dim, dim), dim * 2);
+  EXPECT_EQ(GradientCompressedSize(GRADIENT_COMPRESS_INT8, dim, dim), dim + 4);
+  // 2 rows of 2 values and a row of 1
+  EXPECT_EQ(GradientCompressedSize(GRADIENT_COMPRESS_INT8, dim, 2), 5 + 12);
+
+  for (auto type : {GRADIENT_COMPRESS_NONE, GRADIENT_COMPRESS_FP16,
+                    GRADIENT_COMPRESS_INT8}) {
+    std::vector<char> data(GradientCompressedSize(type, dim, 2));
+    CompressGradient(type, values.data(), dim, 2, nullptr, data.data());
+    std::vector<float> res(dim);
+    DecompressGradient(type, data.data(), dim, 2, res.data());
+    for (size_t i = 0; i < dim; ++i) {
+      float bound = type == GRADIENT_COMPRESS_INT8 ? 3.0 / 127 / 2 + 1e-6
+                                                   : std::fabs(values[i]) / 512;
+      EXPECT_NEAR(res[i], values[i], bound) << type << " " << i;
+    }
+  }
+  EXPECT_EQ(ParseGradientCompressType("int8"), GRADIENT_COMPRESS_INT8);
+  EXPECT_EQ(ParseGradientCompressType(""), GRADIENT_COMPRESS_NONE);
+}
+
+TEST(GradientCodec, ErrorFeedback) {
+  // the small value is under half a step of int8, lost at every push without
+  // the residual
+  std::vector<float> values = {1.0, 0.001};
+  std::vector<float> residual(2, 0);
+  std::vector<char> data(GradientCompressedSize(GRADIENT_COMPRESS_INT8, 2, 2));
+  std::vector<float> res(2);
+  float sum = 0, sum_without_residual = 0;
+  for (int step = 0; step < 1000; ++step) {
+    CompressGradientRow(GRADIENT_COMPRESS_INT8, values.data(), 2,
+                        residual.data(), data.data());
+    DecompressGradientRow(GRADIENT_COMPRESS_INT8, data.data(), 2, res.data());
+    sum += res[1];
+    CompressGradientRow(GRADIENT_COMPRESS_INT8, values.data(), 2, nullptr,
+                        data.data());
+    DecompressGradientRow(GRADIENT_COMPRESS_INT8, data.data(), 2, res.data());
+    sum_without_residual += res[1];
+  }
+  EXPECT_EQ(sum_without_residual, 0);
+  // what is pushed and what is kept add up to the gradients
+  EXPECT_NEAR(sum + residual[1], 1.0, 1e-4);
+  EXPECT_LT(std::fabs(residual[1]), 1.0 / 127);
+}
+
+// Trainers push the compressed gradients of a noisy quadratic to a dense
+// table through CommMergeAccessor, as the server decompresses them. Returns
+// the loss at the end and the bytes pushed.
+static float TrainDense(GradientCompressType type, bool error_feedback,
+                        size_t* bytes) {
+  const size_t trainer_num = 4, dim = 3000, steps = 300;
+  const float lr = 0.1;
+  TableAccessorParameter config;
+  config.set_accessor_class("CommMergeAccessor");
+  CommMergeAccessor accessor;
+  accessor.configure(config);
+
+  std::mt19937 rng(7);
+  std::normal_distribution<float> normal(0, 1);
+  // the curvature of half of the values is 100 times lower
+  std::vector<float> target(dim), curvature(dim);
+  for (size_t i = 0; i < dim; ++i) {
+    target[i] = normal(rng);
+    curvature[i] = i % 2 ? 1.0 : 0.01;
+  }
+  std::vector<float> w(dim, 0), grad(dim), update(dim), sum(dim);
+  std::vector<std::vector<float>> residuals(trainer_num,
+                                            std::vector<float>(dim, 0));
+  size_t data_size = GradientCompressedSize(type, dim, kDenseGradientRowSize);
+  std::vector<char> data(data_size);
+  *bytes = 0;
+  for (size_t step = 0; step < steps; ++step) {
+    std::fill(sum.begin(), sum.end(), 0);
+    for (size_t t = 0; t < trainer_num; ++t) {
+      for (size_t i = 0; i < dim; ++i) {
+        grad[i] = curvature[i] * (w[i] - target[i]) + 0.01 * normal(rng);
+      }
+      CompressGradient(type, grad.data(), dim, kDenseGradientRowSize,
+                       error_feedback ? residuals[t].data() : nullptr,
+                       data.data());
+      *bytes += data_size;
+      EXPECT_EQ(accessor.decompress_dense_update(type, data.data(), data_size,
+                                                 dim, update.data()),
+                0);
+      for (size_t i = 0; i < dim; ++i) {
+        sum[i] += update[i];
+      }
+    }
+    for (size_t i = 0; i < dim; ++i) {
+      w[i] -= lr * sum[i] / trainer_num;
+    }
+  }
+  float loss = 0;
+  for (size_t i = 0; i < dim; ++i) {
+    loss += curvature[i] * (w[i] - target[i]) * (w[i] - target[i]) / 2;
+  }
+  return loss / dim;
+}
+
+TEST(GradientCodec, DenseConvergence) {
+  size_t fp32_bytes, fp16_bytes, int8_bytes, int8_no_ef_bytes;
+  float fp32_loss = TrainDense(GRADIENT_COMPRESS_NONE, true, &fp32_bytes);
+  float fp16_loss = TrainDense(GRADIENT_COMPRESS_FP16, true, &fp16_bytes);
+  float int8_loss = TrainDense(GRADIENT_COMPRESS_INT8, true, &int8_bytes);
+  float int8_no_ef_loss =
+      TrainDense(GRADIENT_COMPRESS_INT8, false, &int8_no_ef_bytes);
+  LOG(INFO) << "fp32 loss " << fp32_loss << " bytes " << fp32_bytes;
+  LOG(INFO) << "fp16 loss " << fp16_loss << " bytes " << fp16_bytes;
+  LOG(INFO) << "int8 loss " << int8_loss << " bytes " << int8_bytes;
+  LOG(INFO) << "int8 without error feedback loss " << int8_no_ef_loss;
+
+  EXPECT_EQ(fp16_bytes * 2, fp32_bytes);
+  EXPECT_LT(int8_bytes * 3.9, fp32_bytes);
+  EXPECT_NEAR(fp16_loss, fp32_loss, fp32_loss * 0.05);
+  EXPECT_NEAR(int8_loss, fp32_loss, fp32_loss * 0.2);
+}
+
+TEST(GradientCodec, SparseAccessor) {
+  TableAccessorParameter config;
+  config.set_accessor_class("CommMergeAccessor");
+  config.set_embedx_dim(3);
+  config.set_gradient_compress_type("fp16");
+  CommMergeAccessor accessor;
+  accessor.configure(config);
+  EXPECT_EQ(accessor.gradient_compress_type(), GRADIENT_COMPRESS_FP16);
+
+  // 2 keys of update_dim values
+  std::vector<float> values = {1, 2, 3, -4, 5, 0.5};
+  std::vector<char> data(GradientCompressedSize(GRADIENT_COMPRESS_FP16, 6, 3));
+  CompressGradient(GRADIENT_COMPRESS_FP16, values.data(), 6, 3, nullptr,
+                   data.data());
+  std::vector<float> res(6);
+  EXPECT_EQ(accessor.decompress_update(GRADIENT_COMPRESS_FP16, data.data(),
+                                       data.size(), 2, res.data()),
+            0);
+  EXPECT_EQ(res, values);
+  EXPECT_NE(accessor.decompress_update(GRADIENT_COMPRESS_FP16, data.data(),
+                                       data.size() - 1, 2, res.data()),
+            0);
+}
+
+TEST(GradientCodec, SparseResidual) {
+  SparseGradientResidual residual(2, 1e-6);
+  std::vector<float> values = {1.0, 0.001};
+  std::vector<char> data(GradientCompressedSize(GRADIENT_COMPRESS_INT8, 2, 2));
+  for (uint64_t key : {1, 2, 3}) {
+    residual.CompressRow(GRADIENT_COMPRESS_INT8, key, values.data(), 2,
+                         data.data());
+  }
+  // the least recently pushed is dropped
+  EXPECT_EQ(residual.size(), 2);
+  EXPECT_EQ(residual.Find(1), nullptr);
+  ASSERT_NE(residual.Find(2), nullptr);
+  EXPECT_NEAR((*residual.Find(2))[1], 0.001, 1e-6);
+  residual.CompressRow(GRADIENT_COMPRESS_INT8, 2, values.data(), 2,
+                       data.data());
+  residual.CompressRow(GRADIENT_COMPRESS_INT8, 4, values.data(), 2,
+                       data.data());
+  EXPECT_EQ(residual.Find(3), nullptr);
+  ASSERT_NE(residual.Find(2), nullptr);
+  EXPECT_NEAR((*residual.Find(2))[1], 0.002, 1e-6);
+
+  // exact in fp16, nothing left to keep
+  std::vector<float> exact = {0.5, -2.0};
+  residual.CompressRow(GRADIENT_COMPRESS_FP16, 5, exact.data(), 2,
+                       data.data());
+  EXPECT_EQ(residual.Find(5), nullptr);
+  EXPECT_EQ(residual.size(), 2);
+}
+
+}  // namespace distributed
+}  // namespace paddle
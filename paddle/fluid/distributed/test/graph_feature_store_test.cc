@@ -0,0 +1,140 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/common_graph_table.h"
+#include "paddle/fluid/distributed/table/graph/graph_feature_store.h"
+
+namespace paddle {
+namespace distributed {
+
+TEST(GraphFeatureStore, Columns) {
+  GraphFeatureStore store;
+  store.init({"float32", "string", "int64"}, {3, 1, 2});
+  EXPECT_TRUE(store.is_numeric(0));
+  EXPECT_FALSE(store.is_numeric(1));
+
+  store.set_feature(7, 0, FeatureNode::parse_value_to_bytes<float>(
+                              {"0.5", "1.5", "2.5", "3.5"}));
+  store.set_feature(7, 1, "hello");
+  store.add_node(9);
+  store.set_feature(9, 2, FeatureNode::parse_value_to_bytes<int64_t>({"-4"}));
+  EXPECT_EQ(store.node_size(), 2);
+
+  std::string feature;
+  store.get_feature(7, 1, &feature);
+  EXPECT_EQ(feature, "hello");
+  store.get_feature(9, 1, &feature);
+  EXPECT_EQ(feature, "");
+  store.get_feature(8, 1, &feature);
+  EXPECT_EQ(feature, "");
+
+  // truncated to the shape, padded with 0, converted
+  std::vector<float> floats(3, -1);
+  store.copy_feature(7, 0, floats.data());
+  EXPECT_EQ(floats, std::vector<float>({0.5, 1.5, 2.5}));
+  std::vector<int64_t> ints(3, -1);
+  store.copy_feature(7, 0, ints.data());
+  EXPECT_EQ(ints, std::vector<int64_t>({0, 1, 2}));
+  store.copy_feature(9, 2, floats.data());
+  // the shape of the column 2 is 2
+  EXPECT_EQ(floats, std::vector<float>({-4, 0, 2.5}));
+  store.copy_feature(8, 0, floats.data());
+  EXPECT_EQ(floats, std::vector<float>({0, 0, 0}));
+
+  // set again, shorter in place and longer appended
+  store.set_feature(7, 1, "hi");
+  store.get_feature(7, 1, &feature);
+  EXPECT_EQ(feature, "hi");
+  store.set_feature(7, 1, "hello world");
+  store.get_feature(7, 1, &feature);
+  EXPECT_EQ(feature, "hello world");
+
+  // the row of a node removed is reused, without its features
+  store.remove_node(7);
+  EXPECT_FALSE(store.has_node(7));
+  store.add_node(11);
+  EXPECT_EQ(store.node_size(), 2);
+  store.get_feature(11, 1, &feature);
+  EXPECT_EQ(feature, "");
+  store.clear();
+  EXPECT_EQ(store.node_size(), 0);
+  EXPECT_TRUE(store.is_numeric(0));
+}
+
+TEST(GraphTable, NodeFeatDense) {
+  std::string node_file = "/tmp/graph_feature_store_test_nodes.txt";
+  {
+    std::ofstream ofile(node_file);
+    ofile << "user\t1\ta 0.5 1.5\tb 7\tc x" << std::endl;
+    ofile << "user\t2\tb 8 9 10" << std::endl;
+    ofile << "user\t3\ta 2.5\tc yz" << std::endl;
+  }
+  TableParameter table_config;
+  table_config.set_table_class("GraphTable");
+  table_config.set_shard_num(7);
+  table_config.mutable_accessor()->set_accessor_class("CommMergeAccessor");
+  CommonAccessorParameter* common_config = table_config.mutable_common();
+  common_config->set_name("graph");
+  common_config->set_table_name("user");
+  std::vector<std::vector<std::string>> feat_confs = {
+      {"a", "float32", "2"}, {"b", "int64", "2"}, {"c", "string", "1"}};
+  for (auto& conf : feat_confs) {
+    common_config->add_attributes(conf[0]);
+    common_config->add_params(conf[1]);
+    common_config->add_dims(std::stoi(conf[2]));
+  }
+  FsClientParameter fs_config;
+  std::unique_ptr<GraphTable> table(new GraphTable());
+  table->set_shard(0, 1);
+  Table* base = table.get();
+  ASSERT_EQ(base->initialize(table_config, fs_config), 0);
+  table->load(node_file, "nuser");
+
+  std::vector<uint64_t> ids = {3, 4, 1, 2};
+  EXPECT_EQ(table->get_numeric_feat_shape("a"), 2);
+  EXPECT_EQ(table->get_numeric_feat_shape("c"), -1);
+  EXPECT_EQ(table->get_numeric_feat_shape("d"), -1);
+  std::vector<float> a(ids.size() * 2, -1);
+  ASSERT_EQ(table->get_node_feat_dense(ids, "a", a.data()), 0);
+  EXPECT_EQ(a, std::vector<float>({2.5, 0, 0, 0, 0.5, 1.5, 0, 0}));
+  std::vector<int64_t> b(ids.size() * 2, -1);
+  ASSERT_EQ(table->get_node_feat_dense(ids, "b", b.data()), 0);
+  EXPECT_EQ(b, std::vector<int64_t>({0, 0, 0, 0, 7, 0, 8, 9}));
+  EXPECT_NE(table->get_node_feat_dense(ids, "c", b.data()), 0);
+
+  // the bytes of the string API are the same as before
+  std::vector<std::vector<std::string>> res(
+      2, std::vector<std::string>(ids.size()));
+  table->get_node_feat(ids, {"c", "b"}, res);
+  EXPECT_EQ(res[0], std::vector<std::string>({"yz", "", "x", ""}));
+  EXPECT_EQ(res[1][3],
+            FeatureNode::parse_value_to_bytes<int64_t>({"8", "9", "10"}));
+
+  std::vector<uint64_t> removed = {1};
+  table->remove_graph_node(removed);
+  ASSERT_EQ(table->get_node_feat_dense(ids, "a", a.data()), 0);
+  EXPECT_EQ(a[4], 0);
+  std::remove(node_file.c_str());
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -558,6 +558,42 @@ void RunBrpcPushSparse() {
   VLOG(0) << "get_node_feat: " << node_feat[1][0];
   VLOG(0) << "get_node_feat: " << node_feat[1][1];
 
+  // Test sample subgraph, of seeds held by both servers
+  auto subgraph = client1.sample_subgraph(
+      std::string("user2item"), node_ids, std::vector<int>({4, 4}),
+      std::string("user"), std::vector<std::string>({std::string("c")}));
+  ASSERT_EQ(subgraph.node_size(), 8);
+  ASSERT_EQ(subgraph.edge_size(), 6);
+  ASSERT_EQ(subgraph.ids[0], 37);
+  ASSERT_EQ(subgraph.ids[1], 96);
+  std::unordered_set<uint64_t> subgraph_neighbors;
+  for (uint32_t i = subgraph.offsets[0]; i < subgraph.offsets[1]; ++i) {
+    subgraph_neighbors.insert(subgraph.ids[subgraph.neighbors[i]]);
+  }
+  ASSERT_EQ(subgraph_neighbors,
+            std::unordered_set<uint64_t>({45, 145, 112}));
+  ASSERT_EQ(subgraph.offsets[8], 6);
+  ASSERT_EQ(subgraph.features.size(), 1);
+  ASSERT_EQ(subgraph.features[0][0], node_feat[0][0]);
+  ASSERT_EQ(subgraph.features[0][1], node_feat[0][1]);
+  ASSERT_EQ(subgraph.features[0][2], std::string(""));
+
+  // Test get node feat into dense buffers
+  std::vector<float> dense_a(node_ids.size(), -1);
+  ASSERT_EQ(client1.get_node_feat_dense(std::string("user"), node_ids,
+                                        std::string("a"), 1, dense_a.data()),
+            0);
+  ASSERT_FLOAT_EQ(dense_a[0], 0.34);
+  ASSERT_FLOAT_EQ(dense_a[1], 0.31);
+  std::vector<int64_t> dense_b(node_ids.size() * 2, -1);
+  ASSERT_EQ(client1.get_node_feat_dense(std::string("user"), node_ids,
+                                        std::string("b"), 2, dense_b.data()),
+            0);
+  ASSERT_EQ(dense_b, std::vector<int64_t>({13, 14, 15, 10}));
+  ASSERT_NE(client1.get_node_feat_dense(std::string("user"), node_ids,
+                                        std::string("c"), 1, dense_a.data()),
+            0);
+
   // Test string
   node_ids.clear();
   node_ids.push_back(37);
@@ -0,0 +1,151 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/table/graph/graph_csr.h"
+#include "paddle/fluid/distributed/table/graph/graph_edge.h"
+#include "paddle/fluid/distributed/table/graph/graph_weighted_sampler.h"
+
+namespace paddle {
+namespace distributed {
+
+static void AddEdges(GraphEdgeBlob* edges, const std::vector<float>& weights) {
+  for (size_t i = 0; i < weights.size(); ++i) {
+    edges->add_edge(100 + i, weights[i]);
+  }
+}
+
+// The frequency of every index over the samples of rounds calls.
+static std::vector<double> Frequency(Sampler* sampler, int n, int k,
+                                     bool replace, int rounds) {
+  std::mt19937_64 rng(0);
+  std::vector<int> res;
+  std::vector<double> freq(n, 0);
+  for (int r = 0; r < rounds; ++r) {
+    sampler->sample_k(k, replace, &rng, &res);
+    EXPECT_EQ(static_cast<int>(res.size()), replace ? k : std::min(k, n));
+    if (!replace) {
+      EXPECT_EQ(std::set<int>(res.begin(), res.end()).size(), res.size());
+    }
+    for (int idx : res) {
+      EXPECT_GE(idx, 0);
+      EXPECT_LT(idx, n);
+      freq[idx] += 1.0 / rounds;
+    }
+  }
+  return freq;
+}
+
+TEST(WeightedSampler, WithReplacement) {
+  std::vector<float> weights = {1, 0, 2, 3, 4, 0, 10};
+  WeightedGraphEdgeBlob edges;
+  AddEdges(&edges, weights);
+  WeightedSampler sampler;
+  sampler.build(&edges);
+  auto freq = Frequency(&sampler, weights.size(), 5, true, 20000);
+  for (size_t i = 0; i < weights.size(); ++i) {
+    EXPECT_NEAR(freq[i] / 5, weights[i] / 20, 0.01);
+  }
+}
+
+TEST(WeightedSampler, WithoutReplacement) {
+  // one neighbor holds most of the weight, so that the rejections give way
+  // to the scan
+  std::vector<float> weights = {1, 0, 1, 1, 100, 1, 0, 1};
+  WeightedGraphEdgeBlob edges;
+  AddEdges(&edges, weights);
+  WeightedSampler sampler;
+  sampler.build(&edges);
+
+  auto freq = Frequency(&sampler, weights.size(), 1, false, 20000);
+  EXPECT_NEAR(freq[4], 100.0 / 105, 0.01);
+  EXPECT_EQ(freq[1], 0);
+  EXPECT_EQ(freq[6], 0);
+
+  // the five other neighbors of positive weight share the rest evenly
+  freq = Frequency(&sampler, weights.size(), 3, false, 20000);
+  EXPECT_NEAR(freq[4], 1, 0.01);
+  for (int i : {0, 2, 3, 5, 7}) {
+    EXPECT_NEAR(freq[i], 2.0 / 5, 0.03);
+  }
+  EXPECT_EQ(freq[1], 0);
+
+  // more than the neighbors of positive weight
+  std::mt19937_64 rng(0);
+  std::vector<int> res;
+  sampler.sample_k(7, false, &rng, &res);
+  EXPECT_EQ(std::set<int>(res.begin(), res.end()),
+            std::set<int>({0, 1, 2, 3, 4, 5, 7}));
+  sampler.sample_k(20, false, &rng, &res);
+  EXPECT_EQ(res.size(), weights.size());
+}
+
+TEST(WeightedSampler, Rebuild) {
+  WeightedGraphEdgeBlob edges;
+  AddEdges(&edges, {0, 0});
+  WeightedSampler sampler;
+  sampler.build(&edges);
+  // no weight at all, uniformly
+  auto freq = Frequency(&sampler, 2, 1, true, 10000);
+  EXPECT_NEAR(freq[0], 0.5, 0.03);
+
+  edges.add_edge(7, 1);
+  sampler.build(&edges);
+  freq = Frequency(&sampler, 3, 1, false, 1000);
+  EXPECT_NEAR(freq[2], 1, 1e-6);
+}
+
+TEST(RandomSampler, Uniform) {
+  GraphEdgeBlob edges;
+  AddEdges(&edges, std::vector<float>(10, 1));
+  RandomSampler sampler;
+  sampler.build(&edges);
+  auto freq = Frequency(&sampler, 10, 4, false, 20000);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_NEAR(freq[i], 0.4, 0.03);
+  }
+  freq = Frequency(&sampler, 10, 20, true, 2000);
+  for (int i = 0; i < 10; ++i) {
+    EXPECT_NEAR(freq[i], 2, 0.1);
+  }
+  auto res = sampler.sample_k(20, std::make_shared<std::mt19937_64>(0));
+  EXPECT_EQ(res, std::vector<int>({0, 1, 2, 3, 4, 5, 6, 7, 8, 9}));
+}
+
+TEST(GraphCsr, WithReplacement) {
+  std::vector<GraphCsrEdge> edges = {{1, 10, 1}, {1, 11, 0}, {1, 12, 3}};
+  GraphCsr csr;
+  csr.build(&edges, true);
+  std::mt19937_64 rng(0);
+  std::vector<int> res;
+  std::vector<int> count(3, 0);
+  for (int r = 0; r < 2000; ++r) {
+    csr.sample_k(0, 5, true, &rng, &res);
+    ASSERT_EQ(res.size(), 5);
+    for (int idx : res) {
+      ++count[idx];
+    }
+  }
+  EXPECT_EQ(count[1], 0);
+  EXPECT_NEAR(count[2] / 10000.0, 0.75, 0.02);
+}
+
+}  // namespace distributed
+}  // namespace paddle
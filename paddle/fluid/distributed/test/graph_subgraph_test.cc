@@ -0,0 +1,112 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/table/graph/graph_subgraph.h"
+
+namespace paddle {
+namespace distributed {
+
+// 1 -> 2, 3; 2 -> 3, 4; 3 -> 1; 4 -> 5, and the nodes asked for per call
+static GraphSampleFunc FakeSampleFunc(
+    std::vector<std::vector<uint64_t>>* calls) {
+  return [calls](const std::vector<uint64_t>& ids, int sample_size,
+                 std::vector<std::vector<std::pair<uint64_t, float>>>* res) {
+    static const std::map<uint64_t, std::vector<uint64_t>> graph = {
+        {1, {2, 3}}, {2, {3, 4}}, {3, {1}}, {4, {5}}};
+    calls->push_back(ids);
+    res->assign(ids.size(), std::vector<std::pair<uint64_t, float>>());
+    for (size_t i = 0; i < ids.size(); ++i) {
+      auto iter = graph.find(ids[i]);
+      if (iter == graph.end()) {
+        continue;
+      }
+      for (size_t j = 0; j < iter->second.size() && j < sample_size; ++j) {
+        (*res)[i].push_back({iter->second[j], ids[i] + 0.5f});
+      }
+    }
+    return 0;
+  };
+}
+
+TEST(GraphSubgraph, Sample) {
+  std::vector<std::vector<uint64_t>> calls;
+  GraphSubgraph subgraph;
+  ASSERT_EQ(subgraph.sample({1, 3, 1}, {2, 1}, FakeSampleFunc(&calls)), 0);
+
+  // the seeds once, then the nodes in the order they are reached
+  EXPECT_EQ(subgraph.ids, std::vector<uint64_t>({1, 3, 2}));
+  EXPECT_EQ(calls, std::vector<std::vector<uint64_t>>({{1, 3}, {2}}));
+  EXPECT_EQ(subgraph.offsets, std::vector<uint32_t>({0, 2, 3, 4}));
+  EXPECT_EQ(subgraph.neighbors, std::vector<uint32_t>({2, 1, 0, 1}));
+  EXPECT_EQ(subgraph.weights, std::vector<float>({1.5, 1.5, 3.5, 2.5}));
+  EXPECT_EQ(subgraph.find(2), 2);
+  EXPECT_EQ(subgraph.find(4), -1);
+
+  // the nodes of the last hop are not asked for
+  calls.clear();
+  ASSERT_EQ(subgraph.sample({4}, {2, 2, 2}, FakeSampleFunc(&calls)), 0);
+  EXPECT_EQ(calls, std::vector<std::vector<uint64_t>>({{4}, {5}}));
+  EXPECT_EQ(subgraph.node_size(), 2);
+  EXPECT_EQ(subgraph.offsets, std::vector<uint32_t>({0, 1, 1}));
+
+  auto failed = [](const std::vector<uint64_t>& ids, int sample_size,
+                   std::vector<std::vector<std::pair<uint64_t, float>>>* res) {
+    return -1;
+  };
+  EXPECT_NE(subgraph.sample({1}, {2}, failed), 0);
+  EXPECT_EQ(subgraph.node_size(), 0);
+}
+
+TEST(GraphSubgraph, Buffer) {
+  std::vector<std::vector<uint64_t>> calls;
+  GraphSubgraph subgraph;
+  ASSERT_EQ(subgraph.sample({1}, {2, 2}, FakeSampleFunc(&calls)), 0);
+  subgraph.features = {{"a", "", "ccc", "dd"}, {"x", "y", "z", std::string()}};
+
+  size_t size = subgraph.get_size();
+  std::unique_ptr<char[]> buffer(new char[size]);
+  subgraph.to_buffer(buffer.get());
+
+  GraphSubgraph res;
+  ASSERT_EQ(res.from_buffer(buffer.get(), size), 0);
+  EXPECT_EQ(res.ids, subgraph.ids);
+  EXPECT_EQ(res.offsets, subgraph.offsets);
+  EXPECT_EQ(res.neighbors, subgraph.neighbors);
+  EXPECT_EQ(res.weights, subgraph.weights);
+  EXPECT_EQ(res.features, subgraph.features);
+  EXPECT_EQ(res.find(3), subgraph.find(3));
+
+  for (size_t truncated : {size_t(0), size_t(5), size / 2, size - 1}) {
+    EXPECT_NE(res.from_buffer(buffer.get(), truncated), 0);
+    EXPECT_EQ(res.node_size(), 0);
+  }
+
+  GraphSubgraph empty;
+  size = empty.get_size();
+  buffer.reset(new char[size]);
+  empty.to_buffer(buffer.get());
+  ASSERT_EQ(res.from_buffer(buffer.get(), size), 0);
+  EXPECT_EQ(res.node_size(), 0);
+  EXPECT_EQ(res.offsets, std::vector<uint32_t>({0}));
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,138 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// Measures the memory per edge and the neighbor sampling throughput of a
+// GraphTable loaded as nodes and as CSR, e.g.
+//   ./graph_table_csr_benchmark --nodes=1000000 --degree=20 --csr=true
+// Run it once per mode, the resident memory of a process does not shrink.
+
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/common_graph_table.h"
+
+DEFINE_int32(nodes, 1000000, "number of source nodes");
+DEFINE_int32(degree, 20, "average number of neighbors of a node");
+DEFINE_bool(weighted, true, "whether the edges have weights");
+DEFINE_bool(csr, true, "whether to load the edges as CSR");
+DEFINE_int32(sample_size, 10, "number of neighbors sampled of a node");
+DEFINE_int32(batch_size, 1000, "number of nodes of a sampling request");
+DEFINE_int32(batches, 1000, "number of sampling requests");
+DEFINE_string(edge_file, "/tmp/graph_table_csr_benchmark_edges.txt",
+              "the edge file, generated if it does not exist");
+DECLARE_bool(pserver_graph_table_csr);
+
+namespace paddle {
+namespace distributed {
+
+static double ResidentMB() {
+  std::ifstream statm("/proc/self/statm");
+  size_t size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+static void GenerateEdges() {
+  if (std::ifstream(FLAGS_edge_file).good()) {
+    return;
+  }
+  std::ofstream ofile(FLAGS_edge_file);
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<int> degree(1, 2 * FLAGS_degree - 1);
+  std::uniform_int_distribution<uint64_t> dst(0, 10ULL * FLAGS_nodes);
+  std::uniform_real_distribution<float> weight(0.1, 10);
+  for (int src = 0; src < FLAGS_nodes; ++src) {
+    for (int i = degree(rng); i > 0; --i) {
+      ofile << src << "\t" << dst(rng);
+      if (FLAGS_weighted) {
+        ofile << "\t" << weight(rng);
+      }
+      ofile << "\n";
+    }
+  }
+}
+
+static void Run() {
+  GenerateEdges();
+  FLAGS_pserver_graph_table_csr = FLAGS_csr;
+  TableParameter table_config;
+  table_config.set_table_class("GraphTable");
+  table_config.set_shard_num(127);
+  table_config.mutable_accessor()->set_accessor_class("CommMergeAccessor");
+  table_config.mutable_common()->set_name("graph");
+  table_config.mutable_common()->set_table_name("benchmark");
+  FsClientParameter fs_config;
+  std::unique_ptr<GraphTable> table(new GraphTable());
+  table->set_shard(0, 1);
+  Table* base = table.get();
+  base->initialize(table_config, fs_config);
+
+  double base_mb = ResidentMB();
+  auto begin = GetCurrentUS();
+  table->load(FLAGS_edge_file, "e>");
+  double load_s = (GetCurrentUS() - begin) / 1e+6;
+  double table_mb = ResidentMB() - base_mb;
+
+  std::vector<uint64_t> all_ids;
+  table->get_nodes_ids_by_ranges({{0, FLAGS_nodes}}, all_ids);
+  size_t edge_num = 0;
+  std::ifstream edge_file(FLAGS_edge_file);
+  for (std::string line; std::getline(edge_file, line);) {
+    ++edge_num;
+  }
+
+  std::mt19937_64 rng(1);
+  std::uniform_int_distribution<size_t> pick(0, all_ids.size() - 1);
+  std::vector<uint64_t> ids(FLAGS_batch_size);
+  std::vector<std::unique_ptr<char[]>> buffers(FLAGS_batch_size);
+  std::vector<int> actual_sizes(FLAGS_batch_size);
+  double sample_s = 0;
+  for (int x = 0; x < FLAGS_batches; ++x) {
+    for (auto& id : ids) {
+      id = all_ids[pick(rng)];
+    }
+    begin = GetCurrentUS();
+    table->random_sample_neighboors(ids.data(), FLAGS_sample_size, buffers,
+                                    actual_sizes);
+    sample_s += (GetCurrentUS() - begin) / 1e+6;
+  }
+
+  std::cout << (FLAGS_csr ? "csr" : "nodes") << ": " << all_ids.size()
+            << " nodes, " << edge_num << " edges, loaded in " << load_s
+            << "s" << std::endl;
+  std::cout << "resident memory " << table_mb << " MB, "
+            << table_mb * 1048576.0 / edge_num << " bytes per edge"
+            << std::endl;
+  std::cout << "sampled " << FLAGS_batches * FLAGS_batch_size << " nodes in "
+            << sample_s << "s, "
+            << FLAGS_batches * FLAGS_batch_size / sample_s << " nodes/s"
+            << std::endl;
+}
+
+}  // namespace distributed
+}  // namespace paddle
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  paddle::distributed::Run();
+  return 0;
+}
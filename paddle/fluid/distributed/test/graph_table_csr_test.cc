@@ -0,0 +1,192 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/common_graph_table.h"
+#include "paddle/fluid/distributed/table/graph/graph_csr.h"
+
+DECLARE_bool(pserver_graph_table_csr);
+
+namespace paddle {
+namespace distributed {
+
+static void WriteFile(const std::string& file_name,
+                      const std::vector<std::string>& lines) {
+  std::ofstream ofile(file_name);
+  for (auto& line : lines) {
+    ofile << line << std::endl;
+  }
+}
+
+static std::unique_ptr<GraphTable> CreateGraphTable(bool csr) {
+  FLAGS_pserver_graph_table_csr = csr;
+  TableParameter table_config;
+  table_config.set_table_class("GraphTable");
+  table_config.set_shard_num(7);
+  table_config.mutable_accessor()->set_accessor_class("CommMergeAccessor");
+  CommonAccessorParameter* common_config = table_config.mutable_common();
+  common_config->set_name("graph");
+  common_config->set_table_name("user2item");
+  common_config->add_attributes("a");
+  common_config->add_params("float32");
+  common_config->add_dims(1);
+  FsClientParameter fs_config;
+  std::unique_ptr<GraphTable> table(new GraphTable());
+  table->set_shard(0, 1);
+  Table* base = table.get();
+  EXPECT_EQ(base->initialize(table_config, fs_config), 0);
+  return table;
+}
+
+// node id -> its neighbors and weights as sampled with a large sample size,
+// which returns all of them in the order they are stored
+static std::map<uint64_t, std::vector<std::pair<uint64_t, float>>>
+SampleAll(GraphTable* table, std::vector<uint64_t> ids) {
+  std::vector<std::unique_ptr<char[]>> buffers(ids.size());
+  std::vector<int> actual_sizes(ids.size(), 0);
+  table->random_sample_neighboors(ids.data(), 100, buffers, actual_sizes);
+  std::map<uint64_t, std::vector<std::pair<uint64_t, float>>> res;
+  int unit = Node::id_size + Node::weight_size;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    auto& neighbors = res[ids[i]];
+    for (int offset = 0; offset < actual_sizes[i]; offset += unit) {
+      uint64_t id;
+      float weight;
+      memcpy(&id, buffers[i].get() + offset, Node::id_size);
+      memcpy(&weight, buffers[i].get() + offset + Node::id_size,
+             Node::weight_size);
+      neighbors.emplace_back(id, weight);
+    }
+  }
+  return res;
+}
+
+static std::set<uint64_t> AllIds(GraphTable* table) {
+  std::vector<uint64_t> ids;
+  table->get_nodes_ids_by_ranges({{0, 1000}}, ids);
+  return std::set<uint64_t>(ids.begin(), ids.end());
+}
+
+TEST(GraphTableCsr, SameAsNodes) {
+  std::string edge_file = "/tmp/graph_table_csr_test_edges.txt";
+  std::string more_edge_file = "/tmp/graph_table_csr_test_more_edges.txt";
+  std::string node_file = "/tmp/graph_table_csr_test_nodes.txt";
+  std::vector<std::string> edges;
+  for (uint64_t src = 0; src < 50; ++src) {
+    for (uint64_t dst = 0; dst < src % 9; ++dst) {
+      edges.push_back(std::to_string(src) + "\t" +
+                      std::to_string(src * 100 + dst) + "\t" +
+                      std::to_string(0.5 + dst));
+    }
+  }
+  WriteFile(edge_file, edges);
+  WriteFile(more_edge_file, {"3\t999\t2.5", "1000\t1\t1.5"});
+  WriteFile(node_file, {"user\t2000\ta 0.9", "user\t3000\ta 0.7"});
+
+  std::vector<uint64_t> ids;
+  for (uint64_t id = 0; id < 50; ++id) {
+    ids.push_back(id);
+  }
+  ids.push_back(1000);
+  ids.push_back(2000);
+  ids.push_back(3000);
+
+  auto node_table = CreateGraphTable(false);
+  auto csr_table = CreateGraphTable(true);
+  for (auto* table : {node_table.get(), csr_table.get()}) {
+    // the nodes of features stay out of the csr, which the second file of
+    // edges extends
+    ASSERT_EQ(table->load(node_file, "nuser"), 0);
+    ASSERT_EQ(table->load(edge_file, "e>"), 0);
+    ASSERT_EQ(table->load(more_edge_file, "e>"), 0);
+  }
+
+  EXPECT_EQ(SampleAll(node_table.get(), ids), SampleAll(csr_table.get(), ids));
+  auto csr_ids = AllIds(csr_table.get());
+  EXPECT_EQ(AllIds(node_table.get()), csr_ids);
+  EXPECT_EQ(csr_ids.count(1000), 1);
+  EXPECT_EQ(csr_ids.count(2000), 1);
+  EXPECT_EQ(csr_ids.count(0), 0);
+
+  std::vector<std::vector<std::string>> node_feats(1), csr_feats(1);
+  node_feats[0].resize(ids.size());
+  csr_feats[0].resize(ids.size());
+  node_table->get_node_feat(ids, {"a"}, node_feats);
+  csr_table->get_node_feat(ids, {"a"}, csr_feats);
+  EXPECT_EQ(node_feats, csr_feats);
+  EXPECT_EQ(FeatureNode::parse_bytes_to_array<float>(csr_feats[0][51]),
+            std::vector<float>{0.9f});
+
+  std::unique_ptr<char[]> node_buffer, csr_buffer;
+  int node_size = 0, csr_size = 0;
+  node_table->pull_graph_list(0, 1000, node_buffer, node_size, true, 1);
+  csr_table->pull_graph_list(0, 1000, csr_buffer, csr_size, true, 1);
+  EXPECT_EQ(node_size, csr_size);
+
+  // sampling fewer neighbors than the degree, the weights are kept
+  std::vector<uint64_t> one_id = {8};
+  std::vector<std::unique_ptr<char[]>> buffers(1);
+  std::vector<int> actual_sizes(1);
+  csr_table->random_sample_neighboors(one_id.data(), 3, buffers, actual_sizes);
+  ASSERT_EQ(actual_sizes[0], 3 * (Node::id_size + Node::weight_size));
+  std::set<uint64_t> sampled;
+  for (int i = 0; i < 3; ++i) {
+    uint64_t id;
+    memcpy(&id, buffers[0].get() + i * (Node::id_size + Node::weight_size),
+           Node::id_size);
+    EXPECT_GE(id, 800);
+    EXPECT_LT(id, 808);
+    sampled.insert(id);
+  }
+  EXPECT_EQ(sampled.size(), 3);
+  FLAGS_pserver_graph_table_csr = false;
+}
+
+TEST(GraphCsr, WeightedSample) {
+  std::vector<GraphCsrEdge> edges = {
+      {1, 10, 1}, {1, 11, 0}, {1, 12, 3}, {2, 20, 1}};
+  GraphCsr csr;
+  csr.build(&edges, true);
+  EXPECT_TRUE(edges.empty());
+  EXPECT_EQ(csr.node_size(), 2);
+  EXPECT_EQ(csr.edge_size(), 4);
+  EXPECT_EQ(csr.find(3), -1);
+  int64_t pos = csr.find(1);
+  ASSERT_EQ(pos, 0);
+
+  auto rng = std::make_shared<std::mt19937_64>(0);
+  std::vector<int> count(3, 0);
+  for (int i = 0; i < 4000; ++i) {
+    auto res = csr.sample_k(pos, 1, rng);
+    ASSERT_EQ(res.size(), 1);
+    ++count[res[0]];
+  }
+  // the neighbor of zero weight is never sampled, the others by 1 : 3
+  EXPECT_EQ(count[1], 0);
+  EXPECT_GT(count[2], count[0] * 2);
+  EXPECT_LT(count[2], count[0] * 4);
+}
+
+}  // namespace distributed
+}  // namespace paddle
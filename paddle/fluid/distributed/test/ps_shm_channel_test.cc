@@ -0,0 +1,272 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>  // NOLINT
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/service/ps_shm_channel.h"
+
+DECLARE_string(pserver_shm_endpoints);
+
+namespace paddle {
+namespace distributed {
+
+// Answers every key with key * cmd_id, as many floats as slot->num.
+static void MultiplyHandler(PsShmSlot* slot) {
+  const uint64_t* keys = reinterpret_cast<const uint64_t*>(slot->data());
+  std::vector<float> values(slot->num);
+  for (uint32_t i = 0; i < slot->num; ++i) {
+    values[i] = static_cast<float>(keys[i] * slot->cmd_id);
+  }
+  std::memcpy(slot->data(), values.data(), sizeof(float) * values.size());
+  slot->data_size = sizeof(float) * values.size();
+  slot->err_code = slot->table_id == 0 ? 0 : -1;
+}
+
+// Takes longer than the calls are willing to wait.
+static void SlowHandler(PsShmSlot* slot) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  MultiplyHandler(slot);
+}
+
+static bool CallMultiply(PsShmChannel* channel, int cmd_id, uint32_t table_id,
+                         const std::vector<uint64_t>& keys,
+                         int wait_us = 10000000, int timeout_ms = 10000) {
+  PsShmClaim claim;
+  if (!channel->Acquire(sizeof(uint64_t) * keys.size(),
+                        sizeof(float) * keys.size(), wait_us, &claim)) {
+    return false;
+  }
+  auto* slot = claim.slot;
+  slot->cmd_id = cmd_id;
+  slot->table_id = table_id;
+  slot->num = keys.size();
+  slot->data_size = sizeof(uint64_t) * keys.size();
+  std::memcpy(slot->data(), keys.data(), slot->data_size);
+  if (!channel->Call(&claim, timeout_ms)) {
+    EXPECT_EQ(claim.slot, nullptr);
+    return false;
+  }
+  bool ok = slot->data_size == sizeof(float) * keys.size() &&
+            slot->err_code == (table_id == 0 ? 0 : -1);
+  const float* values = reinterpret_cast<const float*>(slot->data());
+  for (size_t i = 0; ok && i < keys.size(); ++i) {
+    ok = values[i] == static_cast<float>(keys[i] * cmd_id);
+  }
+  channel->Release(&claim);
+  return ok;
+}
+
+// Claims up to count slots of the channel, and gives them back.
+static int Claim(PsShmChannel* channel, int count, int wait_us) {
+  std::vector<PsShmClaim> claims;
+  PsShmClaim claim;
+  while (static_cast<int>(claims.size()) < count &&
+         channel->Acquire(0, 0, wait_us, &claim)) {
+    claims.push_back(claim);
+  }
+  for (auto& c : claims) {
+    channel->Release(&c);
+  }
+  return claims.size();
+}
+
+TEST(PsShmChannel, Enabled) {
+  FLAGS_pserver_shm_endpoints = "127.0.0.1:4300, 127.0.0.1:4301";
+  EXPECT_TRUE(PsShmEnabled("127.0.0.1", 4300));
+  EXPECT_TRUE(PsShmEnabled("127.0.0.1", 4301));
+  EXPECT_FALSE(PsShmEnabled("127.0.0.1", 4302));
+  FLAGS_pserver_shm_endpoints = "";
+  EXPECT_FALSE(PsShmEnabled("127.0.0.1", 4300));
+}
+
+TEST(PsShmChannel, Threads) {
+  std::string ip = "127.0.0.1";
+  uint32_t port = 4310 + getpid() % 1000;
+  EXPECT_EQ(PsShmChannel::Open(ip, port), nullptr);
+
+  PsShmServer server;
+  ASSERT_EQ(server.Start(ip, port, 4, 4096, 2, MultiplyHandler), 0);
+  auto channel = PsShmChannel::Open(ip, port);
+  ASSERT_NE(channel, nullptr);
+  EXPECT_EQ(channel->slot_size(), 4096);
+  EXPECT_FALSE(CallMultiply(channel.get(), 1, 0, std::vector<uint64_t>(600)));
+
+  // more threads than slots, so that Acquire has to wait
+  std::vector<std::thread> threads;
+  std::vector<int> failures(8, 0);
+  for (int t = 0; t < 8; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int x = 0; x < 500; ++x) {
+        std::vector<uint64_t> keys(1 + (x + t) % 100);
+        for (size_t i = 0; i < keys.size(); ++i) {
+          keys[i] = t * 1000 + x + i;
+        }
+        if (!CallMultiply(channel.get(), 1 + t, x % 10 == 0 ? 1 : 0, keys)) {
+          ++failures[t];
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (int t = 0; t < 8; ++t) {
+    EXPECT_EQ(failures[t], 0);
+  }
+  server.Stop();
+  EXPECT_EQ(PsShmChannel::Open(ip, port), nullptr);
+}
+
+TEST(PsShmChannel, Processes) {
+  std::string ip = "127.0.0.1";
+  uint32_t port = 5310 + getpid() % 1000;
+  PsShmServer server;
+  ASSERT_EQ(server.Start(ip, port, 8, 1 << 16, 4, MultiplyHandler), 0);
+
+  std::vector<pid_t> children;
+  for (int c = 0; c < 4; ++c) {
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+      auto channel = PsShmChannel::Open(ip, port);
+      int failures = channel == nullptr ? 1 : 0;
+      for (int x = 0; channel != nullptr && x < 1000; ++x) {
+        std::vector<uint64_t> keys(1 + x % 1000, c * 100000 + x);
+        if (!CallMultiply(channel.get(), 2 + c, 0, keys)) {
+          ++failures;
+        }
+      }
+      _exit(failures == 0 ? 0 : 1);
+    }
+    children.push_back(pid);
+  }
+  for (auto pid : children) {
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status));
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+  }
+  server.Stop();
+}
+
+TEST(PsShmChannel, AcquireTimeout) {
+  std::string ip = "127.0.0.1";
+  uint32_t port = 6310 + getpid() % 1000;
+  PsShmServer server;
+  ASSERT_EQ(server.Start(ip, port, 2, 4096, 1, MultiplyHandler), 0);
+  auto channel = PsShmChannel::Open(ip, port);
+  ASSERT_NE(channel, nullptr);
+
+  PsShmClaim first, second, third;
+  ASSERT_TRUE(channel->Acquire(8, 8, 0, &first));
+  ASSERT_TRUE(channel->Acquire(8, 8, 0, &second));
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(channel->Acquire(8, 8, 20000, &third));
+  EXPECT_GE(std::chrono::steady_clock::now() - start,
+            std::chrono::microseconds(20000));
+  EXPECT_EQ(third.slot, nullptr);
+  channel->Release(&first);
+  EXPECT_TRUE(channel->Acquire(8, 8, 0, &third));
+  channel->Release(&second);
+  channel->Release(&third);
+  EXPECT_EQ(Claim(channel.get(), 3, 0), 2);
+  server.Stop();
+}
+
+TEST(PsShmChannel, WaitTimeout) {
+  std::string ip = "127.0.0.1";
+  uint32_t port = 7310 + getpid() % 1000;
+  PsShmServer server;
+  ASSERT_EQ(server.Start(ip, port, 2, 4096, 1, SlowHandler), 0);
+  auto channel = PsShmChannel::Open(ip, port);
+  ASSERT_NE(channel, nullptr);
+
+  // both given up while served, the server frees them once done
+  std::vector<uint64_t> keys = {1, 2, 3};
+  EXPECT_FALSE(CallMultiply(channel.get(), 2, 0, keys, 0, 50));
+  EXPECT_FALSE(CallMultiply(channel.get(), 2, 0, keys, 0, 50));
+  EXPECT_LT(Claim(channel.get(), 2, 0), 2);
+  EXPECT_EQ(Claim(channel.get(), 2, 3000000), 2);
+  EXPECT_TRUE(CallMultiply(channel.get(), 2, 0, keys));
+  server.Stop();
+}
+
+TEST(PsShmChannel, DeadTrainer) {
+  std::string ip = "127.0.0.1";
+  uint32_t port = 8310 + getpid() % 1000;
+  PsShmServer server;
+  ASSERT_EQ(server.Start(ip, port, 2, 4096, 1, MultiplyHandler), 0);
+
+  // dies holding a claimed slot and a published one
+  pid_t pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    auto channel = PsShmChannel::Open(ip, port);
+    PsShmClaim claimed, published;
+    bool ok = channel != nullptr && channel->Acquire(8, 8, 0, &claimed) &&
+              channel->Acquire(8, 8, 0, &published);
+    if (ok) {
+      published.slot->num = 0;
+      published.slot->data_size = 0;
+      channel->Publish(&published);
+    }
+    _exit(ok ? 0 : 1);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(pid, &status, 0), pid);
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  auto channel = PsShmChannel::Open(ip, port);
+  ASSERT_NE(channel, nullptr);
+  EXPECT_EQ(Claim(channel.get(), 2, 3000000), 2);
+  server.Stop();
+}
+
+TEST(PsShmChannel, Restart) {
+  std::string ip = "127.0.0.1";
+  uint32_t port = 9310 + getpid() % 1000;
+  std::vector<uint64_t> keys = {1, 2, 3};
+  std::unique_ptr<PsShmServer> server(new PsShmServer());
+  ASSERT_EQ(server->Start(ip, port, 2, 4096, 1, MultiplyHandler), 0);
+  auto channel = PsShmChannel::Open(ip, port);
+  ASSERT_NE(channel, nullptr);
+  EXPECT_TRUE(CallMultiply(channel.get(), 3, 0, keys));
+
+  server.reset();
+  EXPECT_FALSE(CallMultiply(channel.get(), 3, 0, keys));
+
+  // the channel maps the segment of the new server
+  server.reset(new PsShmServer());
+  ASSERT_EQ(server->Start(ip, port, 4, 8192, 1, MultiplyHandler), 0);
+  bool ok = false;
+  for (int x = 0; !ok && x < 300; ++x) {
+    ok = CallMultiply(channel.get(), 3, 0, keys);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_TRUE(ok);
+  EXPECT_EQ(channel->slot_size(), 8192);
+  server->Stop();
+}
+
+}  // namespace distributed
+}  // namespace paddle
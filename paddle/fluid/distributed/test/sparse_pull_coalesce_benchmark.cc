@@ -0,0 +1,228 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// Measures the pull_sparse throughput of a pserver under many concurrent
+// requests of overlapping feasigns, each looked up alone and coalesced by
+// SparsePullCoalescer in the brpc handlers of BrpcPsServer, e.g.
+//   ./sparse_pull_coalesce_benchmark --threads=128 --window_us=200
+
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/service/brpc_ps_client.h"
+#include "paddle/fluid/distributed/service/brpc_ps_server.h"
+#include "paddle/fluid/distributed/service/env.h"
+#include "paddle/fluid/framework/program_desc.h"
+
+DEFINE_int32(threads, 64, "number of trainer threads pulling concurrently");
+DEFINE_int32(requests, 200, "requests of every thread");
+DEFINE_int32(keys_per_request, 1000, "feasigns of every request");
+DEFINE_int64(key_space, 1000000, "distinct feasigns pulled");
+DEFINE_double(zipf, 1.1, "skew of the feasigns pulled, a zipf exponent");
+DEFINE_int32(emb_dim, 16, "embedding dim of every row");
+DEFINE_int32(window_us, 200, "coalescing window");
+DEFINE_int32(max_requests, 64, "max requests coalesced into a lookup");
+DEFINE_int32(alone_port, 4249, "port of the pserver looking up alone");
+DEFINE_int32(coalesced_port, 4259, "port of the pserver coalescing pulls");
+DECLARE_int32(pserver_pull_sparse_coalesce_window_us);
+DECLARE_int32(pserver_pull_sparse_coalesce_max_requests);
+
+namespace paddle {
+namespace distributed {
+
+static void GetSparseTableProto(TableParameter* sparse_table_proto) {
+  sparse_table_proto->set_table_id(0);
+  sparse_table_proto->set_table_class("CommonSparseTable");
+  sparse_table_proto->set_shard_num(256);
+  sparse_table_proto->set_type(PS_SPARSE_TABLE);
+  TableAccessorParameter* accessor_proto =
+      sparse_table_proto->mutable_accessor();
+  CommonAccessorParameter* common_proto = sparse_table_proto->mutable_common();
+
+  accessor_proto->set_accessor_class("CommMergeAccessor");
+  accessor_proto->set_fea_dim(0);
+  accessor_proto->set_embedx_dim(FLAGS_emb_dim);
+
+  common_proto->set_name("sgd");
+  common_proto->set_table_name("benchmark");
+  common_proto->set_trainer_num(1);
+  common_proto->set_sync(false);
+  common_proto->set_entry("none");
+  common_proto->add_params("Param");
+  common_proto->add_dims(FLAGS_emb_dim);
+  common_proto->add_initializers("uniform_random&0&-1.0&1.0");
+  common_proto->add_params("LearningRate");
+  common_proto->add_dims(1);
+  common_proto->add_initializers("fill_constant&1.0");
+}
+
+static PSParameter GetProto(bool is_worker) {
+  PSParameter fleet_desc;
+  if (is_worker) {
+    GetSparseTableProto(fleet_desc.mutable_worker_param()
+                            ->mutable_downpour_worker_param()
+                            ->add_downpour_table_param());
+  }
+  DownpourServerParameter* downpour_server_proto =
+      fleet_desc.mutable_server_param()->mutable_downpour_server_param();
+  ServerServiceParameter* server_service_proto =
+      downpour_server_proto->mutable_service_param();
+  server_service_proto->set_service_class("BrpcPsService");
+  server_service_proto->set_server_class("BrpcPsServer");
+  server_service_proto->set_client_class("BrpcPsClient");
+  server_service_proto->set_start_server_port(0);
+  server_service_proto->set_server_thread_num(12);
+  GetSparseTableProto(downpour_server_proto->add_downpour_table_param());
+  return fleet_desc;
+}
+
+// The feasigns of every request of every thread, zipf distributed over the
+// key space by inverse transform of its continuous approximation.
+static std::vector<std::vector<uint64_t>> GenerateKeys() {
+  std::vector<std::vector<uint64_t>> keys(FLAGS_threads);
+  double s = FLAGS_zipf;
+  double n = static_cast<double>(FLAGS_key_space);
+  for (int t = 0; t < FLAGS_threads; ++t) {
+    std::mt19937_64 rng(t);
+    std::uniform_real_distribution<double> uniform(0, 1);
+    size_t num = static_cast<size_t>(FLAGS_requests) * FLAGS_keys_per_request;
+    keys[t].resize(num);
+    for (size_t i = 0; i < num; ++i) {
+      double u = uniform(rng);
+      double rank = std::pow(u * (std::pow(n, 1 - s) - 1) + 1, 1 / (1 - s));
+      keys[t][i] = std::min<uint64_t>(static_cast<uint64_t>(rank) - 1,
+                                      FLAGS_key_space - 1);
+    }
+  }
+  return keys;
+}
+
+// A pserver and the client of the trainer threads pulling from it.
+class Endpoint {
+ public:
+  Endpoint(const std::string& ip, uint32_t port) : ip_(ip), port_(port) {
+    host_sign_list_.push_back(PSHost(ip_, port_, 0).serialize_to_string());
+  }
+
+  // The pserver coalesces the pulls of every table if window_us > 0.
+  void Start(int window_us) {
+    FLAGS_pserver_pull_sparse_coalesce_window_us = window_us;
+    FLAGS_pserver_pull_sparse_coalesce_max_requests = FLAGS_max_requests;
+    server_thread_ = std::thread([this]() {
+      auto server_proto = GetProto(false);
+      PaddlePSEnvironment env;
+      env.set_ps_servers(&host_sign_list_, 1);
+      server_.reset(PSServerFactory::create(server_proto));
+      std::vector<framework::ProgramDesc> empty_vec;
+      empty_vec.push_back(framework::ProgramDesc());
+      server_->configure(server_proto, env, 0, empty_vec);
+      server_->start(ip_, port_);
+    });
+    sleep(1);
+
+    auto worker_proto = GetProto(true);
+    PaddlePSEnvironment env;
+    env.set_ps_servers(&host_sign_list_, 1);
+    std::map<uint64_t, std::vector<Region>> dense_regions;
+    dense_regions[0] = {};
+    client_.reset(PSClientFactory::create(worker_proto));
+    client_->configure(worker_proto, dense_regions, env, 0);
+  }
+
+  void Stop() {
+    client_->stop_server();
+    client_->finalize_worker();
+    server_thread_.join();
+  }
+
+  void Run(const std::string& name,
+           const std::vector<std::vector<uint64_t>>& keys) {
+    auto begin = GetCurrentUS();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < FLAGS_threads; ++t) {
+      threads.emplace_back([this, &keys, t]() {
+        std::vector<float> values(FLAGS_keys_per_request * FLAGS_emb_dim);
+        std::vector<float*> value_ptrs(FLAGS_keys_per_request);
+        for (int i = 0; i < FLAGS_keys_per_request; ++i) {
+          value_ptrs[i] = values.data() + i * FLAGS_emb_dim;
+        }
+        for (int r = 0; r < FLAGS_requests; ++r) {
+          const uint64_t* request_keys =
+              keys[t].data() + static_cast<size_t>(r) * FLAGS_keys_per_request;
+          client_
+              ->pull_sparse(value_ptrs.data(), 0, request_keys,
+                            FLAGS_keys_per_request, true)
+              .wait();
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    double s = (GetCurrentUS() - begin) / 1e+6;
+    double requests = static_cast<double>(FLAGS_threads) * FLAGS_requests;
+    std::cout << name << ": " << requests / s << " requests/s, "
+              << requests * FLAGS_keys_per_request / s << " feasigns/s"
+              << std::endl;
+  }
+
+ private:
+  std::string ip_;
+  uint32_t port_;
+  std::vector<std::string> host_sign_list_;
+  std::shared_ptr<PSServer> server_;
+  std::shared_ptr<PSClient> client_;
+  std::thread server_thread_;
+};
+
+static void Run() {
+  setenv("http_proxy", "", 1);
+  setenv("https_proxy", "", 1);
+  std::string ip = "127.0.0.1";
+  auto keys = GenerateKeys();
+
+  Endpoint alone(ip, FLAGS_alone_port);
+  Endpoint coalesced(ip, FLAGS_coalesced_port);
+  alone.Start(0);
+  coalesced.Start(FLAGS_window_us);
+
+  // the rows are created ahead of the measured runs
+  alone.Run("warm up alone", keys);
+  coalesced.Run("warm up coalesced", keys);
+  alone.Run("alone", keys);
+  coalesced.Run("coalesced", keys);
+
+  alone.Stop();
+  coalesced.Stop();
+}
+
+}  // namespace distributed
+}  // namespace paddle
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  paddle::distributed::Run();
+  return 0;
+}
@@ -0,0 +1,163 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <memory>
+#include <string>
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/service/sparse_pull_coalescer.h"
+#include "paddle/fluid/distributed/table/common_sparse_table.h"
+#include "paddle/fluid/distributed/table/table.h"
+
+namespace paddle {
+namespace distributed {
+
+static const int kEmbDim = 4;
+
+static std::unique_ptr<Table> CreateSparseTable(const std::string& entry) {
+  TableParameter table_config;
+  table_config.set_table_class("CommonSparseTable");
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new CommonSparseTable());
+  table->set_shard(0, 1);
+  TableAccessorParameter* accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CommMergeAccessor");
+  // no pre-inited rows, the tests count the rows they pull
+  accessor_config->set_fea_dim(0);
+  CommonAccessorParameter* common_config = table_config.mutable_common();
+  common_config->set_name("sgd");
+  common_config->set_table_name("coalescer_test_table");
+  common_config->set_trainer_num(1);
+  common_config->set_entry(entry);
+  common_config->add_params("Param");
+  common_config->add_dims(kEmbDim);
+  common_config->add_initializers("uniform_random&0&-1.0&1.0");
+  common_config->add_params("LearningRate");
+  common_config->add_dims(1);
+  common_config->add_initializers("fill_constant&1.0");
+  EXPECT_EQ(table->initialize(table_config, fs_config), 0);
+  return table;
+}
+
+// Pulls keys through the coalescer in a thread per request, returns the
+// values of every request. Every pull must succeed unless rets is given.
+static std::vector<std::vector<float>> PullConcurrently(
+    SparsePullCoalescer* coalescer,
+    const std::vector<std::vector<uint64_t>>& keys,
+    std::vector<int32_t>* rets = nullptr) {
+  std::vector<std::vector<float>> values(keys.size());
+  std::vector<int32_t> pull_rets(keys.size());
+  std::vector<std::thread> threads;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    threads.emplace_back([coalescer, &keys, &values, &pull_rets, i]() {
+      std::vector<uint64_t> feasigns = keys[i];
+      std::vector<uint32_t> frequencies(feasigns.size(), 1);
+      PullSparseValue value(feasigns.size(), kEmbDim);
+      value.feasigns_ = feasigns.data();
+      value.frequencies_ = frequencies.data();
+      values[i].resize(feasigns.size() * kEmbDim);
+      pull_rets[i] = coalescer->Pull(value, values[i].data());
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  if (rets == nullptr) {
+    EXPECT_EQ(pull_rets, std::vector<int32_t>(keys.size(), 0));
+  } else {
+    rets->swap(pull_rets);
+  }
+  return values;
+}
+
+TEST(SparsePullCoalescer, Scatter) {
+  auto table = CreateSparseTable("none");
+  // a batch is closed once the 4 requests are in
+  SparsePullCoalescer coalescer(table.get(), 10000000, 4);
+  std::vector<std::vector<uint64_t>> keys = {
+      {1, 2, 3}, {3, 4, 1, 1}, {5}, {2, 6, 7, 8, 9}};
+  auto values = PullConcurrently(&coalescer, keys);
+  EXPECT_EQ(coalescer.requests(), 4);
+  EXPECT_EQ(coalescer.lookups(), 1);
+
+  // every request gets the values of its own keys
+  for (size_t i = 0; i < keys.size(); ++i) {
+    std::vector<float> expected(keys[i].size() * kEmbDim);
+    std::vector<uint32_t> frequencies(keys[i].size(), 1);
+    PullSparseValue value(keys[i].size(), kEmbDim);
+    value.is_training_ = false;
+    value.feasigns_ = keys[i].data();
+    value.frequencies_ = frequencies.data();
+    table->pull_sparse(expected.data(), value);
+    EXPECT_EQ(values[i], expected);
+  }
+  EXPECT_EQ(table->print_table_stat().first, 9);
+}
+
+TEST(SparsePullCoalescer, Frequency) {
+  // 12 is admitted at its third pull, which the three requests of a batch
+  // make together
+  auto table = CreateSparseTable("count_min_sketch_entry:3:4096:4");
+  SparsePullCoalescer coalescer(table.get(), 10000000, 3);
+  auto values = PullConcurrently(&coalescer, {{12}, {12}, {12}});
+  EXPECT_EQ(coalescer.lookups(), 1);
+  EXPECT_EQ(table->print_table_stat().first, 1);
+  EXPECT_EQ(values[0], values[1]);
+  EXPECT_EQ(values[0], values[2]);
+  EXPECT_NE(values[0], std::vector<float>(kEmbDim, 0));
+}
+
+TEST(SparsePullCoalescer, Window) {
+  // a lone request waits the window only
+  auto table = CreateSparseTable("none");
+  SparsePullCoalescer coalescer(table.get(), 1000, 64);
+  for (int i = 0; i < 3; ++i) {
+    PullConcurrently(&coalescer, {{1, 2}});
+  }
+  EXPECT_EQ(coalescer.requests(), 3);
+  EXPECT_EQ(coalescer.lookups(), 3);
+}
+
+TEST(SparsePullCoalescer, Fallback) {
+  // 1 is of the other shard and has no replica, only its request fails
+  auto table = CreateSparseTable("none");
+  table->set_shard(0, 2);
+  SparsePullCoalescer coalescer(table.get(), 10000000, 3);
+  std::vector<std::vector<uint64_t>> keys = {{0, 2}, {1}, {4}};
+  std::vector<int32_t> rets;
+  auto values = PullConcurrently(&coalescer, keys, &rets);
+  // the merged lookup, then one per request
+  EXPECT_EQ(coalescer.lookups(), 4);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (keys[i][0] == 1) {
+      EXPECT_NE(rets[i], 0);
+      continue;
+    }
+    EXPECT_EQ(rets[i], 0);
+    std::vector<float> expected(keys[i].size() * kEmbDim);
+    std::vector<uint32_t> frequencies(keys[i].size(), 1);
+    PullSparseValue value(keys[i].size(), kEmbDim);
+    value.is_training_ = false;
+    value.feasigns_ = keys[i].data();
+    value.frequencies_ = frequencies.data();
+    table->pull_sparse(expected.data(), value);
+    EXPECT_EQ(values[i], expected);
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,137 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <unistd.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/common_sparse_table.h"
+#include "paddle/fluid/distributed/table/depends/count_min_sketch.h"
+#include "paddle/fluid/distributed/table/table.h"
+
+DECLARE_int32(pserver_sparse_evict_ttl);
+DECLARE_int32(pserver_sparse_evict_round_s);
+
+namespace paddle {
+namespace distributed {
+
+static const int kEmbDim = 4;
+
+static std::unique_ptr<Table> CreateSparseTable(const std::string& entry) {
+  TableParameter table_config;
+  table_config.set_table_class("CommonSparseTable");
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new CommonSparseTable());
+  table->set_shard(0, 1);
+  TableAccessorParameter* accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CommMergeAccessor");
+  // no pre-inited rows, the tests count the rows they pull
+  accessor_config->set_fea_dim(0);
+  CommonAccessorParameter* common_config = table_config.mutable_common();
+  common_config->set_name("sgd");
+  common_config->set_table_name("admission_test_table");
+  common_config->set_trainer_num(1);
+  common_config->set_entry(entry);
+  common_config->add_params("Param");
+  common_config->add_dims(kEmbDim);
+  common_config->add_initializers("fill_constant&0.5");
+  common_config->add_params("LearningRate");
+  common_config->add_dims(1);
+  common_config->add_initializers("fill_constant&1.0");
+  EXPECT_EQ(table->initialize(table_config, fs_config), 0);
+  return table;
+}
+
+static std::vector<float> Pull(Table* table, std::vector<uint64_t> keys) {
+  std::vector<uint32_t> frequencies(keys.size(), 1);
+  PullSparseValue value(keys.size(), kEmbDim);
+  value.feasigns_ = keys.data();
+  value.frequencies_ = frequencies.data();
+  std::vector<float> res(keys.size() * kEmbDim, -1);
+  table->pull_sparse(res.data(), value);
+  return res;
+}
+
+TEST(CountMinSketch, Estimate) {
+  CountMinSketch sketch(1024, 4);
+  for (uint64_t key = 0; key < 100; ++key) {
+    sketch.Add(key, key % 7);
+  }
+  for (uint64_t key = 0; key < 100; ++key) {
+    EXPECT_GE(sketch.Estimate(key), key % 7);
+  }
+  EXPECT_EQ(sketch.Estimate(3), 3);
+  EXPECT_EQ(sketch.Add(3, 2), 5);
+  sketch.Decay();
+  EXPECT_EQ(sketch.Estimate(3), 2);
+  EXPECT_EQ(sketch.memory_size(), 1024 * 4 * sizeof(uint32_t));
+}
+
+TEST(CommonSparseTable, SketchAdmission) {
+  auto table = CreateSparseTable("count_min_sketch_entry:3:4096:4");
+  std::vector<uint64_t> keys = {1, 12, 23};
+  for (int i = 0; i < 2; ++i) {
+    EXPECT_EQ(Pull(table.get(), keys), std::vector<float>(12, 0));
+  }
+  // no row for the feasigns not admitted, pushes of them are dropped
+  EXPECT_EQ(table->print_table_stat().first, 0);
+  std::vector<float> grads(keys.size() * kEmbDim, 1);
+  table->push_sparse(keys.data(), grads.data(), keys.size());
+  EXPECT_EQ(table->print_table_stat().first, 0);
+
+  // admitted at the third pull, initialized
+  EXPECT_EQ(Pull(table.get(), {12}), std::vector<float>(kEmbDim, 0.5));
+  EXPECT_EQ(table->print_table_stat().first, 1);
+  table->push_sparse(keys.data(), grads.data(), keys.size());
+  EXPECT_EQ(Pull(table.get(), {12}), std::vector<float>(kEmbDim, -0.5));
+  EXPECT_EQ(table->print_table_stat().first, 1);
+}
+
+TEST(CommonSparseTable, Shrink) {
+  auto table = CreateSparseTable("none");
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < 1000; ++key) {
+    keys.push_back(key);
+  }
+  Pull(table.get(), keys);
+  EXPECT_EQ(table->print_table_stat().first, 1000);
+  table->shrink("2");
+  Pull(table.get(), {7, 8});
+  table->shrink("2");
+  EXPECT_EQ(table->print_table_stat().first, 2);
+}
+
+TEST(CommonSparseTable, BackgroundEviction) {
+  FLAGS_pserver_sparse_evict_ttl = 1;
+  FLAGS_pserver_sparse_evict_round_s = 1;
+  auto table = CreateSparseTable("none");
+  FLAGS_pserver_sparse_evict_ttl = 0;
+  std::vector<uint64_t> keys;
+  for (uint64_t key = 0; key < 1000; ++key) {
+    keys.push_back(key);
+  }
+  Pull(table.get(), keys);
+  EXPECT_EQ(table->print_table_stat().first, 1000);
+  // every row is visited in a round of 1s
+  sleep(2);
+  EXPECT_EQ(table->print_table_stat().first, 0);
+  FLAGS_pserver_sparse_evict_round_s = 3600;
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -0,0 +1,105 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// Measures the save/load throughput of CommonSparseTable checkpoints in the
+// binary and the text format, e.g.
+//   ./sparse_table_checkpoint_benchmark --rows=2000000 --emb_dim=64
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/distributed/common/sparse_sharding_merge.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/common_sparse_table.h"
+#include "paddle/fluid/distributed/table/table.h"
+
+DEFINE_int64(rows, 1000000, "number of sparse rows in the table");
+DEFINE_int32(emb_dim, 64, "embedding dim of every row");
+DEFINE_string(dirname, "/tmp/sparse_table_checkpoint_benchmark",
+              "directory to save the checkpoints");
+DECLARE_string(pserver_sparse_table_save_format);
+
+namespace paddle {
+namespace distributed {
+
+static std::unique_ptr<Table> CreateTable(const std::string& name) {
+  TableParameter table_config;
+  table_config.set_table_class("CommonSparseTable");
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new CommonSparseTable());
+  table->set_shard(0, 1);
+  TableAccessorParameter* accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CommMergeAccessor");
+  CommonAccessorParameter* common_config = table_config.mutable_common();
+  common_config->set_name("sgd");
+  common_config->set_table_name(name);
+  common_config->set_trainer_num(1);
+  common_config->add_params("Param");
+  common_config->add_dims(FLAGS_emb_dim);
+  common_config->add_initializers("uniform_random&0&-1.0&1.0");
+  common_config->add_params("LearningRate");
+  common_config->add_dims(1);
+  common_config->add_initializers("fill_constant&1.0");
+  table->initialize(table_config, fs_config);
+  return table;
+}
+
+static void Run(const std::string& format) {
+  FLAGS_pserver_sparse_table_save_format = format;
+  const std::string name = "benchmark_" + format;
+  auto table = CreateTable(name);
+
+  const int64_t batch = 100000;
+  std::vector<uint64_t> keys(batch);
+  std::vector<char*> ptrs(batch);
+  for (int64_t begin = 0; begin < FLAGS_rows; begin += batch) {
+    size_t num = std::min(batch, FLAGS_rows - begin);
+    for (size_t i = 0; i < num; ++i) {
+      keys[i] = begin + i;
+    }
+    table->pull_sparse_ptr(ptrs.data(), keys.data(), num);
+  }
+
+  // payload only, the text format is several times larger on disk
+  double mb = FLAGS_rows * (FLAGS_emb_dim + 1) * sizeof(float) / 1048576.0;
+
+  auto begin = GetCurrentUS();
+  table->save(FLAGS_dirname, "0");
+  auto save_s = (GetCurrentUS() - begin) / 1e+6;
+
+  auto loaded = CreateTable(name);
+  std::string prefix =
+      FLAGS_dirname + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+  begin = GetCurrentUS();
+  loaded->load(prefix + ".txt", prefix + ".meta");
+  auto load_s = (GetCurrentUS() - begin) / 1e+6;
+
+  std::cout << format << ": rows " << FLAGS_rows << ", save " << save_s
+            << "s (" << mb / save_s << " MB/s), load " << load_s << "s ("
+            << mb / load_s << " MB/s)" << std::endl;
+}
+
+}  // namespace distributed
+}  // namespace paddle
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  paddle::distributed::Run("binary");
+  paddle::distributed::Run("text");
+  return 0;
+}
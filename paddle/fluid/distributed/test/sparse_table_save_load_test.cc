@@ -0,0 +1,311 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/common/sparse_checkpoint_compact.h"
+#include "paddle/fluid/distributed/common/sparse_sharding_merge.h"
+#include "paddle/fluid/distributed/ps.pb.h"
+#include "paddle/fluid/distributed/table/common_sparse_table.h"
+#include "paddle/fluid/distributed/table/depends/large_scale_kv.h"
+#include "paddle/fluid/distributed/table/ssd_sparse_table.h"
+#include "paddle/fluid/distributed/table/table.h"
+
+DECLARE_string(pserver_sparse_table_save_format);
+DECLARE_int32(pserver_sparse_table_save_block_rows);
+DECLARE_bool(pserver_sparse_table_delta_checkpoint);
+#ifdef PADDLE_WITH_HETERPS
+DECLARE_string(rocksdb_path);
+#endif
+
+namespace paddle {
+namespace distributed {
+
+template <typename T = CommonSparseTable>
+static std::unique_ptr<Table> CreateSparseTable(const std::string& name,
+                                                int emb_dim) {
+  TableParameter table_config;
+  table_config.set_table_class("CommonSparseTable");
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new T());
+  table->set_shard(0, 1);
+  TableAccessorParameter* accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CommMergeAccessor");
+  // no pre-inited rows, every row of the table is written by the test
+  accessor_config->set_fea_dim(0);
+  CommonAccessorParameter* common_config = table_config.mutable_common();
+  common_config->set_name("sgd");
+  common_config->set_table_name(name);
+  common_config->set_trainer_num(1);
+  common_config->add_params("Param");
+  common_config->add_dims(emb_dim);
+  common_config->add_initializers("uniform_random&0&-1.0&1.0");
+  common_config->add_params("LearningRate");
+  common_config->add_dims(1);
+  common_config->add_initializers("fill_constant&1.0");
+  EXPECT_EQ(table->initialize(table_config, fs_config), 0);
+  return table;
+}
+
+static std::vector<VALUE*> PullValues(Table* table,
+                                      const std::vector<uint64_t>& keys) {
+  std::vector<char*> ptrs(keys.size());
+  table->pull_sparse_ptr(ptrs.data(), keys.data(), keys.size());
+  std::vector<VALUE*> values;
+  for (auto* ptr : ptrs) {
+    values.push_back(reinterpret_cast<VALUE*>(ptr));
+  }
+  return values;
+}
+
+static void TestSaveAndLoad(const std::string& format) {
+  FLAGS_pserver_sparse_table_save_format = format;
+  // make every shard have several blocks
+  FLAGS_pserver_sparse_table_save_block_rows = 7;
+
+  const int emb_dim = 8;
+  const std::string name = "save_load_test_" + format;
+  const std::string dirname = "/tmp/sparse_table_save_load_test_" + format;
+  auto table = CreateSparseTable(name, emb_dim);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    keys.push_back(i * 13);
+  }
+  auto origin_values = PullValues(table.get(), keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    origin_values[i]->count_ = static_cast<int>(i);
+    origin_values[i]->is_entry_ = (i % 2 == 0);
+    for (int j = 0; j < emb_dim + 1; ++j) {
+      origin_values[i]->data_[j] = static_cast<float>(i) + 0.125f * j;
+    }
+  }
+
+  ASSERT_EQ(table->save(dirname, "0"), 0);
+
+  auto loaded_table = CreateSparseTable(name, emb_dim);
+  std::string prefix =
+      dirname + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+  ASSERT_EQ(loaded_table->load(prefix + ".txt", prefix + ".meta"), 0);
+
+  auto loaded_values = PullValues(loaded_table.get(), keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(loaded_values[i]->count_, origin_values[i]->count_);
+    ASSERT_EQ(loaded_values[i]->is_entry_, origin_values[i]->is_entry_);
+    for (int j = 0; j < emb_dim + 1; ++j) {
+      // text format keeps 6 digits after the point
+      ASSERT_NEAR(loaded_values[i]->data_[j], origin_values[i]->data_[j],
+                  1e-5);
+    }
+  }
+}
+
+static void ExpectSameValues(Table* expect, Table* actual,
+                             const std::vector<uint64_t>& keys, int emb_dim) {
+  ASSERT_EQ(expect->print_table_stat().first,
+            actual->print_table_stat().first);
+  auto expect_values = PullValues(expect, keys);
+  auto actual_values = PullValues(actual, keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    ASSERT_EQ(actual_values[i]->count_, expect_values[i]->count_);
+    for (int j = 0; j < emb_dim + 1; ++j) {
+      ASSERT_EQ(actual_values[i]->data_[j], expect_values[i]->data_[j]);
+    }
+  }
+}
+
+TEST(CommonSparseTable, SaveLoadBinary) { TestSaveAndLoad("binary"); }
+
+TEST(CommonSparseTable, SaveLoadText) { TestSaveAndLoad("text"); }
+
+static std::string ReadFile(const std::string& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::string(std::istreambuf_iterator<char>(file),
+                     std::istreambuf_iterator<char>());
+}
+
+TEST(CommonSparseTable, ShardingMergeBinary) {
+  const int emb_dim = 8;
+  const std::string name = "sharding_merge_test";
+  auto table = CreateSparseTable(name, emb_dim);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 500; ++i) {
+    keys.push_back(i * 7);
+  }
+  auto values = PullValues(table.get(), keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    for (int j = 0; j < emb_dim + 1; ++j) {
+      // exact in the 6 digits of text format
+      values[i]->data_[j] = static_cast<float>(i) + 0.125f * j;
+    }
+  }
+
+  // both formats must merge to the same SelectedRows
+  std::vector<std::string> merged;
+  for (std::string format : {"text", "binary"}) {
+    FLAGS_pserver_sparse_table_save_format = format;
+    FLAGS_pserver_sparse_table_save_block_rows = 7;
+    std::string dirname = "/tmp/sparse_table_merge_test_" + format;
+    ASSERT_EQ(table->save(dirname, "0"), 0);
+    std::string prefix =
+        dirname + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+    std::string output = dirname + "/merged";
+    ShardingMerge merge;
+    merge.Merge({prefix + ".txt"}, {static_cast<int64_t>(keys.size())},
+                output, emb_dim);
+    merged.push_back(ReadFile(output));
+  }
+  ASSERT_FALSE(merged[0].empty());
+  ASSERT_EQ(merged[0], merged[1]);
+}
+
+TEST(CommonSparseTable, DeltaCheckpoint) {
+  FLAGS_pserver_sparse_table_save_format = "binary";
+  FLAGS_pserver_sparse_table_delta_checkpoint = true;
+  FLAGS_pserver_sparse_table_save_block_rows = 16;
+
+  const int emb_dim = 4;
+  const std::string name = "delta_test";
+  const std::string base_dir = "/tmp/sparse_table_delta_test/base";
+  const std::string delta_dir = "/tmp/sparse_table_delta_test/delta";
+  const std::string output_dir = "/tmp/sparse_table_delta_test/compact";
+  auto table = CreateSparseTable(name, emb_dim);
+
+  std::vector<uint64_t> keys;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    keys.push_back(i);
+  }
+  PullValues(table.get(), keys);
+  ASSERT_EQ(table->save(base_dir, std::to_string(SaveMode::base)), 0);
+
+  // update 100 rows and insert 50 new ones
+  std::vector<uint64_t> updated;
+  for (uint64_t i = 0; i < 100; ++i) {
+    updated.push_back(i);
+  }
+  for (uint64_t i = 5000; i < 5050; ++i) {
+    updated.push_back(i);
+  }
+  std::vector<float> params(updated.size() * emb_dim, 0.5f);
+  table->push_sparse_param(updated.data(), params.data(), updated.size());
+
+  // erase 20 rows
+  auto values = PullValues(table.get(), keys);
+  for (size_t i = 200; i < 220; ++i) {
+    values[i]->unseen_days_ = 100;
+  }
+  table->shrink("100");
+  ASSERT_EQ(table->save(delta_dir, std::to_string(SaveMode::delta)), 0);
+
+  std::string base_prefix =
+      base_dir + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+  std::string delta_prefix =
+      delta_dir + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+  std::string output_prefix =
+      output_dir + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+
+  // the delta only holds the dirty rows
+  BinaryIndex delta_index(delta_prefix + PSERVER_SAVE_INDEX_SUFFIX);
+  int64_t delta_rows = 0;
+  int64_t delta_erased = 0;
+  for (auto& shard : delta_index.shards) {
+    delta_rows += shard.rows;
+    delta_erased += shard.erased;
+  }
+  ASSERT_EQ(delta_rows, 150);
+  ASSERT_EQ(delta_erased, 20);
+
+  std::vector<uint64_t> live_keys;
+  for (auto key : keys) {
+    if (key < 200 || key >= 220) live_keys.push_back(key);
+  }
+  for (uint64_t i = 5000; i < 5050; ++i) {
+    live_keys.push_back(i);
+  }
+
+  // replay the delta on top of the base
+  auto replayed = CreateSparseTable(name, emb_dim);
+  ASSERT_EQ(replayed->load(base_prefix + ".txt", base_prefix + ".meta"), 0);
+  ASSERT_EQ(replayed->load(delta_prefix + ".txt", delta_prefix + ".meta"), 0);
+  ExpectSameValues(table.get(), replayed.get(), live_keys, emb_dim);
+
+  CheckpointCompactor compactor;
+  ASSERT_EQ(compactor.Compact(base_prefix, {delta_prefix}, output_prefix, 4),
+            static_cast<int64_t>(live_keys.size()));
+  auto compacted = CreateSparseTable(name, emb_dim);
+  ASSERT_EQ(compacted->load(output_prefix + ".txt", output_prefix + ".meta"),
+            0);
+  ExpectSameValues(table.get(), compacted.get(), live_keys, emb_dim);
+}
+
+#ifdef PADDLE_WITH_HETERPS
+TEST(SSDSparseTable, SaveLoad) {
+  // the rows in rocksdb are lost by the binary format, ssd tables ignore it
+  FLAGS_pserver_sparse_table_save_format = "binary";
+
+  const int emb_dim = 8;
+  const std::string name = "ssd_save_load_test";
+  const std::string dirname = "/tmp/ssd_sparse_table_save_load_test";
+  FLAGS_rocksdb_path = dirname + "/origin_db";
+  auto table = CreateSparseTable<SSDSparseTable>(name, emb_dim);
+
+  std::vector<uint64_t> keys;
+  std::vector<uint32_t> frequencies;
+  for (uint64_t i = 0; i < 1000; ++i) {
+    keys.push_back(i * 13);
+    frequencies.push_back(1);
+  }
+  std::vector<float> expect(keys.size() * emb_dim);
+  auto values = PullValues(table.get(), keys);
+  for (size_t i = 0; i < keys.size(); ++i) {
+    // half of the rows are spilled to rocksdb by update_table
+    values[i]->unseen_days_ = static_cast<int>(i % 2);
+    for (int j = 0; j < emb_dim; ++j) {
+      values[i]->data_[j] = static_cast<float>(i) + 0.125f * j;
+      expect[i * emb_dim + j] = values[i]->data_[j];
+    }
+  }
+  ASSERT_EQ(static_cast<SSDSparseTable*>(table.get())->update_table(), 0);
+  ASSERT_EQ(table->save(dirname, "0"), 0);
+
+  std::string prefix =
+      dirname + "/" + name + PSERVER_SAVE_SUFFIX + "/" + name + ".block0";
+  std::ifstream index(prefix + PSERVER_SAVE_INDEX_SUFFIX);
+  ASSERT_FALSE(index.good());
+
+  FLAGS_rocksdb_path = dirname + "/loaded_db";
+  auto loaded_table = CreateSparseTable<SSDSparseTable>(name, emb_dim);
+  ASSERT_EQ(loaded_table->load(prefix + ".txt", prefix + ".meta"), 0);
+
+  PullSparseValue pull_value(keys.size(), emb_dim);
+  pull_value.is_training_ = false;
+  pull_value.feasigns_ = keys.data();
+  pull_value.frequencies_ = frequencies.data();
+  std::vector<float> actual(keys.size() * emb_dim);
+  ASSERT_EQ(loaded_table->pull_sparse(actual.data(), pull_value), 0);
+  for (size_t i = 0; i < actual.size(); ++i) {
+    ASSERT_NEAR(actual[i], expect[i], 1e-5);
+  }
+}
+#endif
+
+}  // namespace distributed
+}  // namespace paddle
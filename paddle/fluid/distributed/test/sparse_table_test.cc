@@ -15,9 +15,11 @@ limitations under the License. */
 #include <ThreadPool.h>
 
 #include <unistd.h>
+#include <memory>
 #include <string>
 #include <thread>  // NOLINT
 
+#include "gflags/gflags.h"
 #include "google/protobuf/text_format.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/distributed/ps.pb.h"
@@ -26,6 +28,8 @@ limitations under the License. */
 #include "paddle/fluid/distributed/table/sparse_geo_table.h"
 #include "paddle/fluid/distributed/table/table.h"
 
+DECLARE_int32(pserver_sparse_replica_ttl_ms);
+
 namespace paddle {
 namespace distributed {
 
@@ -219,5 +223,71 @@ TEST(CommonSparseTable, Adam) {
   }
 }
 
+// Replicas of the feasigns of the other shard, served until dropped
+TEST(CommonSparseTable, Replica) {
+  int emb_dim = 4;
+  TableParameter table_config;
+  table_config.set_table_class("CommonSparseTable");
+  FsClientParameter fs_config;
+  std::unique_ptr<Table> table(new CommonSparseTable());
+  TableAccessorParameter *accessor_config = table_config.mutable_accessor();
+  accessor_config->set_accessor_class("CommMergeAccessor");
+  CommonAccessorParameter *common_config = table_config.mutable_common();
+  common_config->set_name("sgd");
+  common_config->set_table_name("replica_test_table");
+  common_config->set_trainer_num(1);
+  common_config->add_params("Param");
+  common_config->add_dims(emb_dim);
+  common_config->add_initializers("fill_constant&1.0");
+  common_config->add_params("LearningRate");
+  common_config->add_dims(1);
+  common_config->add_initializers("fill_constant&1.0");
+  table->set_shard(0, 2);
+  ASSERT_EQ(table->initialize(table_config, fs_config), 0);
+
+  // 1 and 3 are owned by shard 1
+  std::vector<uint64_t> keys = {0, 1, 2, 3};
+  std::vector<uint32_t> fres(keys.size(), 1);
+  std::vector<float> replica_values(2 * emb_dim, 2.0);
+  std::vector<uint64_t> replica_keys = {1, 3};
+  ASSERT_EQ(table->push_sparse_replica(replica_keys.data(),
+                                       replica_values.data(), 2),
+            0);
+  std::vector<float> values(keys.size() * emb_dim);
+  PullSparseValue value(keys.size(), emb_dim);
+  value.feasigns_ = keys.data();
+  value.frequencies_ = fres.data();
+  ASSERT_EQ(table->pull_sparse(values.data(), value), 0);
+  for (size_t i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], i / emb_dim % 2 ? 2.0 : 1.0) << i;
+  }
+
+  // 3 is not written again within the ttl
+  auto ttl_ms = FLAGS_pserver_sparse_replica_ttl_ms;
+  FLAGS_pserver_sparse_replica_ttl_ms = 10;
+  usleep(20000);
+  ASSERT_EQ(table->push_sparse_replica(replica_keys.data(),
+                                       replica_values.data(), 1),
+            0);
+  std::vector<uint64_t> replicated = {0, 1};
+  PullSparseValue replicated_value(replicated.size(), emb_dim);
+  replicated_value.feasigns_ = replicated.data();
+  replicated_value.frequencies_ = fres.data();
+  EXPECT_EQ(table->pull_sparse(values.data(), replicated_value), 0);
+  EXPECT_NE(table->pull_sparse(values.data(), value), 0);
+
+  // no replica is left, the feasigns of shard 1 are not created here either
+  usleep(20000);
+  auto feasign_size = table->print_table_stat().first;
+  EXPECT_NE(table->pull_sparse(values.data(), replicated_value), 0);
+  std::vector<uint64_t> not_owned = {1};
+  PullSparseValue not_owned_value(not_owned.size(), emb_dim);
+  not_owned_value.feasigns_ = not_owned.data();
+  not_owned_value.frequencies_ = fres.data();
+  EXPECT_NE(table->pull_sparse(values.data(), not_owned_value), 0);
+  EXPECT_EQ(table->print_table_stat().first, feasign_size);
+  FLAGS_pserver_sparse_replica_ttl_ms = ttl_ms;
+}
+
 }  // namespace distributed
 }  // namespace paddle
@@ -0,0 +1,158 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+// Measures the loading, the ancestor queries, the beam retrieval and the
+// layerwise sampling of a TreeIndex of many leaves, e.g.
+//   ./tree_index_benchmark --leaves=10000000 --branch=2
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/distributed/common/utils.h"
+#include "paddle/fluid/distributed/index_dataset/index_sampler.h"
+#include "paddle/fluid/distributed/index_dataset/index_wrapper.h"
+
+DEFINE_string(tree_file, "/tmp/tree_index_benchmark.pb",
+              "the tree written and loaded");
+DEFINE_int64(leaves, 10000000, "leaves of the tree");
+DEFINE_int32(branch, 2, "branch of the tree");
+DEFINE_int32(batch, 100000, "ids of a batch of ancestor queries and samples");
+DEFINE_int32(beam, 100, "width of the beam retrieved");
+DEFINE_int32(beams, 1000, "beams retrieved");
+DEFINE_int32(layer_sample_num, 2, "negatives sampled in every layer");
+
+namespace paddle {
+namespace distributed {
+
+static void WriteItem(FILE* fp, const std::string& key,
+                      const std::string& value) {
+  KVItem item;
+  item.set_key(key);
+  item.set_value(value);
+  std::string content = item.SerializeAsString();
+  int num = content.size();
+  fwrite(&num, sizeof(num), 1, fp);
+  fwrite(content.data(), 1, num, fp);
+}
+
+// The leaves fill the last level from its first code, with ids 1 to leaves,
+// the nodes above them are their ancestors. Returns the height.
+static int WriteTree() {
+  uint64_t branch = FLAGS_branch;
+  int height = 1;
+  uint64_t level_size = 1, level_offset = 0;
+  while (level_size < static_cast<uint64_t>(FLAGS_leaves)) {
+    level_offset += level_size;
+    level_size *= branch;
+    ++height;
+  }
+
+  FILE* fp = fopen(FLAGS_tree_file.c_str(), "wb");
+  TreeMeta meta;
+  meta.set_height(height);
+  meta.set_branch(FLAGS_branch);
+  WriteItem(fp, ".tree_meta", meta.SerializeAsString());
+  uint64_t first = level_offset, last = level_offset + FLAGS_leaves - 1;
+  uint64_t id = 1;
+  for (int level = height - 1; level >= 0; --level) {
+    for (uint64_t code = first; code <= last; ++code) {
+      IndexNode node;
+      node.set_id(id++);
+      node.set_is_leaf(level == height - 1);
+      node.set_probability(1.0);
+      WriteItem(fp, std::to_string(code), node.SerializeAsString());
+    }
+    first = level > 0 ? (first - 1) / branch : 0;
+    last = level > 0 ? (last - 1) / branch : 0;
+  }
+  fclose(fp);
+  return height;
+}
+
+static void Report(const std::string& name, double begin, double num) {
+  double s = (GetCurrentUS() - begin) / 1e+6;
+  std::cout << name << ": " << s << " s, " << num / s << " /s" << std::endl;
+}
+
+}  // namespace distributed
+}  // namespace paddle
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  using paddle::distributed::GetCurrentUS;
+  using paddle::distributed::Report;
+
+  auto begin = GetCurrentUS();
+  int height = paddle::distributed::WriteTree();
+  Report("write", begin, FLAGS_leaves);
+
+  begin = GetCurrentUS();
+  auto* wrapper = paddle::distributed::IndexWrapper::GetInstance();
+  wrapper->insert_tree_index("benchmark", FLAGS_tree_file);
+  auto tree = wrapper->get_tree_index("benchmark");
+  Report("load", begin, tree->TotalNodeNums());
+
+  std::mt19937_64 rng(0);
+  std::uniform_int_distribution<uint64_t> leaf(1, FLAGS_leaves);
+  std::vector<uint64_t> ids(FLAGS_batch);
+  for (auto& id : ids) {
+    id = leaf(rng);
+  }
+
+  begin = GetCurrentUS();
+  size_t checksum = 0;
+  for (int level = 0; level < height; ++level) {
+    checksum += tree->GetAncestorCodes(ids, level).back();
+  }
+  Report("ancestors", begin, static_cast<double>(FLAGS_batch) * height);
+
+  // every beam keeps the codes of the largest hashes, standing in for the
+  // scores of a model
+  begin = GetCurrentUS();
+  auto score = [](uint64_t code) { return code * 0x9E3779B97F4A7C15ULL; };
+  for (int b = 0; b < FLAGS_beams; ++b) {
+    std::vector<uint64_t> beam = {0};
+    for (int level = 1; level < height; ++level) {
+      beam = tree->GetChildrenCodes(beam, level);
+      if (beam.size() > static_cast<size_t>(FLAGS_beam)) {
+        std::nth_element(beam.begin(), beam.begin() + FLAGS_beam, beam.end(),
+                         [&score, b](uint64_t x, uint64_t y) {
+                           return score(x ^ b) > score(y ^ b);
+                         });
+        beam.resize(FLAGS_beam);
+      }
+    }
+    checksum += beam.size();
+  }
+  Report("beams", begin, FLAGS_beams);
+
+  paddle::distributed::LayerWiseSampler sampler("benchmark");
+  sampler.init_layerwise_conf(
+      std::vector<int>(height - 1, FLAGS_layer_sample_num), 1, 1);
+  std::vector<std::vector<uint64_t>> user_inputs(FLAGS_batch);
+  for (auto& user_input : user_inputs) {
+    user_input = {leaf(rng), leaf(rng)};
+  }
+  begin = GetCurrentUS();
+  checksum += sampler.sample(user_inputs, ids, true).size();
+  Report("samples", begin, FLAGS_batch);
+
+  std::cout << "checksum " << checksum << std::endl;
+  return 0;
+}
@@ -0,0 +1,127 @@
+/* Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License. */
+
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/distributed/index_dataset/index_sampler.h"
+#include "paddle/fluid/distributed/index_dataset/index_wrapper.h"
+
+namespace paddle {
+namespace distributed {
+
+static void WriteItem(FILE* fp, const std::string& key,
+                      const std::string& value) {
+  KVItem item;
+  item.set_key(key);
+  item.set_value(value);
+  std::string content = item.SerializeAsString();
+  int num = content.size();
+  fwrite(&num, sizeof(num), 1, fp);
+  fwrite(content.data(), 1, num, fp);
+}
+
+// A tree of height 3 and branch 3, the codes 0, 1 to 3 and 4 to 12, but the
+// leaf 12. The id of a node is its code plus 100.
+static std::string WriteTree() {
+  std::string path = "/tmp/tree_index_test.pb";
+  FILE* fp = fopen(path.c_str(), "wb");
+  TreeMeta meta;
+  meta.set_height(3);
+  meta.set_branch(3);
+  WriteItem(fp, ".tree_meta", meta.SerializeAsString());
+  for (uint64_t code = 0; code < 12; ++code) {
+    IndexNode node;
+    node.set_id(code + 100);
+    node.set_is_leaf(code >= 4);
+    node.set_probability(0.5);
+    WriteItem(fp, std::to_string(code), node.SerializeAsString());
+  }
+  fclose(fp);
+  return path;
+}
+
+TEST(TreeIndex, Query) {
+  TreeIndex tree;
+  EXPECT_EQ(tree.Load(WriteTree()), 0);
+  EXPECT_EQ(tree.TotalNodeNums(), 12);
+  EXPECT_EQ(tree.EmbSize(), 112);
+  EXPECT_EQ(tree.GetLayerCodes(1), std::vector<uint64_t>({1, 2, 3}));
+  EXPECT_EQ(tree.GetLayerCodes(2).size(), 8);
+  EXPECT_EQ(tree.GetAllLeafs().size(), 8);
+
+  auto nodes = tree.GetNodes({7, 12});
+  EXPECT_EQ(nodes[0].id(), 107);
+  EXPECT_TRUE(nodes[0].is_leaf());
+  EXPECT_EQ(nodes[1].id(), 0);
+
+  // 107 is a child of 2, 200 no leaf
+  EXPECT_EQ(tree.GetAncestorCodes({107, 111, 200}, 1),
+            std::vector<uint64_t>({2, 3, tree.max_code_}));
+  EXPECT_EQ(tree.GetAncestorCodes({107}, 0), std::vector<uint64_t>({0}));
+  EXPECT_EQ(tree.GetTravelCodes(107, 0), std::vector<uint64_t>({7, 2, 0}));
+
+  EXPECT_EQ(tree.GetChildrenCodes(2, 2), std::vector<uint64_t>({7, 8, 9}));
+  EXPECT_EQ(tree.GetChildrenCodes(std::vector<uint64_t>({1, 3}), 2),
+            std::vector<uint64_t>({4, 5, 6, 10, 11}));
+  EXPECT_EQ(tree.GetChildrenCodes(0, 2).size(), 8);
+  EXPECT_EQ(tree.GetChildrenCodes(0, 1), std::vector<uint64_t>({1, 2, 3}));
+}
+
+TEST(LayerWiseSampler, Sample) {
+  IndexWrapper::GetInstance()->insert_tree_index("sampler_test", WriteTree());
+  LayerWiseSampler sampler("sampler_test");
+  // a negative of the leaves, two of the level 1
+  sampler.init_layerwise_conf({2}, 1, 7);
+
+  // more targets than a chunk, sampled by several threads
+  std::vector<uint64_t> leafs = {104, 105, 106, 107, 108, 109, 110, 111};
+  std::vector<std::vector<uint64_t>> user_inputs;
+  std::vector<uint64_t> targets;
+  for (size_t i = 0; i < 1000; ++i) {
+    user_inputs.push_back({leafs[i % 8], 200});
+    targets.push_back(leafs[(i + 3) % 8]);
+  }
+  auto outputs = sampler.sample(user_inputs, targets, true);
+  ASSERT_EQ(outputs.size(), 1000 * 5);
+
+  std::set<uint64_t> level_leafs(leafs.begin(), leafs.end());
+  std::set<uint64_t> level_1 = {101, 102, 103};
+  for (size_t i = 0; i < targets.size(); ++i) {
+    auto* rows = &outputs[i * 5];
+    uint64_t parent = (targets[i] - 100 - 1) / 3 + 100;
+    uint64_t user_parent = (user_inputs[i][0] - 100 - 1) / 3 + 100;
+
+    EXPECT_EQ(rows[0], std::vector<uint64_t>(
+                           {user_inputs[i][0], 200, targets[i], 1}));
+    EXPECT_EQ(rows[1][3], 0);
+    EXPECT_NE(rows[1][2], targets[i]);
+    EXPECT_EQ(level_leafs.count(rows[1][2]), 1);
+
+    // the users of the upper level are the ancestors, 0 where not in the tree
+    EXPECT_EQ(rows[2], std::vector<uint64_t>({user_parent, 0, parent, 1}));
+    for (int j = 3; j < 5; ++j) {
+      EXPECT_EQ(rows[j][0], user_parent);
+      EXPECT_EQ(rows[j][3], 0);
+      EXPECT_NE(rows[j][2], parent);
+      EXPECT_EQ(level_1.count(rows[j][2]), 1);
+    }
+  }
+}
+
+}  // namespace distributed
+}  // namespace paddle
@@ -18,6 +18,7 @@ limitations under the License. */
 #endif
 
 #include "paddle/fluid/framework/data_feed.h"
+#include <zlib.h>
 #ifdef _LINUX
 #include <stdio_ext.h>
 #include <sys/mman.h>
@@ -36,6 +37,181 @@ DLManager& global_dlmanager_pool() {
   return manager;
 }
 
+// The records shorter than this are not worth a deflate stream.
+static constexpr size_t kRecordDeflateMinBytes = 128;
+static constexpr char kRecordPlain = 0;
+static constexpr char kRecordDeflated = 1;
+
+static void AppendVarint(std::string* out, uint64_t x) {
+  while (x >= 0x80) {
+    out->push_back(static_cast<char>(x | 0x80));
+    x >>= 7;
+  }
+  out->push_back(static_cast<char>(x));
+}
+
+static uint64_t ReadVarint(const std::string& in, size_t* pos) {
+  uint64_t x = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    PADDLE_ENFORCE_LT(*pos, in.size(),
+                      platform::errors::InvalidArgument(
+                          "The compressed record is truncated."));
+    uint8_t byte = static_cast<uint8_t>(in[(*pos)++]);
+    x |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      return x;
+    }
+  }
+  PADDLE_THROW(platform::errors::InvalidArgument(
+      "The compressed record has a bad varint."));
+}
+
+// Feasigns are grouped by slot as they are parsed, so a record is a few runs
+// of feasigns of the same slot.
+static size_t SlotRunEnd(const std::vector<FeatureItem>& items, size_t begin) {
+  size_t end = begin;
+  while (end < items.size() && items[end].slot() == items[begin].slot()) {
+    ++end;
+  }
+  return end;
+}
+
+void CompressRecord(Record* r) {
+  if (!r->compressed_.empty()) {
+    return;
+  }
+  std::string raw;
+  raw.reserve(r->uint64_feasigns_.size() * 4 +
+              r->float_feasigns_.size() * sizeof(float) +
+              r->content_.size() + 16);
+
+  const auto& uint64_feasigns = r->uint64_feasigns_;
+  AppendVarint(&raw, uint64_feasigns.size());
+  for (size_t i = 0; i < uint64_feasigns.size();) {
+    size_t end = SlotRunEnd(uint64_feasigns, i);
+    AppendVarint(&raw, uint64_feasigns[i].slot());
+    AppendVarint(&raw, end - i);
+    uint64_t last = 0;
+    for (; i < end; ++i) {
+      uint64_t sign = uint64_feasigns[i].sign().uint64_feasign_;
+      uint64_t delta = sign - last;
+      // zigzag, so that a small step down is a short varint too
+      AppendVarint(&raw, (delta << 1) ^ (0 - (delta >> 63)));
+      last = sign;
+    }
+  }
+
+  const auto& float_feasigns = r->float_feasigns_;
+  AppendVarint(&raw, float_feasigns.size());
+  for (size_t i = 0; i < float_feasigns.size();) {
+    size_t end = SlotRunEnd(float_feasigns, i);
+    AppendVarint(&raw, float_feasigns[i].slot());
+    AppendVarint(&raw, end - i);
+    for (; i < end; ++i) {
+      float sign = float_feasigns[i].sign().float_feasign_;
+      raw.append(reinterpret_cast<const char*>(&sign), sizeof(sign));
+    }
+  }
+
+  AppendVarint(&raw, r->content_.size());
+  raw.append(r->content_);
+
+  std::string& out = r->compressed_;
+  if (raw.size() >= kRecordDeflateMinBytes) {
+    out.push_back(kRecordDeflated);
+    AppendVarint(&out, raw.size());
+    size_t header = out.size();
+    uLongf size = compressBound(raw.size());
+    out.resize(header + size);
+    if (compress2(reinterpret_cast<Bytef*>(&out[header]), &size,
+                  reinterpret_cast<const Bytef*>(raw.data()), raw.size(),
+                  Z_BEST_SPEED) == Z_OK &&
+        header + size < raw.size() + 1) {
+      out.resize(header + size);
+    } else {
+      out.clear();
+    }
+  }
+  if (out.empty()) {
+    out.push_back(kRecordPlain);
+    out.append(raw);
+  }
+  out.shrink_to_fit();
+
+  std::vector<FeatureItem>().swap(r->uint64_feasigns_);
+  std::vector<FeatureItem>().swap(r->float_feasigns_);
+  std::string().swap(r->content_);
+}
+
+void DecompressRecord(Record* r) {
+  if (r->compressed_.empty()) {
+    return;
+  }
+  const std::string* raw = &r->compressed_;
+  size_t pos = 1;
+  std::string inflated;
+  if (r->compressed_[0] == kRecordDeflated) {
+    uLongf size = ReadVarint(r->compressed_, &pos);
+    inflated.resize(size);
+    PADDLE_ENFORCE_EQ(
+        uncompress(reinterpret_cast<Bytef*>(&inflated[0]), &size,
+                   reinterpret_cast<const Bytef*>(r->compressed_.data() + pos),
+                   r->compressed_.size() - pos),
+        Z_OK, platform::errors::InvalidArgument(
+                  "Failed to inflate the compressed record."));
+    raw = &inflated;
+    pos = 0;
+  }
+
+  size_t num = ReadVarint(*raw, &pos);
+  r->uint64_feasigns_.clear();
+  r->uint64_feasigns_.reserve(num);
+  while (r->uint64_feasigns_.size() < num) {
+    uint16_t slot = ReadVarint(*raw, &pos);
+    size_t run = ReadVarint(*raw, &pos);
+    uint64_t last = 0;
+    for (size_t i = 0; i < run; ++i) {
+      uint64_t zigzag = ReadVarint(*raw, &pos);
+      FeatureFeasign f;
+      f.uint64_feasign_ = last + ((zigzag >> 1) ^ (0 - (zigzag & 1)));
+      r->uint64_feasigns_.push_back(FeatureItem(f, slot));
+      last = f.uint64_feasign_;
+    }
+  }
+
+  num = ReadVarint(*raw, &pos);
+  r->float_feasigns_.clear();
+  r->float_feasigns_.reserve(num);
+  while (r->float_feasigns_.size() < num) {
+    uint16_t slot = ReadVarint(*raw, &pos);
+    size_t run = ReadVarint(*raw, &pos);
+    PADDLE_ENFORCE_LE(pos + run * sizeof(float), raw->size(),
+                      platform::errors::InvalidArgument(
+                          "The compressed record is truncated."));
+    for (size_t i = 0; i < run; ++i) {
+      FeatureFeasign f;
+      memcpy(&f.float_feasign_, raw->data() + pos, sizeof(float));
+      pos += sizeof(float);
+      r->float_feasigns_.push_back(FeatureItem(f, slot));
+    }
+  }
+
+  size_t content_size = ReadVarint(*raw, &pos);
+  PADDLE_ENFORCE_LE(pos + content_size, raw->size(),
+                    platform::errors::InvalidArgument(
+                        "The compressed record is truncated."));
+  r->content_.assign(raw->data() + pos, content_size);
+  std::string().swap(r->compressed_);
+}
+
+size_t RecordMemorySize(const Record& r) {
+  return sizeof(Record) +
+         (r.uint64_feasigns_.capacity() + r.float_feasigns_.capacity()) *
+             sizeof(FeatureItem) +
+         r.ins_id_.capacity() + r.content_.capacity() +
+         r.compressed_.capacity();
+}
+
 void RecordCandidateList::ReSize(size_t length) {
   mutex_.lock();
   capacity_ = length;
@@ -241,6 +417,7 @@ InMemoryDataFeed<T>::InMemoryDataFeed() {
   this->parse_content_ = false;
   this->parse_logkey_ = false;
   this->enable_pv_merge_ = false;
+  this->compress_memory_ = false;
   this->current_phase_ = 1;  // 1:join ;0:update
   this->input_channel_ = nullptr;
   this->output_channel_ = nullptr;
@@ -368,6 +545,11 @@ void InMemoryDataFeed<T>::SetParseInsId(bool parse_ins_id) {
   parse_ins_id_ = parse_ins_id;
 }
 
+template <typename T>
+void InMemoryDataFeed<T>::SetCompressMemory(bool compress_memory) {
+  compress_memory_ = compress_memory;
+}
+
 template <typename T>
 void InMemoryDataFeed<T>::LoadIntoMemory() {
 #ifdef _LINUX
@@ -398,6 +580,7 @@ void InMemoryDataFeed<T>::LoadIntoMemory() {
     platform::Timer timeline;
     timeline.Start();
     while (ParseOneInstanceFromPipe(&instance)) {
+      CompactInstance(&instance);
       writer << std::move(instance);
       instance = T();
     }
@@ -406,6 +589,12 @@ void InMemoryDataFeed<T>::LoadIntoMemory() {
       std::lock_guard<std::mutex> flock(*mutex_for_fea_num_);
       *total_fea_num_ += fea_num_;
       fea_num_ = 0;
+      if (total_memory_bytes_ != nullptr) {
+        *total_memory_bytes_ += memory_bytes_;
+        *total_raw_memory_bytes_ += raw_memory_bytes_;
+      }
+      memory_bytes_ = 0;
+      raw_memory_bytes_ = 0;
     }
     writer.Flush();
     timeline.Pause();
@@ -448,9 +637,17 @@ void InMemoryDataFeed<T>::LoadIntoMemoryFromSo() {
         ParseOneInstanceFromSo(str, &instance, parser);
       }
 
+      CompactInstance(&instance);
       writer << std::move(instance);
       instance = T();
     }
+    if (total_memory_bytes_ != nullptr) {
+      std::lock_guard<std::mutex> flock(*mutex_for_fea_num_);
+      *total_memory_bytes_ += memory_bytes_;
+      *total_raw_memory_bytes_ += raw_memory_bytes_;
+    }
+    memory_bytes_ = 0;
+    raw_memory_bytes_ = 0;
 
     writer.Flush();
     timeline.Pause();
@@ -1152,8 +1349,15 @@ void MultiSlotInMemoryDataFeed::PutToFeedVec(
   ins_content_vec_.reserve(ins_vec.size());
   ins_id_vec_.clear();
   ins_id_vec_.reserve(ins_vec.size());
+  Record decompressed;
   for (size_t i = 0; i < ins_vec.size(); ++i) {
-    auto& r = ins_vec[i];
+    const Record* rec = &ins_vec[i];
+    if (!rec->compressed_.empty()) {
+      decompressed = *rec;
+      DecompressRecord(&decompressed);
+      rec = &decompressed;
+    }
+    auto& r = *rec;
     ins_id_vec_.push_back(r.ins_id_);
     ins_content_vec_.push_back(r.content_);
     for (auto& item : r.float_feasigns_) {
@@ -1237,6 +1441,14 @@ void MultiSlotInMemoryDataFeed::PutToFeedVec(
 #endif
 }
 
+void MultiSlotInMemoryDataFeed::CompactInstance(Record* instance) {
+  raw_memory_bytes_ += RecordMemorySize(*instance);
+  if (compress_memory_) {
+    CompressRecord(instance);
+  }
+  memory_bytes_ += RecordMemorySize(*instance);
+}
+
 #if (defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)) && !defined(_WIN32)
 template <typename T>
 void PrivateInstantDataFeed<T>::PutToFeedVec() {
@@ -106,8 +106,21 @@ struct Record {
   uint64_t search_id;
   uint32_t rank;
   uint32_t cmatch;
+  // The feasigns and the content packed by CompressRecord, the fields they
+  // come from are empty then.
+  std::string compressed_;
 };
 
+// A dataset may keep its records compressed in memory: the slots and the
+// zigzag deltas of the feasigns of a slot are written as varints, followed
+// by the content, and the whole is deflated when that makes it smaller.
+// DecompressRecord restores the record, it does nothing on a record which is
+// not compressed.
+void CompressRecord(Record* r);
+void DecompressRecord(Record* r);
+// The bytes of memory a record holds.
+size_t RecordMemorySize(const Record& r);
+
 struct PvInstanceObject {
   std::vector<Record*> ads;
   void merge_instance(Record* ins) { ads.push_back(ins); }
@@ -272,6 +285,15 @@ class DataFeed {
   virtual void SetFeaNumMutex(std::mutex* mutex) { mutex_for_fea_num_ = mutex; }
   virtual void SetFileListIndex(size_t* file_index) { file_idx_ = file_index; }
   virtual void SetFeaNum(uint64_t* fea_num) { total_fea_num_ = fea_num; }
+  // This function will do nothing at default
+  virtual void SetCompressMemory(bool compress_memory) {}
+  // The bytes of the records loaded into memory, and the bytes they would
+  // take without compression, are added to these.
+  virtual void SetMemoryDataBytes(uint64_t* memory_bytes,
+                                  uint64_t* raw_memory_bytes) {
+    total_memory_bytes_ = memory_bytes;
+    total_raw_memory_bytes_ = raw_memory_bytes;
+  }
   virtual const std::vector<std::string>& GetInsIdVec() const {
     return ins_id_vec_;
   }
@@ -308,6 +330,10 @@ class DataFeed {
   std::mutex* mutex_for_fea_num_ = nullptr;
   uint64_t* total_fea_num_ = nullptr;
   uint64_t fea_num_ = 0;
+  uint64_t* total_memory_bytes_ = nullptr;
+  uint64_t* total_raw_memory_bytes_ = nullptr;
+  uint64_t memory_bytes_ = 0;
+  uint64_t raw_memory_bytes_ = 0;
 
   // the alias of used slots, and its order is determined by
   // data_feed_desc(proto object)
@@ -413,6 +439,7 @@ class InMemoryDataFeed : public DataFeed {
   virtual void SetParseLogKey(bool parse_logkey);
   virtual void SetEnablePvMerge(bool enable_pv_merge);
   virtual void SetCurrentPhase(int current_phase);
+  virtual void SetCompressMemory(bool compress_memory);
   virtual void LoadIntoMemory();
   virtual void LoadIntoMemoryFromSo();
 
@@ -422,6 +449,9 @@ class InMemoryDataFeed : public DataFeed {
   virtual void ParseOneInstanceFromSo(const char* str, T* instance,
                                       CustomParser* parser) {}
   virtual void PutToFeedVec(const std::vector<T>& ins_vec) = 0;
+  // Called on every instance before it is kept in memory, it may compress
+  // the instance and should count its bytes.
+  virtual void CompactInstance(T* instance) {}
 
   int thread_id_;
   int thread_num_;
@@ -429,6 +459,7 @@ class InMemoryDataFeed : public DataFeed {
   bool parse_content_;
   bool parse_logkey_;
   bool enable_pv_merge_;
+  bool compress_memory_;
   int current_phase_{-1};  // only for untest
   std::ifstream file_;
   std::shared_ptr<FILE> fp_;
@@ -739,6 +770,7 @@ paddle::framework::Archive<AR>& operator<<(paddle::framework::Archive<AR>& ar,
   ar << r.uint64_feasigns_;
   ar << r.float_feasigns_;
   ar << r.ins_id_;
+  ar << r.compressed_;
   return ar;
 }
 
@@ -748,6 +780,7 @@ paddle::framework::Archive<AR>& operator>>(paddle::framework::Archive<AR>& ar,
   ar >> r.uint64_feasigns_;
   ar >> r.float_feasigns_;
   ar >> r.ins_id_;
+  ar >> r.compressed_;
   return ar;
 }
 
@@ -784,6 +817,7 @@ class MultiSlotInMemoryDataFeed : public InMemoryDataFeed<Record> {
   virtual void ParseOneInstanceFromSo(const char* str, Record* instance,
                                       CustomParser* parser);
   virtual void PutToFeedVec(const std::vector<Record>& ins_vec);
+  virtual void CompactInstance(Record* instance);
   virtual void GetMsgFromLogKey(const std::string& log_key, uint64_t* search_id,
                                 uint32_t* cmatch, uint32_t* rank);
   std::vector<std::vector<float>> batch_float_feasigns_;
@@ -47,6 +47,9 @@ DatasetImpl<T>::DatasetImpl() {
   parse_ins_id_ = false;
   parse_content_ = false;
   parse_logkey_ = false;
+  compress_memory_ = false;
+  total_memory_bytes_ = 0;
+  total_raw_memory_bytes_ = 0;
   preload_thread_num_ = 0;
   global_index_ = 0;
 }
@@ -125,6 +128,11 @@ void DatasetImpl<T>::SetParseContent(bool parse_content) {
   parse_content_ = parse_content;
 }
 
+template <typename T>
+void DatasetImpl<T>::SetCompressMemory(bool compress_memory) {
+  compress_memory_ = compress_memory;
+}
+
 template <typename T>
 void DatasetImpl<T>::SetParseLogKey(bool parse_logkey) {
   parse_logkey_ = parse_logkey;
@@ -239,6 +247,8 @@ void DatasetImpl<T>::LoadIntoMemory() {
   timeline.Pause();
   VLOG(3) << "DatasetImpl<T>::LoadIntoMemory() end"
           << ", memory data size=" << input_channel_->Size()
+          << ", memory data bytes=" << total_memory_bytes_
+          << " (uncompressed " << total_raw_memory_bytes_ << ")"
           << ", cost time=" << timeline.ElapsedSec() << " seconds";
 }
 
@@ -273,7 +283,9 @@ void DatasetImpl<T>::WaitPreLoadDone() {
   input_channel_->Close();
   int64_t in_chan_size = input_channel_->Size();
   input_channel_->SetBlockSize(in_chan_size / thread_num_ + 1);
-  VLOG(3) << "DatasetImpl<T>::WaitPreLoadDone() end";
+  VLOG(3) << "DatasetImpl<T>::WaitPreLoadDone() end"
+          << ", memory data bytes=" << total_memory_bytes_
+          << " (uncompressed " << total_raw_memory_bytes_ << ")";
 }
 
 // release memory data
@@ -331,6 +343,8 @@ void DatasetImpl<T>::ReleaseMemory() {
           << STAT_GET(STAT_total_feasign_num_in_mem) - total_fea_num_
           << ")";  // For Debug
   STAT_SUB(STAT_total_feasign_num_in_mem, total_fea_num_);
+  total_memory_bytes_ = 0;
+  total_raw_memory_bytes_ = 0;
 }
 
 // do local shuffle
@@ -621,9 +635,12 @@ void DatasetImpl<T>::CreateReaders() {
     readers_[i]->SetFileListIndex(&file_idx_);
     readers_[i]->SetFeaNumMutex(&mutex_for_fea_num_);
     readers_[i]->SetFeaNum(&total_fea_num_);
+    readers_[i]->SetMemoryDataBytes(&total_memory_bytes_,
+                                    &total_raw_memory_bytes_);
     readers_[i]->SetFileList(filelist_);
     readers_[i]->SetParseInsId(parse_ins_id_);
     readers_[i]->SetParseContent(parse_content_);
+    readers_[i]->SetCompressMemory(compress_memory_);
     readers_[i]->SetParseLogKey(parse_logkey_);
     readers_[i]->SetEnablePvMerge(enable_pv_merge_);
     // Notice: it is only valid for untest of test_paddlebox_datafeed.
@@ -692,8 +709,11 @@ void DatasetImpl<T>::CreatePreLoadReaders() {
     preload_readers_[i]->SetFileList(filelist_);
     preload_readers_[i]->SetFeaNumMutex(&mutex_for_fea_num_);
     preload_readers_[i]->SetFeaNum(&total_fea_num_);
+    preload_readers_[i]->SetMemoryDataBytes(&total_memory_bytes_,
+                                            &total_raw_memory_bytes_);
     preload_readers_[i]->SetParseInsId(parse_ins_id_);
     preload_readers_[i]->SetParseContent(parse_content_);
+    preload_readers_[i]->SetCompressMemory(compress_memory_);
     preload_readers_[i]->SetParseLogKey(parse_logkey_);
     preload_readers_[i]->SetEnablePvMerge(enable_pv_merge_);
     preload_readers_[i]->SetInputChannel(input_channel_.get());
@@ -720,6 +740,12 @@ int64_t DatasetImpl<T>::GetMemoryDataSize() {
   return input_channel_->Size();
 }
 
+template <typename T>
+std::pair<int64_t, int64_t> DatasetImpl<T>::GetMemoryDataBytes() {
+  std::lock_guard<std::mutex> lock(mutex_for_fea_num_);
+  return {total_memory_bytes_, total_raw_memory_bytes_};
+}
+
 template <typename T>
 int64_t DatasetImpl<T>::GetPvDataSize() {
   if (enable_pv_merge_) {
@@ -827,6 +853,10 @@ void MultiSlotDataset::PreprocessInstance() {
     input_channel_->Close();
     std::vector<PvInstance> pv_data;
     input_channel_->ReadAll(input_records_);
+    // pv instances are fed by pointer to the records
+    for (auto& rec : input_records_) {
+      DecompressRecord(&rec);
+    }
     int all_records_num = input_records_.size();
     std::vector<Record*> all_records;
     all_records.reserve(all_records_num);
@@ -912,8 +942,15 @@ void MultiSlotDataset::GenerateLocalTablesUnlock(int table_id, int feadim,
     std::vector<std::future<void>> task_futures;
     this->multi_output_channel_[i]->Close();
     this->multi_output_channel_[i]->ReadAll(vec_data);
+    Record decompressed;
     for (size_t j = 0; j < vec_data.size(); j++) {
-      for (auto& feature : vec_data[j].uint64_feasigns_) {
+      const Record* rec = &vec_data[j];
+      if (!rec->compressed_.empty()) {
+        decompressed = *rec;
+        DecompressRecord(&decompressed);
+        rec = &decompressed;
+      }
+      for (auto& feature : rec->uint64_feasigns_) {
         int shard = feature.sign().uint64_feasign_ % shard_num;
         task_keys[shard].push_back(feature.sign().uint64_feasign_);
       }
@@ -984,6 +1021,9 @@ void MultiSlotDataset::MergeByInsId() {
   recs.reserve(channel_data->Size());
   channel_data->ReadAll(recs);
   channel_data->Clear();
+  for (auto& rec : recs) {
+    DecompressRecord(&rec);
+  }
   std::sort(recs.begin(), recs.end(), [](const Record& a, const Record& b) {
     return a.ins_id_ < b.ins_id_;
   });
@@ -1123,6 +1163,11 @@ void MultiSlotDataset::MergeByInsId() {
   VLOG(3) << "results size " << results.size();
   LOG(WARNING) << "total drop ins num: " << drop_ins_num;
   results.shrink_to_fit();
+  if (compress_memory_) {
+    for (auto& rec : results) {
+      CompressRecord(&rec);
+    }
+  }
 
   auto fleet_ptr = FleetWrapper::GetInstance();
   std::shuffle(results.begin(), results.end(), fleet_ptr->LocalRandomEngine());
@@ -1271,6 +1316,10 @@ void MultiSlotDataset::PreprocessChannel(
       }
     }
   }
+  // the slots are shuffled on the original data, which is kept decompressed
+  for (auto& rec : slots_shuffle_original_data_) {
+    DecompressRecord(&rec);
+  }
   int end_size = 0;
   if (cur_channel_ == 0) {
     for (size_t i = 0; i < multi_output_channel_.size(); ++i) {
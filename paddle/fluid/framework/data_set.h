@@ -65,6 +65,9 @@ class Dataset {
   // set parse ins id
   virtual void SetParseInsId(bool parse_ins_id) = 0;
   virtual void SetParseContent(bool parse_content) = 0;
+  // keep the records compressed in memory, they are decompressed by batch
+  // when they are fed
+  virtual void SetCompressMemory(bool compress_memory) = 0;
   virtual void SetParseLogKey(bool parse_logkey) = 0;
   virtual void SetEnablePvMerge(bool enable_pv_merge) = 0;
   virtual bool EnablePvMerge() = 0;
@@ -116,6 +119,9 @@ class Dataset {
   virtual void DestroyReaders() = 0;
   // get memory data size
   virtual int64_t GetMemoryDataSize() = 0;
+  // get the bytes of the records loaded into memory, and the bytes they
+  // would take without compression
+  virtual std::pair<int64_t, int64_t> GetMemoryDataBytes() = 0;
   // get memory data size in input_pv_channel_
   virtual int64_t GetPvDataSize() = 0;
   // get shuffle data size
@@ -170,6 +176,7 @@ class DatasetImpl : public Dataset {
   virtual void SetChannelNum(int channel_num);
   virtual void SetParseInsId(bool parse_ins_id);
   virtual void SetParseContent(bool parse_content);
+  virtual void SetCompressMemory(bool compress_memory);
   virtual void SetParseLogKey(bool parse_logkey);
   virtual void SetEnablePvMerge(bool enable_pv_merge);
   virtual void SetMergeBySid(bool is_merge);
@@ -210,6 +217,7 @@ class DatasetImpl : public Dataset {
   virtual void CreateReaders();
   virtual void DestroyReaders();
   virtual int64_t GetMemoryDataSize();
+  virtual std::pair<int64_t, int64_t> GetMemoryDataBytes();
   virtual int64_t GetPvDataSize();
   virtual int64_t GetShuffleDataSize();
   virtual void MergeByInsId() {}
@@ -270,6 +278,8 @@ class DatasetImpl : public Dataset {
   std::vector<std::string> filelist_;
   size_t file_idx_;
   uint64_t total_fea_num_;
+  uint64_t total_memory_bytes_;
+  uint64_t total_raw_memory_bytes_;
   std::mutex mutex_for_pick_file_;
   std::mutex mutex_for_fea_num_;
   std::string fs_name_;
@@ -281,6 +291,7 @@ class DatasetImpl : public Dataset {
   bool parse_ins_id_;
   bool parse_content_;
   bool parse_logkey_;
+  bool compress_memory_;
   bool merge_by_sid_;
   bool enable_pv_merge_;  // True means to merge pv
   int current_phase_;     // 1 join, 0 update
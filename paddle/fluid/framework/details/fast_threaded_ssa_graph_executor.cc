@@ -13,6 +13,7 @@
 // limitations under the License.
 #include "paddle/fluid/framework/details/fast_threaded_ssa_graph_executor.h"
 
+#include <cstring>
 #include <deque>
 #include <memory>
 #include <string>
@@ -40,20 +41,30 @@ FastThreadedSSAGraphExecutor::FastThreadedSSAGraphExecutor(
       places_(places),
       graph_(graph),
       fetch_ctxs_(places),
-      pool_(strategy.num_threads_),
-      // add one more thread for generate op_deps
-      prepare_pool_(1) {
-  for (auto &op : ir::FilterByNodeWrapper<OpHandleBase>(*graph_)) {
-    int dep = static_cast<int>(op->NotReadyInputSize());
-    op_deps_.emplace(op, dep);
-    if (dep == 0) {
-      bootstrap_ops_.emplace_back(op);
-    }
-  }
-  PADDLE_ENFORCE_GT(op_deps_.size(), 0,
+      pool_(strategy.num_threads_) {
+  ops_ = ir::FilterByNodeWrapper<OpHandleBase>(*graph_);
+  num_graph_ops_ = ops_.size();
+  PADDLE_ENFORCE_GT(num_graph_ops_, 0,
                     platform::errors::PreconditionNotMet(
                         "The graph doesn't have operators."));
-  PrepareAtomicOpDeps();
+  for (size_t i = 0; i < num_graph_ops_; ++i) {
+    op_index_.emplace(ops_[i], i);
+  }
+
+  op_deps_.resize(num_graph_ops_);
+  pending_ops_.resize(num_graph_ops_);
+  fetch_pending_ops_.resize(num_graph_ops_);
+  for (size_t i = 0; i < num_graph_ops_; ++i) {
+    op_deps_[i] = static_cast<int>(ops_[i]->NotReadyInputSize());
+    if (op_deps_[i] == 0) {
+      bootstrap_ops_.emplace_back(i);
+    }
+    for (auto &output : ops_[i]->Outputs()) {
+      for (auto &pending_op : output->PendingOps()) {
+        pending_ops_[i].emplace_back(op_index_.at(pending_op));
+      }
+    }
+  }
 }
 
 FetchResultType FastThreadedSSAGraphExecutor::Run(
@@ -61,10 +72,14 @@ FetchResultType FastThreadedSSAGraphExecutor::Run(
   VLOG(3) << "enter FastThreadedSSAGraphExecutor Run";
   std::unique_ptr<platform::RecordEvent> event(
       new platform::RecordEvent("FastThreadedSSAGraphExecutorPrepare"));
-  std::unique_ptr<std::unordered_map<OpHandleBase *, std::atomic<int>>>
-      op_deps = atomic_op_deps_.get();
-  PrepareAtomicOpDeps();
-  size_t num_ops = op_deps->size();
+  // drop the fetch ops of the last run
+  ops_.resize(num_graph_ops_);
+  op_deps_.resize(num_graph_ops_);
+  for (auto producer : fetch_producers_) {
+    fetch_pending_ops_[producer].clear();
+  }
+  fetch_producers_.clear();
+  size_t num_ops = num_graph_ops_;
 
   FetchResultType fetches;
   if (return_merged) {
@@ -74,10 +89,11 @@ FetchResultType FastThreadedSSAGraphExecutor::Run(
   }
   std::unordered_map<std::string, std::vector<VarHandleBase *>> fetched_vars;
   std::vector<OpHandleBase *> fetch_ops;
-  std::vector<OpHandleBase *> ready_fetch_ops;
+  std::vector<size_t> ready_fetch_ops;
   exception_.Clear();
-  InsertFetchOps(fetch_tensors, &fetches, &fetched_vars, op_deps.get(),
-                 &fetch_ops, &ready_fetch_ops, return_merged);
+  InsertFetchOps(fetch_tensors, &fetches, &fetched_vars, &fetch_ops,
+                 &ready_fetch_ops, return_merged);
+  ResetAtomicOpDeps();
   event.reset(nullptr);
   if (strategy_.num_threads_ == 1 && traced_ops_.size() == num_ops) {
     // If the num_threads is 1, we can record the order of operator's
@@ -92,37 +108,33 @@ FetchResultType FastThreadedSSAGraphExecutor::Run(
     }
   } else {
     traced_ops_.clear();
-    remaining_ = 0;
-    auto complete_q = std::make_shared<BlockingQueue<size_t>>();
+    // the main thread holds one count until all the bootstrap ops are sent,
+    // so that remaining_ can not drop to zero before that
+    remaining_ = 1;
+    num_complete_ = 0;
+    finished_ = false;
     VLOG(3) << "number of bootstrap_ops_: " << bootstrap_ops_.size();
     VLOG(3) << "number of ready_fetch_ops: " << ready_fetch_ops.size();
-    for (auto op : bootstrap_ops_) {
-      RunOpAsync(op_deps.get(), op, complete_q);
+    for (auto op_idx : bootstrap_ops_) {
+      RunOpAsync(atomic_op_deps_.get(), op_idx);
     }
-    for (auto op : ready_fetch_ops) {
-      RunOpAsync(op_deps.get(), op, complete_q);
+    for (auto op_idx : ready_fetch_ops) {
+      RunOpAsync(atomic_op_deps_.get(), op_idx);
     }
+    FinishTask(0);
 
-    size_t num_complete = 0;
-    while (num_complete != op_deps->size()) {
-      size_t num_comp = complete_q->Pop();
-      if (num_comp == -1UL) {
-        int remaining = 0;
-        while (true) {
-          remaining = remaining_;
-          if (remaining == 0) {
-            break;
-          }
-          for (int i = 0; i < remaining; ++i) {
-            complete_q->Pop();
-          }
-        }
-        if (exception_.IsCaught()) {
-          ExecutionFinal(&fetch_ops);
-        }
-      }
-      num_complete += num_comp;
+    {
+      std::unique_lock<std::mutex> lock(finish_mutex_);
+      finish_cv_.wait(lock, [this] { return finished_; });
     }
+    if (exception_.IsCaught()) {
+      ExecutionFinal(&fetch_ops);
+    }
+    PADDLE_ENFORCE_EQ(num_complete_.load(), ops_.size(),
+                      platform::errors::PreconditionNotMet(
+                          "Only %d of the %d operators were run, the graph "
+                          "may have a cycle.",
+                          num_complete_.load(), ops_.size()));
   }
   // Wait FetchOps.
   ClearFetchOp(graph_, &fetch_ops);
@@ -137,9 +149,8 @@ FetchResultType FastThreadedSSAGraphExecutor::Run(
 void FastThreadedSSAGraphExecutor::InsertFetchOps(
     const std::vector<std::string> &fetch_tensors, FetchResultType *fetches,
     std::unordered_map<std::string, std::vector<VarHandleBase *>> *fetched_vars,
-    std::unordered_map<OpHandleBase *, std::atomic<int>> *op_deps,
     std::vector<OpHandleBase *> *fetch_ops,
-    std::vector<OpHandleBase *> *ready_fetch_ops, bool return_merged) {
+    std::vector<size_t> *ready_fetch_ops, bool return_merged) {
   std::unordered_set<std::string> fetch_tensor_set(fetch_tensors.begin(),
                                                    fetch_tensors.end());
   for (auto &fetch_var_name : fetch_tensor_set) {
@@ -193,17 +204,29 @@ void FastThreadedSSAGraphExecutor::InsertFetchOps(
       }
     }
 
+    size_t op_idx = ops_.size();
+    ops_.emplace_back(op);
     int dep = static_cast<int>(op->NotReadyInputSize());
-    (*op_deps)[op] = dep;
+    op_deps_.emplace_back(dep);
     if (dep == 0) {
-      ready_fetch_ops->emplace_back(op);
+      ready_fetch_ops->emplace_back(op_idx);
+    }
+
+    std::unordered_set<VarHandleBase *> inputs(op->Inputs().begin(),
+                                               op->Inputs().end());
+    for (auto *var : inputs) {
+      auto *producer = var->GeneratedOp();
+      if (producer == nullptr) continue;
+      size_t producer_idx = op_index_.at(producer);
+      if (fetch_pending_ops_[producer_idx].empty()) {
+        fetch_producers_.emplace_back(producer_idx);
+      }
+      fetch_pending_ops_[producer_idx].emplace_back(op_idx);
     }
   }
 }
 
-bool FastThreadedSSAGraphExecutor::RunOp(
-    OpHandleBase *op, const std::shared_ptr<BlockingQueue<size_t>> &complete_q,
-    size_t *complete) {
+bool FastThreadedSSAGraphExecutor::RunOp(OpHandleBase *op, size_t *complete) {
   RunOpSync(op);
   if (LIKELY(!exception_.IsCaught())) {
     if (LIKELY(!strategy_.dry_run_)) {
@@ -212,25 +235,31 @@ bool FastThreadedSSAGraphExecutor::RunOp(
     ++(*complete);
     return true;
   } else {
-    --remaining_;
-    complete_q->Push(-1UL);
     return false;
   }
 }
 
-void FastThreadedSSAGraphExecutor::RunOpAsync(
-    std::unordered_map<OpHandleBase *, std::atomic<int>> *op_deps,
-    OpHandleBase *op,
-    const std::shared_ptr<BlockingQueue<size_t>> &complete_q) {
+void FastThreadedSSAGraphExecutor::FinishTask(size_t complete) {
+  num_complete_.fetch_add(complete);
+  if (remaining_.fetch_sub(1) == 1) {
+    std::lock_guard<std::mutex> lock(finish_mutex_);
+    finished_ = true;
+    finish_cv_.notify_one();
+  }
+}
+
+void FastThreadedSSAGraphExecutor::RunOpAsync(std::atomic<int> *op_deps,
+                                              size_t op_idx) {
   ++remaining_;
   this->pool_.enqueue([=] {
-    std::deque<OpHandleBase *> op_queue;
-    op_queue.push_front(op);
+    std::deque<size_t> op_queue;
+    op_queue.push_front(op_idx);
 
     size_t complete = 0;
     while (!op_queue.empty()) {
-      OpHandleBase *op_to_run = op_queue.back();
+      size_t idx_to_run = op_queue.back();
       op_queue.pop_back();
+      OpHandleBase *op_to_run = ops_[idx_to_run];
 
       // The Op involves data transfer of multiple devices may block other
       // computations emit. For example:
@@ -243,57 +272,66 @@ void FastThreadedSSAGraphExecutor::RunOpAsync(
       // Therefore, emit the op in the queue before running multi device op.
       if (op_to_run->IsMultiDeviceTransfer()) {
         while (!op_queue.empty()) {
-          OpHandleBase *post_op = op_queue.back();
+          size_t post_op = op_queue.back();
           op_queue.pop_back();
-          RunOpAsync(op_deps, post_op, complete_q);
+          RunOpAsync(op_deps, post_op);
         }
       }
       VLOG(3) << "start to run op: " << op_to_run->Name();
-      if (!RunOp(op_to_run, complete_q, &complete)) {
+      if (!RunOp(op_to_run, &complete)) {
+        FinishTask(complete);
         return;
       }
-      auto &outputs = op_to_run->Outputs();
-      op_to_run = nullptr;
-      for (auto &output : outputs) {
-        for (auto &pending_op : output->PendingOps()) {
-          std::atomic<int> &deps = op_deps->at(pending_op);
-          if (deps.fetch_sub(1) != 1) continue;
-
-          // NOTE(zjl): op with highest priority should run
-          // first without switching to another thread.
-          if (pending_op->GetPriority() == OpHandleBase::Priority::kHighest) {
-            op_queue.push_back(pending_op);
-          } else if (pending_op->IsMultiDeviceTransfer()) {
-            // multi device ops should be scheduled prior to computing ops
-            op_queue.push_front(pending_op);
+
+      // The first ready successor runs on this thread right after, the
+      // others are sent to the pool.
+      size_t next_idx = ops_.size();
+      auto on_input_ready = [&](size_t pending_idx) {
+        if (op_deps[pending_idx].fetch_sub(1) != 1) return;
+
+        OpHandleBase *pending_op = ops_[pending_idx];
+        // NOTE(zjl): op with highest priority should run
+        // first without switching to another thread.
+        if (pending_op->GetPriority() == OpHandleBase::Priority::kHighest) {
+          op_queue.push_back(pending_idx);
+        } else if (pending_op->IsMultiDeviceTransfer()) {
+          // multi device ops should be scheduled prior to computing ops
+          op_queue.push_front(pending_idx);
+        } else {
+          if (next_idx == ops_.size()) {
+            next_idx = pending_idx;
           } else {
-            if (op_to_run == nullptr) {
-              op_to_run = pending_op;
-            } else {
-              RunOpAsync(op_deps, pending_op, complete_q);
-            }
+            RunOpAsync(op_deps, pending_idx);
           }
         }
+      };
+      // fetch ops are never the inputs of other ops
+      if (idx_to_run < num_graph_ops_) {
+        for (auto pending_idx : pending_ops_[idx_to_run]) {
+          on_input_ready(pending_idx);
+        }
+        for (auto pending_idx : fetch_pending_ops_[idx_to_run]) {
+          on_input_ready(pending_idx);
+        }
       }
 
-      if (op_to_run != nullptr) {
-        op_queue.push_front(op_to_run);
+      if (next_idx != ops_.size()) {
+        op_queue.push_front(next_idx);
       }
     }
-    --remaining_;
-    complete_q->Push(complete);
+    FinishTask(complete);
   });
 }
 
-void FastThreadedSSAGraphExecutor::PrepareAtomicOpDeps() {
-  atomic_op_deps_ = prepare_pool_.enqueue([&] {
-    auto *op_deps = new std::unordered_map<OpHandleBase *, std::atomic<int>>;
-    for (auto &pair : op_deps_) {
-      (*op_deps)[pair.first] = pair.second;
-    }
-    return std::unique_ptr<
-        std::unordered_map<OpHandleBase *, std::atomic<int>>>(op_deps);
-  });
+void FastThreadedSSAGraphExecutor::ResetAtomicOpDeps() {
+  static_assert(sizeof(std::atomic<int>) == sizeof(int),
+                "std::atomic<int> must have the layout of int");
+  if (atomic_op_deps_size_ < op_deps_.size()) {
+    atomic_op_deps_.reset(new std::atomic<int>[op_deps_.size()]);
+    atomic_op_deps_size_ = op_deps_.size();
+  }
+  std::memcpy(static_cast<void *>(atomic_op_deps_.get()), op_deps_.data(),
+              sizeof(int) * op_deps_.size());
 }
 
 const ir::Graph &FastThreadedSSAGraphExecutor::Graph() const { return *graph_; }
@@ -14,11 +14,13 @@
 
 #pragma once
 #include <ThreadPool.h>
+#include <atomic>
+#include <condition_variable>  // NOLINT
 #include <memory>
+#include <mutex>  // NOLINT
 #include <string>
 #include <unordered_map>
 #include <vector>
-#include "paddle/fluid/framework/blocking_queue.h"
 #include "paddle/fluid/framework/details/exception_holder.h"
 #include "paddle/fluid/framework/details/execution_strategy.h"
 #include "paddle/fluid/framework/details/ssa_graph_executor.h"
@@ -49,31 +51,48 @@ class FastThreadedSSAGraphExecutor : public SSAGraphExecutor {
   std::vector<platform::Place> places_;
   ir::Graph *graph_;
 
-  std::unordered_map<OpHandleBase *, int> op_deps_;
-  std::vector<OpHandleBase *> bootstrap_ops_;
+  // The graph is flattened once: ops_[i] waits for op_deps_[i] inputs and
+  // its outputs are the inputs of pending_ops_[i]. The fetch ops of a run are
+  // appended after the num_graph_ops_ graph ops and removed at the next run.
+  size_t num_graph_ops_;
+  std::vector<OpHandleBase *> ops_;
+  std::unordered_map<OpHandleBase *, size_t> op_index_;
+  std::vector<int> op_deps_;
+  std::vector<std::vector<size_t>> pending_ops_;
+  std::vector<size_t> bootstrap_ops_;
+
+  // fetch_pending_ops_[i] are the fetch ops waiting for graph op i, only
+  // the ops in fetch_producers_ have any.
+  std::vector<std::vector<size_t>> fetch_pending_ops_;
+  std::vector<size_t> fetch_producers_;
+
+  // Reset from op_deps_ with a memcpy before every run.
+  std::unique_ptr<std::atomic<int>[]> atomic_op_deps_;
+  size_t atomic_op_deps_size_{0};
 
   platform::DeviceContextPool fetch_ctxs_;
+
+  // The tasks in flight finish without locking, only the last one wakes up
+  // the thread waiting in Run.
   std::atomic<int> remaining_;
+  std::atomic<size_t> num_complete_;
+  std::mutex finish_mutex_;
+  std::condition_variable finish_cv_;
+  bool finished_{false};
 
-  std::future<
-      std::unique_ptr<std::unordered_map<OpHandleBase *, std::atomic<int>>>>
-      atomic_op_deps_;
   ExceptionHolder exception_;
 
   ::ThreadPool pool_;
-  ::ThreadPool prepare_pool_;
 
   std::vector<OpHandleBase *> traced_ops_;
 
-  bool RunOp(OpHandleBase *op,
-             const std::shared_ptr<BlockingQueue<size_t>> &complete_q,
-             size_t *complete);
+  bool RunOp(OpHandleBase *op, size_t *complete);
+
+  void RunOpAsync(std::atomic<int> *op_deps, size_t op_idx);
 
-  void RunOpAsync(std::unordered_map<OpHandleBase *, std::atomic<int>> *op_deps,
-                  OpHandleBase *op,
-                  const std::shared_ptr<BlockingQueue<size_t>> &complete_q);
+  void FinishTask(size_t complete);
 
-  void PrepareAtomicOpDeps();
+  void ResetAtomicOpDeps();
 
   inline void RecordOps(OpHandleBase *op);
 
@@ -87,9 +106,8 @@ class FastThreadedSSAGraphExecutor : public SSAGraphExecutor {
       const std::vector<std::string> &fetch_tensors, FetchResultType *fetches,
       std::unordered_map<std::string, std::vector<VarHandleBase *>>
           *fetched_vars,
-      std::unordered_map<OpHandleBase *, std::atomic<int>> *op_deps,
       std::vector<OpHandleBase *> *fetch_ops,
-      std::vector<OpHandleBase *> *ready_fetch_ops, bool return_merged);
+      std::vector<size_t> *ready_fetch_ops, bool return_merged);
 };
 }  // namespace details
 }  // namespace framework
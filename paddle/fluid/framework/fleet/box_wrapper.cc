@@ -268,6 +268,7 @@ void BoxWrapper::GetRandomData(
         const auto& ins = pass_data[i];
         const RecordCandidate& rand_rec = random_pool.Get(replace_idx_[i]);
         Record new_rec = ins;
+        DecompressRecord(&new_rec);
         for (auto it = new_rec.uint64_feasigns_.begin();
              it != new_rec.uint64_feasigns_.end();) {
           if (slots_to_replace.find(it->slot()) != slots_to_replace.end()) {
@@ -980,10 +980,16 @@ class BoxHelper {
                              const std::unordered_set<int>& index_map,
                              int thread_id) {
     p_agent->AddKey(0ul, thread_id);
+    Record decompressed;
     for (auto iter = t.begin() + begin_index; iter != t.begin() + end_index;
          iter++) {
-      const auto& ins = *iter;
-      const auto& feasign_v = ins.uint64_feasigns_;
+      const Record* rec = &*iter;
+      if (!rec->compressed_.empty()) {
+        decompressed = *rec;
+        DecompressRecord(&decompressed);
+        rec = &decompressed;
+      }
+      const auto& feasign_v = rec->uint64_feasigns_;
       for (const auto feasign : feasign_v) {
         if (index_map.find(feasign.slot()) != index_map.end()) {
           continue;
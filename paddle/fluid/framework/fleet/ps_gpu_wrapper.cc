@@ -75,10 +75,16 @@ void PSGPUWrapper::BuildTask(std::shared_ptr<HeterContext> gpu_task) {
   size_t begin = 0;
   auto gen_func = [this](const std::deque<Record>& total_data, int begin_index,
                          int end_index, int i) {
+    Record decompressed;
     for (auto iter = total_data.begin() + begin_index;
          iter != total_data.begin() + end_index; iter++) {
-      const auto& ins = *iter;
-      const auto& feasign_v = ins.uint64_feasigns_;
+      const Record* rec = &*iter;
+      if (!rec->compressed_.empty()) {
+        decompressed = *rec;
+        DecompressRecord(&decompressed);
+        rec = &decompressed;
+      }
+      const auto& feasign_v = rec->uint64_feasigns_;
       for (const auto feasign : feasign_v) {
         uint64_t cur_key = feasign.sign().uint64_feasign_;
         int shard_id = cur_key % thread_keys_shard_num_;
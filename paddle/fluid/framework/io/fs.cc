@@ -15,11 +15,34 @@ limitations under the License. */
 #include "paddle/fluid/framework/io/fs.h"
 
 #include <sys/stat.h>
+#if !defined(_WIN32)
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <future>  // NOLINT
+#include <map>
 #include <memory>
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <utility>
 
+#include "ThreadPool.h"
+#include "gflags/gflags.h"
 #include "glog/logging.h"
 #include "paddle/fluid/platform/enforce.h"
 
+DEFINE_int32(fs_read_thread_num, 16,
+             "The number of threads shared by the chunked reads of the files "
+             "of the native fs backends, fs_set_read_threads overrides it.");
+
 namespace paddle {
 namespace framework {
 
@@ -111,7 +134,21 @@ std::shared_ptr<FILE> localfs_open_read(std::string path,
   }
 
   fs_add_read_converter_internal(path, is_pipe, converter);
-  return fs_open_internal(path, is_pipe, "r", localfs_buffer_size());
+  if (is_pipe) {
+    return fs_open_internal(path, is_pipe, "r", localfs_buffer_size());
+  }
+
+  // a plain file is read through a large buffer, and the kernel is told to
+  // read ahead of it
+  size_t buffer_size = localfs_buffer_size();
+  if (buffer_size == 0) {
+    buffer_size = fs_read_chunk_size();
+  }
+  auto fp = fs_open_internal(path, is_pipe, "r", buffer_size);
+#if defined(__linux__)
+  posix_fadvise(fileno(&*fp), 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+  return fp;
 }
 
 std::shared_ptr<FILE> localfs_open_write(std::string path,
@@ -351,6 +388,574 @@ void hdfs_mv(const std::string& src, const std::string& dest) {
       "%s -mv %s %s; true", hdfs_command().c_str(), src.c_str(), dest.c_str()));
 }
 
+std::string LocalFsBackend::LocalPath(const std::string& path) const {
+  if (!prefix_.empty() && fs_begin_with_internal(path, prefix_)) {
+    return path.substr(prefix_.length());
+  }
+  return path;
+}
+
+#if !defined(_WIN32)
+class LocalFsWriter : public FsWriter {
+ public:
+  LocalFsWriter(const std::string& path, int fd) : path_(path), fd_(fd) {}
+
+  ~LocalFsWriter() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  int64_t Write(const char* buf, size_t size) override {
+    size_t done = 0;
+    while (done < size) {
+      ssize_t n = write(fd_, buf + done, size - done);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n < 0) {
+        LOG(ERROR) << "Failed to write " << path_ << ": " << strerror(errno);
+        return -1;
+      }
+      done += n;
+    }
+    return done;
+  }
+
+  int Close() override {
+    int ret = close(fd_);
+    fd_ = -1;
+    return ret;
+  }
+
+ private:
+  std::string path_;
+  int fd_;
+};
+
+static int fs_remove_entry_internal(const char* path, const struct stat*,
+                                    int, struct FTW*) {
+  return remove(path);
+}
+#endif
+
+int64_t LocalFsBackend::ReadRange(const std::string& path, int64_t offset,
+                                  char* buf, size_t size) {
+#if defined(_WIN32)
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "LocalFsBackend is not supported on Windows."));
+  return -1;
+#else
+  int fd = open(LocalPath(path).c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG(ERROR) << "Failed to open " << path << ": " << strerror(errno);
+    return -1;
+  }
+  size_t done = 0;
+  while (done < size) {
+    ssize_t n = pread(fd, buf + done, size - done, offset + done);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      LOG(ERROR) << "Failed to read " << path << ": " << strerror(errno);
+      close(fd);
+      return -1;
+    }
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  close(fd);
+  return done;
+#endif
+}
+
+int64_t LocalFsBackend::FileSize(const std::string& path) {
+  return localfs_file_size(LocalPath(path));
+}
+
+std::unique_ptr<FsWriter> LocalFsBackend::OpenWrite(const std::string& path) {
+#if defined(_WIN32)
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "LocalFsBackend is not supported on Windows."));
+  return nullptr;
+#else
+  std::string local = LocalPath(path);
+  auto pos = local.find_last_of('/');
+  if (pos != std::string::npos && pos > 0) {
+    Mkdir(prefix_ + local.substr(0, pos));
+  }
+  int fd = open(local.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  PADDLE_ENFORCE_GE(fd, 0, platform::errors::Unavailable(
+                               "Failed to open %s for writing: %s.", path,
+                               strerror(errno)));
+  return std::unique_ptr<FsWriter>(new LocalFsWriter(path, fd));
+#endif
+}
+
+std::vector<std::string> LocalFsBackend::List(const std::string& path) {
+#if defined(_WIN32)
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "LocalFsBackend is not supported on Windows."));
+  return {};
+#else
+  std::string local = LocalPath(path);
+  struct stat buf;
+  if (local == "" || stat(local.c_str(), &buf) != 0) {
+    return {};
+  }
+  if (S_ISREG(buf.st_mode)) {
+    return {path};
+  }
+
+  std::vector<std::string> list;
+  DIR* dir = opendir(local.c_str());
+  if (dir == nullptr) {
+    return list;
+  }
+  std::string dir_path = path;
+  if (!fs_end_with_internal(dir_path, "/")) {
+    dir_path += "/";
+  }
+  while (struct dirent* entry = readdir(dir)) {
+    std::string name = entry->d_name;
+    if (stat((local + "/" + name).c_str(), &buf) == 0 &&
+        S_ISREG(buf.st_mode)) {
+      list.push_back(dir_path + name);
+    }
+  }
+  closedir(dir);
+  return list;
+#endif
+}
+
+bool LocalFsBackend::Exists(const std::string& path) {
+  struct stat buf;
+  return stat(LocalPath(path).c_str(), &buf) == 0;
+}
+
+void LocalFsBackend::Remove(const std::string& path) {
+#if defined(_WIN32)
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "LocalFsBackend is not supported on Windows."));
+#else
+  std::string local = LocalPath(path);
+  if (local == "" || !Exists(path)) {
+    return;
+  }
+  PADDLE_ENFORCE_EQ(
+      nftw(local.c_str(), fs_remove_entry_internal, 64, FTW_DEPTH | FTW_PHYS),
+      0, platform::errors::External("Failed to remove %s: %s.", path,
+                                    strerror(errno)));
+#endif
+}
+
+void LocalFsBackend::Mkdir(const std::string& path) {
+#if defined(_WIN32)
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "LocalFsBackend is not supported on Windows."));
+#else
+  std::string local = LocalPath(path);
+  for (size_t pos = local.find('/', 1);; pos = local.find('/', pos + 1)) {
+    std::string dir = local.substr(0, pos);
+    if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST) {
+      PADDLE_THROW(platform::errors::External("Failed to make directory %s: %s.",
+                                              dir, strerror(errno)));
+    }
+    if (pos == std::string::npos) {
+      break;
+    }
+  }
+#endif
+}
+
+void LocalFsBackend::Mv(const std::string& src, const std::string& dest) {
+  if (src == "" || dest == "") {
+    return;
+  }
+  PADDLE_ENFORCE_EQ(
+      rename(LocalPath(src).c_str(), LocalPath(dest).c_str()), 0,
+      platform::errors::External("Failed to move %s to %s: %s.", src, dest,
+                                 strerror(errno)));
+}
+
+static std::mutex& fs_backends_mutex_internal() {
+  static std::mutex x;
+  return x;
+}
+
+static std::map<std::string, std::shared_ptr<FsBackend>>&
+fs_backends_internal() {
+  static std::map<std::string, std::shared_ptr<FsBackend>> x;
+  return x;
+}
+
+void fs_register_backend(const std::string& prefix,
+                         std::shared_ptr<FsBackend> backend) {
+  PADDLE_ENFORCE_NOT_NULL(backend, platform::errors::InvalidArgument(
+                                       "The backend of %s is null.", prefix));
+  std::lock_guard<std::mutex> lock(fs_backends_mutex_internal());
+  fs_backends_internal()[prefix] = std::move(backend);
+}
+
+void fs_unregister_backend(const std::string& prefix) {
+  std::lock_guard<std::mutex> lock(fs_backends_mutex_internal());
+  fs_backends_internal().erase(prefix);
+}
+
+std::shared_ptr<FsBackend> fs_get_backend(const std::string& path) {
+  std::lock_guard<std::mutex> lock(fs_backends_mutex_internal());
+  std::shared_ptr<FsBackend> backend = nullptr;
+  size_t length = 0;
+  for (auto& kv : fs_backends_internal()) {
+    if (kv.first.length() >= length && fs_begin_with_internal(path, kv.first)) {
+      backend = kv.second;
+      length = kv.first.length();
+    }
+  }
+  return backend;
+}
+
+static size_t& fs_read_chunk_size_internal() {
+  static size_t x = 1 << 20;
+  return x;
+}
+
+static size_t& fs_read_ahead_chunks_internal() {
+  static size_t x = 4;
+  return x;
+}
+
+size_t fs_read_chunk_size() { return fs_read_chunk_size_internal(); }
+
+size_t fs_read_ahead_chunks() { return fs_read_ahead_chunks_internal(); }
+
+void fs_set_read_ahead(size_t chunk_size, size_t chunk_num) {
+  PADDLE_ENFORCE_GT(chunk_size, 0,
+                    platform::errors::InvalidArgument(
+                        "The read ahead chunk size should be positive."));
+  fs_read_chunk_size_internal() = chunk_size;
+  fs_read_ahead_chunks_internal() = std::max<size_t>(chunk_num, 1);
+}
+
+static size_t& fs_read_threads_internal() {
+  static size_t x = std::max(FLAGS_fs_read_thread_num, 1);
+  return x;
+}
+
+static std::mutex& fs_read_pool_mutex_internal() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+static std::shared_ptr<::ThreadPool>& fs_read_pool_ptr_internal() {
+  static std::shared_ptr<::ThreadPool> pool;
+  return pool;
+}
+
+size_t fs_read_threads() {
+  std::lock_guard<std::mutex> guard(fs_read_pool_mutex_internal());
+  return fs_read_threads_internal();
+}
+
+void fs_set_read_threads(size_t thread_num) {
+  PADDLE_ENFORCE_GT(thread_num, 0,
+                    platform::errors::InvalidArgument(
+                        "The native read thread number should be positive."));
+  std::lock_guard<std::mutex> guard(fs_read_pool_mutex_internal());
+  fs_read_threads_internal() = thread_num;
+  // the old pool is joined once the reads holding it are issued
+  fs_read_pool_ptr_internal().reset();
+}
+
+// The reads of all the native files are issued to one pool, the threads
+// mostly wait for the backend.
+static std::shared_ptr<::ThreadPool> fs_read_pool_internal() {
+  std::lock_guard<std::mutex> guard(fs_read_pool_mutex_internal());
+  auto& pool = fs_read_pool_ptr_internal();
+  if (pool == nullptr) {
+    pool.reset(new ::ThreadPool(fs_read_threads_internal()));
+  }
+  return pool;
+}
+
+static int64_t fs_read_full_internal(FsBackend* backend,
+                                     const std::string& path, int64_t offset,
+                                     char* buf, size_t size) {
+  size_t done = 0;
+  while (done < size) {
+    int64_t n =
+        backend->ReadRange(path, offset + done, buf + done, size - done);
+    PADDLE_ENFORCE_GE(n, 0, platform::errors::External(
+                                "Failed to read %s at offset %d.", path,
+                                offset + done));
+    if (n == 0) {
+      break;
+    }
+    done += n;
+  }
+  return done;
+}
+
+// The last line of a native file, read backwards by growing windows.
+static std::string fs_native_tail_internal(FsBackend* backend,
+                                           const std::string& path) {
+  int64_t size = backend->FileSize(path);
+  for (int64_t window = 1 << 16;; window *= 2) {
+    int64_t begin = std::max<int64_t>(size - window, 0);
+    std::string buf(size - begin, '\0');
+    buf.resize(fs_read_full_internal(backend, path, begin, &buf[0],
+                                     buf.size()));
+    while (!buf.empty() && buf.back() == '\n') {
+      buf.pop_back();
+    }
+    auto pos = buf.find_last_of('\n');
+    if (pos != std::string::npos) {
+      return buf.substr(pos + 1);
+    }
+    if (begin == 0) {
+      return buf;
+    }
+  }
+}
+
+int64_t fs_read_range(const std::string& path, int64_t offset, char* buf,
+                      size_t size) {
+  static std::shared_ptr<FsBackend> localfs(new LocalFsBackend());
+  auto backend = fs_get_backend(path);
+  if (backend == nullptr) {
+    backend = localfs;
+  }
+
+  size_t chunk_size = fs_read_chunk_size();
+  auto pool = fs_read_pool_internal();
+  std::vector<std::future<int64_t>> tasks;
+  for (size_t begin = 0; begin < size; begin += chunk_size) {
+    size_t length = std::min(chunk_size, size - begin);
+    tasks.emplace_back(pool->enqueue(
+        [backend, path, offset, buf, begin, length]() -> int64_t {
+          return fs_read_full_internal(backend.get(), path, offset + begin,
+                                       buf + begin, length);
+        }));
+  }
+  // every read writes into buf, which the caller frees on an error
+  for (auto& task : tasks) {
+    task.wait();
+  }
+  int64_t total = 0;
+  for (auto& task : tasks) {
+    total += task.get();
+  }
+  return total;
+}
+
+// Reads a native file in order, with the next chunks read ahead in the pool.
+// A task owns its chunk, so that the stream may go away before the tasks.
+class FsReadAheadStream {
+ public:
+  FsReadAheadStream(std::shared_ptr<FsBackend> backend, const std::string& path)
+      : backend_(std::move(backend)),
+        path_(path),
+        chunk_size_(fs_read_chunk_size()),
+        file_size_(backend_->FileSize(path)) {
+    for (size_t i = 0; i < fs_read_ahead_chunks(); ++i) {
+      Issue();
+    }
+  }
+
+  size_t Read(char* buf, size_t size) {
+    size_t done = 0;
+    while (done < size) {
+      if (cursor_ == chunk_.size()) {
+        if (pending_.empty()) {
+          break;
+        }
+        chunk_ = pending_.front().get();
+        pending_.pop_front();
+        cursor_ = 0;
+        if (chunk_.empty()) {
+          pending_.clear();
+          break;
+        }
+        Issue();
+      }
+      size_t n = std::min(size - done, chunk_.size() - cursor_);
+      memcpy(buf + done, chunk_.data() + cursor_, n);
+      cursor_ += n;
+      done += n;
+    }
+    return done;
+  }
+
+ private:
+  void Issue() {
+    if (next_offset_ >= file_size_) {
+      return;
+    }
+    size_t size = std::min<int64_t>(chunk_size_, file_size_ - next_offset_);
+    auto backend = backend_;
+    auto path = path_;
+    int64_t offset = next_offset_;
+    pending_.push_back(
+        fs_read_pool_internal()->enqueue([backend, path, offset, size]() {
+          std::string chunk(size, '\0');
+          chunk.resize(fs_read_full_internal(backend.get(), path, offset,
+                                             &chunk[0], size));
+          return chunk;
+        }));
+    next_offset_ += size;
+  }
+
+  std::shared_ptr<FsBackend> backend_;
+  std::string path_;
+  size_t chunk_size_;
+  int64_t file_size_;
+  int64_t next_offset_{0};
+  std::deque<std::future<std::string>> pending_;
+  std::string chunk_;
+  size_t cursor_{0};
+};
+
+#if defined(__linux__)
+static ssize_t fs_cookie_read_internal(void* cookie, char* buf, size_t size) {
+  try {
+    return static_cast<FsReadAheadStream*>(cookie)->Read(buf, size);
+  } catch (std::exception& e) {
+    LOG(ERROR) << e.what();
+    errno = EIO;
+    return -1;
+  }
+}
+
+static int fs_cookie_close_read_internal(void* cookie) {
+  delete static_cast<FsReadAheadStream*>(cookie);
+  return 0;
+}
+
+static ssize_t fs_cookie_write_internal(void* cookie, const char* buf,
+                                        size_t size) {
+  int64_t n = static_cast<FsWriter*>(cookie)->Write(buf, size);
+  if (n < 0) {
+    errno = EIO;
+    return 0;
+  }
+  return n;
+}
+
+static int fs_cookie_close_write_internal(void* cookie) {
+  auto* writer = static_cast<FsWriter*>(cookie);
+  int ret = writer->Close();
+  delete writer;
+  return ret == 0 ? 0 : EOF;
+}
+
+// Copies src into dest in a thread, the file returned closes both and joins
+// the thread when it is released. This runs a converter between the native
+// stream and the user.
+static std::shared_ptr<FILE> fs_pump_internal(std::shared_ptr<FILE> src,
+                                              std::shared_ptr<FILE> dest,
+                                              std::shared_ptr<FILE> user) {
+  auto pump = std::make_shared<std::thread>([src, dest]() mutable {
+    // a converter which quits early fails the write with EPIPE instead of
+    // killing the process
+    sigset_t sigpipe;
+    sigemptyset(&sigpipe);
+    sigaddset(&sigpipe, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &sigpipe, nullptr);
+
+    std::vector<char> buf(1 << 16);
+    size_t n = 0;
+    while ((n = fread(buf.data(), 1, buf.size(), &*src)) > 0) {
+      if (fwrite(buf.data(), 1, n, &*dest) != n) {
+        LOG(ERROR) << "The converter stops taking input.";
+        break;
+      }
+    }
+    dest = nullptr;
+    src = nullptr;
+  });
+  return {&*user, [user, pump](FILE*) mutable {
+            user = nullptr;
+            pump->join();
+          }};
+}
+#endif
+
+static std::shared_ptr<FILE> fs_native_open_read_internal(
+    std::shared_ptr<FsBackend> backend, const std::string& path, int* err_no,
+    std::string converter) {
+#if defined(__linux__)
+  if (fs_end_with_internal(path, ".gz")) {
+    converter = converter == "" ? "zcat" : "zcat | " + converter;
+  }
+  if (err_no) {
+    *err_no = 0;
+  }
+
+  auto* stream = new FsReadAheadStream(backend, path);
+  cookie_io_functions_t funcs = {fs_cookie_read_internal, nullptr, nullptr,
+                                 fs_cookie_close_read_internal};
+  FILE* fp = fopencookie(stream, "r", funcs);
+  if (fp == nullptr) {
+    delete stream;
+    PADDLE_THROW(platform::errors::Unavailable("Failed to open %s.", path));
+  }
+  std::shared_ptr<FILE> file(fp, [](FILE* fp) { fclose(fp); });
+  if (converter == "" || converter == "cat") {
+    return file;
+  }
+
+  auto pipes = shell_p2open(converter);
+  PADDLE_ENFORCE_EQ(pipes.first != nullptr && pipes.second != nullptr, true,
+                    platform::errors::Unavailable(
+                        "Failed to run converter %s.", converter));
+  return fs_pump_internal(file, pipes.second, pipes.first);
+#else
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "Native file system is only supported on Linux."));
+  return {};
+#endif
+}
+
+static std::shared_ptr<FILE> fs_native_open_write_internal(
+    std::shared_ptr<FsBackend> backend, const std::string& path, int* err_no,
+    std::string converter) {
+#if defined(__linux__)
+  if (fs_end_with_internal(path, ".gz")) {
+    converter = converter == "" ? "gzip" : converter + " | gzip";
+  }
+  if (err_no) {
+    *err_no = 0;
+  }
+
+  auto* writer = backend->OpenWrite(path).release();
+  cookie_io_functions_t funcs = {nullptr, fs_cookie_write_internal, nullptr,
+                                 fs_cookie_close_write_internal};
+  FILE* fp = fopencookie(writer, "w", funcs);
+  if (fp == nullptr) {
+    delete writer;
+    PADDLE_THROW(platform::errors::Unavailable("Failed to open %s.", path));
+  }
+  std::shared_ptr<FILE> file(fp, [](FILE* fp) { fclose(fp); });
+  CHECK_EQ(0, setvbuf(&*file, nullptr, _IOFBF, fs_read_chunk_size()));
+  if (converter == "" || converter == "cat") {
+    return file;
+  }
+
+  auto pipes = shell_p2open(converter);
+  PADDLE_ENFORCE_EQ(pipes.first != nullptr && pipes.second != nullptr, true,
+                    platform::errors::Unavailable(
+                        "Failed to run converter %s.", converter));
+  return fs_pump_internal(pipes.first, file, pipes.second);
+#else
+  PADDLE_THROW(platform::errors::Unimplemented(
+      "Native file system is only supported on Linux."));
+  return {};
+#endif
+}
+
 int fs_select_internal(const std::string& path) {
   if (fs_begin_with_internal(path, "hdfs:")) {
     return 1;
@@ -363,6 +968,10 @@ int fs_select_internal(const std::string& path) {
 
 std::shared_ptr<FILE> fs_open_read(const std::string& path, int* err_no,
                                    const std::string& converter) {
+  if (auto backend = fs_get_backend(path)) {
+    return fs_native_open_read_internal(backend, path, err_no, converter);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_open_read(path, converter);
@@ -381,6 +990,10 @@ std::shared_ptr<FILE> fs_open_read(const std::string& path, int* err_no,
 
 std::shared_ptr<FILE> fs_open_write(const std::string& path, int* err_no,
                                     const std::string& converter) {
+  if (auto backend = fs_get_backend(path)) {
+    return fs_native_open_write_internal(backend, path, err_no, converter);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_open_write(path, converter);
@@ -414,6 +1027,10 @@ std::shared_ptr<FILE> fs_open(const std::string& path, const std::string& mode,
 }
 
 int64_t fs_file_size(const std::string& path) {
+  if (auto backend = fs_get_backend(path)) {
+    return backend->FileSize(path);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_file_size(path);
@@ -427,6 +1044,10 @@ int64_t fs_file_size(const std::string& path) {
 }
 
 void fs_remove(const std::string& path) {
+  if (auto backend = fs_get_backend(path)) {
+    return backend->Remove(path);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_remove(path);
@@ -442,6 +1063,10 @@ void fs_remove(const std::string& path) {
 }
 
 std::vector<std::string> fs_list(const std::string& path) {
+  if (auto backend = fs_get_backend(path)) {
+    return backend->List(path);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_list(path);
@@ -459,6 +1084,10 @@ std::vector<std::string> fs_list(const std::string& path) {
 }
 
 std::string fs_tail(const std::string& path) {
+  if (auto backend = fs_get_backend(path)) {
+    return fs_native_tail_internal(backend.get(), path);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_tail(path);
@@ -476,6 +1105,10 @@ std::string fs_tail(const std::string& path) {
 }
 
 bool fs_exists(const std::string& path) {
+  if (auto backend = fs_get_backend(path)) {
+    return backend->Exists(path);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_exists(path);
@@ -493,6 +1126,10 @@ bool fs_exists(const std::string& path) {
 }
 
 void fs_mkdir(const std::string& path) {
+  if (auto backend = fs_get_backend(path)) {
+    return backend->Mkdir(path);
+  }
+
   switch (fs_select_internal(path)) {
     case 0:
       return localfs_mkdir(path);
@@ -508,6 +1145,14 @@ void fs_mkdir(const std::string& path) {
 }
 
 void fs_mv(const std::string& src, const std::string& dest) {
+  if (auto backend = fs_get_backend(src)) {
+    PADDLE_ENFORCE_EQ(backend == fs_get_backend(dest), true,
+                      platform::errors::InvalidArgument(
+                          "Cannot move %s to %s of another file system.", src,
+                          dest));
+    return backend->Mv(src, dest);
+  }
+
   int s = fs_select_internal(src);
   int d = fs_select_internal(dest);
   CHECK_EQ(s, d);
@@ -85,6 +85,89 @@ extern void hdfs_mkdir(const std::string& path);
 
 extern void hdfs_mv(const std::string& src, const std::string& dest);
 
+// native fs
+// A file system served in process, e.g. by the client library of HDFS or an
+// object store, instead of by a shell command per file. Once registered for
+// a path prefix such as "hdfs:", the fs_* functions of the paths with that
+// prefix go through it. A converter other than "cat" still runs as a shell
+// command, fed by the native read.
+class FsWriter {
+ public:
+  virtual ~FsWriter() {}
+  // Returns the bytes written, or -1 on error.
+  virtual int64_t Write(const char* buf, size_t size) = 0;
+  // Returns 0 on success.
+  virtual int Close() = 0;
+};
+
+class FsBackend {
+ public:
+  virtual ~FsBackend() {}
+  // Reads at most size bytes at offset and returns the bytes read, fewer
+  // only at the end of the file, or -1 on error. Called by several threads
+  // at once.
+  virtual int64_t ReadRange(const std::string& path, int64_t offset,
+                            char* buf, size_t size) = 0;
+  virtual int64_t FileSize(const std::string& path) = 0;
+  virtual std::unique_ptr<FsWriter> OpenWrite(const std::string& path) = 0;
+  // The files directly under path, with the prefix of the backend.
+  virtual std::vector<std::string> List(const std::string& path) = 0;
+  virtual bool Exists(const std::string& path) = 0;
+  virtual void Remove(const std::string& path) = 0;
+  virtual void Mkdir(const std::string& path) = 0;
+  virtual void Mv(const std::string& src, const std::string& dest) = 0;
+};
+
+// The local file system through syscalls, with the prefix it is registered
+// for stripped from the paths. Registered for a made-up prefix, it stands in
+// for a remote file system in tests.
+class LocalFsBackend : public FsBackend {
+ public:
+  explicit LocalFsBackend(const std::string& prefix = "") : prefix_(prefix) {}
+
+  int64_t ReadRange(const std::string& path, int64_t offset, char* buf,
+                    size_t size) override;
+  int64_t FileSize(const std::string& path) override;
+  std::unique_ptr<FsWriter> OpenWrite(const std::string& path) override;
+  std::vector<std::string> List(const std::string& path) override;
+  bool Exists(const std::string& path) override;
+  void Remove(const std::string& path) override;
+  void Mkdir(const std::string& path) override;
+  void Mv(const std::string& src, const std::string& dest) override;
+
+ private:
+  std::string LocalPath(const std::string& path) const;
+
+  std::string prefix_;
+};
+
+extern void fs_register_backend(const std::string& prefix,
+                                std::shared_ptr<FsBackend> backend);
+
+extern void fs_unregister_backend(const std::string& prefix);
+
+// The backend registered for the longest prefix of path, or nullptr.
+extern std::shared_ptr<FsBackend> fs_get_backend(const std::string& path);
+
+// A native read keeps chunk_num reads of chunk_size bytes in flight.
+extern size_t fs_read_chunk_size();
+
+extern size_t fs_read_ahead_chunks();
+
+extern void fs_set_read_ahead(size_t chunk_size, size_t chunk_num);
+
+// The threads shared by the native reads of all files, by default
+// FLAGS_fs_read_thread_num.
+extern size_t fs_read_threads();
+
+extern void fs_set_read_threads(size_t thread_num);
+
+// Reads size bytes at offset of path by chunks in parallel, through the
+// backend of path or the local file system. Returns the bytes read, fewer
+// than size only at the end of the file.
+extern int64_t fs_read_range(const std::string& path, int64_t offset,
+                             char* buf, size_t size);
+
 // aut-detect fs
 extern std::shared_ptr<FILE> fs_open_read(const std::string& path, int* err_no,
                                           const std::string& converter);
@@ -13,7 +13,10 @@
 // limitations under the License.
 
 #include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>  // NOLINT
 #include <fstream>
+#include <thread>  // NOLINT
 #include "paddle/fluid/framework/io/fs.h"
 
 #if defined _WIN32 || defined __APPLE__
@@ -45,3 +48,117 @@ TEST(FS, mv) {
   }
 #endif
 }
+
+#ifdef _LINUX
+// Fails the reads at offset 0 after a while, counts the finished reads.
+class FailingFsBackend : public paddle::framework::LocalFsBackend {
+ public:
+  FailingFsBackend() : LocalFsBackend("failfs:") {}
+
+  int64_t ReadRange(const std::string& path, int64_t offset, char* buf,
+                    size_t size) override {
+    std::this_thread::sleep_for(std::chrono::milliseconds(offset ? 5 : 1));
+    ++finished;
+    if (offset == 0) {
+      return -1;
+    }
+    return LocalFsBackend::ReadRange(path, offset, buf, size);
+  }
+
+  std::atomic<int> finished{0};
+};
+#endif
+
+TEST(FS, native_read_range_error) {
+#ifdef _LINUX
+  auto backend = std::make_shared<FailingFsBackend>();
+  paddle::framework::fs_register_backend("failfs:", backend);
+  paddle::framework::fs_set_read_ahead(16, 3);
+  paddle::framework::fs_set_read_threads(2);
+  paddle::framework::localfs_mkdir("failfs_native");
+  {
+    std::ofstream fout("failfs_native/a.txt");
+    fout << std::string(160, 'x');
+  }
+
+  // the error is rethrown after every chunk is read, buf is still alive
+  std::string range(160, '\0');
+  EXPECT_ANY_THROW(paddle::framework::fs_read_range(
+      "failfs:failfs_native/a.txt", 0, &range[0], range.size()));
+  EXPECT_EQ(backend->finished.load(), 10);
+
+  paddle::framework::fs_remove("failfs:failfs_native");
+  paddle::framework::fs_unregister_backend("failfs:");
+  paddle::framework::fs_set_read_threads(16);
+  paddle::framework::fs_set_read_ahead(1 << 20, 4);
+#endif
+}
+
+TEST(FS, native_backend) {
+#ifdef _LINUX
+  using paddle::framework::LocalFsBackend;
+  paddle::framework::fs_register_backend(
+      "mockfs:", std::make_shared<LocalFsBackend>("mockfs:"));
+  paddle::framework::fs_set_read_ahead(16, 3);
+
+  std::string content;
+  for (int i = 0; i < 100; ++i) {
+    content += "line " + std::to_string(i) + "\n";
+  }
+  {
+    int err_no = 0;
+    auto fp = paddle::framework::fs_open_write("mockfs:native_fs/a.txt",
+                                               &err_no, "");
+    fwrite(content.data(), 1, content.size(), &*fp);
+  }
+  EXPECT_TRUE(std::ifstream("native_fs/a.txt").good());
+  EXPECT_TRUE(paddle::framework::fs_exists("mockfs:native_fs/a.txt"));
+  EXPECT_EQ(paddle::framework::fs_file_size("mockfs:native_fs/a.txt"),
+            static_cast<int64_t>(content.size()));
+  EXPECT_EQ(paddle::framework::fs_tail("mockfs:native_fs/a.txt"), "line 99");
+
+  // the read ahead keeps several chunks in flight, through a converter too
+  for (std::string converter : {"", "cat", "grep -v 1"}) {
+    int err_no = 0;
+    auto fp = paddle::framework::fs_open_read("mockfs:native_fs/a.txt",
+                                              &err_no, converter);
+    std::string read;
+    char buf[7];
+    size_t n = 0;
+    while ((n = fread(buf, 1, sizeof(buf), &*fp)) > 0) {
+      read.append(buf, n);
+    }
+    if (converter == "grep -v 1") {
+      EXPECT_EQ(read.find("line 1\n"), std::string::npos);
+      EXPECT_NE(read.find("line 2\n"), std::string::npos);
+    } else {
+      EXPECT_EQ(read, content);
+    }
+  }
+
+  std::string range(100, '\0');
+  EXPECT_EQ(paddle::framework::fs_read_range("mockfs:native_fs/a.txt", 10,
+                                             &range[0], range.size()),
+            100);
+  EXPECT_EQ(range, content.substr(10, 100));
+  EXPECT_EQ(paddle::framework::fs_read_range("native_fs/a.txt", 10, &range[0],
+                                             range.size()),
+            100);
+  EXPECT_EQ(range, content.substr(10, 100));
+  EXPECT_EQ(paddle::framework::fs_read_range(
+                "mockfs:native_fs/a.txt", content.size() - 5, &range[0],
+                range.size()),
+            5);
+
+  paddle::framework::fs_mv("mockfs:native_fs/a.txt", "mockfs:native_fs/b.txt");
+  auto list = paddle::framework::fs_list("mockfs:native_fs");
+  ASSERT_EQ(list.size(), 1UL);
+  EXPECT_EQ(list[0], "mockfs:native_fs/b.txt");
+
+  paddle::framework::fs_remove("mockfs:native_fs");
+  EXPECT_FALSE(paddle::framework::fs_exists("mockfs:native_fs"));
+  paddle::framework::fs_unregister_backend("mockfs:");
+  EXPECT_EQ(paddle::framework::fs_get_backend("mockfs:native_fs"), nullptr);
+  paddle::framework::fs_set_read_ahead(1 << 20, 4);
+#endif
+}
@@ -302,6 +302,31 @@ std::shared_ptr<Graph> Graph::Clone() {
   }
 }
 
+const std::unordered_map<std::string, std::unordered_set<ir::Node *>>
+    &Graph::OpTypeIndex() const {
+  if (FLAGS_convert_all_blocks) {
+    if (IsMainGraph()) {
+      return GetSubGraph(0)->OpTypeIndex();
+    }
+  }
+  auto retype_count = OpDesc::RetypeCount();
+  if (retype_count == indexed_retype_count_) {
+    return op_type_index_;
+  }
+  indexed_retype_count_ = retype_count;
+  std::vector<ir::Node *> retyped;
+  for (auto &item : indexed_op_types_) {
+    if (IndexedOpType(item.first) != item.second) {
+      retyped.push_back(item.first);
+    }
+  }
+  for (auto *node : retyped) {
+    UnindexOpNode(node);
+    IndexOpNode(node);
+  }
+  return op_type_index_;
+}
+
 std::unique_ptr<Graph> Graph::CloneSubGraph(const size_t idx) {
   PADDLE_ENFORCE_EQ(
       this->IsMainGraph(), true,
@@ -18,6 +18,7 @@ limitations under the License. */
 #include <map>
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -284,6 +285,8 @@ class Graph {
     }
     nodes_.clear();
     node_set_.clear();
+    op_type_index_.clear();
+    indexed_op_types_.clear();
     return ret;
   }
 
@@ -300,6 +303,7 @@ class Graph {
     ret.reset(nodes_.at(node).release());
     nodes_.erase(node);
     node_set_.erase(node);
+    UnindexOpNode(node);
     return ret;
   }
 
@@ -343,9 +347,16 @@ class Graph {
                           "The node to be added already exists."));
     nodes_[node].reset(node);
     node_set_.insert(node);
+    IndexOpNode(node);
     return node;
   }
 
+  // The op nodes of the graph grouped by op type, maintained by AddNode and
+  // RemoveNode. Passes may change the type of an OpDesc in place, so the
+  // index is refreshed on the first read after OpDesc::RetypeCount() moves.
+  const std::unordered_map<std::string, std::unordered_set<ir::Node *>>
+      &OpTypeIndex() const;
+
   void ResolveHazard(
       const std::map<std::string, std::vector<ir::Node *>> &var_nodes);
 
@@ -399,6 +410,28 @@ class Graph {
 
   std::unique_ptr<Graph> CloneSubGraph(const size_t idx);
 
+  static std::string IndexedOpType(ir::Node *node) {
+    return node->Op() ? node->Op()->Type() : node->Name();
+  }
+
+  void IndexOpNode(ir::Node *node) const {
+    if (!node->IsOp()) return;
+    auto type = IndexedOpType(node);
+    op_type_index_[type].insert(node);
+    indexed_op_types_[node] = std::move(type);
+  }
+
+  void UnindexOpNode(ir::Node *node) const {
+    auto it = indexed_op_types_.find(node);
+    if (it == indexed_op_types_.end()) return;
+    auto group = op_type_index_.find(it->second);
+    group->second.erase(node);
+    if (group->second.empty()) {
+      op_type_index_.erase(group);
+    }
+    indexed_op_types_.erase(it);
+  }
+
   // NOTE: program_ shouldn't be exposed to user.
   const ProgramDesc program_;
   // NOTE: main_graph_ doesn't hold any node. It's used as a container of
@@ -410,6 +443,11 @@ class Graph {
   std::map<std::string, std::function<void(void)>> attr_dels_;
   std::map<ir::Node *, std::unique_ptr<ir::Node>> nodes_;
   std::unordered_set<ir::Node *> node_set_;
+  // Mutable since OpTypeIndex() fixes the entries of retyped ops.
+  mutable std::unordered_map<std::string, std::unordered_set<ir::Node *>>
+      op_type_index_;
+  mutable std::unordered_map<ir::Node *, std::string> indexed_op_types_;
+  mutable uint64_t indexed_retype_count_{OpDesc::RetypeCount()};
   size_t num_node_created_{0};  // help to generate a unique node id.
   // NOTE(Aurelius84): Whether is constructed with partial ProgramDesc.
   // In case of @to_static, whole trainning program is splited into two
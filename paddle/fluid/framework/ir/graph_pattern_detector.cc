@@ -13,6 +13,9 @@
 // limitations under the License.
 
 #include "paddle/fluid/framework/ir/graph_pattern_detector.h"
+
+#include <deque>
+
 #include "paddle/fluid/framework/ir/graph_traits.h"
 #include "paddle/fluid/framework/ir/graph_viz_pass.h"
 #include "paddle/fluid/framework/operator.h"
@@ -100,11 +103,17 @@ bool GraphPatternDetector::MarkPDNodesInGraph(const ir::Graph &graph) {
   VLOG(3) << "mark pdnodes in graph";
   if (graph.Nodes().empty()) return false;
 
-  for (auto &node : GraphTraits::DFS(graph)) {
-    for (const auto &pdnode : pattern_.nodes()) {
-      if (pdnode->Tell(&node)) {
-        VLOG(4) << "Node " << node.Name() << " marked as " << pdnode->name();
-        pdnodes2nodes_[pdnode.get()].insert(&node);
+  auto *anchor = SelectAnchor(graph);
+  if (anchor != nullptr) {
+    MarkPDNodesFromAnchor(graph, anchor);
+  } else {
+    for (auto &node : GraphTraits::DFS(graph)) {
+      for (const auto &pdnode : pattern_.nodes()) {
+        if (pdnode->Tell(&node)) {
+          VLOG(4) << "Node " << node.Name() << " marked as "
+                  << pdnode->name();
+          pdnodes2nodes_[pdnode.get()].insert(&node);
+        }
       }
     }
   }
@@ -120,6 +129,106 @@ bool GraphPatternDetector::MarkPDNodesInGraph(const ir::Graph &graph) {
   return !pdnodes2nodes_.empty();
 }
 
+PDNode *GraphPatternDetector::SelectAnchor(const ir::Graph &graph) const {
+  if (pattern_.nodes().empty()) return nullptr;
+  // Every PDNode must be reachable from the anchor through the edges.
+  std::unordered_map<const PDNode *, std::vector<const PDNode *>> neighbors;
+  for (auto &edge : pattern_.edges()) {
+    neighbors[edge.first].push_back(edge.second);
+    neighbors[edge.second].push_back(edge.first);
+  }
+  std::unordered_set<const PDNode *> visited{pattern_.nodes().front().get()};
+  std::vector<const PDNode *> stack{pattern_.nodes().front().get()};
+  while (!stack.empty()) {
+    auto *cur = stack.back();
+    stack.pop_back();
+    for (auto *next : neighbors[cur]) {
+      if (visited.insert(next).second) {
+        stack.push_back(next);
+      }
+    }
+  }
+  if (visited.size() != pattern_.nodes().size()) return nullptr;
+
+  auto &index = graph.OpTypeIndex();
+  PDNode *anchor = nullptr;
+  size_t anchor_size = 0;
+  for (auto &pdnode : pattern_.nodes()) {
+    if (!pdnode->HasOpTypes()) continue;
+    size_t size = 0;
+    for (auto &type : pdnode->op_types()) {
+      auto it = index.find(type);
+      if (it != index.end()) size += it->second.size();
+    }
+    if (anchor == nullptr || size < anchor_size) {
+      anchor = pdnode.get();
+      anchor_size = size;
+    }
+  }
+  if (anchor != nullptr) {
+    VLOG(3) << "anchor " << anchor->name() << " with " << anchor_size
+            << " candidates";
+  }
+  return anchor;
+}
+
+void GraphPatternDetector::MarkPDNodesFromAnchor(const ir::Graph &graph,
+                                                 PDNode *anchor) {
+  auto &index = graph.OpTypeIndex();
+  auto &anchor_nodes = pdnodes2nodes_[anchor];
+  for (auto &type : anchor->op_types()) {
+    auto it = index.find(type);
+    if (it == index.end()) continue;
+    for (auto *node : it->second) {
+      if (anchor->Tell(node)) {
+        anchor_nodes.insert(node);
+      }
+    }
+  }
+
+  // The candidates of a PDNode are the linked nodes of the candidates of a
+  // marked neighbor, so that a match always stays in the marked nodes.
+  std::unordered_set<const PDNode *> visited{anchor};
+  std::deque<const PDNode *> queue{anchor};
+  while (!queue.empty()) {
+    auto *cur = queue.front();
+    queue.pop_front();
+    auto &cur_nodes = pdnodes2nodes_[cur];
+    for (auto &edge : pattern_.edges()) {
+      const PDNode *next = nullptr;
+      bool forward = true;
+      if (edge.first == cur && !visited.count(edge.second)) {
+        next = edge.second;
+      } else if (edge.second == cur && !visited.count(edge.first)) {
+        next = edge.first;
+        forward = false;
+      } else {
+        continue;
+      }
+      auto &next_nodes = pdnodes2nodes_[next];
+      for (auto *node : cur_nodes) {
+        for (auto *linked : forward ? node->outputs : node->inputs) {
+          if (!next_nodes.count(linked) && next->Tell(linked)) {
+            VLOG(4) << "Node " << linked->Name() << " marked as "
+                    << next->name();
+            next_nodes.insert(linked);
+          }
+        }
+      }
+      visited.insert(next);
+      queue.push_back(next);
+    }
+  }
+
+  for (auto it = pdnodes2nodes_.begin(); it != pdnodes2nodes_.end();) {
+    if (it->second.empty()) {
+      it = pdnodes2nodes_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 // The intermediate Nodes can only link to the nodes inside the pattern, or this
 // subgraph will be dropped.
 void GraphPatternDetector::ValidateByNodeRole(
@@ -396,12 +505,28 @@ PDNode &PDNode::LinksFrom(const std::vector<PDNode *> &others) {
   return *this;
 }
 
+void PDNode::RestrictOpTypes(const std::unordered_set<std::string> &op_types) {
+  if (!has_op_types_) {
+    op_types_ = op_types;
+    has_op_types_ = true;
+    return;
+  }
+  for (auto it = op_types_.begin(); it != op_types_.end();) {
+    if (op_types.count(*it)) {
+      ++it;
+    } else {
+      it = op_types_.erase(it);
+    }
+  }
+}
+
 PDNode *PDNode::assert_is_op() {
   asserts_.emplace_back([](Node *x) { return x && x->IsOp(); });
   return this;
 }
 
 PDNode *PDNode::assert_is_op(const std::string &op_type) {
+  RestrictOpTypes({op_type});
   asserts_.emplace_back([op_type](Node *x) {
     return x && x->IsOp() && x->Op()->Type() == op_type;
   });
@@ -572,6 +697,7 @@ PDNode *PDNode::assert_more(PDNode::teller_t &&teller) {
 }
 
 PDNode *PDNode::assert_is_ops(const std::unordered_set<std::string> &op_types) {
+  RestrictOpTypes(op_types);
   asserts_.emplace_back([op_types](Node *x) {
     return x && x->IsOp() && op_types.count(x->Op()->Type());
   });
@@ -80,6 +80,11 @@ struct PDNode {
   bool IsOp() const { return type_ == Type::kOp; }
   bool IsVar() const { return type_ == Type::kVar; }
 
+  // Whether the node only matches ops of op_types(), as asserted by
+  // assert_is_op(type) or assert_is_ops(types).
+  bool HasOpTypes() const { return has_op_types_ && !teller_; }
+  const std::unordered_set<std::string>& op_types() const { return op_types_; }
+
   const std::string& name() const { return name_; }
 
   PDNode& operator=(const PDNode&) = delete;
@@ -179,6 +184,8 @@ struct PDNode {
 
   PDNode(PDNode&& other) = default;
 
+  void RestrictOpTypes(const std::unordered_set<std::string>& op_types);
+
   friend class PDPattern;
 
   // Will removed latter.
@@ -188,6 +195,8 @@ struct PDNode {
   std::string name_;
   Type type_;
   Role role_{Role::kUnknown};
+  bool has_op_types_{false};
+  std::unordered_set<std::string> op_types_;
 };
 
 /*
@@ -292,6 +301,14 @@ class GraphPatternDetector {
   // Mark the nodes that fits the pattern.
   bool MarkPDNodesInGraph(const ir::Graph& graph);
 
+  // The op PDNode with the fewest candidates in the op type index of the
+  // graph, or nullptr if the pattern can't be matched from an anchor.
+  PDNode* SelectAnchor(const ir::Graph& graph) const;
+
+  // Mark from the candidates of the anchor along the pattern edges, only the
+  // nodes linked to them can be part of a match.
+  void MarkPDNodesFromAnchor(const ir::Graph& graph, PDNode* anchor);
+
   // Detect all the pattern and output the hit records.
   std::vector<subgraph_t> DetectPatterns();
 
@@ -0,0 +1,137 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Times pattern detection on a BERT-style graph, once with asserted op types
+// (anchored on the op-type index) and once with tellers (full scan).
+//   ./graph_pattern_detector_benchmark --layers=24 --repeat=10
+
+#include <chrono>  // NOLINT
+#include <iostream>
+#include <string>
+
+#include "gflags/gflags.h"
+#include "paddle/fluid/framework/ir/graph_pattern_detector.h"
+#include "paddle/fluid/framework/ir/pass_tester_helper.h"
+
+DEFINE_int32(layers, 24, "number of encoder layers of the graph");
+DEFINE_int32(hidden, 1024, "hidden size of the graph");
+DEFINE_int32(repeat, 10, "number of detections to time");
+
+namespace paddle {
+namespace framework {
+namespace ir {
+
+static void BuildEncoder(Layers* layers, int num_layers, int64_t hidden) {
+  auto* x = layers->data("x", {1, 128, hidden});
+  auto fc = [&](VarDesc* in, const std::string& name) {
+    auto* w = layers->data(name + ".w", {hidden, hidden}, true);
+    auto* b = layers->data(name + ".b", {hidden}, true);
+    return layers->elementwise_add(layers->mul(in, w), b);
+  };
+  for (int i = 0; i < num_layers; ++i) {
+    auto prefix = "layer" + std::to_string(i);
+    auto* q = layers->transpose2(layers->reshape2(fc(x, prefix + ".q"), {}),
+                                 {0, 2, 1, 3});
+    auto* k = layers->transpose2(layers->reshape2(fc(x, prefix + ".k"), {}),
+                                 {0, 2, 1, 3});
+    auto* v = layers->transpose2(layers->reshape2(fc(x, prefix + ".v"), {}),
+                                 {0, 2, 1, 3});
+    auto* qk = layers->softmax(
+        layers->matmul(layers->scale(q, 0.125f, 0.f, false), k), -1);
+    auto* attn = layers->reshape2(layers->transpose2(layers->matmul(qk, v),
+                                                     {0, 2, 1, 3}),
+                                  {});
+    auto* ln_scale = layers->data(prefix + ".ln.scale", {hidden}, true);
+    auto* ln_bias = layers->data(prefix + ".ln.bias", {hidden}, true);
+    x = layers->layer_norm(
+        layers->elementwise_add(fc(attn, prefix + ".o"), x), ln_scale,
+        ln_bias)[0];
+    x = fc(layers->relu(fc(x, prefix + ".ffn0")), prefix + ".ffn1");
+  }
+}
+
+static int DetectAsserted(Graph* graph) {
+  GraphPatternDetector detector;
+  auto* x = detector.mutable_pattern()
+                ->NewNode("fc/x")
+                ->assert_is_op_input("mul", "X")
+                ->AsInput();
+  patterns::FC fc_pattern(detector.mutable_pattern(), "fc");
+  fc_pattern(x, true, false);
+  int count = 0;
+  detector(graph, [&](const GraphPatternDetector::subgraph_t& subgraph,
+                      Graph* g) { ++count; });
+  return count;
+}
+
+static int DetectScanned(Graph* graph) {
+  GraphPatternDetector detector;
+  auto* pattern = detector.mutable_pattern();
+  auto* mul = pattern->NewNode(
+      [](Node* n) { return n->IsOp() && n->Op()->Type() == "mul"; }, "mul");
+  auto* mul_out = pattern->NewNode(
+      [](Node* n) {
+        return n->IsVar() && VarLinksFromOp(n, "mul") &&
+               VarLinksToOp(n, "elementwise_add");
+      },
+      "mul_out");
+  auto* add = pattern->NewNode(
+      [](Node* n) {
+        return n->IsOp() && n->Op()->Type() == "elementwise_add";
+      },
+      "add");
+  mul->LinksTo({mul_out});
+  add->LinksFrom({mul_out});
+  int count = 0;
+  detector(graph, [&](const GraphPatternDetector::subgraph_t& subgraph,
+                      Graph* g) { ++count; });
+  return count;
+}
+
+template <typename Func>
+static double Time(Func func, Graph* graph, int* count) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < FLAGS_repeat; ++i) {
+    *count = func(graph);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() /
+         FLAGS_repeat;
+}
+
+}  // namespace ir
+}  // namespace framework
+}  // namespace paddle
+
+int main(int argc, char** argv) {
+  google::ParseCommandLineFlags(&argc, &argv, true);
+  using paddle::framework::ir::Graph;
+  paddle::framework::ir::Layers layers;
+  paddle::framework::ir::BuildEncoder(&layers, FLAGS_layers, FLAGS_hidden);
+  Graph graph(layers.main_program());
+
+  int asserted = 0;
+  int scanned = 0;
+  double asserted_ms = paddle::framework::ir::Time(
+      paddle::framework::ir::DetectAsserted, &graph, &asserted);
+  double scanned_ms = paddle::framework::ir::Time(
+      paddle::framework::ir::DetectScanned, &graph, &scanned);
+  std::cout << "graph: " << graph.Nodes().size() << " nodes, "
+            << graph.OpTypeIndex().size() << " op types" << std::endl;
+  std::cout << "anchored: " << asserted << " matches, " << asserted_ms
+            << " ms" << std::endl;
+  std::cout << "full scan: " << scanned << " matches, " << scanned_ms << " ms"
+            << std::endl;
+  return 0;
+}
@@ -15,6 +15,7 @@
 #include <gtest/gtest.h>
 
 #include "paddle/fluid/framework/ir/graph_pattern_detector.h"
+#include "paddle/fluid/framework/ir/pass_tester_helper.h"
 
 namespace paddle {
 namespace framework {
@@ -203,6 +204,69 @@ TEST(GraphPatternDetector, IntermediateCheck) {
   ASSERT_EQ(count, 1);
 }
 
+TEST(GraphPatternDetector, AnchoredMatchesFullScan) {
+  // x -> mul -> elementwise_add -> relu, repeated, with some mul not
+  // followed by elementwise_add
+  Layers layers;
+  auto* x = layers.data("x", {1, 128});
+  for (int i = 0; i < 8; ++i) {
+    auto* w = layers.data("w" + std::to_string(i), {128, 128}, true);
+    auto* bias = layers.data("b" + std::to_string(i), {128}, true);
+    auto* mul_out = layers.mul(x, w);
+    x = i % 3 == 0 ? layers.relu(mul_out)
+                   : layers.relu(layers.elementwise_add(mul_out, bias));
+  }
+  Graph graph(layers.main_program());
+
+  // the op PDNodes assert their types, so mul or elementwise_add anchors
+  auto count_asserted = [&]() {
+    GraphPatternDetector detector;
+    auto* mul = detector.mutable_pattern()
+                    ->NewNode("mul")
+                    ->assert_is_op("mul");
+    auto* mul_out = detector.mutable_pattern()
+                        ->NewNode("mul_out")
+                        ->assert_is_op_output("mul")
+                        ->assert_is_op_input("elementwise_add", "X");
+    auto* add = detector.mutable_pattern()
+                    ->NewNode("add")
+                    ->assert_is_op("elementwise_add");
+    mul->LinksTo({mul_out});
+    add->LinksFrom({mul_out});
+    int count = 0;
+    detector(&graph, [&](const GraphPatternDetector::subgraph_t& g,
+                         Graph* graph) { ++count; });
+    return count;
+  };
+
+  // tellers hide the op types, so every node is checked
+  auto count_scanned = [&]() {
+    GraphPatternDetector detector;
+    auto* mul = detector.mutable_pattern()->NewNode(
+        [](Node* n) { return n->IsOp() && n->Op()->Type() == "mul"; }, "mul");
+    auto* mul_out = detector.mutable_pattern()->NewNode(
+        [](Node* n) {
+          return n->IsVar() && VarLinksFromOp(n, "mul") &&
+                 VarLinksToOp(n, "elementwise_add");
+        },
+        "mul_out");
+    auto* add = detector.mutable_pattern()->NewNode(
+        [](Node* n) {
+          return n->IsOp() && n->Op()->Type() == "elementwise_add";
+        },
+        "add");
+    mul->LinksTo({mul_out});
+    add->LinksFrom({mul_out});
+    int count = 0;
+    detector(&graph, [&](const GraphPatternDetector::subgraph_t& g,
+                         Graph* graph) { ++count; });
+    return count;
+  };
+
+  ASSERT_EQ(count_asserted(), 5);
+  ASSERT_EQ(count_scanned(), 5);
+}
+
 }  // namespace ir
 }  // namespace framework
 }  // namespace paddle
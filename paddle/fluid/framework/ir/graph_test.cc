@@ -122,6 +122,53 @@ TEST(GraphTest, Basic) {
   ASSERT_EQ(nodes.size(), 5UL);
 }
 
+TEST(GraphTest, OpTypeIndex) {
+  ProgramDesc prog;
+  for (int i = 0; i < 3; ++i) {
+    auto *op = prog.MutableBlock(0)->AppendOp();
+    op->SetType("sum");
+    op->SetInput("X", {"test_a"});
+    op->SetOutput("Out", {"test_out_" + std::to_string(i)});
+  }
+  prog.MutableBlock(0)->Var("test_a");
+
+  std::unique_ptr<ir::Graph> g(new ir::Graph(prog));
+  ASSERT_EQ(g->OpTypeIndex().size(), 1UL);
+  ASSERT_EQ(g->OpTypeIndex().at("sum").size(), 3UL);
+
+  // created and removed nodes
+  auto *empty_op = g->CreateEmptyNode("empty", ir::Node::Type::kOperation);
+  g->CreateEmptyNode("empty_var", ir::Node::Type::kVariable);
+  ASSERT_EQ(g->OpTypeIndex().at("empty").size(), 1UL);
+  g->RemoveNode(empty_op);
+  ASSERT_EQ(g->OpTypeIndex().count("empty"), 0UL);
+
+  // an op changed its type in place
+  ir::Node *sum_op = *g->OpTypeIndex().at("sum").begin();
+  sum_op->Op()->SetType("scale");
+  ASSERT_EQ(g->OpTypeIndex().at("sum").size(), 2UL);
+  ASSERT_EQ(g->OpTypeIndex().at("scale").size(), 1UL);
+  ASSERT_EQ(*g->OpTypeIndex().at("scale").begin(), sum_op);
+
+  // setting the same type or typing a fresh desc is not a retype
+  auto retype_count = OpDesc::RetypeCount();
+  sum_op->Op()->SetType("scale");
+  OpDesc fresh_desc;
+  fresh_desc.SetType("relu");
+  ASSERT_EQ(OpDesc::RetypeCount(), retype_count);
+
+  // and neither is copying into a fresh desc, but copying over one is
+  OpDesc copied_desc(*sum_op->Op(), nullptr);
+  ASSERT_EQ(OpDesc::RetypeCount(), retype_count);
+  sum_op->Op()->CopyFrom(fresh_desc);
+  ASSERT_EQ(OpDesc::RetypeCount(), retype_count + 1);
+  ASSERT_EQ(g->OpTypeIndex().count("scale"), 0UL);
+  ASSERT_EQ(*g->OpTypeIndex().at("relu").begin(), sum_op);
+
+  g->ReleaseNodes();
+  ASSERT_EQ(g->OpTypeIndex().size(), 0UL);
+}
+
 TEST(GraphTest, WriteAfterRead) {
   // void Test() {
   ProgramDesc prog;
@@ -347,8 +347,19 @@ OpDesc::OpDesc(const OpDesc &other, BlockDesc *block) {
   need_update_ = true;
 }
 
+static std::atomic<uint64_t> g_op_desc_retype_count{0};
+
+uint64_t OpDesc::RetypeCount() { return g_op_desc_retype_count.load(); }
+
+void OpDesc::SetType(const std::string &type) {
+  if (!desc_.type().empty() && desc_.type() != type) {
+    ++g_op_desc_retype_count;
+  }
+  desc_.set_type(type);
+}
+
 void OpDesc::CopyFrom(const OpDesc &op_desc) {
-  desc_.set_type(op_desc.Type());
+  SetType(op_desc.Type());
   inputs_ = op_desc.inputs_;
   outputs_ = op_desc.outputs_;
   attrs_ = op_desc.attrs_;
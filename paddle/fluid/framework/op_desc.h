@@ -48,7 +48,11 @@ class OpDesc {
 
   std::string Type() const { return desc_.type(); }
 
-  void SetType(const std::string &type) { desc_.set_type(type); }
+  void SetType(const std::string &type);
+
+  // The number of times any OpDesc changed its non-empty type in place, by
+  // SetType or CopyFrom. The indexes keyed by op type refresh when it moves.
+  static uint64_t RetypeCount();
 
   const std::vector<std::string> &Input(const std::string &name) const;
 
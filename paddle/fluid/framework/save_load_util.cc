@@ -14,16 +14,37 @@
 
 #include "paddle/fluid/framework/save_load_util.h"
 
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
 #include <fstream>
+#include <future>  // NOLINT
+#include <list>
+#include <set>
+#include <utility>
 
+#include "ThreadPool.h"
+#include "gflags/gflags.h"
 #include "paddle/fluid/imperative/layer.h"
 
+DEFINE_int32(save_load_thread_num, 8,
+             "The number of threads SaveTensorToDisk and LoadTensorFromDisk "
+             "use to write and read the chunks of the tensors.");
+DEFINE_int32(save_load_chunk_size_mb, 4,
+             "The size in MB of the chunks SaveTensorToDisk splits the "
+             "tensors into.");
+DEFINE_bool(save_load_compress, false,
+            "Whether SaveTensorToDisk deflates the chunks of the tensors "
+            "with the fastest level of zlib.");
+
 namespace paddle {
 namespace framework {
 
 const int model_file_reserve_size = 256;
 const std::string tensor_number_mark = "TNUM";  // NOLINT
 const std::string tensor_name_mark = "NAME";    // NOLINT
+const std::string chunked_file_mark = "PDTCHUNK";  // NOLINT
+const uint32_t chunked_file_version = 1;
 
 void CheckInStreamState(std::istream& istre, size_t length) {
   if (!istre) {
@@ -244,85 +265,382 @@ bool LoadStaticNameListFromDisk(
   return true;
 }
 
-bool SaveTensorToDisk(const std::string& file_name,
-                      const std::map<std::string, Tensor*>& map_tensor) {
-  MkDirRecursively(DirName(file_name).c_str());
+// The chunked format keeps its header in the reserved bytes:
+//   "PDTCHUNK" | uint32 version | uint32 reserved | uint64 index offset |
+//   uint64 index size | uint32 index crc32
+// The tensor data follows the reserved bytes, split into chunks which are
+// stored raw or deflated. The index at the end of the file lists for every
+// tensor its name, TensorDesc and chunks, so that any tensor can be read
+// without reading the ones before it, and the chunks are written and read
+// by several threads.
+struct TensorChunk {
+  uint64_t offset;
+  uint64_t stored_size;
+  uint64_t raw_size;
+  uint32_t crc;
+  uint32_t compressed;
+};
+
+struct TensorEntry {
+  std::string name;
+  proto::VarType::TensorDesc desc;
+  std::vector<TensorChunk> chunks;
+};
+
+template <typename T>
+static void AppendPod(std::string* buf, const T& value) {
+  buf->append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static T ReadPod(const std::string& buf, size_t* cursor) {
+  PADDLE_ENFORCE_LE(*cursor + sizeof(T), buf.size(),
+                    platform::errors::InvalidArgument(
+                        "Model load failed, the tensor index is truncated."));
+  T value;
+  std::memcpy(&value, buf.data() + *cursor, sizeof(T));
+  *cursor += sizeof(T);
+  return value;
+}
 
-  std::ofstream fout(file_name, std::ios::binary);
+static uint32_t Crc32(const char* data, size_t size) {
+  return static_cast<uint32_t>(
+      crc32(0L, reinterpret_cast<const Bytef*>(data), static_cast<uInt>(size)));
+}
+
+static std::string SerializeTensorIndex(
+    const std::vector<TensorEntry>& entries) {
+  std::string buf;
+  buf.append(tensor_number_mark);
+  AppendPod(&buf, static_cast<size_t>(entries.size()));
+  for (auto& entry : entries) {
+    buf.append(tensor_name_mark);
+    AppendPod(&buf, static_cast<size_t>(entry.name.size()));
+    buf.append(entry.name);
+    auto desc = entry.desc.SerializeAsString();
+    AppendPod(&buf, static_cast<int32_t>(desc.size()));
+    buf.append(desc);
+    AppendPod(&buf, static_cast<uint32_t>(entry.chunks.size()));
+    for (auto& chunk : entry.chunks) {
+      AppendPod(&buf, chunk);
+    }
+  }
+  return buf;
+}
+
+static std::vector<TensorEntry> DeserializeTensorIndex(const std::string& buf) {
+  size_t cursor = 0;
+  PADDLE_ENFORCE_EQ(
+      buf.compare(0, tensor_number_mark.size(), tensor_number_mark), 0,
+      platform::errors::InvalidArgument(
+          "Tensor number mark does not match in the tensor index."));
+  cursor += tensor_number_mark.size();
+  auto tensor_number = ReadPod<size_t>(buf, &cursor);
+  std::vector<TensorEntry> entries(tensor_number);
+  for (auto& entry : entries) {
+    PADDLE_ENFORCE_EQ(
+        buf.compare(cursor, tensor_name_mark.size(), tensor_name_mark), 0,
+        platform::errors::InvalidArgument(
+            "Tensor name mark does not match in the tensor index."));
+    cursor += tensor_name_mark.size();
+    auto name_length = ReadPod<size_t>(buf, &cursor);
+    PADDLE_ENFORCE_LE(cursor + name_length, buf.size(),
+                      platform::errors::InvalidArgument(
+                          "Model load failed, the tensor index is truncated."));
+    entry.name = buf.substr(cursor, name_length);
+    cursor += name_length;
+    auto desc_size = ReadPod<int32_t>(buf, &cursor);
+    PADDLE_ENFORCE_EQ(
+        cursor + static_cast<size_t>(desc_size) <= buf.size() &&
+            entry.desc.ParseFromArray(buf.data() + cursor, desc_size),
+        true, platform::errors::InvalidArgument("Parse tensor desc failed."));
+    cursor += desc_size;
+    entry.chunks.resize(ReadPod<uint32_t>(buf, &cursor));
+    for (auto& chunk : entry.chunks) {
+      chunk = ReadPod<TensorChunk>(buf, &cursor);
+    }
+  }
+  return entries;
+}
+
+// Checksums and deflates one chunk, buf keeps the deflated bytes when they
+// are smaller than the raw ones.
+static void PrepareChunk(const char* data, TensorChunk* chunk,
+                         std::string* buf) {
+  chunk->crc = Crc32(data, chunk->raw_size);
+  chunk->compressed = 0;
+  chunk->stored_size = chunk->raw_size;
+  if (!FLAGS_save_load_compress) return;
+  uLongf bound = compressBound(chunk->raw_size);
+  buf->resize(bound);
+  int ret = compress2(reinterpret_cast<Bytef*>(&(*buf)[0]), &bound,
+                      reinterpret_cast<const Bytef*>(data), chunk->raw_size,
+                      Z_BEST_SPEED);
+  PADDLE_ENFORCE_EQ(ret, Z_OK, platform::errors::Unavailable(
+                                   "Model save failed, compress error %d.",
+                                   ret));
+  if (bound < chunk->raw_size) {
+    buf->resize(bound);
+    chunk->compressed = 1;
+    chunk->stored_size = bound;
+  } else {
+    buf->clear();
+  }
+}
+
+static void WriteAt(const std::string& file_name, uint64_t offset,
+                    const char* data, size_t size) {
+  std::fstream fout(file_name,
+                    std::ios::in | std::ios::out | std::ios::binary);
   PADDLE_ENFORCE_EQ(
       fout.is_open(), true,
       platform::errors::Unavailable("File (%s) open failed.", file_name));
+  fout.seekp(offset);
+  fout.write(data, static_cast<std::streamsize>(size));
+  if (!fout) {
+    PADDLE_THROW(platform::errors::Unavailable(
+        "Model save failed, error when writing data into model file [%s].",
+        file_name));
+  }
+}
+
+static void ReadAt(const std::string& file_name, uint64_t offset, char* data,
+                   size_t size) {
+  std::ifstream fin(file_name, std::ios::binary);
+  PADDLE_ENFORCE_EQ(
+      fin.is_open(), true,
+      platform::errors::Unavailable("File (%s) open failed.", file_name));
+  fin.seekg(offset);
+  fin.read(data, static_cast<std::streamsize>(size));
+  CheckInStreamState(fin, size);
+}
+
+static size_t ChunkSize() {
+  PADDLE_ENFORCE_EQ(
+      FLAGS_save_load_chunk_size_mb > 0 && FLAGS_save_load_chunk_size_mb < 4096,
+      true, platform::errors::InvalidArgument(
+                "FLAGS_save_load_chunk_size_mb should be in (0, 4096), but "
+                "got %d.",
+                FLAGS_save_load_chunk_size_mb));
+  return static_cast<size_t>(FLAGS_save_load_chunk_size_mb) << 20;
+}
 
-  // first 256 byte for reserve for fulture upgrade
-  char* kReserveBuffer = new char[model_file_reserve_size];
-  fout.write(kReserveBuffer, sizeof(char) * model_file_reserve_size);
-  delete[] kReserveBuffer;
+static size_t ThreadNum() {
+  return FLAGS_save_load_thread_num > 0 ? FLAGS_save_load_thread_num : 1;
+}
 
-  fout.write(tensor_number_mark.c_str(),
-             sizeof(char) * tensor_number_mark.size());
-  size_t tensor_number = map_tensor.size();
-  fout.write(reinterpret_cast<const char*>(&tensor_number),
-             sizeof(tensor_number));
+// Every task is finished before the first error is rethrown, since the
+// tasks use the buffers of the caller.
+static void WaitAllTasks(std::vector<std::future<void>>* tasks) {
+  for (auto& task : *tasks) task.wait();
+  for (auto& task : *tasks) task.get();
+}
 
+bool SaveTensorToDisk(const std::string& file_name,
+                      const std::map<std::string, Tensor*>& map_tensor) {
+  MkDirRecursively(DirName(file_name).c_str());
+
+  {
+    std::ofstream fout(file_name, std::ios::binary | std::ios::trunc);
+    PADDLE_ENFORCE_EQ(
+        fout.is_open(), true,
+        platform::errors::Unavailable("File (%s) open failed.", file_name));
+    // the header is written at last, once the index is known
+    std::string reserve(model_file_reserve_size, '\0');
+    fout.write(reserve.data(), reserve.size());
+  }
+
+  const size_t chunk_size = ChunkSize();
+  std::vector<TensorEntry> entries;
+  entries.reserve(map_tensor.size());
+  std::list<Tensor> cpu_tensors;
+  std::vector<const char*> chunk_data;
+  std::vector<TensorChunk*> chunks;
   for (auto& itera : map_tensor) {
-    // first save tensor name
-    fout.write(tensor_name_mark.c_str(),
-               sizeof(char) * tensor_name_mark.size());
-    size_t name_length = itera.first.size();
-    fout.write(reinterpret_cast<const char*>(&name_length),
-               sizeof(name_length));
-    fout.write(itera.first.c_str(), sizeof(char) * name_length);
-    // write tensor version
-    constexpr uint32_t version = 0;
-    fout.write(reinterpret_cast<const char*>(&version), sizeof(version));
-
-    // the 2nd field, tensor description
-    // int32_t  size
-    // void*    protobuf message
     auto tensor = itera.second;
-
-    proto::VarType::TensorDesc desc;
-    desc.set_data_type(tensor->type());
+    entries.emplace_back();
+    auto& entry = entries.back();
+    entry.name = itera.first;
+    entry.desc.set_data_type(tensor->type());
     auto dims = framework::vectorize(tensor->dims());
-    auto* pb_dims = desc.mutable_dims();
+    auto* pb_dims = entry.desc.mutable_dims();
     pb_dims->Resize(static_cast<int>(dims.size()), 0);
     std::copy(dims.begin(), dims.end(), pb_dims->begin());
-    int32_t size = desc.ByteSize();
-    fout.write(reinterpret_cast<const char*>(&size), sizeof(size));
-    auto out = desc.SerializeAsString();
-    fout.write(out.data(), size);
 
-    // save tensor
     uint64_t data_size =
         tensor->numel() * framework::SizeOfType(tensor->type());
     auto* data_ptr = tensor->data<void>();
     if (platform::is_gpu_place(tensor->place())) {
 #if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
-      framework::Tensor temp;
-      TensorCopySync(*tensor, platform::CPUPlace(), &temp);
-      data_ptr = temp.data<void>();
+      cpu_tensors.emplace_back();
+      TensorCopySync(*tensor, platform::CPUPlace(), &cpu_tensors.back());
+      data_ptr = cpu_tensors.back().data<void>();
 #else
       PADDLE_THROW(platform::errors::Unavailable(
           "Tensor is in CUDA device, but paddle not compiled with CUDA."));
 #endif
     }
-    fout.write(static_cast<const char*>(data_ptr),
-               static_cast<std::streamsize>(data_size));
+    entry.chunks.resize((data_size + chunk_size - 1) / chunk_size);
+    for (size_t i = 0; i < entry.chunks.size(); ++i) {
+      entry.chunks[i].raw_size =
+          std::min<uint64_t>(chunk_size, data_size - i * chunk_size);
+      chunk_data.push_back(static_cast<const char*>(data_ptr) +
+                           i * chunk_size);
+    }
+  }
+  for (auto& entry : entries) {
+    for (auto& chunk : entry.chunks) {
+      chunks.push_back(&chunk);
+    }
   }
 
-  if (!fout) {
-    PADDLE_THROW(platform::errors::Unavailable(
-        "Model save failed, error when writing data into model file [%s].",
-        file_name));
+  // Chunks are prepared and written window by window, which bounds the
+  // memory of the deflated chunks.
+  const size_t window = ThreadNum() * 2;
+  std::vector<std::string> bufs(window);
+  // after bufs, so that the pool is joined before bufs is freed
+  ::ThreadPool pool(ThreadNum());
+  uint64_t offset = model_file_reserve_size;
+  for (size_t begin = 0; begin < chunks.size(); begin += window) {
+    size_t end = std::min(begin + window, chunks.size());
+    std::vector<std::future<void>> tasks;
+    for (size_t i = begin; i < end; ++i) {
+      tasks.emplace_back(pool.enqueue([&, i, begin] {
+        PrepareChunk(chunk_data[i], chunks[i], &bufs[i - begin]);
+      }));
+    }
+    WaitAllTasks(&tasks);
+    tasks.clear();
+
+    for (size_t i = begin; i < end; ++i) {
+      chunks[i]->offset = offset;
+      offset += chunks[i]->stored_size;
+    }
+    for (size_t i = begin; i < end; ++i) {
+      tasks.emplace_back(pool.enqueue([&, i, begin] {
+        auto& buf = bufs[i - begin];
+        WriteAt(file_name, chunks[i]->offset,
+                chunks[i]->compressed ? buf.data() : chunk_data[i],
+                chunks[i]->stored_size);
+      }));
+    }
+    WaitAllTasks(&tasks);
   }
 
-  fout.close();
+  auto index = SerializeTensorIndex(entries);
+  WriteAt(file_name, offset, index.data(), index.size());
+
+  std::string header;
+  header.append(chunked_file_mark);
+  AppendPod(&header, chunked_file_version);
+  AppendPod(&header, static_cast<uint32_t>(0));
+  AppendPod(&header, offset);
+  AppendPod(&header, static_cast<uint64_t>(index.size()));
+  AppendPod(&header, Crc32(index.data(), index.size()));
+  WriteAt(file_name, 0, header.data(), header.size());
 
   return true;
 }
 
-bool LoadTensorFromDisk(
-    const std::string& file_name,
+// Returns false when file_name is in the format before the chunked one.
+static bool ReadChunkedTensorIndex(const std::string& file_name,
+                                   std::vector<TensorEntry>* entries) {
+  std::ifstream fin(file_name, std::ios::binary);
+  PADDLE_ENFORCE_EQ(
+      fin.is_open(), true,
+      platform::errors::Unavailable("File (%s) open failed.", file_name));
+  std::string mark(chunked_file_mark.size(), '\0');
+  fin.read(&mark[0], mark.size());
+  if (!fin || mark != chunked_file_mark) {
+    return false;
+  }
+  uint32_t version, reserved, crc;
+  uint64_t index_offset, index_size;
+  fin.read(reinterpret_cast<char*>(&version), sizeof(version));
+  fin.read(reinterpret_cast<char*>(&reserved), sizeof(reserved));
+  fin.read(reinterpret_cast<char*>(&index_offset), sizeof(index_offset));
+  fin.read(reinterpret_cast<char*>(&index_size), sizeof(index_size));
+  fin.read(reinterpret_cast<char*>(&crc), sizeof(crc));
+  CheckInStreamState(fin, model_file_reserve_size);
+  PADDLE_ENFORCE_EQ(version, chunked_file_version,
+                    platform::errors::InvalidArgument(
+                        "Only version %d chunked model file is supported, "
+                        "but got version %d.",
+                        chunked_file_version, version));
+
+  std::string index(index_size, '\0');
+  fin.seekg(index_offset);
+  fin.read(&index[0], index_size);
+  CheckInStreamState(fin, index_size);
+  PADDLE_ENFORCE_EQ(Crc32(index.data(), index.size()), crc,
+                    platform::errors::InvalidArgument(
+                        "Model file (%s) is corrupted, the checksum of the "
+                        "tensor index does not match.",
+                        file_name));
+  *entries = DeserializeTensorIndex(index);
+  return true;
+}
+
+static void LoadChunkedTensors(
+    const std::string& file_name, const std::vector<TensorEntry*>& entries,
+    std::map<std::string, std::shared_ptr<Tensor>>* map_tensor) {
+  std::vector<std::pair<TensorChunk*, char*>> chunks;
+  for (auto* entry : entries) {
+    std::shared_ptr<Tensor> tensor_temp(new Tensor());
+    std::vector<int64_t> dims(entry->desc.dims().begin(),
+                              entry->desc.dims().end());
+    tensor_temp->Resize(framework::make_ddim(dims));
+    void* buf;
+    framework::VisitDataType(
+        entry->desc.data_type(),
+        DeserializedDataFunctor(&buf, tensor_temp.get(), platform::CPUPlace()));
+    uint64_t data_size =
+        tensor_temp->numel() * framework::SizeOfType(entry->desc.data_type());
+    uint64_t raw_size = 0;
+    for (auto& chunk : entry->chunks) {
+      chunks.emplace_back(&chunk, static_cast<char*>(buf) + raw_size);
+      raw_size += chunk.raw_size;
+    }
+    PADDLE_ENFORCE_EQ(raw_size, data_size,
+                      platform::errors::InvalidArgument(
+                          "The chunks of tensor [%s] hold %d bytes, but the "
+                          "tensor has %d bytes.",
+                          entry->name, raw_size, data_size));
+    (*map_tensor)[entry->name] = tensor_temp;
+  }
+
+  ::ThreadPool pool(ThreadNum());
+  std::vector<std::future<void>> tasks;
+  for (auto& item : chunks) {
+    tasks.emplace_back(pool.enqueue([&file_name, item] {
+      auto* chunk = item.first;
+      char* dst = item.second;
+      if (chunk->compressed) {
+        std::string buf(chunk->stored_size, '\0');
+        ReadAt(file_name, chunk->offset, &buf[0], buf.size());
+        uLongf raw_size = chunk->raw_size;
+        int ret = uncompress(reinterpret_cast<Bytef*>(dst), &raw_size,
+                             reinterpret_cast<const Bytef*>(buf.data()),
+                             buf.size());
+        PADDLE_ENFORCE_EQ(ret == Z_OK && raw_size == chunk->raw_size, true,
+                          platform::errors::InvalidArgument(
+                              "Model load failed, uncompress error %d.", ret));
+      } else {
+        ReadAt(file_name, chunk->offset, dst, chunk->raw_size);
+      }
+      PADDLE_ENFORCE_EQ(Crc32(dst, chunk->raw_size), chunk->crc,
+                        platform::errors::InvalidArgument(
+                            "Model file (%s) is corrupted, the checksum of "
+                            "the chunk at %d does not match.",
+                            file_name, chunk->offset));
+    }));
+  }
+  WaitAllTasks(&tasks);
+}
+
+// The format before the chunked one, the tensors are read one by one.
+static void LoadLegacyTensorFromDisk(
+    const std::string& file_name, const std::set<std::string>* tensor_names,
     std::map<std::string, std::shared_ptr<Tensor>>* map_tensor) {
   std::ifstream fin(file_name, std::ios::binary);
 
@@ -365,12 +683,17 @@ bool LoadTensorFromDisk(
                 std::back_inserter(dims));
       auto new_dim = framework::make_ddim(dims);
       tensor_temp->Resize(new_dim);
+      size_t size =
+          tensor_temp->numel() * framework::SizeOfType(desc.data_type());
+      if (tensor_names && tensor_names->count(str_tensor_name) == 0) {
+        fin.seekg(size, std::ios::cur);
+        CheckInStreamState(fin, size);
+        continue;
+      }
       void* buf;
       framework::VisitDataType(desc.data_type(),
                                DeserializedDataFunctor(&buf, tensor_temp.get(),
                                                        platform::CPUPlace()));
-      size_t size =
-          tensor_temp->numel() * framework::SizeOfType(desc.data_type());
 
       fin.read(reinterpret_cast<char*>(buf), size);
       CheckInStreamState(fin, size);
@@ -378,9 +701,87 @@ bool LoadTensorFromDisk(
 
     (*map_tensor)[str_tensor_name] = tensor_temp;
   }
+}
+
+bool LoadTensorFromDisk(
+    const std::string& file_name,
+    std::map<std::string, std::shared_ptr<Tensor>>* map_tensor) {
+  std::vector<TensorEntry> entries;
+  if (!ReadChunkedTensorIndex(file_name, &entries)) {
+    LoadLegacyTensorFromDisk(file_name, nullptr, map_tensor);
+    return true;
+  }
+  std::vector<TensorEntry*> to_load;
+  for (auto& entry : entries) {
+    to_load.push_back(&entry);
+  }
+  LoadChunkedTensors(file_name, to_load, map_tensor);
+  return true;
+}
 
+bool LoadTensorFromDisk(
+    const std::string& file_name, const std::vector<std::string>& tensor_names,
+    std::map<std::string, std::shared_ptr<Tensor>>* map_tensor) {
+  std::set<std::string> names(tensor_names.begin(), tensor_names.end());
+  std::vector<TensorEntry> entries;
+  if (!ReadChunkedTensorIndex(file_name, &entries)) {
+    LoadLegacyTensorFromDisk(file_name, &names, map_tensor);
+  } else {
+    std::vector<TensorEntry*> to_load;
+    for (auto& entry : entries) {
+      if (names.count(entry.name)) {
+        to_load.push_back(&entry);
+      }
+    }
+    LoadChunkedTensors(file_name, to_load, map_tensor);
+  }
+  for (auto& name : names) {
+    PADDLE_ENFORCE_NE(
+        map_tensor->find(name), map_tensor->end(),
+        platform::errors::NotFound("Tensor (%s) not found in model file (%s).",
+                                   name, file_name));
+  }
   return true;
 }
 
+std::vector<std::string> ListTensorNamesInDisk(const std::string& file_name) {
+  std::vector<std::string> names;
+  std::vector<TensorEntry> entries;
+  if (ReadChunkedTensorIndex(file_name, &entries)) {
+    for (auto& entry : entries) {
+      names.push_back(entry.name);
+    }
+    return names;
+  }
+  // the legacy format has no index, its tensors are skipped one by one
+  std::ifstream fin(file_name, std::ios::binary);
+  PADDLE_ENFORCE_EQ(
+      fin.is_open(), true,
+      platform::errors::Unavailable("File (%s) open failed.", file_name));
+  ReadReserveBuffer(fin);
+  size_t tensor_number = ReadTensorNumber(fin);
+  for (size_t i = 0; i < tensor_number; ++i) {
+    names.push_back(ReadTensorName(fin));
+    uint32_t version;
+    fin.read(reinterpret_cast<char*>(&version), sizeof(version));
+    int32_t size;
+    fin.read(reinterpret_cast<char*>(&size), sizeof(size));
+    CheckInStreamState(fin, sizeof(size));
+    std::unique_ptr<char[]> buf(new char[size]);
+    fin.read(buf.get(), size);
+    CheckInStreamState(fin, size);
+    proto::VarType::TensorDesc desc;
+    PADDLE_ENFORCE_EQ(
+        desc.ParseFromArray(buf.get(), size), true,
+        platform::errors::InvalidArgument("Parse tensor desc failed."));
+    int64_t numel = 1;
+    for (auto dim : desc.dims()) {
+      numel *= dim;
+    }
+    fin.seekg(numel * framework::SizeOfType(desc.data_type()), std::ios::cur);
+  }
+  return names;
+}
+
 }  // namespace framework
 }  // namespace paddle
@@ -45,6 +45,9 @@ bool SaveDygraphVarBaseListToDisk(
 const std::vector<std::shared_ptr<imperative::VarBase>>
 LoadDygraphVarBaseListFromDisk(const std::string& file_name);
 
+// The tensors are split into chunks, checksummed and optionally deflated,
+// and written by several threads, see FLAGS_save_load_thread_num,
+// FLAGS_save_load_chunk_size_mb and FLAGS_save_load_compress.
 bool SaveTensorToDisk(const std::string& file_name,
                       const std::map<std::string, Tensor*>& map_tensor);
 
@@ -52,5 +55,12 @@ bool LoadTensorFromDisk(
     const std::string& file_name,
     std::map<std::string, std::shared_ptr<Tensor>>* map_tensor);
 
+// Only loads the given tensors, the chunks of the other ones are not read.
+bool LoadTensorFromDisk(
+    const std::string& file_name, const std::vector<std::string>& tensor_names,
+    std::map<std::string, std::shared_ptr<Tensor>>* map_tensor);
+
+std::vector<std::string> ListTensorNamesInDisk(const std::string& file_name);
+
 }  // namespace framework
 }  // namespace paddle
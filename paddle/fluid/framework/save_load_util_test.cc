@@ -14,9 +14,15 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include <fstream>
+
+#include "gflags/gflags.h"
 #include "gtest/gtest.h"
 #include "paddle/fluid/framework/save_load_util.h"
 
+DECLARE_int32(save_load_chunk_size_mb);
+DECLARE_bool(save_load_compress);
+
 namespace paddle {
 namespace framework {
 TEST(test_save_load_util, test_save_load) {
@@ -71,5 +77,62 @@ TEST(test_save_load_util, test_save_load) {
     ASSERT_EQ(ptr_2[i], ptr_2_new[i]);
   }
 }
+
+TEST(test_save_load_util, test_chunked_compressed_and_partial_load) {
+  FLAGS_save_load_chunk_size_mb = 1;
+  FLAGS_save_load_compress = true;
+  auto cpu_place = platform::CPUPlace();
+  // random values are stored raw, constant ones deflated
+  Tensor random_tensor;
+  random_tensor.Resize({3000, 1000});
+  auto random_data = random_tensor.mutable_data<float>(cpu_place);
+  for (int64_t i = 0; i < random_tensor.numel(); ++i) {
+    random_data[i] = (rand() % 10000) * 1.0 / 50000 - 1.0;  // NOLINT
+  }
+  Tensor constant_tensor;
+  constant_tensor.Resize({1000, 1000});
+  auto constant_data = constant_tensor.mutable_data<int64_t>(cpu_place);
+  for (int64_t i = 0; i < constant_tensor.numel(); ++i) {
+    constant_data[i] = i % 7;
+  }
+
+  std::map<std::string, Tensor*> map_tensor;
+  map_tensor["random"] = &random_tensor;
+  map_tensor["constant"] = &constant_tensor;
+  SaveTensorToDisk("test_2", map_tensor);
+
+  auto names = ListTensorNamesInDisk("test_2");
+  ASSERT_EQ(names.size(), 2UL);
+
+  std::map<std::string, std::shared_ptr<Tensor>> load_map_tensor;
+  LoadTensorFromDisk("test_2", {"constant"}, &load_map_tensor);
+  ASSERT_EQ(load_map_tensor.size(), 1UL);
+  auto loaded = load_map_tensor["constant"];
+  ASSERT_EQ(loaded->dims(), constant_tensor.dims());
+  for (int64_t i = 0; i < constant_tensor.numel(); ++i) {
+    ASSERT_EQ(loaded->data<int64_t>()[i], constant_data[i]);
+  }
+
+  load_map_tensor.clear();
+  LoadTensorFromDisk("test_2", &load_map_tensor);
+  ASSERT_EQ(load_map_tensor.size(), 2UL);
+  for (int64_t i = 0; i < random_tensor.numel(); ++i) {
+    ASSERT_EQ(load_map_tensor["random"]->data<float>()[i], random_data[i]);
+  }
+
+  // a corrupted chunk fails the checksum
+  {
+    std::fstream file("test_2", std::ios::in | std::ios::out |
+                                    std::ios::binary);
+    file.seekp(1024);
+    float bad = 100.0f;
+    file.write(reinterpret_cast<const char*>(&bad), sizeof(bad));
+  }
+  load_map_tensor.clear();
+  ASSERT_ANY_THROW(LoadTensorFromDisk("test_2", &load_map_tensor));
+  FLAGS_save_load_compress = false;
+  FLAGS_save_load_chunk_size_mb = 4;
+}
+
 }  // namespace framework
 }  // namespace paddle
@@ -27,6 +27,7 @@
 #include "paddle/fluid/imperative/gradient_accumulator.h"
 #include "paddle/fluid/imperative/layer.h"
 #include "paddle/fluid/imperative/op_base.h"
+#include "paddle/fluid/imperative/recompute.h"
 #include "paddle/fluid/imperative/tracer.h"
 #include "paddle/fluid/operators/math/math_function.h"
 #include "paddle/fluid/platform/profiler.h"
@@ -232,6 +233,51 @@ void BasicEngine::PrepareGradAccumulators(
   }
 }
 
+// The leaf gradients of op which are not initialized yet, with the dims of
+// their forward vars among the inputs of op, so that they can be assigned to
+// a FusedGradientBuffer before their grad op runs. Only the dense gradients
+// computed on CPU are collected.
+static void CollectLeafGradMetas(
+    const OpBase& op, std::vector<FusedGradientBuffer::GradMeta>* grads) {
+  if (!platform::is_cpu_place(op.place())) {
+    return;
+  }
+  for (const auto& pair : op.GetOutsMap()) {
+    if (!pair.second.IsGrad()) {
+      continue;
+    }
+    for (const auto& var : pair.second) {
+      if (!var || !var->IsLeafGrad() || !var->IsEmpty() ||
+          var->Type() != framework::proto::VarType::LOD_TENSOR) {
+        continue;
+      }
+      bool found = false;
+      for (const auto& in_pair : op.GetInsMap()) {
+        if (in_pair.second.IsGrad()) {
+          continue;
+        }
+        for (const auto& in_var : in_pair.second) {
+          // the dims are kept even if the buffer of a no need buffer var
+          // is cleared
+          if (in_var && in_var->Var().IsType<framework::LoDTensor>() &&
+              framework::GradVarName(in_var->Name()) == var->Name()) {
+            auto& tensor = in_var->Var().Get<framework::LoDTensor>();
+            if (!tensor.IsInitialized() ||
+                platform::is_cpu_place(tensor.place())) {
+              grads->push_back({var, tensor.dims(), var->ForwardDataType()});
+            }
+            found = true;
+            break;
+          }
+        }
+        if (found) {
+          break;
+        }
+      }
+    }
+  }
+}
+
 void BasicEngine::PrepareDeps() {
   PADDLE_ENFORCE_EQ(
       node_deps_.empty(), true,
@@ -248,6 +294,7 @@ void BasicEngine::PrepareDeps() {
 
   std::queue<GradOpNode*> q;
   std::unordered_set<GradOpNode*> visited;
+  std::vector<FusedGradientBuffer::GradMeta> leaf_grad_metas;
 
   for (size_t i = 0; i < init_nodes_.size(); ++i) {
     q.push(init_nodes_[i].get());
@@ -263,6 +310,9 @@ void BasicEngine::PrepareDeps() {
     for (auto& cur_op : *cur_node) {
       cur_op.EnforceHasInOut();
       PrepareGradAccumulators(cur_op, grad_pending_nodes);
+      if (FLAGS_dygraph_fuse_grad_buffer) {
+        CollectLeafGradMetas(cur_op, &leaf_grad_metas);
+      }
     }
 
     for (auto& grad_pending_node : grad_pending_nodes) {
@@ -276,6 +326,11 @@ void BasicEngine::PrepareDeps() {
       }
     }
   }
+
+  // The gradients of the first backward are written into the buffer too.
+  if (!leaf_grad_metas.empty()) {
+    fused_grad_buffer_.Reserve(leaf_grad_metas);
+  }
 }
 
 static std::shared_ptr<NameVarMap<VariableWrapper>> CallGradientHooks(
@@ -320,6 +375,10 @@ void BasicEngine::Execute() {
     auto shared_cur_node = std::move(q.front());
     q.pop();
 
+    if (shared_cur_node->GetRecomputeSegment()) {
+      shared_cur_node->GetRecomputeSegment()->Recompute();
+    }
+
     auto& inplace_grad_name_map = shared_cur_node->InplaceGradNameMap();
 
     for (auto& cur_op : *shared_cur_node) {
@@ -393,6 +452,15 @@ void BasicEngine::Execute() {
                           iter->second.get()) == leaf_accumulators_.end()) {
               leaf_accumulators_.push_back(iter->second.get());
             }
+            if (FLAGS_dygraph_fuse_grad_buffer) {
+              leaf_grad_vars_.push_back(var);
+              // the only contribution is written into the buffer in place
+              if (iter->second->RefCnt() == 1 &&
+                  !var->OverridedStopGradient() &&
+                  fused_grad_buffer_.Contains(*var)) {
+                iter->second->ShareLeafBufferWithInnerVar();
+              }
+            }
 
             if (iter->second->HasInnerVar()) {
               var = iter->second->InnerVar();
@@ -538,6 +606,10 @@ void BasicEngine::Execute() {
       }
     }
   }
+  if (FLAGS_dygraph_fuse_grad_buffer) {
+    fused_grad_buffer_.Assign(leaf_grad_vars_);
+  }
+
   Clear();
 
   VLOG(1) << "Backward op number: " << op_num;
@@ -550,6 +622,7 @@ void BasicEngine::Clear() {
   accumulators_with_grad_node_.clear();
   need_accu_var_list_.clear();
   leaf_accumulators_.clear();
+  leaf_grad_vars_.clear();
 }
 
 }  // namespace imperative
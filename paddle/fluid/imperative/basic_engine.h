@@ -74,6 +74,11 @@ class BasicEngine : public Engine {
   // It should be orderly and not repeated, because multiple cards must ensure
   // that the order of vars is the same.
   std::vector<GradientAccumulator*> leaf_accumulators_;
+  // The leaf gradients of this backward, which are assigned to
+  // fused_grad_buffer_ when FLAGS_dygraph_fuse_grad_buffer is on.
+  std::vector<std::shared_ptr<VariableWrapper>> leaf_grad_vars_;
+  // It lives across backward calls, since the gradients keep their slices.
+  FusedGradientBuffer fused_grad_buffer_;
 
   bool retain_graph_;
 };
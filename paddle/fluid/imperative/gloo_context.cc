@@ -0,0 +1,221 @@
+//   Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(PADDLE_WITH_GLOO)
+#include "paddle/fluid/imperative/gloo_context.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "paddle/fluid/framework/fleet/gloo_wrapper.h"
+#include "paddle/fluid/framework/lod_tensor.h"
+#include "paddle/fluid/framework/tensor_util.h"
+#include "paddle/fluid/framework/variable.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace imperative {
+
+template <typename T>
+static void GlooAllReduceSum(T *data, size_t numel) {
+  auto gloo = framework::GlooWrapper::GetInstance();
+  gloo::AllreduceOptions opts(gloo->GetContext());
+  // The output is also the input, i.e. all-reduce in place
+  opts.setOutput(data, numel);
+  opts.setReduceFunction(
+      static_cast<void (*)(void *, const void *, const void *, size_t)>(
+          &gloo::sum<T>));
+  gloo::allreduce(opts);
+}
+
+template <typename T>
+static void GlooAllGather(const T *input, size_t numel, T *output) {
+  auto gloo = framework::GlooWrapper::GetInstance();
+  gloo::AllgatherOptions opts(gloo->GetContext());
+  opts.setInput(const_cast<T *>(input), numel);
+  opts.setOutput(output, numel * gloo->Size());
+  gloo::allgather(opts);
+}
+
+void GlooParallelContext::Init() {
+  auto gloo = framework::GlooWrapper::GetInstance();
+  PADDLE_ENFORCE_EQ(gloo->IsInitialized(), true,
+                    platform::errors::PreconditionNotMet(
+                        "The gloo context should be initialized before "
+                        "initializing GlooParallelContext."));
+  PADDLE_ENFORCE_EQ(
+      gloo->Size(), strategy_.nranks_,
+      platform::errors::InvalidArgument(
+          "The size of gloo context (%d) should be equal to nranks (%d).",
+          gloo->Size(), strategy_.nranks_));
+  PADDLE_ENFORCE_EQ(platform::is_cpu_place(place_), true,
+                    platform::errors::InvalidArgument(
+                        "GlooParallelContext only supports CPUPlace."));
+  comm_dev_ctx_.reset(new platform::CPUDeviceContext(platform::CPUPlace()));
+  VLOG(0) << "init gloo context nranks: " << strategy_.nranks_
+          << " local rank: " << strategy_.local_rank_;
+}
+
+void GlooParallelContext::InitWithRingID(int ring_id) {
+  // All rings share the only gloo context
+  if (comm_dev_ctx_ == nullptr) {
+    Init();
+  }
+}
+
+void GlooParallelContext::AllReduce(const framework::Tensor &src,
+                                    framework::Tensor *dst) {
+  if (dst != &src) {
+    framework::TensorCopySync(src, platform::CPUPlace(), dst);
+  }
+  auto numel = static_cast<size_t>(dst->numel());
+  switch (dst->type()) {
+    case framework::proto::VarType::FP32:
+      GlooAllReduceSum(dst->data<float>(), numel);
+      break;
+    case framework::proto::VarType::FP64:
+      GlooAllReduceSum(dst->data<double>(), numel);
+      break;
+    case framework::proto::VarType::INT32:
+      GlooAllReduceSum(dst->data<int32_t>(), numel);
+      break;
+    case framework::proto::VarType::INT64:
+      GlooAllReduceSum(dst->data<int64_t>(), numel);
+      break;
+    default:
+      PADDLE_THROW(platform::errors::Unimplemented(
+          "Gloo all reduce does not support data type %s.",
+          framework::DataTypeToString(dst->type())));
+  }
+}
+
+// The rows of every rank are gathered instead of reduced, the same as
+// the SelectedRows all-reduce of NCCL. The rows and values are padded to the
+// max rows of all ranks since gloo allgather needs the same size.
+void GlooParallelContext::AllReduce(const framework::SelectedRows &src,
+                                    framework::SelectedRows *dst) {
+  auto nranks = static_cast<size_t>(strategy_.nranks_);
+  const auto &src_rows = src.rows();
+  const auto &src_value = src.value();
+  int64_t row_width =
+      src_value.numel() / std::max<int64_t>(src_value.dims()[0], 1);
+  size_t elem_size = framework::SizeOfType(src_value.type());
+  size_t row_bytes = row_width * elem_size;
+
+  int64_t rows_num = static_cast<int64_t>(src_rows.size());
+  std::vector<int64_t> rows_nums(nranks);
+  GlooAllGather(&rows_num, 1, rows_nums.data());
+  size_t max_rows = static_cast<size_t>(
+      *std::max_element(rows_nums.begin(), rows_nums.end()));
+
+  std::vector<int64_t> padded_rows(max_rows, 0);
+  std::copy(src_rows.begin(), src_rows.end(), padded_rows.begin());
+  std::vector<uint8_t> padded_value(max_rows * row_bytes, 0);
+  if (rows_num > 0) {
+    std::memcpy(padded_value.data(), src_value.data<void>(),
+                rows_num * row_bytes);
+  }
+
+  std::vector<int64_t> gathered_rows(max_rows * nranks);
+  std::vector<uint8_t> gathered_value(max_rows * row_bytes * nranks);
+  if (max_rows > 0) {
+    GlooAllGather(padded_rows.data(), max_rows, gathered_rows.data());
+    GlooAllGather(padded_value.data(), max_rows * row_bytes,
+                  gathered_value.data());
+  }
+
+  int64_t total_rows = 0;
+  for (auto num : rows_nums) {
+    total_rows += num;
+  }
+  auto dims = src_value.dims();
+  auto dtype = src_value.type();
+  auto height = src.height();
+  dims[0] = total_rows;
+
+  std::vector<int64_t> dst_rows;
+  dst_rows.reserve(total_rows);
+  auto *dst_value = dst->mutable_value();
+  dst_value->Resize(dims);
+  auto *dst_ptr = reinterpret_cast<uint8_t *>(
+      dst_value->mutable_data(platform::CPUPlace(), dtype));
+  for (size_t i = 0; i < nranks; ++i) {
+    auto num = static_cast<size_t>(rows_nums[i]);
+    auto rows_begin = gathered_rows.begin() + i * max_rows;
+    dst_rows.insert(dst_rows.end(), rows_begin, rows_begin + num);
+    std::memcpy(dst_ptr, gathered_value.data() + i * max_rows * row_bytes,
+                num * row_bytes);
+    dst_ptr += num * row_bytes;
+  }
+  dst->set_height(height);
+  dst->set_rows(dst_rows);
+}
+
+void GlooParallelContext::AllReduceByStream(const framework::Variable &src,
+                                            framework::Variable *dst,
+                                            int ring_id, bool use_calc_stream) {
+  PADDLE_ENFORCE_NOT_NULL(comm_dev_ctx_,
+                          platform::errors::PreconditionNotMet(
+                              "GlooParallelContext is not initialized."));
+  if (src.IsType<framework::LoDTensor>()) {
+    if (!dst->IsType<framework::LoDTensor>()) {
+      dst->Clear();
+    }
+    AllReduce(src.Get<framework::LoDTensor>(),
+              dst->GetMutable<framework::LoDTensor>());
+  } else if (src.IsType<framework::SelectedRows>()) {
+    if (&src != dst) {
+      if (!dst->IsType<framework::SelectedRows>()) {
+        dst->Clear();
+      }
+      AllReduce(src.Get<framework::SelectedRows>(),
+                dst->GetMutable<framework::SelectedRows>());
+    } else {
+      // Gather from a copy since the rows of dst are replaced
+      framework::SelectedRows tmp;
+      AllReduce(src.Get<framework::SelectedRows>(), &tmp);
+      auto *dst_rows = dst->GetMutable<framework::SelectedRows>();
+      dst_rows->set_height(tmp.height());
+      dst_rows->set_rows(tmp.rows());
+      dst_rows->mutable_value()->ShareDataWith(tmp.value());
+    }
+  } else {
+    PADDLE_THROW(platform::errors::InvalidArgument(
+        "Unsupported variable type %s for imperative gloo allreduce, only "
+        "LoDTensor and SelectedRows are supported.",
+        platform::demangle(framework::ToTypeName(src.Type()))));
+  }
+}
+
+paddle::platform::DeviceContext *GlooParallelContext::GetDeviceContext(
+    int ring_id) {
+  return comm_dev_ctx_.get();
+}
+
+void GlooParallelContext::WaitCompute(int ring_id) {
+  // do nothing because cpu don't need sync
+}
+
+void GlooParallelContext::WaitComm(int ring_id) {
+  // do nothing because cpu don't need sync
+}
+
+void GlooParallelContext::SynchronizeCompute() {
+  // do nothing because cpu don't need sync
+}
+
+}  //  namespace imperative
+}  //  namespace paddle
+#endif
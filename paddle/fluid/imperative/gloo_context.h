@@ -0,0 +1,75 @@
+//   Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+#pragma once
+
+#if defined(PADDLE_WITH_GLOO)
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "paddle/fluid/framework/selected_rows.h"
+#include "paddle/fluid/framework/tensor.h"
+#include "paddle/fluid/imperative/parallel_context.h"
+#include "paddle/fluid/platform/device_context.h"
+
+namespace paddle {
+namespace imperative {
+
+/*
+ * GlooParallelContext all-reduces the CPU gradients of dygraph data parallel
+ * training over the gloo context of framework::GlooWrapper, which must have
+ * been initialized, e.g. by platform::GlooParallelContext. There is no
+ * stream on CPU, so the Reducer runs the all-reduce of the ready groups in
+ * its communication thread to overlap it with backward, and the Wait*
+ * methods do nothing.
+ */
+class GlooParallelContext : public ParallelContext {
+ public:
+  explicit GlooParallelContext(const ParallelStrategy& strategy,
+                               const platform::Place& place)
+      : ParallelContext(strategy, place) {}
+
+  ~GlooParallelContext() override = default;
+
+  void Init() override;
+
+  void InitWithRingID(int ring_id) override;
+
+  void AllReduceByStream(const framework::Variable& src,
+                         framework::Variable* dst, int ring_id,
+                         bool use_calc_stream) override;
+
+  paddle::platform::DeviceContext* GetDeviceContext(int ring_id) override;
+
+  void WaitCompute(int ring_id) override;
+
+  void WaitComm(int ring_id) override;
+
+  void SynchronizeCompute() override;
+
+ private:
+  void AllReduce(const framework::Tensor& src, framework::Tensor* dst);
+
+  void AllReduce(const framework::SelectedRows& src,
+                 framework::SelectedRows* dst);
+
+  // The device context used by the communication thread of Reducer, so that
+  // concat and split do not share the compute device context.
+  std::unique_ptr<platform::CPUDeviceContext> comm_dev_ctx_;
+};
+
+}  //  namespace imperative
+}  //  namespace paddle
+
+#endif
@@ -15,11 +15,14 @@
 #include "paddle/fluid/imperative/gradient_accumulator.h"
 
 #include <algorithm>
+#include <cstring>
+#include <map>
 #include <memory>
 #include <utility>
 
 #include "paddle/fluid/framework/lod_tensor.h"
 #include "paddle/fluid/framework/selected_rows.h"
+#include "paddle/fluid/framework/tensor_util.h"
 #include "paddle/fluid/imperative/layer.h"
 #include "paddle/fluid/operators/math/blas.h"
 #include "paddle/fluid/operators/math/math_function.h"
@@ -404,6 +407,72 @@ static platform::Place GetPlaceOfVar(
   return place;
 }
 
+// Whether an empty leaf gradient dst still holds a buffer which src can be
+// copied to without reallocation, e.g. a slice of FusedGradientBuffer.
+static bool CanCopyToBuffer(const framework::Variable& src,
+                            const framework::Variable& dst) {
+  if (!src.IsType<framework::LoDTensor>() ||
+      !dst.IsType<framework::LoDTensor>()) {
+    return false;
+  }
+  auto& src_tensor = src.Get<framework::LoDTensor>();
+  auto& dst_tensor = dst.Get<framework::LoDTensor>();
+  return src_tensor.IsInitialized() && dst_tensor.IsInitialized() &&
+         platform::is_cpu_place(src_tensor.place()) &&
+         platform::is_cpu_place(dst_tensor.place()) &&
+         src_tensor.type() == dst_tensor.type() &&
+         src_tensor.numel() == dst_tensor.numel();
+}
+
+// A part of another allocation, which it keeps alive.
+class BufferViewAllocation : public memory::Allocation {
+ public:
+  BufferViewAllocation(std::shared_ptr<memory::Allocation> base, void* ptr,
+                       size_t size)
+      : Allocation(ptr, size, base->place()), base_(std::move(base)) {}
+
+ private:
+  std::shared_ptr<memory::Allocation> base_;
+};
+
+// Whether src was written in the buffer of dst, with the same type and dims.
+static bool IsSameBuffer(const framework::Variable& src,
+                         const framework::Variable& dst) {
+  if (!CanCopyToBuffer(src, dst)) {
+    return false;
+  }
+  auto& src_tensor = src.Get<framework::LoDTensor>();
+  auto& dst_tensor = dst.Get<framework::LoDTensor>();
+  return src_tensor.data<void>() == dst_tensor.data<void>() &&
+         src_tensor.dims() == dst_tensor.dims();
+}
+
+void GradientAccumulator::ShareLeafBufferWithInnerVar() {
+  if (!var_->IsLeafGrad() || !HasInnerVar() || !var_->IsEmpty() ||
+      inner_var_->Var().IsInitialized() ||
+      !var_->Var().IsType<framework::LoDTensor>()) {
+    return;
+  }
+  auto& tensor = var_->Var().Get<framework::LoDTensor>();
+  // a grad op of another type, e.g. of AMP, might overrun the buffer
+  if (!tensor.IsInitialized() || !platform::is_cpu_place(tensor.place()) ||
+      tensor.type() != var_->ForwardDataType()) {
+    return;
+  }
+  VLOG(6) << "Share the buffer of leaf Gradient Var(" << var_->Name()
+          << ") with its grad op";
+  // A view of exactly the bytes of the gradient, rather than the slice of
+  // the whole flat buffer, so that mutable_data of a grad op with another
+  // size allocates anew instead of writing over the next gradients.
+  auto view = std::make_shared<BufferViewAllocation>(
+      tensor.Holder(), const_cast<void*>(tensor.data<void>()),
+      tensor.numel() * framework::SizeOfType(tensor.type()));
+  auto* inner_tensor =
+      inner_var_->MutableVar()->GetMutable<framework::LoDTensor>();
+  inner_tensor->Resize(tensor.dims());
+  inner_tensor->ResetHolderWithType(view, tensor.type());
+}
+
 void GradientAccumulator::AccumulateGrad() {
   /**
    * If the leaf gradient has been calculated done, the inner_var_
@@ -443,6 +512,23 @@ void GradientAccumulator::AccumulateGrad() {
       PADDLE_THROW(platform::errors::PermissionDenied(
           "Only support LoDTensor and SelectedRows for gradient var"));
     }
+  } else if (FLAGS_dygraph_fuse_grad_buffer && IsSameBuffer(*src, *dst)) {
+    VLOG(6) << "Leaf Gradient Var(" << var_->Name()
+            << ") is empty, and written in its buffer by the grad op";
+    auto& src_tensor = src->Get<framework::LoDTensor>();
+    auto* dst_tensor = dst->GetMutable<framework::LoDTensor>();
+    dst_tensor->set_lod(src_tensor.lod());
+    var_->SetDataType(inner_var_->DataType());
+    var_->SetIsEmpty(false);
+  } else if (FLAGS_dygraph_fuse_grad_buffer && CanCopyToBuffer(*src, *dst)) {
+    VLOG(6) << "Leaf Gradient Var(" << var_->Name()
+            << ") is empty, copy to its buffer in place";
+    auto& src_tensor = src->Get<framework::LoDTensor>();
+    auto* dst_tensor = dst->GetMutable<framework::LoDTensor>();
+    framework::TensorCopySync(src_tensor, dst_tensor->place(), dst_tensor);
+    dst_tensor->set_lod(src_tensor.lod());
+    var_->SetDataType(inner_var_->DataType());
+    var_->SetIsEmpty(false);
   } else {
     VLOG(6) << "Leaf Gradient Var(" << var_->Name()
             << ") has not been initialized, not accumulate. Just move";
@@ -691,5 +777,152 @@ void SortedGradientAccumulator::SumGrad(std::shared_ptr<VariableWrapper> var,
   }
 }
 
+bool FusedGradientBuffer::Contains(const VariableWrapper& grad_var) const {
+  if (!grad_var.Var().IsType<framework::LoDTensor>()) {
+    return false;
+  }
+  auto& tensor = grad_var.Var().Get<framework::LoDTensor>();
+  for (auto& buffer : buffers_) {
+    if (tensor.IsSharedBufferWith(buffer.flat)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void FusedGradientBuffer::ReleaseUnused() {
+  // a gradient leaves its slice once destructed or released
+  buffers_.erase(
+      std::remove_if(
+          buffers_.begin(), buffers_.end(),
+          [](const Buffer& buffer) {
+            return std::none_of(
+                buffer.vars.begin(), buffer.vars.end(),
+                [&buffer](const std::weak_ptr<VariableWrapper>& weak_var) {
+                  auto var = weak_var.lock();
+                  return var && var->Var().IsType<framework::LoDTensor>() &&
+                         var->Var().Get<framework::LoDTensor>()
+                             .IsSharedBufferWith(buffer.flat);
+                });
+          }),
+      buffers_.end());
+  for (auto iter = unproduced_.begin(); iter != unproduced_.end();) {
+    iter = iter->expired() ? unproduced_.erase(iter) : std::next(iter);
+  }
+}
+
+void FusedGradientBuffer::ReleaseUnproduced() {
+  for (auto& weak_var : reserved_) {
+    auto var = weak_var.lock();
+    // the grad op has run once it is not empty
+    if (!var || !var->IsEmpty() || !Contains(*var)) {
+      continue;
+    }
+    VLOG(6) << "Release the slice of Gradient Var(" << var->Name()
+            << "), which is not produced by the backward";
+    var->MutableVar()->GetMutable<framework::LoDTensor>()->clear();
+    unproduced_.insert(var);
+  }
+  reserved_.clear();
+}
+
+void FusedGradientBuffer::Reserve(const std::vector<GradMeta>& grads) {
+  ReleaseUnused();
+
+  std::map<framework::proto::VarType::Type, std::vector<GradMeta>> candidates;
+  for (auto& grad : grads) {
+    if (!grad.var || grad.var->Type() != framework::proto::VarType::LOD_TENSOR ||
+        framework::product(grad.dims) <= 0) {
+      continue;
+    }
+    auto& var = grad.var->Var();
+    if (var.IsInitialized() && (!var.IsType<framework::LoDTensor>() ||
+                                var.Get<framework::LoDTensor>().IsInitialized())) {
+      continue;
+    }
+    if (unproduced_.count(grad.var) > 0) {
+      continue;
+    }
+    auto& same_type_grads = candidates[grad.type];
+    if (std::find_if(same_type_grads.begin(), same_type_grads.end(),
+                     [&grad](const GradMeta& other) {
+                       return other.var == grad.var;
+                     }) == same_type_grads.end()) {
+      same_type_grads.push_back(grad);
+    }
+  }
+  for (auto& pair : candidates) {
+    Fuse(pair.first, pair.second);
+  }
+}
+
+void FusedGradientBuffer::Assign(
+    const std::vector<std::shared_ptr<VariableWrapper>>& grad_vars) {
+  ReleaseUnproduced();
+  ReleaseUnused();
+
+  std::map<framework::proto::VarType::Type, std::vector<GradMeta>> candidates;
+  for (auto& var : grad_vars) {
+    if (!var || var->IsEmpty() || !var->Var().IsType<framework::LoDTensor>()) {
+      continue;
+    }
+    auto& tensor = var->Var().Get<framework::LoDTensor>();
+    if (!tensor.IsInitialized() || tensor.numel() == 0 ||
+        !platform::is_cpu_place(tensor.place()) || Contains(*var)) {
+      continue;
+    }
+    auto& same_type_grads = candidates[tensor.type()];
+    if (std::find_if(same_type_grads.begin(), same_type_grads.end(),
+                     [&var](const GradMeta& other) {
+                       return other.var == var;
+                     }) == same_type_grads.end()) {
+      same_type_grads.push_back({var, tensor.dims(), tensor.type()});
+    }
+  }
+  for (auto& pair : candidates) {
+    Fuse(pair.first, pair.second);
+  }
+}
+
+void FusedGradientBuffer::Fuse(framework::proto::VarType::Type type,
+                               const std::vector<GradMeta>& grads) {
+  // A single gradient gains nothing from a flat buffer.
+  if (grads.size() < 2) {
+    return;
+  }
+  int64_t total_numel = 0;
+  for (auto& grad : grads) {
+    total_numel += framework::product(grad.dims);
+  }
+
+  Buffer buffer;
+  buffer.flat.Resize({total_numel});
+  buffer.flat.mutable_data(platform::CPUPlace(), type);
+  size_t size_of_type = framework::SizeOfType(type);
+  int64_t offset = 0;
+  for (auto& grad : grads) {
+    auto* tensor = grad.var->MutableVar()->GetMutable<framework::LoDTensor>();
+    int64_t numel = framework::product(grad.dims);
+    auto slice = buffer.flat.Slice(offset, offset + numel);
+    if (tensor->IsInitialized()) {
+      std::memcpy(slice.data<void>(), tensor->data<void>(),
+                  numel * size_of_type);
+    } else {
+      // reserved before backward, it stays empty until its grad op runs
+      std::memset(slice.data<void>(), 0, numel * size_of_type);
+      grad.var->SetIsEmpty(true);
+      reserved_.emplace_back(grad.var);
+    }
+    tensor->ShareDataWith(slice);
+    tensor->Resize(grad.dims);
+    buffer.vars.emplace_back(grad.var);
+    offset += numel;
+  }
+  VLOG(3) << "Fuse " << grads.size() << " gradients of "
+          << framework::DataTypeToString(type) << " with " << total_numel
+          << " elements into one buffer";
+  buffers_.emplace_back(std::move(buffer));
+}
+
 }  // namespace imperative
 }  // namespace paddle
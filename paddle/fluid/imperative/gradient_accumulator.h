@@ -15,12 +15,17 @@
 #pragma once
 
 #include <memory>
+#include <set>
 #include <utility>
 #include <vector>
 
+#include "gflags/gflags.h"
+
 #include "paddle/fluid/imperative/hooks.h"
 #include "paddle/fluid/imperative/layer.h"
 
+DECLARE_bool(dygraph_fuse_grad_buffer);
+
 namespace paddle {
 namespace imperative {
 
@@ -93,6 +98,11 @@ class GradientAccumulator {
   // function that Sum Gradient with Previous Graph
   void AccumulateGrad();
 
+  // Let the grad op of this graph write into the buffer which the empty
+  // leaf gradient var_ still holds, e.g. a slice of FusedGradientBuffer,
+  // instead of a new allocation. AccumulateGrad then has nothing to copy.
+  void ShareLeafBufferWithInnerVar();
+
   /** [ Hook related methods ]
    *
    *  [Why need two types of VariableWrapperHook? ]
@@ -163,5 +173,68 @@ class SortedGradientAccumulator : public GradientAccumulator {
   std::vector<SavedVarInfo> tmp_grad_vars_;
 };
 
+/**
+ * [ Why need FusedGradientBuffer? ]
+ *
+ * ClearGradient sets the gradient of a leaf tensor to zero and marks it
+ * empty, then AccumulateGrad moves the gradient of the next batch into it,
+ * so the allocation of every parameter gradient is released and replaced
+ * by the output of its grad op in each batch.
+ *
+ * With FLAGS_dygraph_fuse_grad_buffer, the dense gradients with the same
+ * data type are assigned to slices of one flat buffer, as Reducer::Group
+ * does for allreduce. BasicEngine reserves the slices from the dims of the
+ * forward vars before the first backward, and the grad ops of the leaf
+ * gradients write into their slices, so the gradients stay contiguous and
+ * are never reallocated nor copied. Only CPU gradients are fused. A reserved
+ * gradient whose grad op did not run in the backward is released, so that it
+ * stays uninitialized rather than zero, and it is not reserved again.
+ */
+class FusedGradientBuffer {
+ public:
+  struct GradMeta {
+    std::shared_ptr<VariableWrapper> var;
+    framework::DDim dims;
+    framework::proto::VarType::Type type;
+  };
+
+  // Assign the gradients which are not initialized yet to new slices of
+  // the given dims and type. The gradients are left empty.
+  void Reserve(const std::vector<GradMeta>& grads);
+
+  // Called after the backward. Release the reserved gradients which are
+  // still empty, and assign the initialized dense gradients which are not in
+  // a buffer yet.
+  void Assign(const std::vector<std::shared_ptr<VariableWrapper>>& grad_vars);
+
+  // Return whether the gradient holds a slice of one of the buffers.
+  bool Contains(const VariableWrapper& grad_var) const;
+
+  size_t BufferCount() const { return buffers_.size(); }
+
+ private:
+  struct Buffer {
+    framework::Tensor flat;
+    std::vector<std::weak_ptr<VariableWrapper>> vars;
+  };
+
+  // Release the buffers none of whose gradients holds a slice anymore.
+  void ReleaseUnused();
+
+  void ReleaseUnproduced();
+
+  // Add a buffer of the gradients, which keep their data if initialized.
+  void Fuse(framework::proto::VarType::Type type,
+            const std::vector<GradMeta>& grads);
+
+  std::vector<Buffer> buffers_;
+  // reserved since the last Assign
+  std::vector<std::weak_ptr<VariableWrapper>> reserved_;
+  // reserved once but not produced by their backward
+  std::set<std::weak_ptr<VariableWrapper>,
+           std::owner_less<std::weak_ptr<VariableWrapper>>>
+      unproduced_;
+};
+
 }  // namespace imperative
 }  // namespace paddle
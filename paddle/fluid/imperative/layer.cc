@@ -373,8 +373,13 @@ static void OpBaseRunImpl(const framework::OperatorBase& op,
    */
   auto prepared_op =
       PreparedOp::Prepare(ins, outs, *op_kernel, place, attrs, default_attrs);
-  auto tmp_ins_ptr =
-      PrepareData<VarType>(*op_kernel, ins, prepared_op.kernel_type());
+  std::shared_ptr<NameVarMap<VarType>> tmp_ins_ptr = nullptr;
+  if (prepared_op.need_prepare_data()) {
+    tmp_ins_ptr =
+        PrepareData<VarType>(*op_kernel, ins, prepared_op.kernel_type());
+  } else {
+    SetForwardDataTypeOfGradVars<VarType>(ins);
+  }
   if (tmp_ins_ptr == nullptr) {
     prepared_op.Run(ins, outs, attrs, default_attrs);
   } else {
@@ -29,6 +29,8 @@
 namespace paddle {
 namespace imperative {
 
+class RecomputeSegment;
+
 // TODO(zjl): to support py_func layer
 class OpBase {
  public:
@@ -267,6 +269,16 @@ class GradOpNode {
     return grad_pending_nodes_;
   }
 
+  void SetRecomputeSegment(
+      const std::shared_ptr<RecomputeSegment>& recompute_segment) {
+    recompute_segment_ = recompute_segment;
+  }
+
+  // The forward segment to run again before this node, see recompute.h.
+  const std::shared_ptr<RecomputeSegment>& GetRecomputeSegment() const {
+    return recompute_segment_;
+  }
+
  private:
   DISABLE_COPY_AND_ASSIGN(GradOpNode);
 
@@ -276,6 +288,7 @@ class GradOpNode {
   // Mapping relationship between grad output and grad input of the grad node of
   // Inplace op.
   std::map<std::string, std::string> inplace_grad_name_map_;
+  std::shared_ptr<RecomputeSegment> recompute_segment_;
 };
 
 }  // namespace imperative
@@ -27,6 +27,7 @@
 #include "paddle/fluid/imperative/gradient_accumulator.h"
 #include "paddle/fluid/imperative/layer.h"
 #include "paddle/fluid/imperative/op_base.h"
+#include "paddle/fluid/imperative/recompute.h"
 #include "paddle/fluid/imperative/tracer.h"
 #include "paddle/fluid/operators/math/math_function.h"
 #include "paddle/fluid/platform/device_context.h"
@@ -72,6 +73,8 @@ static void GetGraphInfoBetweenTargets(
     std::unordered_map<OpBase *, std::unordered_set<OpBase *>> *pending_ops_ptr,
     std::unordered_map<OpBase *, size_t> *op_deps_ptr,
     std::unordered_set<VariableWrapper *> *related_grad_vars_ptr,
+    std::unordered_map<OpBase *, std::shared_ptr<RecomputeSegment>>
+        *recompute_segments_ptr,
     const std::unordered_set<VariableWrapper *> &no_grad_var_grad) {
   VLOG(10) << "prune graph starts";
   /**
@@ -118,6 +121,12 @@ static void GetGraphInfoBetweenTargets(
     auto *op = op_node_pair.first;
     auto *node = op_node_pair.second;
 
+    // The forward vars of a recompute segment are refilled before the
+    // first grad op of it runs, see PartialGradTask::Run.
+    if (node->GetRecomputeSegment()) {
+      (*recompute_segments_ptr)[op] = node->GetRecomputeSegment();
+    }
+
     VLOG(10) << "Visit node " << node << " , visit op " << op->Type();
 
     for (auto &output_pair : op->GetOutsMap()) {
@@ -565,6 +574,10 @@ class PartialGradTask {
   std::unordered_set<OpBase *> startup_ops_;
   std::unordered_map<OpBase *, std::unordered_set<OpBase *>> pending_ops_;
   std::unordered_map<OpBase *, size_t> op_deps_;
+  // The recompute segments of the grad ops, run again before the first
+  // grad op of each segment.
+  std::unordered_map<OpBase *, std::shared_ptr<RecomputeSegment>>
+      recompute_segments_;
 
   ReadyGradVarInfoMap ready_grad_vars_;
 
@@ -673,7 +686,7 @@ PartialGradTask::PartialGradTask(
   std::unordered_set<VariableWrapper *> related_grad_vars;
   GetGraphInfoBetweenTargets(&input_target_grads_, &out_set, &startup_ops_,
                              &pending_ops_, &op_deps_, &related_grad_vars,
-                             no_grad_var_grad_);
+                             &recompute_segments_, no_grad_var_grad_);
 
   for (auto &op_pair : pending_ops_) {
     auto *op = op_pair.first;
@@ -782,6 +795,10 @@ std::vector<std::shared_ptr<VarBase>> PartialGradTask::Run() {
 
     VLOG(10) << "Start to run " << op->Type();
     op->EnforceHasInOut();
+    auto segment_iter = recompute_segments_.find(op);
+    if (segment_iter != recompute_segments_.end()) {
+      segment_iter->second->Recompute();
+    }
     RunEachOp(op);
     if (!retain_graph_) {
       op->ClearBackwardTrace();
@@ -19,6 +19,7 @@
 #include "paddle/fluid/imperative/infer_shape_context.h"
 
 DECLARE_bool(check_nan_inf);
+DECLARE_int32(dygraph_prepared_op_cache_capacity);
 
 namespace paddle {
 namespace imperative {
@@ -79,12 +80,257 @@ PreparedOp::PreparedOp(const framework::OperatorBase& op,
                        const framework::RuntimeContext& ctx,
                        const framework::OpKernelType& kernel_type,
                        const framework::OperatorWithKernel::OpKernelFunc& func,
-                       platform::DeviceContext* dev_ctx)
+                       platform::DeviceContext* dev_ctx, bool need_prepare_data)
     : op_(op),
       ctx_(ctx),
       kernel_type_(kernel_type),
       func_(func),
-      dev_ctx_(dev_ctx) {}
+      dev_ctx_(dev_ctx),
+      need_prepare_data_(need_prepare_data) {}
+
+PreparedOpCache& PreparedOpCache::Instance() {
+  static thread_local PreparedOpCache g_prepared_op_cache;
+  return g_prepared_op_cache;
+}
+
+template <typename VarType>
+static PreparedOpCache::VarMeta GetVarMeta(const std::shared_ptr<VarType>& var,
+                                           bool with_tensor_meta) {
+  PreparedOpCache::VarMeta meta{-1, false, -1, -1, platform::CPUPlace()};
+  if (var == nullptr) {
+    return meta;
+  }
+  meta.var_type = static_cast<int>(var->Type());
+  if (!with_tensor_meta) {
+    return meta;
+  }
+  const auto* tensor = GetTensorFromVar(var->Var());
+  meta.initialized = tensor && tensor->IsInitialized();
+  if (meta.initialized) {
+    meta.data_type = static_cast<int>(tensor->type());
+    meta.layout = static_cast<int>(tensor->layout());
+    meta.place = tensor->place();
+  }
+  return meta;
+}
+
+static inline bool operator==(const PreparedOpCache::VarMeta& a,
+                              const PreparedOpCache::VarMeta& b) {
+  return a.var_type == b.var_type && a.initialized == b.initialized &&
+         a.data_type == b.data_type && a.layout == b.layout &&
+         a.place == b.place;
+}
+
+using SlotMetas =
+    std::vector<std::pair<std::string, std::vector<PreparedOpCache::VarMeta>>>;
+
+template <typename VarType>
+static SlotMetas GetSlotMetas(const NameVarMap<VarType>& vars,
+                              bool with_tensor_meta) {
+  SlotMetas metas;
+  metas.reserve(vars.size());
+  for (const auto& name_pair : vars) {
+    std::vector<PreparedOpCache::VarMeta> slot;
+    slot.reserve(name_pair.second.size());
+    for (const auto& var : name_pair.second) {
+      slot.emplace_back(GetVarMeta<VarType>(var, with_tensor_meta));
+    }
+    metas.emplace_back(name_pair.first, std::move(slot));
+  }
+  return metas;
+}
+
+// Compares in place, so that a hit allocates nothing.
+template <typename VarType>
+static bool MatchSlotMetas(const SlotMetas& metas,
+                           const NameVarMap<VarType>& vars,
+                           bool with_tensor_meta) {
+  if (metas.size() != vars.size()) {
+    return false;
+  }
+  auto meta_iter = metas.begin();
+  for (const auto& name_pair : vars) {
+    const auto& slot = *(meta_iter++);
+    if (slot.first != name_pair.first ||
+        slot.second.size() != name_pair.second.size()) {
+      return false;
+    }
+    for (size_t i = 0; i < slot.second.size(); ++i) {
+      if (!(slot.second[i] ==
+            GetVarMeta<VarType>(name_pair.second[i], with_tensor_meta))) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+template <typename VarType>
+const PreparedOpCache::Value* PreparedOpCache::Get(
+    size_t hash, const std::string& op_type, const NameVarMap<VarType>& ins,
+    const NameVarMap<VarType>& outs, const framework::AttributeMap& attrs,
+    const platform::Place& place) const {
+  auto iter = cache_.find(hash);
+  if (iter == cache_.end()) {
+    return nullptr;
+  }
+  const auto& key = iter->second.key;
+  if (key.op_type != op_type || !(key.place == place) || key.attrs != attrs ||
+      !MatchSlotMetas<VarType>(key.ins, ins, /*with_tensor_meta=*/true) ||
+      !MatchSlotMetas<VarType>(key.outs, outs, /*with_tensor_meta=*/false)) {
+    VLOG(3) << "Prepared op cache entry of " << op_type
+            << " collides with one of " << key.op_type << ", miss";
+    return nullptr;
+  }
+  return &(iter->second);
+}
+
+template <typename VarType>
+void PreparedOpCache::Insert(
+    size_t hash, const std::string& op_type, const NameVarMap<VarType>& ins,
+    const NameVarMap<VarType>& outs, const framework::AttributeMap& attrs,
+    const platform::Place& place, const framework::OpKernelType& kernel_type,
+    const framework::OperatorWithKernel::OpKernelFunc& func,
+    platform::DeviceContext* dev_ctx, bool need_prepare_data) {
+  if (cache_.size() >=
+      static_cast<size_t>(FLAGS_dygraph_prepared_op_cache_capacity)) {
+    VLOG(3) << "Prepared op cache is full (" << cache_.size()
+            << " entries), clear it";
+    cache_.clear();
+  }
+  Key key{op_type, place, attrs,
+          GetSlotMetas<VarType>(ins, /*with_tensor_meta=*/true),
+          GetSlotMetas<VarType>(outs, /*with_tensor_meta=*/false)};
+  // a colliding entry is replaced by the latest one
+  cache_.erase(hash);
+  cache_.emplace(hash, Value{std::move(key), kernel_type, func, dev_ctx,
+                             need_prepare_data});
+}
+
+template const PreparedOpCache::Value* PreparedOpCache::Get<VarBase>(
+    size_t hash, const std::string& op_type, const NameVarMap<VarBase>& ins,
+    const NameVarMap<VarBase>& outs, const framework::AttributeMap& attrs,
+    const platform::Place& place) const;
+template const PreparedOpCache::Value* PreparedOpCache::Get<VariableWrapper>(
+    size_t hash, const std::string& op_type,
+    const NameVarMap<VariableWrapper>& ins,
+    const NameVarMap<VariableWrapper>& outs,
+    const framework::AttributeMap& attrs, const platform::Place& place) const;
+
+template <typename T>
+static inline void HashCombine(size_t* seed, const T& val) {
+  std::hash<T> hasher;
+  (*seed) ^= hasher(val) + 0x9e3779b9 + ((*seed) << 6) + ((*seed) >> 2);
+}
+
+struct AttributeHashVisitor : public boost::static_visitor<size_t> {
+  size_t operator()(const boost::blank&) const { return 0; }
+
+  size_t operator()(framework::BlockDesc* block) const {
+    return std::hash<framework::BlockDesc*>()(block);
+  }
+
+  template <typename T>
+  size_t operator()(const T& val) const {
+    return std::hash<T>()(val);
+  }
+
+  template <typename T>
+  size_t operator()(const std::vector<T>& vals) const {
+    size_t seed = vals.size();
+    for (const auto& val : vals) {
+      HashCombine<T>(&seed, val);
+    }
+    return seed;
+  }
+
+  size_t operator()(const std::vector<bool>& vals) const {
+    return std::hash<std::vector<bool>>()(vals);
+  }
+};
+
+struct PlaceDeviceIdVisitor : public boost::static_visitor<int> {
+  template <typename PlaceType>
+  int operator()(const PlaceType&) const {
+    return 0;
+  }
+  int operator()(const platform::CUDAPlace& place) const {
+    return place.GetDeviceId();
+  }
+  int operator()(const platform::XPUPlace& place) const {
+    return place.GetDeviceId();
+  }
+  int operator()(const platform::NPUPlace& place) const {
+    return place.GetDeviceId();
+  }
+};
+
+static inline void HashPlace(size_t* seed, const platform::Place& place) {
+  HashCombine<int>(seed, place.which());
+  HashCombine<int>(seed, boost::apply_visitor(PlaceDeviceIdVisitor(), place));
+}
+
+template <typename VarType>
+static void HashNameVarMap(size_t* seed, const NameVarMap<VarType>& vars,
+                           bool with_tensor_meta) {
+  // NameVarMap is an ordered map, so the order of slots is fixed.
+  for (const auto& name_pair : vars) {
+    HashCombine<std::string>(seed, name_pair.first);
+    HashCombine<size_t>(seed, name_pair.second.size());
+    for (const auto& var : name_pair.second) {
+      if (var == nullptr) {
+        HashCombine<int>(seed, -1);
+        continue;
+      }
+      HashCombine<int>(seed, static_cast<int>(var->Type()));
+      if (!with_tensor_meta) {
+        continue;
+      }
+      const auto* tensor = GetTensorFromVar(var->Var());
+      bool initialized = tensor && tensor->IsInitialized();
+      HashCombine<bool>(seed, initialized);
+      if (initialized) {
+        HashCombine<int>(seed, static_cast<int>(tensor->type()));
+        HashCombine<int>(seed, static_cast<int>(tensor->layout()));
+        HashPlace(seed, tensor->place());
+      }
+    }
+  }
+}
+
+template <typename VarType>
+size_t PreparedOpCacheKey(const std::string& op_type,
+                          const NameVarMap<VarType>& ins,
+                          const NameVarMap<VarType>& outs,
+                          const framework::AttributeMap& attrs,
+                          const platform::Place& place) {
+  size_t seed = std::hash<std::string>()(op_type);
+  HashPlace(&seed, place);
+  // AttributeMap is an unordered map, combine the attributes with an order
+  // independent sum so that equal maps always get the same key.
+  size_t attrs_hash = attrs.size();
+  for (const auto& attr : attrs) {
+    size_t attr_seed = std::hash<std::string>()(attr.first);
+    HashCombine<int>(&attr_seed, attr.second.which());
+    HashCombine<size_t>(&attr_seed,
+                        boost::apply_visitor(AttributeHashVisitor(),
+                                             attr.second));
+    attrs_hash += attr_seed;
+  }
+  HashCombine<size_t>(&seed, attrs_hash);
+  HashNameVarMap<VarType>(&seed, ins, /*with_tensor_meta=*/true);
+  HashNameVarMap<VarType>(&seed, outs, /*with_tensor_meta=*/false);
+  return seed;
+}
+
+template size_t PreparedOpCacheKey<VarBase>(
+    const std::string& op_type, const NameVarMap<VarBase>& ins,
+    const NameVarMap<VarBase>& outs, const framework::AttributeMap& attrs,
+    const platform::Place& place);
+template size_t PreparedOpCacheKey<VariableWrapper>(
+    const std::string& op_type, const NameVarMap<VariableWrapper>& ins,
+    const NameVarMap<VariableWrapper>& outs,
+    const framework::AttributeMap& attrs, const platform::Place& place);
 
 template <typename VarType>
 PreparedOp PrepareImpl(const NameVarMap<VarType>& ins,
@@ -93,6 +339,23 @@ PreparedOp PrepareImpl(const NameVarMap<VarType>& ins,
                        const platform::Place& place,
                        const framework::AttributeMap& attrs,
                        const framework::AttributeMap& default_attrs) {
+  // The kernel selection reads the attributes of MKLDNN ops, which are
+  // overwritten below, so the cache is not used with MKLDNN.
+  const bool use_cache = FLAGS_dygraph_prepared_op_cache && !FLAGS_use_mkldnn;
+  size_t cache_key = 0;
+  if (use_cache) {
+    cache_key = PreparedOpCacheKey<VarType>(op.Type(), ins, outs, attrs, place);
+    auto* cached = PreparedOpCache::Instance().Get<VarType>(
+        cache_key, op.Type(), ins, outs, attrs, place);
+    if (cached) {
+      VLOG(4) << "Hit prepared op cache of " << op.Type() << ": "
+              << cached->kernel_type;
+      static framework::RuntimeContext empty_ctx({}, {});
+      return PreparedOp(op, empty_ctx, cached->kernel_type, cached->func,
+                        cached->dev_ctx, cached->need_prepare_data);
+    }
+  }
+
   platform::DeviceContextPool& pool = platform::DeviceContextPool::Instance();
   auto* dev_ctx = pool.Get(place);
 
@@ -155,6 +418,14 @@ PreparedOp PrepareImpl(const NameVarMap<VarType>& ins,
     dev_ctx = pool.Get(expected_kernel_key.place_);
   }
 
+  if (use_cache) {
+    bool need_prepare_data =
+        NeedPrepareData<VarType>(op, ins, expected_kernel_key);
+    PreparedOpCache::Instance().Insert<VarType>(
+        cache_key, op.Type(), ins, outs, attrs, place, expected_kernel_key,
+        kernel_iter->second, dev_ctx, need_prepare_data);
+  }
+
   return PreparedOp(op, ctx, expected_kernel_key, kernel_iter->second, dev_ctx);
 }
 
@@ -15,6 +15,7 @@
 #pragma once
 #include <memory>
 #include <string>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -26,6 +27,7 @@
 #include "paddle/fluid/imperative/type_defs.h"
 
 DECLARE_bool(use_mkldnn);
+DECLARE_bool(dygraph_prepared_op_cache);
 
 namespace paddle {
 namespace framework {
@@ -69,6 +71,17 @@ extern const std::shared_ptr<VariableWrapper>& GetVariableWrapper(
 extern const std::shared_ptr<VariableWrapper>& GetVariableWrapper(
     const std::shared_ptr<VariableWrapper>& var);
 
+template <typename VarType>
+void SetForwardDataTypeOfGradVars(const NameVarMap<VarType>& ins) {
+  for (const auto& name_pair : ins) {
+    for (const auto& var : name_pair.second) {
+      if (var) {
+        SetForwardDataTypeOfGradVar(var);
+      }
+    }
+  }
+}
+
 template <typename VarType>
 std::shared_ptr<NameVarMap<VarType>> PrepareData(
     const framework::OperatorWithKernel& op, const NameVarMap<VarType>& ins,
@@ -139,13 +152,112 @@ std::shared_ptr<NameVarMap<VarType>> PrepareData(
   return tmp_ins_ptr;
 }
 
+// Return whether any initialized input of op should be transformed to
+// expected_kernel_key, i.e. whether PrepareData has anything to do.
+template <typename VarType>
+bool NeedPrepareData(const framework::OperatorWithKernel& op,
+                     const NameVarMap<VarType>& ins,
+                     const framework::OpKernelType& expected_kernel_key) {
+  for (const auto& name_pair : ins) {
+    for (const auto& var_base : name_pair.second) {
+      const auto* tensor = GetTensorFromVar(var_base->Var());
+      if (tensor && tensor->IsInitialized()) {
+        auto kernel_type_for_var = op.GetKernelTypeForVar(
+            name_pair.first, *tensor, expected_kernel_key);
+        if (NeedTransform(kernel_type_for_var, expected_kernel_key)) {
+          return true;
+        }
+      }
+    }
+  }
+  return false;
+}
+
+/**
+ * [ Why need PreparedOpCache? ]
+ *
+ * In dygraph mode, every traced op goes through PreparedOp::Prepare, which
+ * builds an execution context for GetExpectedKernelType and looks up the
+ * kernel maps, then PrepareData calls GetKernelTypeForVar for every input.
+ * For models with many tiny ops this dominates the step time.
+ *
+ * The result only depends on the op type, the attributes and the var type,
+ * data type, place and layout of the inputs and outputs, so it is cached
+ * when FLAGS_dygraph_prepared_op_cache is on. The entries are found by a hash
+ * of those, and every hit compares the full key, so a hash collision misses
+ * the cache instead of running a wrong kernel.
+ * The cache is thread local, so no lock is needed on the hot path.
+ */
+class PreparedOpCache {
+ public:
+  // The var type of an input or output, and for an input the data type,
+  // layout and place of its tensor.
+  struct VarMeta {
+    int var_type;
+    bool initialized;
+    int data_type;
+    int layout;
+    platform::Place place;
+  };
+
+  struct Key {
+    std::string op_type;
+    platform::Place place;
+    framework::AttributeMap attrs;
+    std::vector<std::pair<std::string, std::vector<VarMeta>>> ins;
+    std::vector<std::pair<std::string, std::vector<VarMeta>>> outs;
+  };
+
+  struct Value {
+    Key key;
+    framework::OpKernelType kernel_type;
+    framework::OperatorWithKernel::OpKernelFunc func;
+    platform::DeviceContext* dev_ctx;
+    bool need_prepare_data;
+  };
+
+  static PreparedOpCache& Instance();
+
+  // Return nullptr if not cached, or if the entry of the hash was cached for
+  // another op type, place, attributes, inputs or outputs.
+  template <typename VarType>
+  const Value* Get(size_t hash, const std::string& op_type,
+                   const NameVarMap<VarType>& ins,
+                   const NameVarMap<VarType>& outs,
+                   const framework::AttributeMap& attrs,
+                   const platform::Place& place) const;
+
+  template <typename VarType>
+  void Insert(size_t hash, const std::string& op_type,
+              const NameVarMap<VarType>& ins, const NameVarMap<VarType>& outs,
+              const framework::AttributeMap& attrs,
+              const platform::Place& place,
+              const framework::OpKernelType& kernel_type,
+              const framework::OperatorWithKernel::OpKernelFunc& func,
+              platform::DeviceContext* dev_ctx, bool need_prepare_data);
+
+  size_t Size() const { return cache_.size(); }
+
+  void Clear() { cache_.clear(); }
+
+ private:
+  std::unordered_map<size_t, Value> cache_;
+};
+
+template <typename VarType>
+size_t PreparedOpCacheKey(const std::string& op_type,
+                          const NameVarMap<VarType>& ins,
+                          const NameVarMap<VarType>& outs,
+                          const framework::AttributeMap& attrs,
+                          const platform::Place& place);
+
 class PreparedOp {
  public:
   PreparedOp(const framework::OperatorBase& op,
              const framework::RuntimeContext& ctx,
              const framework::OpKernelType& kernel_type,
              const framework::OperatorWithKernel::OpKernelFunc& func,
-             platform::DeviceContext* dev_ctx);
+             platform::DeviceContext* dev_ctx, bool need_prepare_data = true);
 
   static PreparedOp Prepare(const NameVarMap<VarBase>& ins,
                             const NameVarMap<VarBase>& outs,
@@ -172,12 +284,16 @@ class PreparedOp {
 
   const framework::OpKernelType& kernel_type() const { return kernel_type_; }
 
+  // False only if it is known that no input needs data transform.
+  bool need_prepare_data() const { return need_prepare_data_; }
+
  private:
   const framework::OperatorBase& op_;
   const framework::RuntimeContext& ctx_;
   framework::OpKernelType kernel_type_;
   framework::OperatorWithKernel::OpKernelFunc func_;
   platform::DeviceContext* dev_ctx_;
+  bool need_prepare_data_;
 };
 
 }  // namespace imperative
@@ -0,0 +1,202 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "paddle/fluid/imperative/recompute.h"
+
+#include <unordered_set>
+#include <utility>
+
+#include "paddle/fluid/imperative/layer.h"
+#include "paddle/fluid/imperative/op_base.h"
+#include "paddle/fluid/platform/profiler.h"
+
+namespace paddle {
+namespace imperative {
+
+static NameVarMap<VariableWrapper> ToVariableWrapperMap(
+    const NameVarBaseMap& vars) {
+  NameVarMap<VariableWrapper> result;
+  for (auto& pair : vars) {
+    auto& wrappers = result[pair.first];
+    for (auto& var : pair.second) {
+      wrappers.emplace_back(var ? var->SharedVar() : nullptr);
+    }
+  }
+  return result;
+}
+
+RecomputeSegment::RecomputeSegment(bool preserve_rng_state)
+    : preserve_rng_state_(preserve_rng_state) {
+  if (preserve_rng_state_) {
+    SaveRNGState();
+  }
+}
+
+void RecomputeSegment::SaveRNGState() {
+  cpu_generator_state_ = framework::DefaultCPUGenerator()->GetState();
+  op_default_cpu_engine_ = *framework::OpDefaultCPUEngine();
+#if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
+  cuda_generator_state_ = framework::GetDefaultCUDAGenerator()->GetState();
+#endif
+}
+
+void RecomputeSegment::SwapRNGState() {
+  auto cpu_generator_state = framework::DefaultCPUGenerator()->GetState();
+  framework::DefaultCPUGenerator()->SetState(cpu_generator_state_);
+  cpu_generator_state_ = cpu_generator_state;
+
+  auto op_default_cpu_engine = framework::OpDefaultCPUEngine();
+  std::swap(*op_default_cpu_engine, op_default_cpu_engine_);
+
+#if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
+  auto& cuda_generator = framework::GetDefaultCUDAGenerator();
+  auto cuda_generator_state = cuda_generator->GetState();
+  cuda_generator->SetState(cuda_generator_state_);
+  cuda_generator_state_ = cuda_generator_state;
+#endif
+}
+
+void RecomputeSegment::AddOp(std::shared_ptr<framework::OperatorBase> op,
+                             const NameVarBaseMap& ins,
+                             const NameVarBaseMap& outs,
+                             const framework::AttributeMap& attrs,
+                             const framework::AttributeMap& default_attrs,
+                             const platform::Place& place) {
+  PADDLE_ENFORCE_EQ(finished_, false,
+                    platform::errors::PreconditionNotMet(
+                        "Can not add op %s to a finished recompute segment.",
+                        op->Type()));
+  for (auto& pair : outs) {
+    for (auto& var : pair.second) {
+      if (var) {
+        out_var_bases_[var->SharedVar().get()] = var;
+      }
+    }
+  }
+  ops_.push_back({std::move(op), ToVariableWrapperMap(ins),
+                  ToVariableWrapperMap(outs), attrs, default_attrs, place});
+}
+
+void RecomputeSegment::AddGradNode(
+    const std::shared_ptr<GradOpNode>& grad_node) {
+  if (grad_node) {
+    grad_nodes_.emplace_back(grad_node);
+  }
+}
+
+void RecomputeSegment::Finish(
+    const std::vector<std::shared_ptr<VarBase>>& outputs) {
+  PADDLE_ENFORCE_EQ(finished_, false,
+                    platform::errors::PreconditionNotMet(
+                        "The recompute segment has been finished."));
+  finished_ = true;
+
+  std::unordered_set<const VariableWrapper*> kept_vars;
+  for (auto& var : outputs) {
+    if (var) {
+      kept_vars.insert(var->SharedVar().get());
+    }
+  }
+
+  // The vars read before they are produced in this segment are its inputs.
+  std::unordered_set<const VariableWrapper*> produced_vars;
+  for (auto& recorded_op : ops_) {
+    for (auto& pair : recorded_op.ins) {
+      for (auto& var : pair.second) {
+        if (var && produced_vars.count(var.get()) == 0) {
+          kept_vars.insert(var.get());
+        }
+      }
+    }
+    for (auto& pair : recorded_op.outs) {
+      for (auto& var : pair.second) {
+        if (var) {
+          produced_vars.insert(var.get());
+        }
+      }
+    }
+  }
+
+  std::unordered_set<const VariableWrapper*> released_vars;
+  size_t held_var_num = 0;
+  for (auto& recorded_op : ops_) {
+    for (auto& pair : recorded_op.outs) {
+      for (auto& var : pair.second) {
+        if (!var || kept_vars.count(var.get()) ||
+            released_vars.count(var.get()) ||
+            !var->Var().IsType<framework::LoDTensor>()) {
+          continue;
+        }
+        auto var_base_iter = out_var_bases_.find(var.get());
+        if (var_base_iter != out_var_bases_.end() &&
+            !var_base_iter->second.expired()) {
+          VLOG(4) << "Keep the intermediate var " << var->Name()
+                  << " of recompute segment, which is still held";
+          kept_vars.insert(var.get());
+          ++held_var_num;
+          continue;
+        }
+        // Keep the LoDTensor with its dims and inplace version, only
+        // release its memory.
+        auto* tensor = var->MutableVar()->GetMutable<framework::LoDTensor>();
+        if (tensor->IsInitialized()) {
+          released_memory_size_ += tensor->memory_size();
+        }
+        tensor->clear();
+        released_vars.insert(var.get());
+      }
+    }
+  }
+
+  out_var_bases_.clear();
+
+  VLOG(3) << "Recompute segment with " << ops_.size() << " ops releases "
+          << released_vars.size() << " intermediate vars ("
+          << released_memory_size_ << " bytes), keeps " << held_var_num
+          << " held ones";
+
+  // NOTE: the grad nodes hold the segment, but the segment does not hold
+  // the grad nodes, so there is no reference cycle.
+  auto self = shared_from_this();
+  for (auto& weak_node : grad_nodes_) {
+    if (auto node = weak_node.lock()) {
+      node->SetRecomputeSegment(self);
+    }
+  }
+  grad_nodes_.clear();
+}
+
+void RecomputeSegment::Recompute() {
+  if (recomputed_) {
+    return;
+  }
+  recomputed_ = true;
+  platform::RecordEvent record_event("Recompute");
+  VLOG(3) << "Recompute segment with " << ops_.size() << " ops";
+
+  if (preserve_rng_state_) {
+    SwapRNGState();
+  }
+  for (auto& recorded_op : ops_) {
+    OpBase::Run(*recorded_op.op, recorded_op.ins, recorded_op.outs,
+                recorded_op.attrs, recorded_op.default_attrs,
+                recorded_op.place);
+  }
+  if (preserve_rng_state_) {
+    SwapRNGState();
+  }
+}
+
+}  // namespace imperative
+}  // namespace paddle
@@ -0,0 +1,119 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#pragma once
+
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "paddle/fluid/framework/generator.h"
+#include "paddle/fluid/framework/operator.h"
+#include "paddle/fluid/framework/type_defs.h"
+#include "paddle/fluid/imperative/type_defs.h"
+#include "paddle/fluid/platform/place.h"
+
+namespace paddle {
+namespace imperative {
+
+class GradOpNode;
+class VarBase;
+class VariableWrapper;
+
+/**
+ * [ Why need RecomputeSegment? ]
+ *
+ * The grad ops hold every forward activation they need until backward, so
+ * long sequence models run out of memory before they run out of compute.
+ *
+ * The ops traced between Tracer::BeginRecompute and Tracer::EndRecompute
+ * form a segment. When the segment ends, the tensors of its intermediate
+ * vars, i.e. the vars produced inside the segment except its outputs, are
+ * released, and every grad node of the segment holds the segment. Before
+ * BasicEngine or PartialGradEngine runs the first grad op of the segment,
+ * the forward ops are run again from the saved inputs to refill the released
+ * tensors, with the random generator state of the forward replayed so that
+ * random ops such as dropout produce the same result.
+ *
+ * Only the intermediate vars which no VarBase holds any more are released.
+ * A var still held by the user, e.g. by a python variable alive after the
+ * segment, keeps its tensor, since the user may read it before backward.
+ *
+ * Inplace ops are not allowed in a segment, since running them again would
+ * modify the saved inputs twice.
+ */
+class RecomputeSegment
+    : public std::enable_shared_from_this<RecomputeSegment> {
+ public:
+  explicit RecomputeSegment(bool preserve_rng_state);
+
+  void AddOp(std::shared_ptr<framework::OperatorBase> op,
+             const NameVarBaseMap& ins, const NameVarBaseMap& outs,
+             const framework::AttributeMap& attrs,
+             const framework::AttributeMap& default_attrs,
+             const platform::Place& place);
+
+  void AddGradNode(const std::shared_ptr<GradOpNode>& grad_node);
+
+  // Release the intermediate vars which are not in outputs and not held by
+  // any VarBase, and attach the segment to its grad nodes.
+  void Finish(const std::vector<std::shared_ptr<VarBase>>& outputs);
+
+  // Run the forward ops again, only the first call takes effect.
+  void Recompute();
+
+  bool IsFinished() const { return finished_; }
+
+  bool IsRecomputed() const { return recomputed_; }
+
+  size_t OpSize() const { return ops_.size(); }
+
+  // The bytes of the intermediate tensors released by Finish.
+  size_t ReleasedMemorySize() const { return released_memory_size_; }
+
+ private:
+  struct RecordedOp {
+    std::shared_ptr<framework::OperatorBase> op;
+    NameVarMap<VariableWrapper> ins;
+    NameVarMap<VariableWrapper> outs;
+    framework::AttributeMap attrs;
+    framework::AttributeMap default_attrs;
+    platform::Place place;
+  };
+
+  void SaveRNGState();
+  void SwapRNGState();
+
+  std::vector<RecordedOp> ops_;
+  std::vector<std::weak_ptr<GradOpNode>> grad_nodes_;
+  // The VarBases of the vars produced in the segment, to tell at Finish
+  // whether the user still holds them.
+  std::unordered_map<const VariableWrapper*, std::weak_ptr<VarBase>>
+      out_var_bases_;
+
+  bool preserve_rng_state_;
+  framework::GeneratorState cpu_generator_state_;
+  std::mt19937_64 op_default_cpu_engine_;
+#if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
+  framework::GeneratorState cuda_generator_state_;
+#endif
+
+  bool finished_{false};
+  bool recomputed_{false};
+  size_t released_memory_size_{0};
+};
+
+}  // namespace imperative
+}  // namespace paddle
@@ -28,7 +28,7 @@ namespace paddle {
 namespace imperative {
 
 #if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_RCCL) || \
-    defined(PADDLE_WITH_XPU_BKCL)
+    defined(PADDLE_WITH_XPU_BKCL) || defined(PADDLE_WITH_GLOO)
 // div the nranks
 void Group::DivNRanks(const platform::DeviceContext &context, int64_t nranks) {
   framework::Tensor *tensor =
@@ -307,6 +307,14 @@ Reducer::Reducer(const std::vector<std::shared_ptr<imperative::VarBase>> &vars,
 #endif
   // initialize groups
   InitializeGroups(group_indices);
+#ifdef PADDLE_WITH_GLOO
+  // On CPU, the allreduce of gloo is blocking, so it runs in comm_pool_ to
+  // overlap with backward.
+  if (comm_pool_ == nullptr && platform::is_cpu_place(place_)) {
+    comm_pool_.reset(new ::ThreadPool(1));
+    comm_op_count_ = 0;
+  }
+#endif
   for (size_t global_var_index = 0; global_var_index < vars_.size();
        ++global_var_index) {
     auto var = vars_[global_var_index];
@@ -767,30 +775,38 @@ void Reducer::MarkGroupReady(size_t group_index) {
     // so we expose WaitCompute() interface and call
     // it here.
     parallel_ctx_->WaitCompute(run_order);
-#ifdef PADDLE_WITH_XPU_BKCL
-    {
-      std::lock_guard<std::mutex> lock(mutex_);
-      comm_op_count_ += 1;  // lock
-    }
-    // TODO(liuyuhui): Add try catch to deal with exception later,
-    // otherwise the main thread will continue to run when an exception is
-    // thrown in comm_pool_.
-    auto next_group = next_group_;
-    comm_pool_->enqueue([this, run_order, next_group, &group] {
-      auto dev_id = BOOST_GET_CONST(platform::XPUPlace, place_).device;
-      platform::SetXPUDeviceId(dev_id);
-      FusedAllReduceSchedule(run_order, group, next_group);
+#if defined(PADDLE_WITH_XPU_BKCL) || defined(PADDLE_WITH_GLOO)
+    if (comm_pool_ != nullptr) {
       {
         std::lock_guard<std::mutex> lock(mutex_);
-        comm_op_count_ -= 1;  // lock
-        cv_.notify_all();
+        comm_op_count_ += 1;  // lock
       }
-    });
-#elif defined(PADDLE_WITH_RCCL) || defined(PADDLE_WITH_NCCL)
+      // TODO(liuyuhui): Add try catch to deal with exception later,
+      // otherwise the main thread will continue to run when an exception is
+      // thrown in comm_pool_.
+      auto next_group = next_group_;
+      comm_pool_->enqueue([this, run_order, next_group, &group] {
+#ifdef PADDLE_WITH_XPU_BKCL
+        if (platform::is_xpu_place(place_)) {
+          auto dev_id = BOOST_GET_CONST(platform::XPUPlace, place_).device;
+          platform::SetXPUDeviceId(dev_id);
+        }
+#endif
+        FusedAllReduceSchedule(run_order, group, next_group);
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          comm_op_count_ -= 1;  // lock
+          cv_.notify_all();
+        }
+      });
+      continue;
+    }
+#endif
+#if defined(PADDLE_WITH_RCCL) || defined(PADDLE_WITH_NCCL)
     FusedAllReduceSchedule(run_order, group, next_group_);
 #else
     PADDLE_THROW(platform::errors::PreconditionNotMet(
-        "Not compiled with BKCL or NCCL."));
+        "Not compiled with BKCL, NCCL or GLOO."));
 #endif
   }
 }
@@ -942,8 +958,8 @@ bool Reducer::HasGrad(size_t var_index) {
 
 void Reducer::FinalizeBackward() {
   groups_need_finalize_ = false;
-#ifdef PADDLE_WITH_XPU_BKCL
-  {
+#if defined(PADDLE_WITH_XPU_BKCL) || defined(PADDLE_WITH_GLOO)
+  if (comm_pool_ != nullptr) {
     std::unique_lock<std::mutex> lock(mutex_);
     cv_.wait(lock, [&] { return comm_op_count_ == 0; });
   }
@@ -965,6 +981,10 @@ void Reducer::FinalizeBackward() {
 // TODO(liuyuhui) support xpu about Tensorcopy/TensorFromVector/TensorToVector
 #if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_RCCL)
     ProcessUnusedDenseVars();
+#elif defined(PADDLE_WITH_GLOO)
+    if (platform::is_cpu_place(place_)) {
+      ProcessUnusedDenseVars();
+    }
 #endif
     // Initialize local used vars
     local_used_vars_.clear();
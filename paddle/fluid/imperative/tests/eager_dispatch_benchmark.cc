@@ -0,0 +1,88 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measure how many tiny ops per second Tracer::TraceOp can run on CPU, with
+// and without FLAGS_dygraph_prepared_op_cache.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/imperative/prepared_operator.h"
+#include "paddle/fluid/imperative/tracer.h"
+#include "paddle/fluid/platform/device_tracer.h"
+
+DEFINE_int32(burning, 100, "Burning times.");
+DEFINE_int32(repeat, 100000, "Repeat times.");
+DEFINE_int32(numel, 16, "The numel of the inputs of the traced op.");
+
+namespace paddle {
+namespace imperative {
+
+static std::shared_ptr<VarBase> CreateInput(const std::string& name,
+                                            int64_t numel) {
+  auto var = std::make_shared<VarBase>(false, name);
+  auto* tensor = var->MutableVar()->GetMutable<framework::LoDTensor>();
+  tensor->Resize(framework::make_ddim({numel}));
+  auto* data = tensor->mutable_data<float>(platform::CPUPlace());
+  for (int64_t i = 0; i < numel; ++i) {
+    data[i] = static_cast<float>(i);
+  }
+  return var;
+}
+
+static double BenchTraceOp(bool use_cache) {
+  FLAGS_dygraph_prepared_op_cache = use_cache;
+  PreparedOpCache::Instance().Clear();
+
+  Tracer tracer;
+  platform::CPUPlace place;
+  auto x = CreateInput("x", FLAGS_numel);
+  auto y = CreateInput("y", FLAGS_numel);
+  auto out = std::make_shared<VarBase>(false, "out");
+  NameVarBaseMap ins = {{"X", {x}}, {"Y", {y}}};
+  NameVarBaseMap outs = {{"Out", {out}}};
+  framework::AttributeMap attrs = {{"axis", -1}};
+
+  for (int i = 0; i < FLAGS_burning; ++i) {
+    tracer.TraceOp("elementwise_add", ins, outs, attrs, place, false);
+  }
+  auto start = platform::PosixInNsec();
+  for (int i = 0; i < FLAGS_repeat; ++i) {
+    tracer.TraceOp("elementwise_add", ins, outs, attrs, place, false);
+  }
+  auto end = platform::PosixInNsec();
+  return FLAGS_repeat / (static_cast<double>(end - start) * 1e-9);
+}
+
+}  // namespace imperative
+}  // namespace paddle
+
+int main(int argc, char* argv[]) {
+  ::GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  LOG(INFO) << "Trace elementwise_add of " << FLAGS_numel << " floats "
+            << FLAGS_repeat << " times";
+  double without_cache = paddle::imperative::BenchTraceOp(false);
+  double with_cache = paddle::imperative::BenchTraceOp(true);
+  LOG(INFO) << "Without prepared op cache: " << without_cache << " ops/s";
+  LOG(INFO) << "With prepared op cache: " << with_cache << " ops/s ("
+            << with_cache / without_cache << "x)";
+  return 0;
+}
+
+USE_OP(elementwise_add);
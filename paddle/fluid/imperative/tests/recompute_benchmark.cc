@@ -0,0 +1,125 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Measure the memory kept by a chain of tanh ops after forward and the time
+// of forward and backward, with and without recompute segments.
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/framework/op_registry.h"
+#include "paddle/fluid/imperative/basic_engine.h"
+#include "paddle/fluid/imperative/tracer.h"
+#include "paddle/fluid/platform/device_tracer.h"
+
+DEFINE_int32(repeat, 10, "Repeat times.");
+DEFINE_int32(numel, 1 << 20, "The numel of each activation.");
+DEFINE_int32(op_num, 64, "The number of tanh ops in the chain.");
+DEFINE_int32(segment_size, 8, "The number of ops in each recompute segment.");
+
+namespace paddle {
+namespace imperative {
+
+struct BenchResult {
+  size_t kept_bytes{0};
+  double time_in_ms{0};
+};
+
+static std::shared_ptr<VarBase> CreateInput(const std::string& name,
+                                            int64_t numel) {
+  auto var = std::make_shared<VarBase>(true, name);
+  var->SetOverridedStopGradient(false);
+  auto* tensor = var->MutableVar()->GetMutable<framework::LoDTensor>();
+  tensor->Resize(framework::make_ddim({numel}));
+  auto* data = tensor->mutable_data<float>(platform::CPUPlace());
+  for (int64_t i = 0; i < numel; ++i) {
+    data[i] = static_cast<float>(i % 100) / 100;
+  }
+  return var;
+}
+
+static BenchResult BenchRecompute(bool use_recompute) {
+  BenchResult result;
+  platform::CPUPlace place;
+  auto x = CreateInput("x", FLAGS_numel);
+
+  auto start = platform::PosixInNsec();
+  for (int r = 0; r < FLAGS_repeat; ++r) {
+    Tracer tracer;
+    // not held, which would keep them from being released
+    std::vector<std::weak_ptr<VariableWrapper>> activations;
+    auto h = x;
+    for (int i = 0; i < FLAGS_op_num; ++i) {
+      bool begin_segment = use_recompute && i % FLAGS_segment_size == 0;
+      bool end_segment = use_recompute &&
+                         (i % FLAGS_segment_size == FLAGS_segment_size - 1 ||
+                          i == FLAGS_op_num - 1);
+      if (begin_segment) {
+        tracer.BeginRecompute(false);
+      }
+      auto out = std::make_shared<VarBase>(true, "tanh_" + std::to_string(i));
+      tracer.TraceOp("tanh", {{"X", {h}}}, {{"Out", {out}}}, {}, place, true);
+      activations.emplace_back(out->SharedVar());
+      h = out;
+      if (end_segment) {
+        tracer.EndRecompute({h});
+      }
+    }
+
+    if (r == 0) {
+      for (auto& weak_var : activations) {
+        auto var = weak_var.lock();
+        if (!var) {
+          continue;
+        }
+        auto& tensor = var->Var().Get<framework::LoDTensor>();
+        if (tensor.IsInitialized()) {
+          result.kept_bytes += tensor.memory_size();
+        }
+      }
+    }
+
+    BasicEngine engine;
+    engine.Init({h}, {nullptr});
+    engine.Execute();
+    x->ClearGradient();
+  }
+  auto end = platform::PosixInNsec();
+  result.time_in_ms = static_cast<double>(end - start) * 1e-6 / FLAGS_repeat;
+  return result;
+}
+
+}  // namespace imperative
+}  // namespace paddle
+
+int main(int argc, char* argv[]) {
+  ::GFLAGS_NAMESPACE::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  LOG(INFO) << "Chain of " << FLAGS_op_num << " tanh ops of " << FLAGS_numel
+            << " floats, recompute segment size " << FLAGS_segment_size;
+  auto baseline = paddle::imperative::BenchRecompute(false);
+  auto recompute = paddle::imperative::BenchRecompute(true);
+  LOG(INFO) << "Without recompute: " << baseline.kept_bytes
+            << " bytes kept after forward, " << baseline.time_in_ms
+            << " ms per step";
+  LOG(INFO) << "With recompute: " << recompute.kept_bytes
+            << " bytes kept after forward, " << recompute.time_in_ms
+            << " ms per step";
+  return 0;
+}
+
+USE_OP(tanh);
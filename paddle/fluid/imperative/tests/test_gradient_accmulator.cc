@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <memory>
+#include <string>
 #include <type_traits>
 #include <vector>
 #include "gtest/gtest.h"
@@ -365,5 +366,155 @@ TEST(test_gradient_accumulator, test_unchange_input) {
   }
 }
 
+TEST(test_gradient_accumulator, test_fused_gradient_buffer) {
+  platform::CPUPlace place;
+  std::vector<std::shared_ptr<VariableWrapper>> grad_vars;
+  std::vector<int64_t> numels = {3, 5, 7};
+  for (size_t i = 0; i < numels.size(); ++i) {
+    auto var = std::make_shared<VariableWrapper>("grad_" + std::to_string(i));
+    auto* tensor = var->MutableVar()->GetMutable<framework::LoDTensor>();
+    tensor->Resize({numels[i]});
+    auto* data = tensor->mutable_data<float>(place);
+    for (int64_t j = 0; j < numels[i]; ++j) {
+      data[j] = static_cast<float>(i * 10 + j);
+    }
+    var->SetIsEmpty(false);
+    grad_vars.push_back(var);
+  }
+
+  FusedGradientBuffer buffer;
+  buffer.Assign(grad_vars);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+  // assign again should not create another buffer
+  buffer.Assign(grad_vars);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+
+  const float* expected_ptr = nullptr;
+  for (size_t i = 0; i < grad_vars.size(); ++i) {
+    ASSERT_TRUE(buffer.Contains(*grad_vars[i]));
+    auto& tensor = grad_vars[i]->Var().Get<framework::LoDTensor>();
+    ASSERT_EQ(tensor.numel(), numels[i]);
+    const float* data = tensor.data<float>();
+    // the gradients are contiguous in the buffer
+    if (expected_ptr) {
+      ASSERT_EQ(data, expected_ptr);
+    }
+    expected_ptr = data + numels[i];
+    for (int64_t j = 0; j < numels[i]; ++j) {
+      ASSERT_EQ(data[j], static_cast<float>(i * 10 + j));
+    }
+  }
+
+  // the buffer is released after all gradients are destructed
+  grad_vars.clear();
+  buffer.Assign(grad_vars);
+  ASSERT_EQ(buffer.BufferCount(), 0UL);
+}
+
+TEST(test_gradient_accumulator, test_fused_gradient_buffer_in_place) {
+  FLAGS_dygraph_fuse_grad_buffer = true;
+  platform::CPUPlace place;
+  std::vector<FusedGradientBuffer::GradMeta> grads;
+  for (size_t i = 0; i < 2; ++i) {
+    auto var = std::make_shared<VariableWrapper>("grad_" + std::to_string(i));
+    var->SetOverridedStopGradient(false);
+    var->SetForwardDataType(framework::proto::VarType::FP32);
+    grads.push_back(
+        {var, framework::make_ddim({2, 3}), framework::proto::VarType::FP32});
+  }
+
+  // reserved before the first backward, the gradients stay empty
+  FusedGradientBuffer buffer;
+  buffer.Reserve(grads);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+  for (auto& grad : grads) {
+    ASSERT_TRUE(buffer.Contains(*grad.var));
+    ASSERT_TRUE(grad.var->IsEmpty());
+  }
+
+  // the grad op writes into the slice, which AccumulateGrad keeps
+  auto& slice = grads[0].var->Var().Get<framework::LoDTensor>();
+  const float* slice_data = slice.data<float>();
+  EagerGradientAccumulator accumulator(grads[0].var.get());
+  accumulator.IncreaseRefCnt();
+  accumulator.ShareLeafBufferWithInnerVar();
+  auto* out =
+      accumulator.InnerVar()->MutableVar()->GetMutable<framework::LoDTensor>();
+  out->Resize(framework::make_ddim({2, 3}));
+  float* out_data = out->mutable_data<float>(place);
+  ASSERT_EQ(out_data, slice_data);
+  for (int i = 0; i < 6; ++i) {
+    out_data[i] = static_cast<float>(i);
+  }
+  accumulator.AccumulateGrad();
+  ASSERT_FALSE(grads[0].var->IsEmpty());
+  auto& grad = grads[0].var->Var().Get<framework::LoDTensor>();
+  ASSERT_EQ(grad.data<float>(), slice_data);
+  for (int i = 0; i < 6; ++i) {
+    ASSERT_EQ(grad.data<float>()[i], static_cast<float>(i));
+  }
+
+  // an output of another size is allocated anew, not over the next slice
+  auto& next_slice = grads[1].var->Var().Get<framework::LoDTensor>();
+  EagerGradientAccumulator next_accumulator(grads[1].var.get());
+  next_accumulator.IncreaseRefCnt();
+  next_accumulator.ShareLeafBufferWithInnerVar();
+  auto* next_out = next_accumulator.InnerVar()
+                       ->MutableVar()
+                       ->GetMutable<framework::LoDTensor>();
+  next_out->Resize(framework::make_ddim({4, 3}));
+  ASSERT_NE(next_out->mutable_data<float>(place), next_slice.data<float>());
+  FLAGS_dygraph_fuse_grad_buffer = false;
+}
+
+TEST(test_gradient_accumulator, test_fused_gradient_buffer_unproduced) {
+  std::vector<FusedGradientBuffer::GradMeta> grads;
+  std::vector<std::shared_ptr<VariableWrapper>> grad_vars;
+  for (size_t i = 0; i < 3; ++i) {
+    auto var = std::make_shared<VariableWrapper>("grad_" + std::to_string(i));
+    var->SetForwardDataType(framework::proto::VarType::FP32);
+    grads.push_back(
+        {var, framework::make_ddim({2, 3}), framework::proto::VarType::FP32});
+    grad_vars.push_back(var);
+  }
+
+  FusedGradientBuffer buffer;
+  buffer.Reserve(grads);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+  // the grad ops of the first two gradients run, the third one's does not
+  for (size_t i = 0; i < 2; ++i) {
+    grads[i].var->SetIsEmpty(false);
+  }
+  buffer.Assign(grad_vars);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+  for (size_t i = 0; i < 2; ++i) {
+    ASSERT_TRUE(buffer.Contains(*grads[i].var));
+  }
+  // no zero gradient for the third one
+  ASSERT_FALSE(buffer.Contains(*grads[2].var));
+  ASSERT_TRUE(grads[2].var->IsEmpty());
+  ASSERT_FALSE(
+      grads[2].var->Var().Get<framework::LoDTensor>().IsInitialized());
+
+  // nor in the next backward
+  buffer.Reserve(grads);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+  ASSERT_FALSE(
+      grads[2].var->Var().Get<framework::LoDTensor>().IsInitialized());
+
+  // a buffer none of whose gradients is produced is released
+  std::vector<FusedGradientBuffer::GradMeta> other_grads;
+  for (size_t i = 0; i < 2; ++i) {
+    auto var = std::make_shared<VariableWrapper>("other_grad_" +
+                                                 std::to_string(i));
+    other_grads.push_back(
+        {var, framework::make_ddim({4}), framework::proto::VarType::FP32});
+  }
+  buffer.Reserve(other_grads);
+  ASSERT_EQ(buffer.BufferCount(), 2UL);
+  buffer.Assign(grad_vars);
+  ASSERT_EQ(buffer.BufferCount(), 1UL);
+}
+
 }  // namespace imperative
 }  // namespace paddle
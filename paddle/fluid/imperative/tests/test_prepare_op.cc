@@ -214,6 +214,62 @@ TEST(test_prepare_op, test_prepare_data_cpu_mkldnn) {
   TestPrepareDataSamePlace({{"use_mkldnn", true}});
 }
 #endif
+
+TEST(test_prepare_op, test_prepared_op_cache) {
+  std::shared_ptr<imperative::VarBase> vin(
+      new imperative::VarBase(false, "vin"));
+  std::shared_ptr<imperative::VarBase> vout(
+      new imperative::VarBase(false, "vout"));
+  platform::CPUPlace cpu_place;
+  auto* vin_tensor = vin->MutableVar()->GetMutable<framework::LoDTensor>();
+  vin_tensor->Resize(framework::make_ddim({2, 5}));
+  vin_tensor->mutable_data<float>(cpu_place);
+
+  var_pair x_pair = var_pair("X", vb_vector(1, vin));
+  var_pair out_pair = var_pair("Out", vb_vector(1, vout));
+  imperative::NameVarBaseMap ins = {x_pair};
+  imperative::NameVarBaseMap outs = {out_pair};
+  const std::string op_type = "relu";
+  framework::AttributeMap attr_map;
+  const auto& info = framework::OpInfoMap::Instance().Get(op_type);
+  if (info.Checker()) info.Checker()->Check(&attr_map);
+  auto op = framework::OpRegistry::CreateOp(
+      op_type, CreateVarNameMap(info, op_type, ins, true),
+      CreateVarNameMap(info, op_type, outs, false), attr_map);
+  auto& op_kernel = dynamic_cast<framework::OperatorWithKernel&>(*op);
+
+  FLAGS_dygraph_prepared_op_cache = true;
+  auto& cache = PreparedOpCache::Instance();
+  cache.Clear();
+  auto prepared_op =
+      PreparedOp::Prepare(ins, outs, op_kernel, cpu_place, attr_map, {});
+  ASSERT_EQ(cache.Size(), 1UL);
+  auto cached_op =
+      PreparedOp::Prepare(ins, outs, op_kernel, cpu_place, attr_map, {});
+  ASSERT_EQ(cache.Size(), 1UL);
+  ASSERT_EQ(cached_op.kernel_type(), prepared_op.kernel_type());
+  ASSERT_FALSE(cached_op.need_prepare_data());
+
+  size_t float_key = PreparedOpCacheKey<imperative::VarBase>(
+      op_type, ins, outs, attr_map, cpu_place);
+  ASSERT_NE(cache.Get<imperative::VarBase>(float_key, op_type, ins, outs,
+                                           attr_map, cpu_place),
+            nullptr);
+
+  // different dtype of input should not hit the cache, even under the hash
+  // of the float inputs, as if the two keys collided
+  vin_tensor->mutable_data<double>(cpu_place);
+  ASSERT_EQ(cache.Get<imperative::VarBase>(float_key, op_type, ins, outs,
+                                           attr_map, cpu_place),
+            nullptr);
+  auto double_op =
+      PreparedOp::Prepare(ins, outs, op_kernel, cpu_place, attr_map, {});
+  ASSERT_EQ(cache.Size(), 2UL);
+  ASSERT_EQ(double_op.kernel_type().data_type_,
+            framework::proto::VarType::FP64);
+  FLAGS_dygraph_prepared_op_cache = false;
+  cache.Clear();
+}
 }  // namespace imperative
 }  // namespace paddle
 
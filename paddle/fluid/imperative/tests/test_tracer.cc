@@ -403,6 +403,81 @@ TEST(test_tracer, test_var_without_grad_var) {
   }
 }
 
+static std::shared_ptr<imperative::VarBase> CreateTanhInput() {
+  auto x = std::make_shared<imperative::VarBase>(true, "x");
+  x->SetOverridedStopGradient(false);
+  auto* tensor = x->MutableVar()->GetMutable<framework::LoDTensor>();
+  tensor->Resize(framework::make_ddim({2, 5}));
+  auto* data = tensor->mutable_data<float>(platform::CPUPlace());
+  for (int i = 0; i < tensor->numel(); ++i) {
+    data[i] = 0.2f * i - 1.0f;
+  }
+  return x;
+}
+
+// The grad of x through a chain of three tanh ops, each of whose grad reads
+// the output of its forward op, i.e. the activations released by recompute.
+static std::vector<float> TanhChainGrad(
+    bool use_recompute,
+    std::shared_ptr<imperative::RecomputeSegment>* segment = nullptr) {
+  imperative::Tracer tracer;
+  platform::CPUPlace place;
+  auto x = CreateTanhInput();
+  auto out = std::make_shared<imperative::VarBase>(true, "out");
+  if (use_recompute) {
+    tracer.BeginRecompute();
+  }
+  {
+    auto h1 = std::make_shared<imperative::VarBase>(true, "h1");
+    auto h2 = std::make_shared<imperative::VarBase>(true, "h2");
+    tracer.TraceOp("tanh", {{"X", {x}}}, {{"Out", {h1}}}, {}, place, true);
+    tracer.TraceOp("tanh", {{"X", {h1}}}, {{"Out", {h2}}}, {}, place, true);
+    tracer.TraceOp("tanh", {{"X", {h2}}}, {{"Out", {out}}}, {}, place, true);
+  }
+  if (use_recompute) {
+    *segment = tracer.EndRecompute({out});
+  }
+
+  imperative::BasicEngine engine;
+  engine.Init({out}, {nullptr});
+  engine.Execute();
+
+  auto& x_grad = x->GradVar().Get<framework::LoDTensor>();
+  return std::vector<float>(x_grad.data<float>(),
+                            x_grad.data<float>() + x_grad.numel());
+}
+
+TEST(test_tracer, test_recompute) {
+  auto expected = TanhChainGrad(false);
+  std::shared_ptr<imperative::RecomputeSegment> segment;
+  auto grad = TanhChainGrad(true, &segment);
+
+  // h1 and h2 are released, x and out are kept
+  ASSERT_EQ(segment->OpSize(), 3UL);
+  ASSERT_EQ(segment->ReleasedMemorySize(), 2 * 10 * sizeof(float));
+  ASSERT_TRUE(segment->IsRecomputed());
+  ASSERT_EQ(grad.size(), expected.size());
+  for (size_t i = 0; i < grad.size(); ++i) {
+    ASSERT_FLOAT_EQ(grad[i], expected[i]);
+  }
+}
+
+TEST(test_tracer, test_recompute_keeps_held_vars) {
+  imperative::Tracer tracer;
+  platform::CPUPlace place;
+  auto x = CreateTanhInput();
+  auto h1 = std::make_shared<imperative::VarBase>(true, "h1");
+  auto out = std::make_shared<imperative::VarBase>(true, "out");
+  tracer.BeginRecompute();
+  tracer.TraceOp("tanh", {{"X", {x}}}, {{"Out", {h1}}}, {}, place, true);
+  tracer.TraceOp("tanh", {{"X", {h1}}}, {{"Out", {out}}}, {}, place, true);
+  auto segment = tracer.EndRecompute({out});
+
+  // h1 is still held here, so the user can read it
+  ASSERT_EQ(segment->ReleasedMemorySize(), 0UL);
+  ASSERT_TRUE(h1->Var().Get<framework::LoDTensor>().IsInitialized());
+}
+
 template <typename T>
 using WeakPtrSet =
     std::set<std::weak_ptr<T>, std::owner_less<std::weak_ptr<T>>>;
@@ -538,3 +613,4 @@ USE_OP(mul_grad);
 USE_OP(reduce_sum);
 USE_OP(reduce_sum_grad);
 USE_OP(elementwise_add);
+USE_OP(tanh);
@@ -227,12 +227,23 @@ void Tracer::TraceOp(const std::string& type, const NameVarBaseMap& ins,
     program_desc_tracer_->InsertOp(type, new_ins, outs, attrs);
   }
 
+  std::shared_ptr<GradOpNode> grad_node;
   if (ComputeRequiredGrad(new_ins, outs, trace_backward)) {
-    CreateGradOpNode(*op, new_ins, outs, attrs, default_attrs, place,
-                     inplace_map);
+    grad_node = CreateGradOpNode(*op, new_ins, outs, attrs, default_attrs,
+                                 place, inplace_map);
   } else {
     VLOG(3) << "No Grad to track for Op: " << type;
   }
+
+  if (recompute_segment_) {
+    PADDLE_ENFORCE_EQ(
+        inplace_map.empty(), true,
+        platform::errors::Unimplemented(
+            "Inplace op %s is not supported in recompute segment.", type));
+    recompute_segment_->AddOp(std::move(op), new_ins, outs, attrs,
+                              default_attrs, place);
+    recompute_segment_->AddGradNode(grad_node);
+  }
 }
 
 void Tracer::TraceOp(const std::string& type, const NameVarBaseMap& ins,
@@ -242,6 +253,27 @@ void Tracer::TraceOp(const std::string& type, const NameVarBaseMap& ins,
           inplace_map);
 }
 
+void Tracer::BeginRecompute(bool preserve_rng_state) {
+  PADDLE_ENFORCE_EQ(recompute_segment_, nullptr,
+                    platform::errors::PreconditionNotMet(
+                        "Nested recompute segment is not supported."));
+  VLOG(3) << "Begin recompute segment";
+  recompute_segment_ = std::make_shared<RecomputeSegment>(preserve_rng_state);
+}
+
+std::shared_ptr<RecomputeSegment> Tracer::EndRecompute(
+    const std::vector<std::shared_ptr<VarBase>>& outputs) {
+  PADDLE_ENFORCE_NOT_NULL(
+      recompute_segment_,
+      platform::errors::PreconditionNotMet(
+          "EndRecompute is called without BeginRecompute."));
+  auto segment = std::move(recompute_segment_);
+  recompute_segment_ = nullptr;
+  segment->Finish(outputs);
+  VLOG(3) << "End recompute segment";
+  return segment;
+}
+
 void Tracer::SetExpectedPlace(platform::Place place) {
   expected_place_ = place;
 }
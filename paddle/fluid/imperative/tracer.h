@@ -26,6 +26,7 @@
 #include "paddle/fluid/imperative/basic_engine.h"
 #include "paddle/fluid/imperative/jit/program_desc_tracer.h"
 #include "paddle/fluid/imperative/layer.h"
+#include "paddle/fluid/imperative/recompute.h"
 #include "paddle/fluid/platform/macros.h"
 
 namespace paddle {
@@ -112,6 +113,15 @@ class Tracer {
   paddle::framework::GarbageCollector* MutableGarbageCollectorIfNotExists(
       const platform::Place& place);
 
+  // The ops traced until EndRecompute are recorded into a recompute segment,
+  // whose intermediate vars are released and computed again in backward.
+  void BeginRecompute(bool preserve_rng_state = true);
+
+  std::shared_ptr<RecomputeSegment> EndRecompute(
+      const std::vector<std::shared_ptr<VarBase>>& outputs);
+
+  bool IsRecomputing() const { return recompute_segment_ != nullptr; }
+
  private:
   std::unique_ptr<BasicEngine> basic_engine_;
   std::unique_ptr<jit::ProgramDescTracer> program_desc_tracer_;
@@ -121,6 +131,7 @@ class Tracer {
   bool has_grad_{true};
   bool enable_autocast_{false};
   GarbageCollectorMap gcs_;
+  std::shared_ptr<RecomputeSegment> recompute_segment_;
 };
 
 // To access static variable current_tracer
@@ -13,6 +13,8 @@
 // limitations under the License.
 
 #include "paddle/fluid/inference/analysis/ir_pass_manager.h"
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <map>
 #include <memory>
 #include <string>
@@ -221,11 +223,34 @@ std::unique_ptr<Graph> IRPassManager::Apply(std::unique_ptr<Graph> graph) {
   PADDLE_ENFORCE_NOT_NULL(graph.get(), platform::errors::PreconditionNotMet(
                                            "Graph cannot be NULL."));
   // Apply all the passes
+  pass_costs_.clear();
+  double total_cost = 0;
   for (const auto &pass : passes_) {
     if (pass->Type() != "graph_viz_pass" && !disable_logs_) {
       PrettyLogEndl(Style::H2(), "--- Running IR pass [%s]", pass->Type());
     }
+    auto start = std::chrono::steady_clock::now();
     graph.reset(pass->Apply(graph.release()));
+    double cost = std::chrono::duration<double, std::milli>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    pass_costs_.emplace_back(pass->Type(), cost);
+    total_cost += cost;
+  }
+
+  if (!disable_logs_) {
+    auto costs = pass_costs_;
+    std::stable_sort(costs.begin(), costs.end(),
+                     [](const std::pair<std::string, double> &a,
+                        const std::pair<std::string, double> &b) {
+                       return a.second > b.second;
+                     });
+    PrettyLogEndl(Style::H2(), "--- IR passes took %.3f ms in total",
+                  total_cost);
+    for (auto &cost : costs) {
+      PrettyLogEndl(Style::detail(), "    %-50s %10.3f ms", cost.first,
+                    cost.second);
+    }
   }
   return graph;
 }
@@ -52,12 +52,18 @@ class IRPassManager final {
 
   framework::ir::Graph &graph() const { return *graph_; }
 
+  // The milliseconds every pass took in the last Apply, in running order.
+  const std::vector<std::pair<std::string, double>> &pass_costs() const {
+    return pass_costs_;
+  }
+
  private:
   void CreatePasses(Argument *argument, const std::vector<std::string> &passes);
 
   std::unique_ptr<Graph> graph_;
   std::vector<std::unique_ptr<Pass>> passes_;
   bool disable_logs_{false};
+  std::vector<std::pair<std::string, double>> pass_costs_;
 };
 
 }  // namespace analysis
@@ -19,6 +19,7 @@
 #include <fcntl.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <atomic>
 #include <random>
 #include <string>
 
@@ -29,7 +30,33 @@ namespace paddle {
 namespace memory {
 namespace allocation {
 
+// The header of a file of the MemoryMapAllocationPool, the data follows it
+// at kPoolHeaderSize.
+struct MemoryMapPoolHeader {
+  std::atomic<int32_t> state;
+};
+
+enum MemoryMapPoolState : int32_t {
+  kFree = 0,
+  // written, not mapped by the reader yet
+  kInUse = 1,
+  // mapped by the reader while the writer has exited, the reader unlinks
+  // the file
+  kOrphaned = 2,
+  kMapped = 3,
+};
+
+static constexpr size_t kPoolHeaderSize = 64;
+
+static MemoryMapPoolHeader *PoolHeader(void *base) {
+  return reinterpret_cast<MemoryMapPoolHeader *>(base);
+}
+
 MemoryMapWriterAllocation::~MemoryMapWriterAllocation() {
+  // the file of a pooled allocation stays mapped in the pool
+  if (pooled_) {
+    return;
+  }
   PADDLE_ENFORCE_NE(
       munmap(this->ptr(), this->size()), -1,
       platform::errors::Unavailable("could not unmap the shared memory file %s",
@@ -37,6 +64,20 @@ MemoryMapWriterAllocation::~MemoryMapWriterAllocation() {
 }
 
 MemoryMapReaderAllocation::~MemoryMapReaderAllocation() {
+  if (pooled_) {
+    void *base = static_cast<char *>(this->ptr()) - kPoolHeaderSize;
+    auto state = PoolHeader(base)->state.exchange(kFree);
+    PADDLE_ENFORCE_NE(munmap(base, this->size() + kPoolHeaderSize), -1,
+                      platform::errors::Unavailable(
+                          "could not unmap the shared memory file %s",
+                          this->ipc_name()));
+    if (state == kOrphaned) {
+      shm_unlink(this->ipc_name().c_str());
+    }
+    MemoryMapFdSet::Instance().Remove(this->ipc_name());
+    VLOG(3) << "~MemoryMapReaderAllocation: release " << this->ipc_name();
+    return;
+  }
   PADDLE_ENFORCE_NE(
       munmap(this->ptr(), this->size()), -1,
       platform::errors::Unavailable("could not unmap the shared memory file %s",
@@ -99,6 +140,131 @@ std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
   return std::make_shared<MemoryMapReaderAllocation>(ptr, size, ipc_name);
 }
 
+std::shared_ptr<MemoryMapReaderAllocation>
+RebuildPooledMemoryMapReaderAllocation(const std::string &ipc_name,
+                                       size_t size) {
+  // read-write, the reader marks the file free in the header
+  int fd = shm_open(ipc_name.c_str(), O_RDWR, 0644);
+  PADDLE_ENFORCE_NE(
+      fd, -1, platform::errors::Unavailable("File descriptor %s open failed",
+                                            ipc_name.c_str()));
+
+  void *base = mmap(NULL, size + kPoolHeaderSize, PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  PADDLE_ENFORCE_NE(base, MAP_FAILED,
+                    platform::errors::Unavailable(
+                        "Memory map failed when rebuild shared memory."));
+  close(fd);
+  PoolHeader(base)->state.store(kMapped);
+  // unlinked by the reader's MemoryMapFdSet::Clear if the reader exits
+  // before releasing it
+  MemoryMapFdSet::Instance().Insert(ipc_name);
+  return std::make_shared<MemoryMapReaderAllocation>(
+      static_cast<char *>(base) + kPoolHeaderSize, size, ipc_name, true);
+}
+
+MemoryMapAllocationPool &MemoryMapAllocationPool::Instance() {  // NOLINT
+  static MemoryMapAllocationPool pool;
+  return pool;
+}
+
+std::shared_ptr<MemoryMapWriterAllocation> MemoryMapAllocationPool::Allocate(
+    size_t size) {
+  std::lock_guard<std::mutex> guard(mtx_);
+  // the smallest free file large enough, or else the smallest free file,
+  // which is replaced, so that the pool only grows with the files in use
+  int fit = -1;
+  int small = -1;
+  for (size_t i = 0; i < files_.size(); ++i) {
+    auto &file = files_[i];
+    if (PoolHeader(file.base)->state.load() != kFree) {
+      continue;
+    }
+    if (file.capacity >= size) {
+      if (fit == -1 || file.capacity < files_[fit].capacity) {
+        fit = i;
+      }
+    } else if (small == -1 || file.capacity < files_[small].capacity) {
+      small = i;
+    }
+  }
+
+  if (fit == -1) {
+    if (small != -1) {
+      Unmap(files_[small]);
+      shm_unlink(files_[small].ipc_name.c_str());
+      files_.erase(files_.begin() + small);
+    }
+    // rounded up, so that batches of varying sizes share the files
+    size_t capacity = 4096;
+    while (capacity < size) {
+      capacity <<= 1;
+    }
+    File file;
+    file.ipc_name = GetIPCName();
+    file.capacity = capacity;
+    int fd = shm_open(file.ipc_name.c_str(), O_RDWR | O_CREAT, 0644);
+    PADDLE_ENFORCE_NE(fd, -1,
+                      platform::errors::Unavailable(
+                          "File descriptor %s open failed",
+                          file.ipc_name.c_str()));
+    PADDLE_ENFORCE_EQ(ftruncate(fd, capacity + kPoolHeaderSize), 0,
+                      platform::errors::Unavailable(
+                          "Fruncate a file to a specified length failed!"));
+    file.base = mmap(NULL, capacity + kPoolHeaderSize, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    PADDLE_ENFORCE_NE(file.base, MAP_FAILED,
+                      platform::errors::Unavailable(
+                          "Memory map failed when create shared memory."));
+    close(fd);
+    new (file.base) MemoryMapPoolHeader();
+    PoolHeader(file.base)->state.store(kFree);
+    files_.emplace_back(std::move(file));
+    fit = files_.size() - 1;
+    VLOG(3) << "PID: " << getpid() << ", MemoryMapAllocationPool: create "
+            << files_[fit].ipc_name << " of " << capacity
+            << " bytes, file num: " << files_.size();
+  }
+
+  auto &file = files_[fit];
+  PoolHeader(file.base)->state.store(kInUse);
+  return std::make_shared<MemoryMapWriterAllocation>(
+      static_cast<char *>(file.base) + kPoolHeaderSize, size, file.ipc_name,
+      true);
+}
+
+size_t MemoryMapAllocationPool::FileNum() {
+  std::lock_guard<std::mutex> guard(mtx_);
+  return files_.size();
+}
+
+void MemoryMapAllocationPool::Unmap(const File &file) {
+  PADDLE_ENFORCE_NE(
+      munmap(file.base, file.capacity + kPoolHeaderSize), -1,
+      platform::errors::Unavailable("could not unmap the shared memory file %s",
+                                    file.ipc_name));
+}
+
+void MemoryMapAllocationPool::Clear() {
+  std::lock_guard<std::mutex> guard(mtx_);
+  for (auto &file : files_) {
+    // A file in use but never mapped, whose tensor was never unpickled, has
+    // no reader to unlink it.
+    int32_t state = kMapped;
+    bool orphaned = PoolHeader(file.base)->state.compare_exchange_strong(
+        state, kOrphaned);
+    Unmap(file);
+    if (!orphaned) {
+      shm_unlink(file.ipc_name.c_str());
+    }
+  }
+  VLOG(3) << "PID: " << getpid() << ", MemoryMapAllocationPool: clear "
+          << files_.size() << " files";
+  files_.clear();
+}
+
+MemoryMapAllocationPool::~MemoryMapAllocationPool() { Clear(); }
+
 MemoryMapFdSet &MemoryMapFdSet::Instance() {  // NOLINT
   static MemoryMapFdSet set;
   return set;
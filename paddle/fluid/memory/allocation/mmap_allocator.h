@@ -21,6 +21,7 @@
 #include <string>
 #include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "paddle/fluid/memory/allocation/allocator.h"
 
@@ -28,34 +29,44 @@ namespace paddle {
 namespace memory {
 namespace allocation {
 
+// A pooled allocation lives in a shared memory file of the
+// MemoryMapAllocationPool of the writer process, behind a header.
 class MemoryMapWriterAllocation : public Allocation {
  public:
   explicit MemoryMapWriterAllocation(void *ptr, size_t size,
-                                     std::string ipc_name)
+                                     std::string ipc_name, bool pooled = false)
       : Allocation(ptr, size, platform::CPUPlace()),
-        ipc_name_(std::move(ipc_name)) {}
+        ipc_name_(std::move(ipc_name)),
+        pooled_(pooled) {}
 
   inline const std::string &ipc_name() const { return ipc_name_; }
 
+  inline bool pooled() const { return pooled_; }
+
   ~MemoryMapWriterAllocation() override;
 
  private:
   std::string ipc_name_;
+  bool pooled_;
 };
 
 class MemoryMapReaderAllocation : public Allocation {
  public:
   explicit MemoryMapReaderAllocation(void *ptr, size_t size,
-                                     std::string ipc_name)
+                                     std::string ipc_name, bool pooled = false)
       : Allocation(ptr, size, platform::CPUPlace()),
-        ipc_name_(std::move(ipc_name)) {}
+        ipc_name_(std::move(ipc_name)),
+        pooled_(pooled) {}
 
   inline const std::string &ipc_name() const { return ipc_name_; }
 
+  inline bool pooled() const { return pooled_; }
+
   ~MemoryMapReaderAllocation() override;
 
  private:
   std::string ipc_name_;
+  bool pooled_;
 };
 
 std::shared_ptr<MemoryMapWriterAllocation> AllocateMemoryMapWriterAllocation(
@@ -64,6 +75,49 @@ std::shared_ptr<MemoryMapWriterAllocation> AllocateMemoryMapWriterAllocation(
 std::shared_ptr<MemoryMapReaderAllocation> RebuildMemoryMapReaderAllocation(
     const std::string &ipc_name, size_t size);
 
+// Maps the file of a pooled writer allocation, the file is given back to the
+// writer's pool when the returned allocation is released.
+std::shared_ptr<MemoryMapReaderAllocation>
+RebuildPooledMemoryMapReaderAllocation(const std::string &ipc_name,
+                                       size_t size);
+
+// An allocation of AllocateMemoryMapWriterAllocation is a new shared memory
+// file, unlinked by its reader. For the batches a DataLoader worker sends
+// to the trainer, the pool keeps the files instead: the reader marks a file
+// free when it releases the tensor, and the worker writes a later batch
+// into it. This saves the shm_open, ftruncate, mmap and page faults of a
+// new file for every tensor of every batch.
+// The pool is only for memory with exactly one reader.
+class MemoryMapAllocationPool {
+ public:
+  static MemoryMapAllocationPool &Instance();  // NOLINT
+
+  std::shared_ptr<MemoryMapWriterAllocation> Allocate(size_t size);
+
+  size_t FileNum();
+
+  // Unlinks the files, except the ones mapped by a reader, which the reader
+  // unlinks when it releases them. A file written but never mapped, whose
+  // tensor was lost on the way, is unlinked too.
+  void Clear();
+
+  ~MemoryMapAllocationPool();
+
+ private:
+  struct File {
+    std::string ipc_name;
+    void *base;
+    size_t capacity;
+  };
+
+  MemoryMapAllocationPool() = default;
+
+  void Unmap(const File &file);
+
+  std::vector<File> files_;
+  std::mutex mtx_;
+};
+
 class MemoryMapFdSet {
  public:
   static MemoryMapFdSet &Instance();  // NOLINT
@@ -16,6 +16,11 @@
 
 #include "paddle/fluid/memory/allocation/mmap_allocator.h"
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
 #include "gtest/gtest.h"
 
 namespace paddle {
@@ -45,6 +50,77 @@ TEST(MemoryMapAllocation, test_allocation_base) {
   }
 }
 
+TEST(MemoryMapAllocationPool, test_reuse_released_file) {
+  auto &pool = MemoryMapAllocationPool::Instance();
+  pool.Clear();
+  size_t data_size = 4UL * 1024;
+  auto writer_holder = pool.Allocate(data_size);
+  std::string ipc_name = writer_holder->ipc_name();
+  auto *writer_ptr = static_cast<int32_t *>(writer_holder->ptr());
+  for (int32_t i = 0; i < 1024; ++i) {
+    writer_ptr[i] = i;
+  }
+  writer_holder.reset();
+
+  // the file is in use until the reader releases it
+  auto in_use_holder = pool.Allocate(data_size);
+  ASSERT_NE(in_use_holder->ipc_name(), ipc_name);
+  ASSERT_EQ(pool.FileNum(), 2UL);
+
+  pid_t fpid = fork();
+  if (fpid == 0) {
+    int ret = 0;
+    {
+      auto reader_holder =
+          RebuildPooledMemoryMapReaderAllocation(ipc_name, data_size);
+      auto *reader_ptr = static_cast<int32_t *>(reader_holder->ptr());
+      for (int32_t i = 0; i < 1024; ++i) {
+        if (reader_ptr[i] != i) ret = 1;
+      }
+    }
+    _exit(ret);
+  }
+  int status = 0;
+  ASSERT_EQ(waitpid(fpid, &status, 0), fpid);
+  ASSERT_TRUE(WIFEXITED(status));
+  ASSERT_EQ(WEXITSTATUS(status), 0);
+
+  // released by the reader, reused without a new file
+  auto reused_holder = pool.Allocate(data_size / 2);
+  ASSERT_EQ(reused_holder->ipc_name(), ipc_name);
+  ASSERT_EQ(pool.FileNum(), 2UL);
+  // release the files as their readers would, Clear unlinks free files
+  RebuildPooledMemoryMapReaderAllocation(in_use_holder->ipc_name(), data_size);
+  RebuildPooledMemoryMapReaderAllocation(reused_holder->ipc_name(), data_size);
+  pool.Clear();
+  ASSERT_EQ(pool.FileNum(), 0UL);
+}
+
+static bool ShmExists(const std::string &ipc_name) {
+  int fd = shm_open(ipc_name.c_str(), O_RDONLY, 0644);
+  if (fd == -1) return false;
+  close(fd);
+  return true;
+}
+
+TEST(MemoryMapAllocationPool, test_clear_unmapped_file) {
+  auto &pool = MemoryMapAllocationPool::Instance();
+  pool.Clear();
+  size_t data_size = 4UL * 1024;
+  // the tensor of this file never reaches the reader
+  std::string lost_name = pool.Allocate(data_size)->ipc_name();
+  std::string mapped_name = pool.Allocate(data_size)->ipc_name();
+  auto reader_holder =
+      RebuildPooledMemoryMapReaderAllocation(mapped_name, data_size);
+
+  pool.Clear();
+  ASSERT_FALSE(ShmExists(lost_name));
+  // the reader unlinks the file it maps when releasing it
+  ASSERT_TRUE(ShmExists(mapped_name));
+  reader_holder.reset();
+  ASSERT_FALSE(ShmExists(mapped_name));
+}
+
 }  // namespace allocation
 }  // namespace memory
 }  // namespace paddle
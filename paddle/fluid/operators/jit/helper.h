@@ -14,7 +14,10 @@
 
 #pragma once
 
+#include <algorithm>
+#include <chrono>  // NOLINT
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
 #include <string>
@@ -22,18 +25,26 @@
 #include <utility>  // for std::move
 #include <vector>
 
+#include "gflags/gflags.h"
 #include "paddle/fluid/operators/jit/gen_base.h"
 #include "paddle/fluid/operators/jit/kernel_base.h"
 #include "paddle/fluid/operators/jit/kernel_key.h"
 #include "paddle/fluid/operators/jit/kernel_pool.h"
 #include "paddle/fluid/platform/place.h"
 
+DECLARE_bool(jit_autotune);
+
 namespace paddle {
 namespace operators {
 namespace jit {
 
 class GenBase;
 
+const char* to_string(KernelType kt);
+const char* to_string(SeqPoolType kt);
+
+KernelType to_kerneltype(const std::string& act);
+
 template <typename KernelTuple, typename PlaceType>
 inline typename std::enable_if<
     std::is_same<typename KernelTuple::data_type, float>::value &&
@@ -178,16 +189,124 @@ std::vector<typename KernelTuple::func_type> GetAllCandidateFuncs(
   return res;
 }
 
+// Return the average time in us of running the kernel in autotune mode
+template <typename Callable>
+double AutotuneTimeInUs(Callable&& run) {
+  constexpr int kBurning = 10;
+  constexpr int kRepeat = 100;
+  for (int i = 0; i < kBurning; ++i) {
+    run();
+  }
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRepeat; ++i) {
+    run();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::micro>(end - start).count() /
+         kRepeat;
+}
+
+// Measure one candidate on synthetic inputs built from the attr.
+// Only the kernels whose arguments can be derived from the attr alone are
+// tunable, the others always use the default search order.
+template <typename Func, typename Attr>
+struct AutotuneBench {
+  static constexpr bool kTunable = false;
+  static double Run(Func func, const Attr& attr) { return 0.; }
+};
+
+// x, y, z, n and a, x, y, n
+template <typename T>
+struct AutotuneBench<void (*)(const T*, const T*, T*, int), int> {
+  static constexpr bool kTunable = true;
+  static double Run(void (*func)(const T*, const T*, T*, int), int n) {
+    std::vector<T> x(n, static_cast<T>(1)), y(n, static_cast<T>(2)), z(n);
+    return AutotuneTimeInUs(
+        [&]() { func(x.data(), y.data(), z.data(), n); });
+  }
+};
+
+// x, y, n and x, returned value, n
+template <typename T>
+struct AutotuneBench<void (*)(const T*, T*, int), int> {
+  static constexpr bool kTunable = true;
+  static double Run(void (*func)(const T*, T*, int), int n) {
+    std::vector<T> x(n, static_cast<T>(1)), y(std::max(n, 1));
+    return AutotuneTimeInUs([&]() { func(x.data(), y.data(), n); });
+  }
+};
+
+// The key of AutotunedKernelPool: kernel type, data type and attr
+template <typename KernelTuple>
+std::string AutotuneKey(const typename KernelTuple::attr_type& attr) {
+  using T = typename KernelTuple::data_type;
+  const char* dtype = std::is_same<T, float>::value
+                          ? "float"
+                          : (std::is_same<T, double>::value ? "double"
+                                                            : "unknown");
+  return std::string(to_string(KernelTuple::kernel_type)) + "." + dtype + "." +
+         std::to_string(
+             JitCodeKey<typename KernelTuple::attr_type>(attr));
+}
+
+// Return the fastest implementation measured on this host.
+// The decision is recorded in AutotunedKernelPool, so it is only measured once
+// per process, or never if it was loaded from FLAGS_jit_autotune_cache_file.
+template <typename KernelTuple, typename PlaceType = platform::CPUPlace>
+typename KernelTuple::func_type GetAutotunedBestFunc(
+    const typename KernelTuple::attr_type& attr) {
+  using Bench = AutotuneBench<typename KernelTuple::func_type,
+                              typename KernelTuple::attr_type>;
+  auto funcs = GetAllCandidateFuncsWithTypes<KernelTuple, PlaceType>(attr);
+  PADDLE_ENFORCE_GE(funcs.size(), 1UL,
+                    platform::errors::InvalidArgument(
+                        "The candicate jit kernel is at least one in CPU."));
+  if (funcs.size() == 1 || !Bench::kTunable) {
+    return funcs[0].second;
+  }
+
+  auto& pool = AutotunedKernelPool::Instance();
+  std::string key = AutotuneKey<KernelTuple>(attr);
+  std::string impl_type;
+  if (pool.Find(key, &impl_type)) {
+    for (auto& f : funcs) {
+      if (f.first == impl_type) {
+        return f.second;
+      }
+    }
+    // The recorded implementation is not available here, measure again.
+    VLOG(3) << "Autotuned jit kernel " << impl_type << " of " << key
+            << " is not available, tune it again";
+  }
+
+  size_t best = 0;
+  double best_time = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < funcs.size(); ++i) {
+    double time = Bench::Run(funcs[i].second, attr);
+    VLOG(4) << "Autotune jit kernel " << key << ": " << funcs[i].first
+            << " takes " << time << " us";
+    if (time < best_time) {
+      best_time = time;
+      best = i;
+    }
+  }
+  VLOG(3) << "Autotune jit kernel " << key << " chooses " << funcs[best].first;
+  pool.Insert(key, funcs[best].first);
+  return funcs[best].second;
+}
+
 template <typename KernelTuple, typename PlaceType = platform::CPUPlace>
 typename KernelTuple::func_type GetDefaultBestFunc(
     const typename KernelTuple::attr_type& attr) {
+  if (FLAGS_jit_autotune) {
+    return GetAutotunedBestFunc<KernelTuple, PlaceType>(attr);
+  }
   auto funcs = GetAllCandidateFuncs<KernelTuple, PlaceType>(attr);
   PADDLE_ENFORCE_GE(funcs.size(), 1UL,
                     platform::errors::InvalidArgument(
                         "The candicate jit kernel is at least one in CPU."));
-  // Here could do some runtime benchmark of this attr and return the best one.
-  // But yet just get the first one as the default best one,
-  // which is searched in order and tuned by offline.
+  // Get the first one as the default best one, which is searched in order
+  // and tuned by offline. Use FLAGS_jit_autotune to benchmark at runtime.
   return funcs[0];
 }
 
@@ -241,11 +360,6 @@ class KernelFuncs {
   DISABLE_COPY_AND_ASSIGN(KernelFuncs);
 };
 
-const char* to_string(KernelType kt);
-const char* to_string(SeqPoolType kt);
-
-KernelType to_kerneltype(const std::string& act);
-
 inline std::ostream& operator<<(std::ostream& os, const lstm_attr_t& attr) {
   os << "dim_size[" << attr.d << "],act_gate[" << to_string(attr.act_gate)
      << "],act_cand[" << to_string(attr.act_cand) << "],act_cell["
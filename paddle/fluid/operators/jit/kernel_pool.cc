@@ -14,6 +14,19 @@
 
 #include "paddle/fluid/operators/jit/kernel_pool.h"
 
+#include <fstream>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "paddle/fluid/platform/enforce.h"
+
+DEFINE_bool(jit_autotune, false,
+            "Whether to choose the jit kernel implementation by measuring "
+            "all the candidates on first use instead of the static order.");
+DEFINE_string(jit_autotune_cache_file, "",
+              "The file to load and persist the jit autotune decisions. "
+              "Empty means the decisions are only kept in memory.");
+
 namespace paddle {
 namespace operators {
 namespace jit {
@@ -38,6 +51,69 @@ ReferKernelPool& ReferKernelPool::Instance() {
   return g_refer_kernel_pool;
 }
 
+AutotunedKernelPool& AutotunedKernelPool::Instance() {
+  static AutotunedKernelPool g_autotuned_kernel_pool;
+  return g_autotuned_kernel_pool;
+}
+
+AutotunedKernelPool::AutotunedKernelPool() {
+  if (!FLAGS_jit_autotune_cache_file.empty()) {
+    Load(FLAGS_jit_autotune_cache_file);
+  }
+}
+
+bool AutotunedKernelPool::Find(const std::string& key,
+                               std::string* impl_type) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto iter = decisions_.find(key);
+  if (iter == decisions_.end()) {
+    return false;
+  }
+  *impl_type = iter->second;
+  return true;
+}
+
+void AutotunedKernelPool::Insert(const std::string& key,
+                                 const std::string& impl_type) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  decisions_[key] = impl_type;
+  if (!FLAGS_jit_autotune_cache_file.empty()) {
+    std::ofstream fout(FLAGS_jit_autotune_cache_file, std::ios::app);
+    if (fout.is_open()) {
+      fout << key << " " << impl_type << "\n";
+    } else {
+      LOG(WARNING) << "Can not open jit autotune cache file "
+                   << FLAGS_jit_autotune_cache_file << " to append " << key;
+    }
+  }
+}
+
+void AutotunedKernelPool::Load(const std::string& path) {
+  std::ifstream fin(path);
+  if (!fin.is_open()) {
+    VLOG(3) << "Jit autotune cache file " << path << " does not exist yet";
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::string key, impl_type;
+  while (fin >> key >> impl_type) {
+    decisions_[key] = impl_type;
+  }
+  VLOG(3) << "Loaded " << decisions_.size()
+          << " jit autotune decisions from " << path;
+}
+
+void AutotunedKernelPool::Save(const std::string& path) const {
+  std::ofstream fout(path, std::ios::out | std::ios::trunc);
+  PADDLE_ENFORCE_EQ(fout.is_open(), true,
+                    platform::errors::Unavailable(
+                        "Can not open jit autotune cache file %s.", path));
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto& pair : decisions_) {
+    fout << pair.first << " " << pair.second << "\n";
+  }
+}
+
 }  // namespace jit
 }  // namespace operators
 }  // namespace paddle
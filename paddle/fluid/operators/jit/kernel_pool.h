@@ -16,6 +16,7 @@
 
 #include <map>
 #include <memory>  // for unique_ptr
+#include <mutex>   // NOLINT
 #include <string>
 #include <unordered_map>
 #include <utility>  // for move
@@ -129,6 +130,29 @@ class ReferKernelPool {
   DISABLE_COPY_AND_ASSIGN(ReferKernelPool);
 };
 
+// The implementation measured to be the fastest for each
+// (kernel type, data type, attr) when FLAGS_jit_autotune is enabled.
+// Unlike KernelFuncs it is shared by all threads, so a kernel is only measured
+// once per process. If FLAGS_jit_autotune_cache_file is set, the decisions
+// are loaded from it on first use and new ones are appended to it.
+class AutotunedKernelPool {
+ public:
+  static AutotunedKernelPool& Instance();
+  AutotunedKernelPool();
+
+  bool Find(const std::string& key, std::string* impl_type) const;
+  void Insert(const std::string& key, const std::string& impl_type);
+
+  // Each line of the file is "key impl_type", later lines win.
+  void Load(const std::string& path);
+  void Save(const std::string& path) const;
+
+ private:
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, std::string> decisions_;
+  DISABLE_COPY_AND_ASSIGN(AutotunedKernelPool);
+};
+
 }  // namespace jit
 }  // namespace operators
 }  // namespace paddle
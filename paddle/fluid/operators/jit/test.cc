@@ -12,6 +12,7 @@ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
 See the License for the specific language governing permissions and
 limitations under the License. */
 
+#include <cstdio>
 #include <iostream>
 #include <random>
 
@@ -1316,6 +1317,37 @@ TEST(JITKernel_key, sgd) {
   EXPECT_TRUE(key4 != key5);
 }
 
+TEST(JITKernel_autotune, vmul) {
+  using T = float;
+  using KernelTuple = jit::VMulTuple<T>;
+  const int d = 128;
+  auto func = jit::GetAutotunedBestFunc<KernelTuple, CPUPlace>(d);
+  EXPECT_TRUE(func != nullptr);
+
+  std::vector<T> x(d), y(d), zref(d), ztgt(d);
+  RandomVec<T>(d, x.data());
+  RandomVec<T>(d, y.data());
+  jit::GetReferFunc<KernelTuple>()(x.data(), y.data(), zref.data(), d);
+  func(x.data(), y.data(), ztgt.data(), d);
+  ExpectEQ<T>(ztgt.data(), zref.data(), d);
+
+  // the decision is recorded and can be persisted
+  auto key = jit::AutotuneKey<KernelTuple>(d);
+  std::string impl_type;
+  auto& pool = jit::AutotunedKernelPool::Instance();
+  EXPECT_TRUE(pool.Find(key, &impl_type));
+  EXPECT_TRUE(jit::GetAutotunedBestFunc<KernelTuple, CPUPlace>(d) == func);
+
+  const std::string path = "jit_autotune_cache_test.txt";
+  pool.Save(path);
+  jit::AutotunedKernelPool loaded;
+  loaded.Load(path);
+  std::string loaded_impl_type;
+  EXPECT_TRUE(loaded.Find(key, &loaded_impl_type));
+  EXPECT_EQ(loaded_impl_type, impl_type);
+  std::remove(path.c_str());
+}
+
 // test kernerls
 #define TestKernelVMul TestKernelXYZN
 #define TestKernelVAdd TestKernelXYZN
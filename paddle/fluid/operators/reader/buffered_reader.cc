@@ -13,28 +13,49 @@
 // limitations under the License.
 
 #include "paddle/fluid/operators/reader/buffered_reader.h"
+#include <chrono>  // NOLINT
 #include "paddle/fluid/platform/profiler.h"
 
 namespace paddle {
 namespace operators {
 namespace reader {
+
+// The memory of a slot still held by the consumer cannot be written, the
+// slot gets new memory for the next batch instead.
+static void ReleaseHeldBuffers(std::vector<framework::LoDTensor> *buffers) {
+  for (auto &tensor : *buffers) {
+    if (tensor.Holder() && tensor.Holder().use_count() > 1) {
+      tensor = framework::LoDTensor();
+    }
+  }
+}
+
+// Only the copy to a device place runs in parallel with the reads.
+static size_t NumCopyThreads(const platform::Place &place,
+                             size_t num_threads) {
+  if (platform::is_cpu_place(place)) {
+    if (num_threads > 1) {
+      VLOG(1) << "BufferedReader on CPUPlace has nothing to copy, uses one "
+                 "thread instead of "
+              << num_threads;
+    }
+    return 1;
+  }
+  return num_threads > 0 ? num_threads : 1;
+}
+
 BufferedReader::~BufferedReader() {
   VLOG(1) << "~BufferedReader";
   reader_->Shutdown();
-  while (!position_.empty()) {
-    auto &front = position_.front();
-    if (front.valid()) {
-      front.wait();
-    }
-    position_.pop();
-  }
+  WaitAllAsync();
 }
 
 BufferedReader::BufferedReader(
     const std::shared_ptr<framework::ReaderBase> &reader,
-    const platform::Place &place, size_t buffer_size, bool pin_memory)
+    const platform::Place &place, size_t buffer_size, bool pin_memory,
+    size_t num_threads)
     : framework::DecoratedReader(reader),
-      thread_pool_(1),
+      thread_pool_(NumCopyThreads(place, num_threads)),
       place_(place),
       buffer_size_(buffer_size),
       pin_memory_(pin_memory) {
@@ -80,10 +101,39 @@ void BufferedReader::ReadTillBufferFullAsync() {
   }
 }
 
+void BufferedReader::WaitAllAsync() {
+  while (!position_.empty()) {
+    auto &front = position_.front();
+    if (front.valid()) {
+      front.wait();
+    }
+    position_.pop();
+  }
+}
+
+void BufferedReader::ReadInOrder(size_t seq, TensorVec *cpu) {
+  std::unique_lock<std::mutex> lock(read_mutex_);
+  read_cv_.wait(lock, [this, seq] { return read_seq_ == seq; });
+  try {
+    reader_->ReadNext(cpu);
+  } catch (...) {
+    ++read_seq_;
+    lock.unlock();
+    read_cv_.notify_all();
+    throw;
+  }
+  ++read_seq_;
+  lock.unlock();
+  read_cv_.notify_all();
+}
+
 void BufferedReader::ReadAsync(size_t i) {
-  position_.emplace(thread_pool_.enqueue([this, i]() -> size_t {
+  size_t seq = issue_seq_++;
+  position_.emplace(thread_pool_.enqueue([this, i, seq]() -> size_t {
     TensorVec &cpu = cpu_buffer_[i];
-    reader_->ReadNext(&cpu);
+    // The tasks are taken from the pool in order, so the task waiting here
+    // only waits for the tasks already running.
+    ReadInOrder(seq, &cpu);
 
     if (cpu.empty()) {
       return -1UL;
@@ -147,6 +197,7 @@ void BufferedReader::ReadAsync(size_t i) {
         // TensorCopySync would block other stream, because TensorCopySync
         // issues the copying command to the default stream, it will make two
         // commands from different streams cannot run concurrently.
+        ReleaseHeldBuffers(&cuda);
         std::vector<void *> gpu_ptrs;
         gpu_ptrs.reserve(cpu.size());
         for (size_t i = 0; i < cpu.size(); ++i) {
@@ -230,6 +281,7 @@ void BufferedReader::ReadAsync(size_t i) {
                 npu.size(), cpu.size()));
       }
 
+      ReleaseHeldBuffers(&npu);
       std::vector<void *> npu_ptrs;
       npu_ptrs.reserve(cpu.size());
       for (size_t i = 0; i < cpu.size(); ++i) {
@@ -274,9 +326,8 @@ void BufferedReader::ReadAsync(size_t i) {
 void BufferedReader::ShutdownImpl() {
   VLOG(1) << "ShutdownImpl";
   reader_->Shutdown();
-  while (!position_.empty()) {
-    position_.pop();
-  }
+  // the running tasks still write the buffers, which the next Start reuses
+  WaitAllAsync();
   prev_pos_ = -1UL;
 }
 
@@ -290,18 +341,32 @@ void BufferedReader::ReadNextImpl(std::vector<framework::LoDTensor> *out) {
     out->clear();
     return;
   }
-  size_t i = position_.front().get();
+  auto &front = position_.front();
+  if (front.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+    auto start = std::chrono::steady_clock::now();
+    front.wait();
+    stall_time_us_ += std::chrono::duration_cast<std::chrono::microseconds>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    ++stall_num_;
+  }
+  size_t i = front.get();
   position_.pop();
 
   if (i == -1UL) {
     ReadNextImpl(out);
     return;
   }
+  ++batch_num_;
 
-  if (platform::is_gpu_place(place_)) {
+  // The pinned buffers are moved out, a pinned slot cannot know when the copy
+  // from it to the device is done.
+  if (platform::is_gpu_place(place_) && pin_memory_) {
     *out = std::move(cuda_buffer_[i]);
+  } else if (platform::is_gpu_place(place_)) {
+    *out = cuda_buffer_[i];
   } else if (platform::is_npu_place(place_)) {
-    *out = std::move(npu_buffer_[i]);
+    *out = npu_buffer_[i];
   } else {
     *out = std::move(cpu_buffer_[i]);
   }
@@ -315,6 +380,20 @@ void BufferedReader::ReadNextImpl(std::vector<framework::LoDTensor> *out) {
   prev_pos_ = i;
 }
 
+BufferedReaderStat BufferedReader::GetStat() const {
+  BufferedReaderStat stat;
+  stat.batch_num = batch_num_;
+  stat.stall_num = stall_num_;
+  stat.stall_time_us = stall_time_us_;
+  return stat;
+}
+
+void BufferedReader::ResetStat() {
+  batch_num_ = 0;
+  stall_num_ = 0;
+  stall_time_us_ = 0;
+}
+
 }  // namespace reader
 }  // namespace operators
 }  // namespace paddle
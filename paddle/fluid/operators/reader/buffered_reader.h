@@ -14,8 +14,11 @@
 
 #pragma once
 
+#include <atomic>
+#include <condition_variable>  // NOLINT
 #include <list>
 #include <memory>
+#include <mutex>  // NOLINT
 #include <queue>
 #include <vector>
 
@@ -33,22 +36,43 @@ namespace paddle {
 namespace operators {
 namespace reader {
 
+// How often the consumer of a BufferedReader had to wait for a batch, i.e.
+// how much of the input time is not hidden by the prefetching.
+struct BufferedReaderStat {
+  int64_t batch_num{0};
+  int64_t stall_num{0};
+  int64_t stall_time_us{0};
+};
+
 class BufferedReader : public framework::DecoratedReader {
   using TensorVec = std::vector<framework::LoDTensor>;
   using VecFuture = std::future<TensorVec>;
 
  public:
+  // buffer_size batches are prefetched by num_threads threads. The batches
+  // are read from the underlying reader one by one in order, only the copy
+  // to the place runs in parallel, so the order of the batches is kept.
+  // A CPU place has no copy, the batch read is handed out as it is, so it
+  // always uses one thread.
   BufferedReader(const std::shared_ptr<framework::ReaderBase>& reader,
                  const platform::Place& place, size_t buffer_size,
-                 bool pin_memory = false);
+                 bool pin_memory = false, size_t num_threads = 1);
 
   ~BufferedReader() override;
 
+  BufferedReaderStat GetStat() const;
+
+  void ResetStat();
+
  private:
   void ReadTillBufferFullAsync();
 
   void ReadAsync(size_t i);
 
+  void ReadInOrder(size_t seq, TensorVec* cpu);
+
+  void WaitAllAsync();
+
  protected:
   void ShutdownImpl() override;
   void StartImpl() override;
@@ -62,11 +86,25 @@ class BufferedReader : public framework::DecoratedReader {
 
   std::queue<std::future<size_t>> position_;
 
+  // The sequence number of the next ReadAsync, and of the next read of the
+  // underlying reader.
+  size_t issue_seq_{0};
+  size_t read_seq_{0};
+  std::mutex read_mutex_;
+  std::condition_variable read_cv_;
+
+  std::atomic<int64_t> batch_num_{0};
+  std::atomic<int64_t> stall_num_{0};
+  std::atomic<int64_t> stall_time_us_{0};
+
   // The buffer for reading data.
   // NOTE: the simplest way to implement buffered reader is do not use any
   // buffer, just read async and create futures as buffer size. However, to
   // malloc tensors every time is extremely slow. Here we store all data in
   // buffers and prevent alloc every time.
+  // The device buffers are a ring: a batch is handed out sharing the memory
+  // of its slot, and the slot reuses that memory for a later batch once the
+  // consumer has released it.
   std::vector<TensorVec> cpu_buffer_;
   std::vector<TensorVec> cuda_buffer_;
   std::vector<TensorVec> npu_buffer_;
@@ -0,0 +1,183 @@
+// Copyright (c) 2021 PaddlePaddle Authors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <chrono>  // NOLINT
+#include <mutex>   // NOLINT
+#include <thread>  // NOLINT
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "paddle/fluid/operators/reader/buffered_reader.h"
+
+namespace paddle {
+namespace operators {
+namespace reader {
+
+// Yields batches holding 0, 1, ..., batch_num - 1, and an empty one at the
+// end. Every read sleeps a while, longer for the odd batches.
+class CountingReader : public framework::ReaderBase {
+ public:
+  explicit CountingReader(int64_t batch_num)
+      : framework::ReaderBase({framework::make_ddim({1})},
+                              {framework::proto::VarType::INT64}, {false}),
+        batch_num_(batch_num) {}
+
+ protected:
+  void ReadNextImpl(std::vector<framework::LoDTensor>* out) override {
+    if (next_ == batch_num_) {
+      out->clear();
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(next_ % 2 * 500));
+    out->resize(1);
+    auto* data = (*out)[0].mutable_data<int64_t>(framework::make_ddim({1}),
+                                                 platform::CPUPlace());
+    data[0] = next_++;
+  }
+
+  void StartImpl() override { next_ = 0; }
+
+ private:
+  int64_t batch_num_;
+  int64_t next_{0};
+};
+
+static void CheckInOrder(framework::ReaderBase* reader, int64_t batch_num) {
+  std::vector<framework::LoDTensor> out;
+  for (int64_t i = 0; i < batch_num; ++i) {
+    reader->ReadNext(&out);
+    ASSERT_EQ(out.size(), 1UL);
+    EXPECT_EQ(out[0].data<int64_t>()[0], i);
+  }
+  reader->ReadNext(&out);
+  EXPECT_TRUE(out.empty());
+}
+
+TEST(BufferedReader, MultiThreadKeepOrder) {
+  const int64_t batch_num = 100;
+  auto underlying = std::make_shared<CountingReader>(batch_num);
+  auto reader = framework::MakeDecoratedReader<BufferedReader>(
+      underlying, platform::CPUPlace(), 8, false, 4);
+  auto* buffered = static_cast<BufferedReader*>(reader.get());
+
+  CheckInOrder(reader.get(), batch_num);
+  auto stat = buffered->GetStat();
+  EXPECT_EQ(stat.batch_num, batch_num);
+  EXPECT_LE(stat.stall_num, batch_num);
+
+  // restart while the next batches are still being read
+  buffered->ResetStat();
+  reader->Shutdown();
+  reader->Start();
+  CheckInOrder(reader.get(), batch_num);
+  EXPECT_EQ(buffered->GetStat().batch_num, batch_num);
+}
+
+// Yields batch_num batches of numel floats, every read takes read_us and
+// records when it began.
+class SlowReader : public framework::ReaderBase {
+ public:
+  SlowReader(int64_t batch_num, int64_t numel, int64_t read_us)
+      : framework::ReaderBase({framework::make_ddim({numel})},
+                              {framework::proto::VarType::FP32}, {false}),
+        batch_num_(batch_num),
+        numel_(numel),
+        read_us_(read_us) {}
+
+  std::vector<std::chrono::steady_clock::time_point> ReadBegins() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return read_begins_;
+  }
+
+ protected:
+  void ReadNextImpl(std::vector<framework::LoDTensor>* out) override {
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      if (static_cast<int64_t>(read_begins_.size()) == batch_num_) {
+        out->clear();
+        return;
+      }
+      read_begins_.push_back(std::chrono::steady_clock::now());
+    }
+    std::this_thread::sleep_for(std::chrono::microseconds(read_us_));
+    out->resize(1);
+    (*out)[0].mutable_data<float>(framework::make_ddim({numel_}),
+                                  platform::CPUPlace());
+  }
+
+  void StartImpl() override {
+    std::lock_guard<std::mutex> guard(mutex_);
+    read_begins_.clear();
+  }
+
+ private:
+  int64_t batch_num_;
+  int64_t numel_;
+  int64_t read_us_;
+  std::mutex mutex_;
+  std::vector<std::chrono::steady_clock::time_point> read_begins_;
+};
+
+// The reads of the next batches run while the consumer works on a batch.
+TEST(BufferedReader, ReadsOverlapConsumer) {
+  const int64_t batch_num = 40;
+  auto underlying = std::make_shared<SlowReader>(batch_num, 16, 1000);
+  auto reader = framework::MakeDecoratedReader<BufferedReader>(
+      underlying, platform::CPUPlace(), 4, false, 4);
+  auto* buffered = static_cast<BufferedReader*>(reader.get());
+
+  std::vector<framework::LoDTensor> out;
+  for (int64_t i = 0; i < batch_num; ++i) {
+    reader->ReadNext(&out);
+    ASSERT_EQ(out.size(), 1UL);
+    std::this_thread::sleep_for(std::chrono::microseconds(4000));
+  }
+  reader->ReadNext(&out);
+  EXPECT_TRUE(out.empty());
+  // only the first batches may not be prefetched in time
+  EXPECT_LE(buffered->GetStat().stall_num, batch_num / 4);
+}
+
+#if defined(PADDLE_WITH_CUDA) || defined(PADDLE_WITH_HIP)
+static double ReadPeriodUs(size_t num_threads) {
+  const int64_t batch_num = 20;
+  auto underlying = std::make_shared<SlowReader>(batch_num, 16 << 20, 5000);
+  auto reader = framework::MakeDecoratedReader<BufferedReader>(
+      underlying, platform::CUDAPlace(0), 4, false, num_threads);
+  std::vector<framework::LoDTensor> out;
+  for (int64_t i = 0; i < batch_num; ++i) {
+    reader->ReadNext(&out);
+  }
+  auto begins = underlying->ReadBegins();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             begins.back() - begins.front())
+             .count() /
+         static_cast<double>(begins.size() - 1);
+}
+
+// With more threads the next read begins while the last batch is copied to
+// the device, instead of after the copy.
+TEST(BufferedReader, ReadsOverlapCopies) {
+  if (platform::GetCUDADeviceCount() == 0) return;
+  auto serial_us = ReadPeriodUs(1);
+  auto overlapped_us = ReadPeriodUs(4);
+  VLOG(1) << "read period with 1 thread " << serial_us << "us, with 4 threads "
+          << overlapped_us << "us";
+  EXPECT_LT(overlapped_us, serial_us);
+}
+#endif
+
+}  // namespace reader
+}  // namespace operators
+}  // namespace paddle
@@ -541,6 +541,20 @@ DEFINE_bool(sort_sum_gradient, false,
             "Sum gradients by the reverse order of "
             "the forward execution sequence.");
 
+/**
+ * Performance related FLAG
+ * Name: dygraph_fuse_grad_buffer
+ * Since Version: 2.1.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: If True, the dense CPU gradients of leaf tensors with the same data
+ * type are assigned to slices of one flat buffer after backward, and the
+ * gradients of later batches are accumulated into the slices in place.
+ */
+DEFINE_bool(dygraph_fuse_grad_buffer, false,
+            "Assign the dense CPU gradients of leaf tensors to a flat buffer "
+            "and accumulate the gradients of later batches in place.");
+
 /**
  * Performance related FLAG
  * Name: max_inplace_grad_add
@@ -556,6 +570,33 @@ DEFINE_int32(
     "less FLAGS_max_inplace_grad_add, than it will be use several grad_add"
     "instead of sum. Default is 0.");
 
+/**
+ * Performance related FLAG
+ * Name: dygraph_prepared_op_cache
+ * Since Version: 2.1.0
+ * Value Range: bool, default=false
+ * Example:
+ * Note: If True, the kernel chosen for a dygraph op and whether its inputs
+ * need data transform are cached by op type, attributes and the data type,
+ * place and layout of the inputs, so repeated calls skip the kernel selection.
+ */
+DEFINE_bool(dygraph_prepared_op_cache, false,
+            "Cache the kernel selection of dygraph ops by op type, attributes "
+            "and the data type, place and layout of the inputs.");
+
+/**
+ * Performance related FLAG
+ * Name: dygraph_prepared_op_cache_capacity
+ * Since Version: 2.1.0
+ * Value Range: int32, default=10000
+ * Example:
+ * Note: The max number of entries of the thread local dygraph prepared op
+ * cache, the cache is cleared when it is full.
+ */
+DEFINE_int32(dygraph_prepared_op_cache_capacity, 10000,
+             "The max number of entries of the thread local dygraph prepared "
+             "op cache, the cache is cleared when it is full.");
+
 /**
  * Debug related FLAG
  * Name: tracer_mkldnn_ops_on
@@ -255,6 +255,8 @@ void BindDataset(py::module *m) {
            py::call_guard<py::gil_scoped_release>())
       .def("get_memory_data_size", &framework::Dataset::GetMemoryDataSize,
            py::call_guard<py::gil_scoped_release>())
+      .def("get_memory_data_bytes", &framework::Dataset::GetMemoryDataBytes,
+           py::call_guard<py::gil_scoped_release>())
       .def("get_pv_data_size", &framework::Dataset::GetPvDataSize,
            py::call_guard<py::gil_scoped_release>())
       .def("get_shuffle_data_size", &framework::Dataset::GetShuffleDataSize,
@@ -265,6 +267,8 @@ void BindDataset(py::module *m) {
            py::call_guard<py::gil_scoped_release>())
       .def("set_parse_content", &framework::Dataset::SetParseContent,
            py::call_guard<py::gil_scoped_release>())
+      .def("set_compress_memory", &framework::Dataset::SetCompressMemory,
+           py::call_guard<py::gil_scoped_release>())
       .def("set_parse_logkey", &framework::Dataset::SetParseLogKey,
            py::call_guard<py::gil_scoped_release>())
       .def("set_merge_by_sid", &framework::Dataset::SetMergeBySid,
@@ -28,6 +28,7 @@ limitations under the License. */
 #include <string>
 #include <vector>
 
+#include "paddle/fluid/distributed/common/sparse_checkpoint_compact.h"
 #include "paddle/fluid/distributed/common/sparse_sharding_merge.h"
 #include "paddle/fluid/distributed/communicator_common.h"
 #include "paddle/fluid/distributed/fleet.h"
@@ -38,6 +39,7 @@ limitations under the License. */
 #include "paddle/fluid/distributed/service/graph_brpc_client.h"
 #include "paddle/fluid/distributed/service/graph_py_service.h"
 #include "paddle/fluid/distributed/service/heter_client.h"
+#include "pybind11/numpy.h"
 
 namespace py = pybind11;
 using paddle::distributed::CommContext;
@@ -50,6 +52,7 @@ using paddle::distributed::GraphPyServer;
 using paddle::distributed::GraphPyClient;
 using paddle::distributed::FeatureNode;
 using paddle::distributed::ShardingMerge;
+using paddle::distributed::CheckpointCompactor;
 
 namespace paddle {
 namespace pybind {
@@ -93,6 +96,10 @@ void BindSparseShardingTools(py::module* m) {
   py::class_<ShardingMerge>(*m, "ShardingMerge")
       .def(py::init<>())
       .def("merge", &ShardingMerge::Merge);
+  py::class_<CheckpointCompactor>(*m, "CheckpointCompactor")
+      .def(py::init<>())
+      .def("compact", &CheckpointCompactor::Compact,
+           py::call_guard<py::gil_scoped_release>());
 }
 
 void BindCommunicatorContext(py::module* m) {
@@ -221,6 +228,45 @@ void BindGraphPyClient(py::module* m) {
              }
              return bytes_feats;
            })
+      .def("get_node_feat_dense",
+           [](GraphPyClient& self, std::string node_type,
+              std::vector<uint64_t> node_ids, std::string feature_name,
+              int shape, std::string dtype) -> py::object {
+             std::vector<size_t> dims = {node_ids.size(),
+                                         static_cast<size_t>(shape)};
+             if (dtype == "int64") {
+               py::array_t<int64_t> res(dims);
+               self.get_node_feat_dense(node_type, node_ids, feature_name,
+                                        shape, res.mutable_data());
+               return std::move(res);
+             }
+             py::array_t<float> res(dims);
+             self.get_node_feat_dense(node_type, node_ids, feature_name, shape,
+                                      res.mutable_data());
+             return std::move(res);
+           },
+           py::arg("node_type"), py::arg("node_ids"), py::arg("feature_name"),
+           py::arg("shape"), py::arg("dtype") = "float32")
+      .def("sample_subgraph",
+           [](GraphPyClient& self, std::string name,
+              std::vector<uint64_t> seeds, std::vector<int> fanouts,
+              std::string node_type, std::vector<std::string> feature_names) {
+             auto subgraph = self.sample_subgraph(name, seeds, fanouts,
+                                                  node_type, feature_names);
+             std::vector<std::vector<py::bytes>> bytes_feats(
+                 subgraph.features.size());
+             for (size_t i = 0; i < subgraph.features.size(); ++i) {
+               for (auto& feat : subgraph.features[i]) {
+                 bytes_feats[i].push_back(py::bytes(feat));
+               }
+             }
+             return py::make_tuple(subgraph.ids, subgraph.offsets,
+                                   subgraph.neighbors, subgraph.weights,
+                                   bytes_feats);
+           },
+           py::arg("name"), py::arg("seeds"), py::arg("fanouts"),
+           py::arg("node_type") = "",
+           py::arg("feature_names") = std::vector<std::string>())
       .def("bind_local_server", &GraphPyClient::bind_local_server);
 }
 
@@ -263,6 +309,9 @@ void BindTreeIndex(py::module* m) {
            [](TreeIndex& self, uint64_t ancestor, int level) {
              return self.GetChildrenCodes(ancestor, level);
            })
+      .def("get_batch_children_codes",
+           [](TreeIndex& self, const std::vector<uint64_t>& ancestors,
+              int level) { return self.GetChildrenCodes(ancestors, level); })
       .def("get_travel_codes",
            [](TreeIndex& self, uint64_t id, int start_level) {
              return self.GetTravelCodes(id, start_level);
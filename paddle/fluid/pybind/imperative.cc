@@ -34,6 +34,7 @@ limitations under the License. */
 #include "paddle/fluid/imperative/basic_engine.h"
 #include "paddle/fluid/imperative/bkcl_context.h"
 #include "paddle/fluid/imperative/data_loader.h"
+#include "paddle/fluid/imperative/gloo_context.h"
 #include "paddle/fluid/imperative/hooks.h"
 #include "paddle/fluid/imperative/layer.h"
 #include "paddle/fluid/imperative/nccl_context.h"
@@ -651,6 +652,36 @@ void BindImperative(py::module *m_ptr) {
         },
         py::return_value_policy::take_ownership);
 
+  // Like _array_to_share_memory_tensor, but the shared memory comes from the
+  // MemoryMapAllocationPool of the process, for the batches of DataLoader
+  // workers which are read by the trainer only once.
+  m.def("_array_to_pooled_share_memory_tensor",
+        [](py::object &obj) {
+          auto array = obj.cast<py::array>();
+          PADDLE_ENFORCE_NE(
+              string::Sprintf("%s", array.dtype()).compare("object"), 0,
+              platform::errors::InvalidArgument(
+                  "Faild to convert input data to a regular ndarray.\n  * "
+                  "Usually this means the input data contains nested "
+                  "lists with different lengths.\n  * Check the reader "
+                  "function passed to 'set_(sample/sample_list/batch)"
+                  "_generator' to locate the data causes this issue."));
+          // The tensor only wraps the memory of the array to get its type
+          // and dims, the data is copied once, straight into the pool.
+          framework::LoDTensor t;
+          SetTensorFromPyArray<platform::CPUPlace>(&t, array,
+                                                   platform::CPUPlace(), true);
+          size_t data_size = t.numel() * framework::SizeOfType(t.type());
+          auto shared_writer_holder =
+              memory::allocation::MemoryMapAllocationPool::Instance().Allocate(
+                  data_size);
+          memory::Copy(platform::CPUPlace(), shared_writer_holder->ptr(),
+                       platform::CPUPlace(), t.data<void>(), data_size);
+          t.ResetHolder(shared_writer_holder);
+          return t;
+        },
+        py::return_value_policy::take_ownership);
+
   m.def("_remove_tensor_list_mmap_fds", [](py::list &tensor_list) {
     for (size_t i = 0; i < tensor_list.size(); ++i) {
       auto t = tensor_list[i].cast<framework::LoDTensor>();
@@ -667,8 +698,10 @@ void BindImperative(py::module *m_ptr) {
     }
   });
 
-  m.def("_cleanup_mmap_fds",
-        []() { memory::allocation::MemoryMapFdSet::Instance().Clear(); });
+  m.def("_cleanup_mmap_fds", []() {
+    memory::allocation::MemoryMapFdSet::Instance().Clear();
+    memory::allocation::MemoryMapAllocationPool::Instance().Clear();
+  });
 #endif
 
   m.def("start_imperative_gperf_profiler",
@@ -1422,6 +1455,33 @@ void BindImperative(py::module *m_ptr) {
 #endif
            },
            py::return_value_policy::reference)
+      .def("_share_pooled_memory",
+           [](const std::shared_ptr<imperative::VarBase> &self) {
+#ifndef _WIN32
+             PADDLE_ENFORCE_EQ(
+                 platform::is_cpu_place(self->Place()), true,
+                 platform::errors::InvalidArgument(
+                     "Sharing memory only support CPU Tensor currently"));
+             // The pooled memory is reused once the reader releases it, so
+             // the data is copied to a new tensor, self keeps its own memory.
+             auto &src = self->Var().Get<framework::LoDTensor>();
+             size_t data_size =
+                 src.numel() * framework::SizeOfType(src.type());
+             auto shared_writer_holder =
+                 memory::allocation::MemoryMapAllocationPool::Instance()
+                     .Allocate(data_size);
+             memory::Copy(platform::CPUPlace(), shared_writer_holder->ptr(),
+                          platform::CPUPlace(), src.data<void>(), data_size);
+             framework::LoDTensor t;
+             t.ResetHolderWithType(shared_writer_holder, src.type());
+             t.Resize(src.dims());
+             t.set_lod(src.lod());
+             return t;
+#else
+             PADDLE_THROW(platform::errors::PermissionDenied(
+                 "Sharing memory in Windows OS is not supported currently"));
+#endif
+           })
       .def("copy_", &imperative::VarBase::CopyFrom)
       .def("_copy_to",
            [](const std::shared_ptr<imperative::VarBase> &self,
@@ -1630,6 +1690,16 @@ void BindImperative(py::module *m_ptr) {
            py::return_value_policy::reference)
       .def("_generate_unique_name", &imperative::Tracer::GenerateUniqueName,
            py::arg("key") = "dygraph_tmp")
+      .def("_begin_recompute", &imperative::Tracer::BeginRecompute,
+           py::arg("preserve_rng_state") = true)
+      .def("_end_recompute",
+           [](imperative::Tracer &self,
+              const std::vector<std::shared_ptr<imperative::VarBase>>
+                  &outputs) {
+             // Return the bytes released by the segment
+             return self.EndRecompute(outputs)->ReleasedMemorySize();
+           })
+      .def("_is_recomputing", &imperative::Tracer::IsRecomputing)
       .def("_set_amp_op_list",
            [](imperative::Tracer &self,
               std::unordered_set<std::string> &allow_ops,
@@ -1784,7 +1854,7 @@ void BindImperative(py::module *m_ptr) {
       py::call_guard<py::gil_scoped_release>());
 
 #if defined(PADDLE_WITH_NCCL) || defined(PADDLE_WITH_RCCL) || \
-    defined(PADDLE_WITH_XPU_BKCL)
+    defined(PADDLE_WITH_XPU_BKCL) || defined(PADDLE_WITH_GLOO)
   py::class_<imperative::ParallelContext,
              std::shared_ptr<imperative::ParallelContext>>(m,
                                                            "ParallelContext");
@@ -1818,6 +1888,18 @@ void BindImperative(py::module *m_ptr) {
            py::arg("ring_id"));
 #endif
 
+#if defined(PADDLE_WITH_GLOO)
+  py::class_<imperative::GlooParallelContext, imperative::ParallelContext,
+             std::shared_ptr<imperative::GlooParallelContext>>(
+      m, "GLOOParallelContext")
+      .def(py::init<const imperative::ParallelStrategy &,
+                    const platform::CPUPlace &>())
+      .def("init", [](imperative::GlooParallelContext &self) { self.Init(); })
+      .def("init_with_ring_id",
+           &imperative::GlooParallelContext::InitWithRingID,
+           py::arg("ring_id"));
+#endif
+
 #if defined(PADDLE_WITH_XPU_BKCL)
   py::class_<imperative::BKCLParallelContext, imperative::ParallelContext,
              std::shared_ptr<imperative::BKCLParallelContext>>(
@@ -1088,10 +1088,11 @@ PYBIND11_MODULE(core_noavx, m) {
 
             return py::make_tuple(mmap_writer_allocation->ipc_name(),
                                   mmap_writer_allocation->size(),
-                                  type_idx, vectorize(t.dims()), t.lod());
+                                  type_idx, vectorize(t.dims()), t.lod(),
+                                  mmap_writer_allocation->pooled());
           },
           [](py::tuple t) {  // __setstate__
-            if (t.size() != 5)
+            if (t.size() != 5 && t.size() != 6)
               throw std::runtime_error("Invalid LoDTensor state!");
 
             // 1. Create a new C++ instance
@@ -1100,13 +1101,23 @@ PYBIND11_MODULE(core_noavx, m) {
             // 2. Rebuild Allocation
             const std::string &ipc_name = t[0].cast<std::string>();
             size_t size = t[1].cast<size_t>();
-            auto shared_reader_holder =
-              memory::allocation::RebuildMemoryMapReaderAllocation(
-                ipc_name, size);
+            bool pooled = t.size() == 6 && t[5].cast<bool>();
+            std::shared_ptr<memory::Allocation> shared_reader_holder;
+            if (pooled) {
+              // 3. The file stays in the pool of the writer, it is kept in
+              // the global fd set while this process maps it
+              shared_reader_holder =
+                memory::allocation::RebuildPooledMemoryMapReaderAllocation(
+                  ipc_name, size);
+            } else {
+              shared_reader_holder =
+                memory::allocation::RebuildMemoryMapReaderAllocation(
+                  ipc_name, size);
 
-            // 3. Maintain global fd set
-            VLOG(3) << "LoDTensor ipc name: " << ipc_name;
-            memory::allocation::MemoryMapFdSet::Instance().Insert(ipc_name);
+              // 3. Maintain global fd set
+              VLOG(3) << "LoDTensor ipc name: " << ipc_name;
+              memory::allocation::MemoryMapFdSet::Instance().Insert(ipc_name);
+            }
 
             // 4. Rebuild LoDTensor
             tensor.ResetHolderWithType(shared_reader_holder,
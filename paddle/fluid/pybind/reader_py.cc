@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include "paddle/fluid/pybind/reader_py.h"
+#include <algorithm>
 #include <exception>
 #include <memory>
 #include <string>
@@ -35,6 +36,14 @@
 DEFINE_bool(reader_queue_speed_test_mode, false,
             "If set true, the queue.pop will only get data from queue but not "
             "remove the data from queue for speed testing");
+DEFINE_int32(reader_buffer_size, 2,
+             "The number of batches prefetched for each place by the double "
+             "buffer of the DataLoader.");
+DEFINE_int32(reader_num_threads, 1,
+             "The number of threads of the double buffer of the DataLoader "
+             "for each device place, which copy the prefetched batches to the "
+             "place in parallel. The order of the batches is kept. A CPU "
+             "place always uses one thread, it has nothing to copy.");
 
 namespace paddle {
 namespace pybind {
@@ -156,9 +165,14 @@ class MultiDeviceFeedReader {
       auto reader = create_or_get_reader(i);
       if (use_double_buffer) {
         VLOG(10) << "Creating " << i << "-th BufferedReader";
-        holder->Reset(
+        auto buffered_reader =
             framework::MakeDecoratedReader<operators::reader::BufferedReader>(
-                reader, p, 2, pin_memory_));
+                reader, p, std::max(FLAGS_reader_buffer_size, 1), pin_memory_,
+                std::max(FLAGS_reader_num_threads, 1));
+        buffered_readers_.emplace_back(
+            std::static_pointer_cast<operators::reader::BufferedReader>(
+                buffered_reader));
+        holder->Reset(buffered_reader);
       } else {
         if (platform::is_gpu_place(p)) {
           PADDLE_THROW(platform::errors::PermissionDenied(
@@ -227,6 +241,24 @@ class MultiDeviceFeedReader {
     for (auto &r : readers_) r->Shutdown();
   }
 
+  // The prefetching statistics summed over all places, the stall time is
+  // the time the reader waited for a batch not prefetched yet.
+  std::unordered_map<std::string, int64_t> Stat() const {
+    std::unordered_map<std::string, int64_t> result{
+        {"batch_num", 0}, {"stall_num", 0}, {"stall_time_us", 0}};
+    for (auto &r : buffered_readers_) {
+      auto stat = r->GetStat();
+      result["batch_num"] += stat.batch_num;
+      result["stall_num"] += stat.stall_num;
+      result["stall_time_us"] += stat.stall_time_us;
+    }
+    return result;
+  }
+
+  void ResetStat() {
+    for (auto &r : buffered_readers_) r->ResetStat();
+  }
+
   ~MultiDeviceFeedReader() {
     queue_->Close();
     pool_.reset();
@@ -317,6 +349,8 @@ class MultiDeviceFeedReader {
   std::unique_ptr<::ThreadPool> pool_;
 
   std::vector<std::unique_ptr<framework::ReaderHolder>> readers_;
+  std::vector<std::shared_ptr<operators::reader::BufferedReader>>
+      buffered_readers_;
 
   std::vector<std::future<Status>> futures_;
   std::vector<std::exception_ptr> exceptions_;
@@ -364,7 +398,9 @@ void BindMultiDeviceReader(py::module *module, const char *reader_name) {
       .def("reset", &ReaderType::Reset,
            py::call_guard<py::gil_scoped_release>())
       .def("shutdown", &ReaderType::Shutdown,
-           py::call_guard<py::gil_scoped_release>());
+           py::call_guard<py::gil_scoped_release>())
+      .def("stat", &ReaderType::Stat)
+      .def("reset_stat", &ReaderType::ResetStat);
 }
 
 void BindReader(py::module *module) {
@@ -334,6 +334,8 @@ class DistributedStrategy(object):
 
             runtime_split_send_recv(bool): if we are using Tensor split for send and recv during runtime
 
+            gradient_compress_type(str): how the workers compress the gradients they push, one of "none", "fp16" and "int8"
+
         Examples:
 
           .. code-block:: python
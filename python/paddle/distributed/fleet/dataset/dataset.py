@@ -281,6 +281,7 @@ class InMemoryDataset(DatasetBase):
         self.parse_ins_id = False
         self.parse_content = False
         self.parse_logkey = False
+        self.compress_memory = False
         self.merge_by_sid = True
         self.enable_pv_merge = False
         self.merge_by_lineid = False
@@ -299,6 +300,7 @@ class InMemoryDataset(DatasetBase):
                              you should parse line id in data generator. default is -1.
             parse_ins_id(bool): Set if Dataset need to parse ins_id. default is False.
             parse_content(bool): Set if Dataset need to parse content. default is False.
+            compress_memory(bool): Set if Dataset keeps the data compressed in memory. default is False.
             fleet_send_batch_size(int): Set fleet send batch size in one rpc, default is 1024
             fleet_send_sleep_seconds(int): Set fleet send sleep time, default is 0
             fea_eval(bool): Set if Dataset need to do feature importance evaluation using slots shuffle.
@@ -334,6 +336,9 @@ class InMemoryDataset(DatasetBase):
         parse_content = kwargs.get("parse_content", False)
         self._set_parse_content(parse_content)
 
+        compress_memory = kwargs.get("compress_memory", False)
+        self._set_compress_memory(compress_memory)
+
         fleet_send_batch_size = kwargs.get("fleet_send_batch_size", None)
         if fleet_send_batch_size:
             self._set_fleet_send_batch_size(fleet_send_batch_size)
@@ -420,6 +425,8 @@ class InMemoryDataset(DatasetBase):
                 self._set_parse_ins_id(kwargs[key])
             elif key == "parse_content":
                 self._set_parse_content(kwargs[key])
+            elif key == "compress_memory":
+                self._set_compress_memory(kwargs[key])
             elif key == "fleet_send_batch_size":
                 self._set_fleet_send_batch_size(kwargs[key])
             elif key == "fleet_send_sleep_seconds":
@@ -539,6 +546,7 @@ class InMemoryDataset(DatasetBase):
         self.dataset.set_parse_ins_id(self.parse_ins_id)
         self.dataset.set_parse_content(self.parse_content)
         self.dataset.set_parse_logkey(self.parse_logkey)
+        self.dataset.set_compress_memory(self.compress_memory)
         self.dataset.set_merge_by_sid(self.merge_by_sid)
         self.dataset.set_enable_pv_merge(self.enable_pv_merge)
         self.dataset.set_data_feed_desc(self._desc())
@@ -616,6 +624,27 @@ class InMemoryDataset(DatasetBase):
         """
         self.parse_content = parse_content
 
+    def _set_compress_memory(self, compress_memory):
+        """
+        Set if Dataset keeps the data compressed in memory. The feasigns
+        and the content of every instance are compressed when it is loaded,
+        and decompressed by batch when it is fed, which saves memory at
+        the cost of some reading throughput.
+
+        Args:
+            compress_memory(bool): if compress the data in memory or not
+
+        Examples:
+            .. code-block:: python
+
+              import paddle
+              paddle.enable_static()
+              dataset = paddle.distributed.InMemoryDataset()
+              dataset._set_compress_memory(True)
+
+        """
+        self.compress_memory = compress_memory
+
     def _set_fleet_send_batch_size(self, fleet_send_batch_size=1024):
         """
         Set fleet send batch size, default is 1024
@@ -977,6 +1006,32 @@ class InMemoryDataset(DatasetBase):
             return global_data_size[0]
         return local_data_size[0]
 
+    def get_memory_data_bytes(self):
+        """
+        :api_attr: Static Graph
+
+        Get the bytes of memory taken by the data of this worker after load
+        into memory, and the bytes it would take without compression.
+
+        Returns:
+            A tuple of the bytes in memory and the uncompressed bytes.
+
+        Examples:
+            .. code-block:: python
+
+                import paddle
+                paddle.enable_static()
+
+                dataset = paddle.distributed.InMemoryDataset()
+                dataset._set_compress_memory(True)
+                filelist = ["a.txt", "b.txt"]
+                dataset.set_filelist(filelist)
+                dataset.load_into_memory()
+                memory_bytes, raw_bytes = dataset.get_memory_data_bytes()
+
+        """
+        return self.dataset.get_memory_data_bytes()
+
     def get_shuffle_data_size(self, fleet=None):
         """
         :api_attr: Static Graph
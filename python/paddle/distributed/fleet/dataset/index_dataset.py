@@ -63,6 +63,9 @@ class TreeIndex(Index):
     def get_children_codes(self, ancestor, level):
         return self._tree.get_children_codes(ancestor, level)
 
+    def get_batch_children_codes(self, ancestors, level):
+        return self._tree.get_batch_children_codes(ancestors, level)
+
     def get_travel_path(self, child, ancestor):
         res = []
         while (child > ancestor):
@@ -59,6 +59,7 @@ class Accessor:
         self.feature_dim = -1
         self.embedding_dim = -1
         self.optimizer = None
+        self.gradient_compress_type = "none"
 
     def to_string(self, indent):
         accessor_str = "{}accessor {{{}\n{}}}"
@@ -66,6 +67,8 @@ class Accessor:
         attrs += "accessor_class: \"{}\" ".format(self.accessor_class)
         attrs += "fea_dim: {} ".format(self.feature_dim)
         attrs += "embedx_dim: {} ".format(self.embedding_dim)
+        attrs += "gradient_compress_type: \"{}\" ".format(
+            self.gradient_compress_type)
         attrs += "\n"
         if self.optimizer is not None:
             attrs += self.optimizer.to_string(indent)
@@ -638,6 +641,13 @@ class TheOnePSRuntime(RuntimeBase):
                 accessor.feature_dim = ctx.sections()[0]
                 accessor.embedding_dim = 1
 
+            gradient_compress_type = self.context[
+                "valid_strategy"].a_sync_configs["gradient_compress_type"]
+            if gradient_compress_type not in ["none", "fp16", "int8"]:
+                raise ValueError("Gradient Compress Type Not Support {}".format(
+                    gradient_compress_type))
+            accessor.gradient_compress_type = gradient_compress_type
+
             return accessor
 
         def _build_barrier_table(idx):
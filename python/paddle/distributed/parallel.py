@@ -121,12 +121,17 @@ def init_parallel_env():
         )
         return
 
-    # 1. gpu xpu check, must be gpu or xpu
-    if not core.is_compiled_with_cuda() and not core.is_compiled_with_xpu():
+    # 1. gpu xpu check, must be gpu or xpu, or cpu with gloo
+    init_gloo = int(os.getenv("PADDLE_WITH_GLOO", "0"))
+    is_cpu_only = not core.is_compiled_with_cuda(
+    ) and not core.is_compiled_with_xpu()
+    if is_cpu_only and not (init_gloo and
+                            hasattr(core, "GLOOParallelContext")):
         raise NotImplementedError(
-            "Cannot initialize parallel environment in CPU-only version, now only "
-            "supports initializing the GPU and XPU parallel environment. Please recompile "
-            "or reinstall paddle with GPU or XPU support.")
+            "Cannot initialize parallel environment in CPU-only version without "
+            "gloo, now only supports initializing the GPU and XPU parallel "
+            "environment, or the CPU parallel environment with PADDLE_WITH_GLOO=1. "
+            "Please recompile or reinstall paddle with GPU, XPU or GLOO support.")
 
     # 2. check env
     def _check_var_exists(var_name):
@@ -147,7 +152,6 @@ def init_parallel_env():
     _check_var_exists("PADDLE_TRAINER_ENDPOINTS")
 
     # 3: init gloo context (step 1: httpsever start)
-    init_gloo = int(os.getenv("PADDLE_WITH_GLOO", "0"))
     if init_gloo:
         ep_rank_0 = parallel_env.trainer_endpoints[0].split(":")
         manager = Manager()
@@ -184,6 +188,8 @@ def init_parallel_env():
         place = core.CUDAPlace(parallel_env.device_id)
     elif core.is_compiled_with_xpu():
         place = core.XPUPlace(parallel_env.device_id)
+    else:
+        place = core.CPUPlace()
     _set_expected_place(place)
 
     # init nccl or bkcl context
@@ -193,7 +199,8 @@ def init_parallel_env():
     elif core.is_compiled_with_xpu():
         parallel_helper._set_parallel_ctx(
             core.BKCLParallelContext(strategy, place))
-    parallel_helper._init_parallel_ctx()
+    if not is_cpu_only:
+        parallel_helper._init_parallel_ctx()
 
     # 5: init gloo context (step 2: gloo init)
     # dividing init_gloo into two part beacause nccl and gloo
@@ -217,6 +224,13 @@ def init_parallel_env():
             http_server_d["running"] = False
             http_server.join()
 
+    # 6: init the gloo parallel context of the reducer for cpu, which
+    # all-reduces over the gloo context initialized above
+    if is_cpu_only:
+        parallel_helper._set_parallel_ctx(
+            core.GLOOParallelContext(strategy, place))
+        parallel_helper._init_parallel_ctx()
+
 
 def get_rank():
     """
@@ -191,6 +191,8 @@ def __bootstrap__():
         'memory_fraction_of_eager_deletion',
         'allocator_strategy',
         'reader_queue_speed_test_mode',
+        'reader_buffer_size',
+        'reader_num_threads',
         'print_sub_graph_dir',
         'pe_profile_fname',
         'inner_op_parallelism',
@@ -281,6 +281,7 @@ if avx_supported():
             from .core_avx import _throw_error_if_process_failed
             from .core_avx import _convert_to_tensor_list
             from .core_avx import _array_to_share_memory_tensor
+            from .core_avx import _array_to_pooled_share_memory_tensor
             from .core_avx import _cleanup_mmap_fds
             from .core_avx import _remove_tensor_list_mmap_fds
     except Exception as e:
@@ -330,6 +331,7 @@ if load_noavx:
             from .core_noavx import _throw_error_if_process_failed
             from .core_noavx import _convert_to_tensor_list
             from .core_noavx import _array_to_share_memory_tensor
+            from .core_noavx import _array_to_pooled_share_memory_tensor
             from .core_noavx import _cleanup_mmap_fds
             from .core_noavx import _remove_tensor_list_mmap_fds
     except Exception as e:
@@ -327,13 +327,16 @@ def _worker_loop(dataset, dataset_kind, indices_queue, out_queue, done_event,
                     out_queue.put((idx, batch, None))
                 batch, structure = _flatten_batch(batch)
                 if use_shared_memory:
+                    # NOTE: the shared memory files are kept in the pool of
+                    # this worker, and reused for later batches once the
+                    # main process released them, they are unlinked by
+                    # _cleanup_mmap when the worker exits
                     tensor_list = [
-                        core._array_to_share_memory_tensor(b)
-                        if isinstance(b, np.ndarray) else b._share_memory()
-                        for b in batch
+                        core._array_to_pooled_share_memory_tensor(b)
+                        if isinstance(b, np.ndarray) else
+                        b._share_pooled_memory() for b in batch
                     ]
                     out_queue.put((idx, tensor_list, structure))
-                    core._remove_tensor_list_mmap_fds(tensor_list)
                 else:
                     out_queue.put((idx, batch, structure))
     except KeyboardInterrupt:
@@ -267,6 +267,70 @@ class TestDataset(unittest.TestCase):
         os.remove("./test_in_memory_dataset_run_a.txt")
         os.remove("./test_in_memory_dataset_run_b.txt")
 
+    def test_in_memory_dataset_compress_memory(self):
+        """
+        Testcase for InMemoryDataset which keeps the data compressed.
+        """
+        filename = "test_in_memory_dataset_compress_memory.txt"
+        with open(filename, "w") as f:
+            for i in range(1, 21):
+                # small and large ids, up and down, and a long slot which
+                # is deflated
+                long_slot = [i * 1000 + j for j in range(60)]
+                f.write("3 %d %d %d " % (i, (1 << 40) + i, 7))
+                f.write("%d %s " % (len(long_slot), " ".join(
+                    str(x) for x in long_slot)))
+                f.write("2 %f %f\n" % (i * 0.5, -i * 0.25))
+
+        slots = ["slot1", "slot2", "slot3"]
+        slots_vars = []
+        for slot in slots[:2]:
+            var = fluid.layers.data(
+                name=slot, shape=[1], dtype="int64", lod_level=1)
+            slots_vars.append(var)
+        slots_vars.append(
+            fluid.layers.data(
+                name=slots[2], shape=[1], dtype="float32", lod_level=1))
+
+        def read(compress_memory):
+            dataset = paddle.distributed.InMemoryDataset()
+            dataset.init(
+                batch_size=4,
+                thread_num=1,
+                pipe_command="cat",
+                use_var=slots_vars)
+            dataset._set_compress_memory(compress_memory)
+            dataset.set_filelist([filename])
+            dataset.load_into_memory()
+            memory_bytes, raw_bytes = dataset.get_memory_data_bytes()
+            if compress_memory:
+                self.assertLess(memory_bytes, raw_bytes)
+            else:
+                self.assertEqual(memory_bytes, raw_bytes)
+
+            batches = []
+            data_loader = fluid.io.DataLoader.from_dataset(
+                dataset, fluid.cpu_places(), False)
+            for data in data_loader():
+                batches.append([(np.array(data[0][slot]), data[0][slot].lod())
+                                for slot in slots])
+            dataset.release_memory()
+            return batches
+
+        exe = fluid.Executor(fluid.CPUPlace())
+        exe.run(fluid.default_startup_program())
+        expected = read(False)
+        actual = read(True)
+        self.assertEqual(len(expected), 5)
+        self.assertEqual(len(actual), len(expected))
+        for expected_batch, actual_batch in zip(expected, actual):
+            for (expected_value, expected_lod), (actual_value, actual_lod) in \
+                    zip(expected_batch, actual_batch):
+                self.assertTrue(np.array_equal(expected_value, actual_value))
+                self.assertEqual(expected_lod, actual_lod)
+
+        os.remove(filename)
+
     def test_in_memory_dataset_masterpatch(self):
         """
         Testcase for InMemoryDataset from create to run.
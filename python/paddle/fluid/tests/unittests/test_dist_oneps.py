@@ -12,12 +12,14 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
+import os
 import unittest
 
 import paddle
+import paddle.distributed.fleet.base.role_maker as role_maker
 paddle.enable_static()
 
-from paddle.distributed.fleet.runtime.the_one_ps import Table
+from paddle.distributed.fleet.runtime.the_one_ps import Accessor, Table
 
 
 class TestTable(unittest.TestCase):
@@ -37,5 +39,80 @@ class TestTable(unittest.TestCase):
         self.assertEqual(table.to_string(0), pt)
 
 
+class TestAccessor(unittest.TestCase):
+    def test_accessor_gradient_compress_type(self):
+        accessor = Accessor()
+        accessor.accessor_class = "CommMergeAccessor"
+        accessor.feature_dim = 1000
+        accessor.embedding_dim = 8
+
+        pt = "accessor {accessor_class: \"CommMergeAccessor\" " \
+             "fea_dim: 1000 embedx_dim: 8 gradient_compress_type: \"none\" " \
+             "\n\n}"
+        self.assertEqual(accessor.to_string(0), pt)
+
+        accessor.gradient_compress_type = "int8"
+        self.assertIn("gradient_compress_type: \"int8\"",
+                      accessor.to_string(0))
+
+
+class TestGradientCompressType(unittest.TestCase):
+    def setUp(self):
+        os.environ["PADDLE_PSERVER_NUMS"] = "2"
+        os.environ["PADDLE_TRAINERS_NUM"] = "2"
+        os.environ["POD_IP"] = "127.0.0.1"
+        os.environ["PADDLE_PORT"] = "36001"
+        os.environ["PADDLE_TRAINER_ID"] = "0"
+        os.environ["PADDLE_PSERVERS_IP_PORT_LIST"] = \
+            "127.0.0.1:36001,127.0.0.2:36001"
+        os.environ["TRAINING_ROLE"] = "TRAINER"
+
+    def get_fleet_proto(self, configs):
+        import paddle.distributed.fleet as fleet
+
+        main_program = paddle.fluid.Program()
+        startup_program = paddle.fluid.Program()
+
+        paddle.fluid.framework.switch_main_program(main_program)
+        paddle.fluid.framework.switch_startup_program(startup_program)
+
+        fleet.init(role_maker.PaddleCloudRoleMaker())
+        # every strategy builds its own runtime
+        fleet.fleet._runtime_handle = None
+
+        x = paddle.fluid.layers.data(name='x', shape=[1], dtype='int64')
+        emb = paddle.fluid.layers.embedding(
+            input=x, size=[1000, 8], is_sparse=True)
+        y = paddle.fluid.layers.fc(input=emb, size=1)
+        avg_cost = paddle.fluid.layers.mean(y)
+
+        strategy = paddle.distributed.fleet.DistributedStrategy()
+        strategy.a_sync = True
+        strategy.a_sync_configs = configs
+
+        optimizer = paddle.fluid.optimizer.SGD(learning_rate=0.01)
+        optimizer = fleet.distributed_optimizer(optimizer, strategy=strategy)
+        optimizer.minimize(avg_cost)
+
+        runtime = fleet.fleet._runtime_handle
+        runtime._server_sub_program = []
+        return str(runtime._get_fleet_proto(is_server=False, is_sync=False))
+
+    def test_default(self):
+        proto_txt = self.get_fleet_proto({})
+        self.assertNotIn("gradient_compress_type: \"int8\"", proto_txt)
+        self.assertIn("gradient_compress_type: \"none\"", proto_txt)
+
+    def test_int8(self):
+        proto_txt = self.get_fleet_proto({"gradient_compress_type": "int8"})
+        # the sparse and the dense table compress, the barrier table not
+        self.assertEqual(proto_txt.count("gradient_compress_type: \"int8\""),
+                         2)
+
+    def test_invalid(self):
+        self.assertRaises(ValueError, self.get_fleet_proto,
+                          {"gradient_compress_type": "int4"})
+
+
 if __name__ == '__main__':
     unittest.main()
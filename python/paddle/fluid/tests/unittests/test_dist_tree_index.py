@@ -76,6 +76,12 @@ class TestTreeIndex(unittest.TestCase):
         children_ids = [node.id() for node in tree.get_nodes(children_codes)]
         self.assertIn(all_leaf_ids[0], children_ids)
 
+        # get_batch_children
+        batch_children_codes = tree.get_batch_children_codes(
+            [travel_codes[1], travel_codes[2]], height - 1)
+        self.assertEqual(batch_children_codes[:len(children_codes)],
+                         children_codes)
+
 
 class TestIndexSampler(unittest.TestCase):
     def test_layerwise_sampler(self):